@@ -76,6 +76,7 @@ int AudioEncoder::excuteEncodeAudio() {
 
         // 暂停
         if (pauseRequest) {
+            waitWhilePaused();
             continue;
         }
         // 获取原始av数据
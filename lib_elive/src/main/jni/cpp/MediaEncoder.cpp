@@ -27,6 +27,17 @@ void MediaEncoder::pause() {
     mutex.unlock();
 }
 
+/**
+ * pause/resume/stop都会发出通知，唤醒以后重新检查暂停和停止标志
+ */
+void MediaEncoder::waitWhilePaused() {
+    mutex.lock();
+    while (pauseRequest && !abortRequest) {
+        condition.wait(mutex);
+    }
+    mutex.unlock();
+}
+
 void MediaEncoder::putAvData(AvData* data) {
     if (avQueue1){
         avQueue1->putData(data);
@@ -65,6 +65,14 @@ void RtmpLivePush::pause() {
     mutex.unlock();
 }
 
+void RtmpLivePush::waitWhilePaused() {
+    mutex.lock();
+    while (pauseRequest && !abortRequest) {
+        condition.wait(mutex);
+    }
+    mutex.unlock();
+}
+
 void RtmpLivePush::stop() {
     mutex.lock();
     abortRequest = true;
@@ -105,6 +113,7 @@ void RtmpLivePush::excuteRtmpPush() {
         }
         // 暂停
         if (pauseRequest) {
+            waitWhilePaused();
             continue;
         }
         LOGD("编码后数据开始取");
@@ -79,6 +79,7 @@ void VideoEncoder::excuteEncodeVideo() {
 
         // 暂停
         if (pauseRequest) {
+            waitWhilePaused();
             continue;
         }
         LOGD("压缩后YUV数据开始取");
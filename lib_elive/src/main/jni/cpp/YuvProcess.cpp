@@ -98,6 +98,14 @@ void YuvProcess::pause() {
     mutex.unlock();
 }
 
+void YuvProcess::waitWhilePaused() {
+    mutex.lock();
+    while (pauseRequest && !abortRequest) {
+        condition.wait(mutex);
+    }
+    mutex.unlock();
+}
+
 void YuvProcess::flush() {
 
     if (avQueue1) {
@@ -127,6 +135,7 @@ void YuvProcess::excuteProcessYUV() {
         }
         // 暂停
         if (pauseRequest) {
+            waitWhilePaused();
             continue;
         }
 
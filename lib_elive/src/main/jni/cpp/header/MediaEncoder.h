@@ -31,6 +31,9 @@ public:
     virtual void run(); // 虚函数代表子类可以重写
 
 protected:
+    // 暂停时阻塞编码线程，直到继续或者停止
+    void waitWhilePaused();
+
     Mutex mutex;
     Condition condition;
     bool abortRequest=false; // 停止
@@ -30,6 +30,9 @@ class RtmpLivePush : public Runnable {
     } NalType;
 
 private:
+    // 暂停时阻塞推流线程，直到继续或者停止
+    void waitWhilePaused();
+
     Mutex mutex;
     Condition condition;
     bool abortRequest=false; // 停止
@@ -55,6 +55,8 @@ public:
     void setYuvCallback(YuvCallback callback);
 
 private:
+    // 暂停时阻塞处理线程，直到继续或者停止
+    void waitWhilePaused();
 
     Mutex mutex;
     Condition condition;
@@ -223,18 +223,42 @@ int EMediaPlayer::getVideoHeight() {
 
 status_t EMediaPlayer::seekTo(float msec) {
     if (mediaPlayer != nullptr) {
-        // if in seeking state, put seek message in queue, to process after preview seeking.
-        if (mSeeking) {
-            mediaPlayer->getMessageQueue()->postMessage(MSG_REQUEST_SEEK, msec);
-        } else {
-            mediaPlayer->seekTo(msec);
-            mSeekingPosition = (long) msec;
-            mSeeking = true;
-        }
+        // seekTo does not block, a new position replaces the pending one, so only the last one is rendered.
+        mediaPlayer->seekTo(msec);
+        mSeekingPosition = (long) msec;
+        mSeeking = true;
     }
     return NO_ERROR;
 }
 
+status_t EMediaPlayer::stepForward() {
+    if (mediaPlayer == nullptr) {
+        return INVALID_OPERATION;
+    }
+    return mediaPlayer->stepForward();
+}
+
+status_t EMediaPlayer::stepBackward() {
+    if (mediaPlayer == nullptr) {
+        return INVALID_OPERATION;
+    }
+    return mediaPlayer->stepBackward();
+}
+
+status_t EMediaPlayer::setReverse(bool reverse) {
+    if (mediaPlayer == nullptr) {
+        return INVALID_OPERATION;
+    }
+    return mediaPlayer->setReverse(reverse);
+}
+
+bool EMediaPlayer::isReverse() {
+    if (mediaPlayer != nullptr) {
+        return (mediaPlayer->isReverse() != 0);
+    }
+    return false;
+}
+
 long EMediaPlayer::getCurrentPosition() {
     if (mediaPlayer != nullptr) {
         if (mSeeking) {
@@ -306,6 +330,41 @@ void EMediaPlayer::setPitch(float pitch) {
     }
 }
 
+int EMediaPlayer::getTrackCount() {
+    if (mediaPlayer != nullptr) {
+        return mediaPlayer->getTrackCount();
+    }
+    return 0;
+}
+
+int EMediaPlayer::getTrackType(int index) {
+    if (mediaPlayer != nullptr) {
+        return mediaPlayer->getTrackType(index);
+    }
+    return MEDIA_TRACK_TYPE_UNKNOWN;
+}
+
+const char *EMediaPlayer::getTrackLanguage(int index) {
+    if (mediaPlayer != nullptr) {
+        return mediaPlayer->getTrackLanguage(index);
+    }
+    return "und";
+}
+
+int EMediaPlayer::getSelectedTrack(int trackType) {
+    if (mediaPlayer != nullptr) {
+        return mediaPlayer->getSelectedTrack(trackType);
+    }
+    return -1;
+}
+
+status_t EMediaPlayer::selectTrack(int index, bool select) {
+    if (mediaPlayer == nullptr) {
+        return INVALID_OPERATION;
+    }
+    return mediaPlayer->selectTrack(index, select);
+}
+
 status_t EMediaPlayer::setAudioSessionId(int sessionId) {
     if (sessionId < 0) {
         return BAD_VALUE;
@@ -422,7 +481,8 @@ void EMediaPlayer::run() {
             }
 
             case MSG_VIDEO_RENDERING_START: {
-                LOGD("EMediaPlayer is video playing.\n");
+                LOGD("EMediaPlayer is video playing, startup latency: %dms\n", msg.arg1);
+                postEvent(MEDIA_INFO, MEDIA_INFO_RENDERING_START, msg.arg1);
                 break;
             }
 
@@ -468,6 +528,11 @@ void EMediaPlayer::run() {
                 break;
             }
 
+            case MSG_READ_AHEAD_UPDATE: {
+                LOGD("EMediaPlayer read ahead: %dKB, %d%%", msg.arg1, msg.arg2);
+                break;
+            }
+
             case MSG_BUFFERING_UPDATE: {
                 LOGD("EMediaPlayer is buffering: %d, %d", msg.arg1, msg.arg2);
                 postEvent(MEDIA_BUFFERING_UPDATE, msg.arg1, msg.arg2);
@@ -486,6 +551,30 @@ void EMediaPlayer::run() {
                 break;
             }
 
+            case MSG_VARIANT_CHANGED: {
+                LOGD("EMediaPlayer switches to variant %d, %d kbps\n", msg.arg2, msg.arg1);
+                postEvent(MEDIA_INFO, MEDIA_INFO_VARIANT_CHANGED, msg.arg1);
+                break;
+            }
+
+            case MSG_DECODER_LEVEL_CHANGED: {
+                LOGD("EMediaPlayer changes decoder level to %d, decode time %d ms\n", msg.arg1, msg.arg2);
+                postEvent(MEDIA_INFO, MEDIA_INFO_DECODER_LEVEL_CHANGED, msg.arg1);
+                break;
+            }
+
+            case MSG_PRELOAD_COMPLETE: {
+                LOGD("EMediaPlayer preloads %d KB\n", msg.arg1);
+                postEvent(MEDIA_INFO, MEDIA_INFO_PRELOAD_COMPLETE, msg.arg1);
+                break;
+            }
+
+            case MSG_SEEK_RENDERING_START: {
+                LOGD("EMediaPlayer renders the first frame after seeking in %d ms\n", msg.arg1);
+                postEvent(MEDIA_INFO, MEDIA_INFO_SEEK_RENDERING_START, msg.arg1);
+                break;
+            }
+
             case MSG_PLAYBACK_STATE_CHANGED: {
                 LOGD("EMediaPlayer's playback state is changed.");
                 break;
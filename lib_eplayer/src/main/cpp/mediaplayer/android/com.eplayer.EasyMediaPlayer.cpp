@@ -90,10 +90,22 @@ void JNIMediaPlayerListener::notify(int msg, int ext1, int ext2, void *obj) {
     //获取对应线程的JNIEnv对象，将当前线程跟JVM关联
     bool status = (javaVM->AttachCurrentThread(&env, NULL) >= 0);
 
-    // TODO obj needs changing into jobject
+    // 字幕文字是UTF-8字符串，转成byte[]交给java层解码，其他消息不传递对象
+    jobject object = NULL;
+    if (msg == MEDIA_TIMED_TEXT && obj) {
+        jsize length = (jsize) strlen((const char *) obj);
+        jbyteArray array = env->NewByteArray(length);
+        if (array) {
+            env->SetByteArrayRegion(array, 0, length, (const jbyte *) obj);
+            object = array;
+        }
+    }
     //调用java层的static方法，mObject, msg, ext1, ext2, obj 均为方法参数，对应java层handler的方法obtainMessage(what, arg1, arg2, obj)，msg为消息ID
     //调用java层的static方法，关键需要java层对应类的class对象和方法ID，后面就是参数
-    env->CallStaticVoidMethod(mClass, fields.post_event, mObject, msg, ext1, ext2, obj);
+    env->CallStaticVoidMethod(mClass, fields.post_event, mObject, msg, ext1, ext2, object);
+    if (object) {
+        env->DeleteLocalRef(object);
+    }
 
     if (env->ExceptionCheck()) {
         LOGW("An exception occurred while notifying an event.");
@@ -534,6 +546,91 @@ void EMediaPlayer_setPitch(JNIEnv *env, jobject thiz, jfloat pitch) {
     mp->setPitch(pitch);
 }
 
+void EMediaPlayer_stepForward(JNIEnv *env, jobject thiz) {
+    EMediaPlayer *mp = getMediaPlayer(env, thiz);
+    if (mp == NULL) {
+        jniThrowException(env, "java/lang/IllegalStateException");
+        return;
+    }
+    process_media_player_call(env, thiz, mp->stepForward(),
+                              "java/lang/IllegalStateException", "stepForward failed.");
+}
+
+void EMediaPlayer_stepBackward(JNIEnv *env, jobject thiz) {
+    EMediaPlayer *mp = getMediaPlayer(env, thiz);
+    if (mp == NULL) {
+        jniThrowException(env, "java/lang/IllegalStateException");
+        return;
+    }
+    process_media_player_call(env, thiz, mp->stepBackward(),
+                              "java/lang/IllegalStateException", "stepBackward failed.");
+}
+
+void EMediaPlayer_setReverse(JNIEnv *env, jobject thiz, jboolean reverse) {
+    EMediaPlayer *mp = getMediaPlayer(env, thiz);
+    if (mp == NULL) {
+        jniThrowException(env, "java/lang/IllegalStateException");
+        return;
+    }
+    process_media_player_call(env, thiz, mp->setReverse(reverse),
+                              "java/lang/IllegalStateException", "setReverse failed.");
+}
+
+jboolean EMediaPlayer_isReverse(JNIEnv *env, jobject thiz) {
+    EMediaPlayer *mp = getMediaPlayer(env, thiz);
+    if (mp == NULL) {
+        jniThrowException(env, "java/lang/IllegalStateException");
+        return JNI_FALSE;
+    }
+    return (jboolean) (mp->isReverse() ? JNI_TRUE : JNI_FALSE);
+}
+
+jint EMediaPlayer_getTrackCount(JNIEnv *env, jobject thiz) {
+    EMediaPlayer *mp = getMediaPlayer(env, thiz);
+    if (mp == NULL) {
+        jniThrowException(env, "java/lang/IllegalStateException");
+        return 0;
+    }
+    return mp->getTrackCount();
+}
+
+jint EMediaPlayer_getTrackType(JNIEnv *env, jobject thiz, jint index) {
+    EMediaPlayer *mp = getMediaPlayer(env, thiz);
+    if (mp == NULL) {
+        jniThrowException(env, "java/lang/IllegalStateException");
+        return 0;
+    }
+    return mp->getTrackType(index);
+}
+
+jstring EMediaPlayer_getTrackLanguage(JNIEnv *env, jobject thiz, jint index) {
+    EMediaPlayer *mp = getMediaPlayer(env, thiz);
+    if (mp == NULL) {
+        jniThrowException(env, "java/lang/IllegalStateException");
+        return NULL;
+    }
+    return env->NewStringUTF(mp->getTrackLanguage(index));
+}
+
+jint EMediaPlayer_getSelectedTrack(JNIEnv *env, jobject thiz, jint trackType) {
+    EMediaPlayer *mp = getMediaPlayer(env, thiz);
+    if (mp == NULL) {
+        jniThrowException(env, "java/lang/IllegalStateException");
+        return -1;
+    }
+    return mp->getSelectedTrack(trackType);
+}
+
+void EMediaPlayer_selectTrack(JNIEnv *env, jobject thiz, jint index, jboolean select) {
+    EMediaPlayer *mp = getMediaPlayer(env, thiz);
+    if (mp == NULL) {
+        jniThrowException(env, "java/lang/IllegalStateException");
+        return;
+    }
+    process_media_player_call(env, thiz, mp->selectTrack(index, select),
+                              "java/lang/IllegalArgumentException", "selectTrack failed.");
+}
+
 jlong EMediaPlayer_getCurrentPosition(JNIEnv *env, jobject thiz) {
 
     EMediaPlayer *mp = getMediaPlayer(env, thiz);
@@ -649,6 +746,10 @@ static const JNINativeMethod gMethods[] = {
         {"_getVideoHeight",     "()I",                                      (void *) EMediaPlayer_getVideoHeight},
         {"_seekTo",             "(F)V",                                     (void *) EMediaPlayer_seekTo},
         {"_pause",              "()V",                                      (void *) EMediaPlayer_pause},
+        {"_stepForward",        "()V",                                      (void *) EMediaPlayer_stepForward},
+        {"_stepBackward",       "()V",                                      (void *) EMediaPlayer_stepBackward},
+        {"_setReverse",         "(Z)V",                                     (void *) EMediaPlayer_setReverse},
+        {"_isReverse",          "()Z",                                      (void *) EMediaPlayer_isReverse},
         {"_isPlaying",          "()Z",                                      (void *) EMediaPlayer_isPlaying},
         {"_getCurrentPosition", "()J",                                      (void *) EMediaPlayer_getCurrentPosition},
         {"_getDuration",        "()J",                                      (void *) EMediaPlayer_getDuration},
@@ -660,6 +761,11 @@ static const JNINativeMethod gMethods[] = {
         {"_setMute",            "(Z)V",                                     (void *) EMediaPlayer_setMute},
         {"_setRate",            "(F)V",                                     (void *) EMediaPlayer_setRate},
         {"_setPitch",           "(F)V",                                     (void *) EMediaPlayer_setPitch},
+        {"_getTrackCount",      "()I",                                      (void *) EMediaPlayer_getTrackCount},
+        {"_getTrackType",       "(I)I",                                     (void *) EMediaPlayer_getTrackType},
+        {"_getTrackLanguage",   "(I)Ljava/lang/String;",                    (void *) EMediaPlayer_getTrackLanguage},
+        {"_getSelectedTrack",   "(I)I",                                     (void *) EMediaPlayer_getSelectedTrack},
+        {"_selectTrack",        "(IZ)V",                                    (void *) EMediaPlayer_selectTrack},
         {"native_init",         "()V",                                      (void *) EMediaPlayer_init},
         {"native_setup",        "(Ljava/lang/Object;)V",                    (void *) EMediaPlayer_setup},
         {"native_finalize",     "()V",                                      (void *) EMediaPlayer_finalize},
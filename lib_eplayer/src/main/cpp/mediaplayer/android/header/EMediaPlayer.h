@@ -73,6 +73,16 @@ enum media_info_type {
 
     //9xx
             MEDIA_INFO_TIMED_TEXT_ERROR = 900,
+
+    //10xxx
+    // The first frame after seeking has been rendered, extra is the time from the last seek request in ms
+            MEDIA_INFO_SEEK_RENDERING_START = 10001,
+    // Adaptive bitrate switched to another variant, extra is the bitrate of the new variant in kbps
+            MEDIA_INFO_VARIANT_CHANGED = 10002,
+    // Preloading is complete and the first frame is decoded, extra is the preload memory budget used in KB
+            MEDIA_INFO_PRELOAD_COMPLETE = 10003,
+    // The video decoder changed its degradation level under overload, extra is the new level
+            MEDIA_INFO_DECODER_LEVEL_CHANGED = 10004,
 };
 
 //这是一个抽象类，类似于Java的接口，notify方法留给实现类去定义
@@ -138,6 +148,14 @@ public:
 
     status_t seekTo(float msec);
 
+    status_t stepForward();
+
+    status_t stepBackward();
+
+    status_t setReverse(bool reverse);
+
+    bool isReverse();
+
     long getCurrentPosition();
 
     long getDuration();
@@ -158,6 +176,16 @@ public:
 
     void setPitch(float pitch);
 
+    int getTrackCount();
+
+    int getTrackType(int index);
+
+    const char *getTrackLanguage(int index);
+
+    int getSelectedTrack(int trackType);
+
+    status_t selectTrack(int index, bool select);
+
     status_t setAudioSessionId(int sessionId);
 
     int getAudioSessionId();
@@ -10,10 +10,19 @@ AudioResampler::AudioResampler(PlayerState *playerState, AudioDecoder *audioDeco
     memset(audioState, 0, sizeof(AudioState));
     soundTouchWrapper = new SoundTouchWrapper();
     frame = av_frame_alloc();
-
+    pcmQueue = new PcmQueue(playerState->pcmQueueDepth);
+    playBuffer = NULL;
+    resampleThread = NULL;
+    abortRequest = true;
+    underrunCount = 0;
 }
 
 AudioResampler::~AudioResampler() {
+    stop();
+    if (pcmQueue) {
+        delete pcmQueue;
+        pcmQueue = NULL;
+    }
     playerState = NULL;
     audioDecoder = NULL;
     mediaSync = NULL;
@@ -24,6 +33,7 @@ AudioResampler::~AudioResampler() {
     if (audioState) {
         swr_free(&audioState->swr_ctx);
         av_freep(&audioState->resampleBuffer);
+        av_freep(&audioState->soundTouchBuffer);
         memset(audioState, 0, sizeof(AudioState));
         av_free(audioState);
         audioState = NULL;
@@ -71,13 +81,92 @@ int AudioResampler::setResampleParams(AudioDeviceSpec *spec, int64_t wanted_chan
     return 0;
 }
 
+/**
+ * 开启音频解码线程，需要在设置重采样参数以后调用
+ */
+void AudioResampler::start() {
+    if (resampleThread) {
+        return;
+    }
+    abortRequest = false;
+    pcmQueue->start();
+    resampleThread = new Thread(this, Priority_High);
+    resampleThread->start();
+}
+
+/**
+ * 停止音频解码线程，需要先停止音频解码器，否则线程可能阻塞在取数据包中
+ */
+void AudioResampler::stop() {
+    abortRequest = true;
+    pcmQueue->abort();
+    if (resampleThread) {
+        resampleThread->join();
+        delete resampleThread;
+        resampleThread = NULL;
+    }
+}
+
+/**
+ * 定位时清空PCM队列，音频回调会丢弃旧的数据
+ */
+void AudioResampler::flush() {
+    pcmQueue->flush();
+}
+
+int64_t AudioResampler::getUnderrunCount() {
+    return underrunCount;
+}
+
+/**
+ * 音频解码线程，提前解码和重采样，写入PCM队列中
+ */
+void AudioResampler::run() {
+    while (!abortRequest && !playerState->abortRequest) {
+        // 队列已满时阻塞
+        PcmBuffer *buffer = pcmQueue->peekWritable();
+        if (!buffer) {
+            break;
+        }
+        // 读数据包线程只在送入数据包以后检查缓冲状态，这时队列不会是空的，没有视频时也没有同步线程
+        // 所以在取数据包之前检查一次，队列已经取空时开始缓冲
+        if (mediaSync) {
+            mediaSync->updateBuffering();
+        }
+        // 解码之前记录序列号，解码过程中发生定位时这块数据会被丢弃
+        int serial = pcmQueue->getSerial();
+        int size = audioFrameResample();
+        if (size < 0) {
+            av_frame_unref(frame);
+            continue;
+        }
+        av_fast_malloc(&buffer->data, &buffer->capacity, (size_t) size);
+        if (!buffer->data) {
+            av_frame_unref(frame);
+            continue;
+        }
+        memcpy(buffer->data, audioState->outputBuffer, (size_t) size);
+        // 没有重采样时outputBuffer指向frame中的数据，复制完以后才能释放引用
+        av_frame_unref(frame);
+        buffer->size = size;
+        buffer->clock = audioState->frameClock;
+        buffer->serial = serial;
+        pcmQueue->pushBuffer();
+        // 音频回调不能加锁，也不能投递消息，每写入一块数据通知一次当前位置，同步到视频时钟时由同步线程通知
+        if (playerState->messageQueue && playerState->syncType != AV_SYNC_VIDEO) {
+            playerState->messageQueue->postMessage(MSG_CURRENT_POSITON, mediaSync->getCurrentPosition(),
+                                                   playerState->videoDuration);
+        }
+    }
+}
+
 /**
  * PCM队列回调方法，用于取得PCM数据
  * @param stream
  * @param len 需要读取数据的长度
  */
 void AudioResampler::pcmQueueCallback(uint8_t *stream, int len) {
-    int bufferSize, length;
+    int length;
 
     // 没有音频解码器时，直接返回
     if (!audioDecoder) {
@@ -88,17 +177,30 @@ void AudioResampler::pcmQueueCallback(uint8_t *stream, int len) {
     //单位:AV_TIME_BASE,即ffmpeg内部使用的时间单位，返回的可能是从系统启动那一刻开始计时的时间
     audioState->audio_callback_time = av_gettime_relative();
     while (len > 0) {
-        //一般 audioState->bufferSize 为一次audioFrameResample采集音频数据大小，audioState->bufferIndex 实际上就是这些数据写了多少
+        //一般 audioState->bufferSize 为一块PCM数据的大小，audioState->bufferIndex 实际上就是这些数据写了多少
         if (audioState->bufferIndex >= audioState->bufferSize) {
-            //采集的音频数据保存到audioState->outputBuffer缓存区中
-            bufferSize = audioFrameResample();
-            if (bufferSize < 0) {
+            // 当前缓冲块已经播放完，归还给音频解码线程
+            if (playBuffer) {
+                pcmQueue->popBuffer();
+                playBuffer = NULL;
+            }
+            // 暂停、缓冲和倒放时不消耗数据，这里只复制数据，不做解码和重采样
+            if (!playerState->abortRequest && !playerState->pauseRequest && !playerState->buffering
+                && !playerState->reversePlayback) {
+                playBuffer = pcmQueue->peekReadable();
+                if (!playBuffer) {
+                    underrunCount++;
+                }
+            }
+            if (playBuffer) {
+                audioState->outputBuffer = playBuffer->data;
+                audioState->bufferSize = (unsigned int) playBuffer->size;
+                audioState->audioClock = playBuffer->clock;
+            } else {
                 audioState->outputBuffer = NULL;
                 audioState->bufferSize = (unsigned int) (AUDIO_MIN_BUFFER_SIZE /
                                                          audioState->audioParamsTarget.frame_size *
                                                          audioState->audioParamsTarget.frame_size);
-            } else {
-                audioState->bufferSize = bufferSize;
             }
             audioState->bufferIndex = 0;
         }
@@ -128,9 +230,11 @@ void AudioResampler::pcmQueueCallback(uint8_t *stream, int len) {
 
     if (!isnan(audioState->audioClock) && mediaSync) {
         //audioState->audioClock代表当前帧播放完时的时刻，
+        // 变速以后输出的每一秒数据对应播放速度倍数的媒体时长，还没有播放的数据换算成媒体时长时要乘上播放速度
+        double speed = playerState->playbackRate * playerState->liveCatchUpRate;
         mediaSync->updateAudioClock(audioState->audioClock -
                                     (double) (2 * audioState->audio_hw_buf_size + audioState->writeBufferSize) /
-                                    audioState->audioParamsTarget.bytes_per_sec,
+                                    audioState->audioParamsTarget.bytes_per_sec * speed,
                                     audioState->audio_callback_time / 1000000.0);
     }
 }
@@ -172,8 +276,8 @@ int AudioResampler::audioFrameResample() {
     int translate_time = 1;
     int ret = -1;
 
-    // 处于暂停状态
-    if (!audioDecoder || playerState->abortRequest || playerState->pauseRequest) {
+    // 暂停时也继续解码，PCM队列写满以后解码线程会阻塞
+    if (!audioDecoder || playerState->abortRequest) {
         return -1;
     }
 
@@ -280,8 +384,9 @@ int AudioResampler::audioFrameResample() {
             resampled_data_size = len2 * audioState->audioParamsTarget.channels *
                                   av_get_bytes_per_sample(audioState->audioParamsTarget.fmt);
 
-            // 变速变调处理
-            if ((playerState->playbackRate != 1.0f || playerState->playbackPitch != 1.0f) &&
+            // 变速变调处理，直播追赶延时的速度叠加到播放速度上
+            float playbackRate = playerState->playbackRate * playerState->liveCatchUpRate;
+            if ((playbackRate != 1.0f || playerState->playbackPitch != 1.0f) &&
                 !playerState->abortRequest) {
                 int bytes_per_sample = av_get_bytes_per_sample(audioState->audioParamsTarget.fmt);
                 av_fast_malloc(&audioState->soundTouchBuffer, &audioState->soundTouchBufferSize,
@@ -294,9 +399,9 @@ int AudioResampler::audioFrameResample() {
                     soundTouchWrapper = new SoundTouchWrapper();
                 }
                 int ret_len = soundTouchWrapper->translate(audioState->soundTouchBuffer,
-                                                           (float) (playerState->playbackRate),
+                                                           playbackRate,
                                                            (float) (playerState->playbackPitch != 1.0f
-                                                                    ? playerState->playbackPitch : 1.0f /playerState->playbackRate),
+                                                                    ? playerState->playbackPitch : 1.0f / playbackRate),
                                                            resampled_data_size / 2,
                                                            bytes_per_sample,
                                                            audioState->audioParamsTarget.channels,
@@ -319,17 +424,15 @@ int AudioResampler::audioFrameResample() {
         break;
     }
 
-    // 利用pts更新音频时钟
+    // 利用pts计算这一帧播放完时的音频时钟
     if (frame->pts != AV_NOPTS_VALUE) {
-        audioState->audioClock = frame->pts * av_q2d((AVRational) {1, frame->sample_rate}) +
+        audioState->frameClock = frame->pts * av_q2d((AVRational) {1, frame->sample_rate}) +
                                  (double) frame->nb_samples / frame->sample_rate;
     } else {
-        audioState->audioClock = NAN;
+        audioState->frameClock = NAN;
     }
 
-    // 使用完成释放引用，防止内存泄漏
-    av_frame_unref(frame);
-
+    // frame的引用在数据复制到PCM队列以后释放
     return resampled_data_size;
 }
 
@@ -6,6 +6,7 @@
 #include <MediaSync.h>
 #include <SoundTouchWrapper.h>
 #include <AudioDevice.h>
+#include <PcmQueue.h>
 #include "AndroidLog.h"
 
 /**
@@ -25,6 +26,7 @@ typedef struct AudioParams {
  */
 typedef struct AudioState {
     double audioClock;                      // 音频时钟
+    double frameClock;                      // 解码线程当前重采样帧播放完时的时钟
     double audio_diff_cum;
     double audio_diff_avg_coef;
     double audio_diff_threshold;
@@ -45,9 +47,9 @@ typedef struct AudioState {
 } AudioState;
 
 /**
- * 音频重采样器
+ * 音频重采样器，解码和重采样在独立线程中进行，音频回调只从PCM队列中复制数据
  */
-class AudioResampler {
+class AudioResampler : public Runnable {
 public:
     AudioResampler(PlayerState *playerState, AudioDecoder *audioDecoder, MediaSync *mediaSync);
 
@@ -55,8 +57,18 @@ public:
 
     int setResampleParams(AudioDeviceSpec *spec, int64_t wanted_channel_layout);
 
+    void start();
+
+    void stop();
+
+    void flush();
+
     void pcmQueueCallback(uint8_t *stream, int len);
 
+    int64_t getUnderrunCount();
+
+    void run() override;
+
 private:
     int audioSynchronize(int nbSamples);
 
@@ -70,6 +82,12 @@ private:
     AudioDecoder *audioDecoder;             // 音频解码器
     AudioState *audioState;                 // 音频重采样状态
     SoundTouchWrapper *soundTouchWrapper;   // 变速变调处理
+
+    PcmQueue *pcmQueue;                     // 重采样后的PCM队列
+    PcmBuffer *playBuffer;                  // 音频回调当前正在播放的缓冲块
+    Thread *resampleThread;                 // 音频解码线程
+    bool abortRequest;
+    int64_t underrunCount;                  // 音频回调取不到数据的次数
 };
 
 #endif //EPLAYER_AUDIORESAMPLER_H
@@ -19,6 +19,23 @@ AudioDecoder::~AudioDecoder() {
     mMutex.unlock();
 }
 
+/**
+ * 旧音频流还没有送入解码器的数据包和推算的时间戳都要丢弃
+ */
+void AudioDecoder::changeStream(AVCodecContext *avctx, AVStream *stream, int streamIndex) {
+    if (packetPending) {
+        av_packet_unref(packet);
+        packetPending = 0;
+    }
+    next_pts = AV_NOPTS_VALUE;
+    MediaDecoder::changeStream(avctx, stream, streamIndex);
+}
+
+/**
+ * 取得一帧音频，先取出解码器中已经解码好的帧，解码器返回EAGAIN以后才送入下一个数据包
+ * @param frame
+ * @return
+ */
 int AudioDecoder::getAudioFrame(AVFrame *frame) {
     int got_frame = 0;
     int ret = 0;
@@ -36,48 +53,22 @@ int AudioDecoder::getAudioFrame(AVFrame *frame) {
         }
 
         if (playerState->seekRequest) { //正在定位
-            continue;
-        }
-
-        AVPacket pkt;
-        if (packetPending) {
-            av_packet_move_ref(&pkt, packet);
-            packetPending = 0;
-        } else {
-            //取出数据包
-            if (packetQueue->getPacket(&pkt) < 0) {
-                ret = -1;
-                break;
-            }
-        }
-
-        playerState->mMutex.lock();
-        // 将数据包解码
-        ret = avcodec_send_packet(pCodecCtx, &pkt);
-        if (ret < 0) {
-            // 一次解码无法消耗完AVPacket中的所有数据，需要重新解码
-            if (ret == AVERROR(EAGAIN)) {
-                av_packet_move_ref(packet, &pkt);
-                packetPending = 1;
-            } else {
-                av_packet_unref(&pkt);
+            // 定位以后解码器会被清空，未送入的数据包也要丢弃
+            if (packetPending) {
+                av_packet_unref(packet);
                 packetPending = 0;
             }
-            playerState->mMutex.unlock();
+            // 阻塞到定位完成，不再空转
+            playerState->waitForSeek(&abortRequest);
             continue;
         }
 
-        // 获取解码得到的音频帧AVFrame
+        // 获取解码得到的音频帧AVFrame，只锁住当前解码器
+        mCodecMutex.lock();
         ret = avcodec_receive_frame(pCodecCtx, frame);
-        playerState->mMutex.unlock();
-        // 释放数据包的引用，防止内存泄漏
-        av_packet_unref(packet);
-        if (ret < 0) {
-            av_frame_unref(frame);
-            got_frame = 0;
-            continue;
-        } else { //取到了音频帧
-            got_frame = 1;
+        mCodecMutex.unlock();
+
+        if (ret >= 0) { //取到了音频帧
             // 这里要重新计算frame的pts 否则会导致网络视频出现pts 对不上的情况
             AVRational tb = (AVRational) {1, frame->sample_rate};
             if (frame->pts != AV_NOPTS_VALUE) {
@@ -91,6 +82,48 @@ int AudioDecoder::getAudioFrame(AVFrame *frame) {
                 next_pts = frame->pts + frame->nb_samples;
                 next_pts_tb = tb;
             }
+            // 精确定位时丢弃目标之前的音频帧
+            if (isBeforeSeekTarget(frame->pts == AV_NOPTS_VALUE ? NAN
+                                   : (frame->pts + frame->nb_samples) * av_q2d(tb))) {
+                av_frame_unref(frame);
+                continue;
+            }
+            got_frame = 1;
+            break;
+        }
+
+        av_frame_unref(frame);
+        if (ret == AVERROR_EOF) {
+            // 空数据包送入以后解码器已经排空，重置解码器以便继续解码
+            mCodecMutex.lock();
+            avcodec_flush_buffers(pCodecCtx);
+            mCodecMutex.unlock();
+        }
+
+        // 解码器需要新的数据包
+        AVPacket pkt;
+        if (packetPending) {
+            av_packet_move_ref(&pkt, packet);
+            packetPending = 0;
+        } else {
+            //取出数据包
+            if (getPacket(&pkt) < 0) {
+                ret = -1;
+                break;
+            }
+        }
+
+        // 将数据包解码
+        mCodecMutex.lock();
+        ret = avcodec_send_packet(pCodecCtx, &pkt);
+        mCodecMutex.unlock();
+        if (ret == AVERROR(EAGAIN)) {
+            // 解码器还有未取出的帧，先取帧以后再重新送入
+            av_packet_move_ref(packet, &pkt);
+            packetPending = 1;
+        } else {
+            // 释放数据包的引用，防止内存泄漏
+            av_packet_unref(&pkt);
         }
     } while (!got_frame); //解码帧成功即退出
 
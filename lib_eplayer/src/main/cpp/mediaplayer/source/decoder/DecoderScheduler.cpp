@@ -0,0 +1,95 @@
+
+#include "DecoderScheduler.h"
+#include <unistd.h>
+
+DecoderScheduler *DecoderScheduler::instance;
+std::mutex DecoderScheduler::mutex;
+
+DecoderScheduler::DecoderScheduler() {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    workerCount = cores > 0 ? (int) cores : 1;
+    busyWorkers = 0;
+    playerCount = 0;
+    for (int i = 0; i < DECODE_PRIORITY_COUNT; i++) {
+        waiters[i] = 0;
+    }
+}
+
+DecoderScheduler::~DecoderScheduler() {
+}
+
+DecoderScheduler *DecoderScheduler::getInstance() {
+    if (!instance) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!instance) {
+            instance = new(std::nothrow) DecoderScheduler();
+        }
+    }
+    return instance;
+}
+
+void DecoderScheduler::attach() {
+    Mutex::Autolock lock(mMutex);
+    playerCount++;
+}
+
+void DecoderScheduler::detach() {
+    Mutex::Autolock lock(mMutex);
+    if (playerCount > 0) {
+        playerCount--;
+    }
+}
+
+/**
+ * CPU核数平均分给使用调度器的播放器，至少一个线程
+ * @return
+ */
+int DecoderScheduler::getCodecThreadCount() {
+    Mutex::Autolock lock(mMutex);
+    return playerCount > 1 ? (workerCount + playerCount - 1) / playerCount : workerCount;
+}
+
+bool DecoderScheduler::hasHigherWaiter(int priority) {
+    for (int i = priority + 1; i < DECODE_PRIORITY_COUNT; i++) {
+        if (waiters[i] > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * 有空闲的工作槽并且没有更高优先级的线程在等待时才能拿到工作槽
+ * @param priority
+ * @param abort
+ * @return
+ */
+bool DecoderScheduler::acquire(int priority, const bool *abort) {
+    priority = priority < 0 ? 0 : (priority >= DECODE_PRIORITY_COUNT ? DECODE_PRIORITY_COUNT - 1 : priority);
+    Mutex::Autolock lock(mMutex);
+    waiters[priority]++;
+    while ((busyWorkers >= workerCount || hasHigherWaiter(priority)) && !(abort && *abort)) {
+        mCondition.wait(mMutex);
+    }
+    waiters[priority]--;
+    if (abort && *abort) {
+        // 自己不再等待以后低优先级的线程可能可以拿到工作槽
+        mCondition.broadcast();
+        return false;
+    }
+    busyWorkers++;
+    return true;
+}
+
+void DecoderScheduler::release() {
+    Mutex::Autolock lock(mMutex);
+    if (busyWorkers > 0) {
+        busyWorkers--;
+    }
+    mCondition.broadcast();
+}
+
+void DecoderScheduler::wakeUp() {
+    Mutex::Autolock lock(mMutex);
+    mCondition.broadcast();
+}
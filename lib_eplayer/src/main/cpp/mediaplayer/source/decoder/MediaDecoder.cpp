@@ -8,6 +8,8 @@ MediaDecoder::MediaDecoder(AVCodecContext *avctx, AVStream *stream, int streamIn
     this->pStream = stream;
     this->streamIndex = streamIndex;
     this->playerState = playerState;
+    seekTarget = AV_NOPTS_VALUE;
+    flushSerial = 0;
 }
 
 MediaDecoder::~MediaDecoder() {
@@ -41,6 +43,8 @@ void MediaDecoder::stop() {
     abortRequest = true;
     mCondition.signal();
     mMutex.unlock();
+    // 唤醒阻塞在暂停/定位门限上的解码线程
+    playerState->signalGate();
     if (packetQueue) {
         packetQueue->abort();
     }
@@ -50,10 +54,20 @@ void MediaDecoder::flush() {
     if (packetQueue) {
         packetQueue->flush();
     }
+    // 新的定位会重新设置目标
+    seekTarget = AV_NOPTS_VALUE;
     // 定位时，音视频均需要清空缓冲区
-    playerState->mMutex.lock();
+    mCodecMutex.lock();
     avcodec_flush_buffers(getCodecContext());
-    playerState->mMutex.unlock();
+    // 跟清空解码器在同一个锁里，取帧时记录的序列号不一致说明帧是清空之前解码的
+    flushSerial++;
+    mCodecMutex.unlock();
+}
+
+void MediaDecoder::dropPackets() {
+    if (packetQueue) {
+        packetQueue->flush();
+    }
 }
 
 int MediaDecoder::pushPacket(AVPacket *pkt) {
@@ -63,6 +77,13 @@ int MediaDecoder::pushPacket(AVPacket *pkt) {
     return 0;
 }
 
+int MediaDecoder::pushNullPacket() {
+    if (packetQueue) {
+        return packetQueue->pushNullPacket(streamIndex);
+    }
+    return 0;
+}
+
 int MediaDecoder::getPacketSize() {
     return packetQueue ? packetQueue->getPacketSize() : 0;
 }
@@ -83,12 +104,157 @@ int MediaDecoder::getMemorySize() {
     return packetQueue ? packetQueue->getSize() : 0;
 }
 
+const QueueWatermark *MediaDecoder::getWatermark() {
+    return pCodecCtx->codec_type == AVMEDIA_TYPE_AUDIO ? &playerState->audioWatermark
+                                                       : &playerState->videoWatermark;
+}
+
+/**
+ * 队列是否达到高水位，字节数或者时长任意一个达到即可
+ * @return
+ */
 int MediaDecoder::hasEnoughPackets() {
     Mutex::Autolock lock(mMutex);
+    const QueueWatermark *watermark = getWatermark();
     return (packetQueue == NULL) || (packetQueue->isAbort())
            || (pStream->disposition & AV_DISPOSITION_ATTACHED_PIC)
+           || (packetQueue->getSize() >= watermark->highBytes)
            || (packetQueue->getPacketSize() > MIN_FRAMES) &&
-              (!packetQueue->getDuration() || av_q2d(pStream->time_base) * packetQueue->getDuration() > 1.0);
+              (!packetQueue->getDuration() ||
+               av_q2d(pStream->time_base) * packetQueue->getDuration() > watermark->highSeconds);
+}
+
+int MediaDecoder::hasBufferedDuration(double seconds) {
+    Mutex::Autolock lock(mMutex);
+    if (packetQueue == NULL || packetQueue->isAbort()
+        || (pStream->disposition & AV_DISPOSITION_ATTACHED_PIC)) {
+        return 1;
+    }
+    if (!packetQueue->getDuration()) {
+        return packetQueue->getPacketSize() > MIN_FRAMES;
+    }
+    return av_q2d(pStream->time_base) * packetQueue->getDuration() >= seconds;
+}
+
+/**
+ * 队列是否低于低水位，字节数和时长都低于低水位才需要补充数据
+ * @return
+ */
+int MediaDecoder::isBelowLowWatermark() {
+    Mutex::Autolock lock(mMutex);
+    if (packetQueue == NULL || packetQueue->isAbort()
+        || (pStream->disposition & AV_DISPOSITION_ATTACHED_PIC)) {
+        return 0;
+    }
+    const QueueWatermark *watermark = getWatermark();
+    if (packetQueue->getSize() >= watermark->lowBytes) {
+        return 0;
+    }
+    if (!packetQueue->getDuration()) {
+        return packetQueue->getPacketSize() <= MIN_FRAMES / 2;
+    }
+    return av_q2d(pStream->time_base) * packetQueue->getDuration() < watermark->lowSeconds;
+}
+
+/**
+ * 数据包没有时长的时候按照数据包数量估算
+ * @return
+ */
+double MediaDecoder::getBufferingProgress() {
+    Mutex::Autolock lock(mMutex);
+    if (packetQueue == NULL || packetQueue->isAbort()
+        || (pStream->disposition & AV_DISPOSITION_ATTACHED_PIC)) {
+        return 1.0;
+    }
+    const QueueWatermark *watermark = getWatermark();
+    if (packetQueue->getSize() >= watermark->highBytes) {
+        return 1.0;
+    }
+    if (!packetQueue->getDuration()) {
+        return FFMIN(packetQueue->getPacketSize() / (double) MIN_FRAMES, 1.0);
+    }
+    double duration = av_q2d(pStream->time_base) * packetQueue->getDuration();
+    return playerState->bufferingSeconds > 0 ? FFMIN(duration / playerState->bufferingSeconds, 1.0) : 1.0;
+}
+
+double MediaDecoder::getQueueLevel() {
+    Mutex::Autolock lock(mMutex);
+    if (packetQueue == NULL || packetQueue->isAbort()
+        || (pStream->disposition & AV_DISPOSITION_ATTACHED_PIC)) {
+        return 1.0;
+    }
+    const QueueWatermark *watermark = getWatermark();
+    double level = watermark->highBytes > 0 ? packetQueue->getSize() / (double) watermark->highBytes : 1.0;
+    if (packetQueue->getDuration() && watermark->highSeconds > 0) {
+        double duration = av_q2d(pStream->time_base) * packetQueue->getDuration();
+        level = FFMAX(level, duration / watermark->highSeconds);
+    }
+    return FFMIN(level, 1.0);
+}
+
+int MediaDecoder::getPacket(AVPacket *pkt) {
+    int ret = packetQueue->getPacket(pkt);
+    if (ret > 0 && playerState->bufferWaiting && isBelowLowWatermark()) {
+        playerState->notifyBufferDrained();
+    }
+    return ret;
+}
+
+int MediaDecoder::getFlushSerial() {
+    return flushSerial;
+}
+
+/**
+ * 解码线程阻塞在帧队列上时可能已经发生了定位，这时拿着的帧属于定位之前的位置
+ * @param serial 从解码器取帧时的序列号
+ * @return
+ */
+bool MediaDecoder::isStaleFrame(int serial) {
+    return serial != flushSerial || playerState->seekRequest;
+}
+
+void MediaDecoder::setSeekTarget(int64_t target) {
+    seekTarget = target;
+}
+
+/**
+ * 数据包队列只清空不重建，读数据包线程可以继续往里面送数据包
+ * @param avctx
+ * @param stream
+ * @param streamIndex
+ */
+void MediaDecoder::changeStream(AVCodecContext *avctx, AVStream *stream, int streamIndex) {
+    if (packetQueue) {
+        packetQueue->flush();
+    }
+    mCodecMutex.lock();
+    if (pCodecCtx) {
+        avcodec_close(pCodecCtx);
+        avcodec_free_context(&pCodecCtx);
+    }
+    pCodecCtx = avctx;
+    pStream = stream;
+    this->streamIndex = streamIndex;
+    mCodecMutex.unlock();
+    seekTarget = AV_NOPTS_VALUE;
+}
+
+/**
+ * 精确定位时判断帧是否在目标之前，帧的结束时间超过目标时说明已经到达目标帧
+ * @param endTime 帧的结束时间，单位秒，没有时间戳时视为已经到达
+ * @return
+ */
+bool MediaDecoder::isBeforeSeekTarget(double endTime) {
+    int64_t target = seekTarget;
+    if (target == AV_NOPTS_VALUE) {
+        return false;
+    }
+    if (!isnan(endTime) && endTime * AV_TIME_BASE <= target) {
+        return true;
+    }
+    // 只清除当前的目标，不覆盖读数据包线程新设置的目标
+    seekTarget.compare_exchange_strong(target, AV_NOPTS_VALUE);
+    return false;
 }
 
 void MediaDecoder::run() {
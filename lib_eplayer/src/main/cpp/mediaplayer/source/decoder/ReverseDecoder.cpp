@@ -0,0 +1,470 @@
+
+#include "ReverseDecoder.h"
+
+ReverseDecoder::ReverseDecoder(PlayerState *playerState, AVFormatContext *pFormatCtx, AVStream *stream,
+                               AVCodecContext *videoCtx) {
+    this->playerState = playerState;
+    decodeThread = NULL;
+    abortRequest = true;
+    finished = false;
+    url = av_strdup(playerState->url);
+    iformat = pFormatCtx->iformat;
+    streamId = stream->id;
+    streamIndex = stream->index;
+    timeBase = stream->time_base;
+    codecpar = avcodec_parameters_alloc();
+    if (codecpar && avcodec_parameters_copy(codecpar, stream->codecpar) < 0) {
+        avcodec_parameters_free(&codecpar);
+    }
+    codec = videoCtx && videoCtx->codec ? videoCtx->codec : avcodec_find_decoder(stream->codecpar->codec_id);
+    AVRational frameRate = av_guess_frame_rate(pFormatCtx, stream, NULL);
+    frameDuration = frameRate.num && frameRate.den ? av_q2d((AVRational) {frameRate.den, frameRate.num}) : 0;
+    streamStartPts = 0;
+
+    this->pFormatCtx = NULL;
+    pCodecCtx = NULL;
+    swsContext = NULL;
+
+    memset(gops, 0, sizeof(gops));
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < REVERSE_GOP_MAX_FRAMES; j++) {
+            gops[i].frames[j].frame = av_frame_alloc();
+        }
+        gops[i].capacity = 1;
+    }
+    fillIndex = 0;
+    presentIndex = 0;
+    memset(&shownFrame, 0, sizeof(Frame));
+    shownFrame.frame = av_frame_alloc();
+    shownBytes = 0;
+
+    startPosition = NAN;
+    endPts = AV_NOPTS_VALUE;
+    retreat = 0;
+    gopFrames = 0;
+    downscale = 0;
+
+    decodedFrames = 0;
+    redecodeCount = 0;
+    decodeTime = 0;
+    peakBytes = 0;
+}
+
+ReverseDecoder::~ReverseDecoder() {
+    stop();
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < REVERSE_GOP_MAX_FRAMES; j++) {
+            av_frame_free(&gops[i].frames[j].frame);
+        }
+    }
+    av_frame_free(&shownFrame.frame);
+    if (pCodecCtx) {
+        avcodec_free_context(&pCodecCtx);
+    }
+    if (pFormatCtx) {
+        avformat_close_input(&pFormatCtx);
+    }
+    if (swsContext) {
+        sws_freeContext(swsContext);
+        swsContext = NULL;
+    }
+    avcodec_parameters_free(&codecpar);
+    av_freep(&url);
+}
+
+void ReverseDecoder::start(double position) {
+    startPosition = position;
+    if (!decodeThread) {
+        abortRequest = false;
+        decodeThread = new Thread(this);
+        decodeThread->start();
+    }
+}
+
+void ReverseDecoder::stop() {
+    mMutex.lock();
+    abortRequest = true;
+    mCondition.signal();
+    mMutex.unlock();
+    if (decodeThread) {
+        decodeThread->join();
+        delete decodeThread;
+        decodeThread = NULL;
+        LOGD("倒放解码%d帧，平均每帧%.1fms，分段重复解码%d次，图像缩小到1/%d，GOP缓冲内存峰值%lldKB",
+             decodedFrames, decodedFrames > 0 ? decodeTime / 1000.0 / decodedFrames : 0,
+             redecodeCount, 1 << downscale, (long long) (peakBytes / 1024));
+    }
+}
+
+double ReverseDecoder::getStartPosition() {
+    return startPosition;
+}
+
+/**
+ * 先取正在显示的GOP，取完了再取已经解码好的前一个GOP
+ * @param offset
+ * @return
+ */
+Frame *ReverseDecoder::peekFrame(int offset) {
+    Mutex::Autolock lock(mMutex);
+    for (int i = 0; i < 2; i++) {
+        ReverseGop *gop = &gops[(presentIndex + i) % 2];
+        if (!gop->ready) {
+            return NULL;
+        }
+        if (offset < gop->count) {
+            return &gop->frames[(gop->head + gop->count - 1 - offset) % gop->capacity];
+        }
+        offset -= gop->count;
+    }
+    return NULL;
+}
+
+/**
+ * 帧的引用移到正在显示的帧中，GOP取完以后马上交给解码线程填充
+ */
+void ReverseDecoder::popFrame() {
+    Mutex::Autolock lock(mMutex);
+    ReverseGop *gop = &gops[presentIndex];
+    if (!gop->ready || gop->count == 0) {
+        return;
+    }
+    Frame *vp = &gop->frames[(gop->head + gop->count - 1) % gop->capacity];
+    int64_t bytes = getFrameBytes(vp->width, vp->height, vp->format, 0);
+    av_frame_unref(shownFrame.frame);
+    av_frame_move_ref(shownFrame.frame, vp->frame);
+    shownFrame.pts = vp->pts;
+    shownFrame.duration = vp->duration;
+    shownFrame.width = vp->width;
+    shownFrame.height = vp->height;
+    shownFrame.format = vp->format;
+    shownFrame.uploaded = 0;
+    shownFrame.seekFrame = 0;
+    shownBytes = bytes;
+    gop->bytes -= bytes;
+    gop->count--;
+    if (gop->count == 0) {
+        gop->ready = false;
+        gop->bytes = 0;
+        presentIndex = (presentIndex + 1) % 2;
+        mCondition.signal();
+    }
+}
+
+Frame *ReverseDecoder::getShownFrame() {
+    Mutex::Autolock lock(mMutex);
+    return shownFrame.frame && shownFrame.frame->buf[0] ? &shownFrame : NULL;
+}
+
+bool ReverseDecoder::isFinished() {
+    Mutex::Autolock lock(mMutex);
+    return finished && !gops[presentIndex].ready;
+}
+
+int ReverseDecoder::interruptCallback(void *opaque) {
+    ReverseDecoder *decoder = (ReverseDecoder *) opaque;
+    return decoder->abortRequest || decoder->playerState->abortRequest;
+}
+
+/**
+ * 打开独立的解复用器和解码器，头部就有媒体流信息的封装格式不需要再探测
+ * @return
+ */
+int ReverseDecoder::openInput() {
+    AVDictionary *opts = NULL;
+    int index = -1;
+    int ret;
+
+    if (!url || !codecpar || !codec) {
+        return AVERROR(EINVAL);
+    }
+    pFormatCtx = avformat_alloc_context();
+    if (!pFormatCtx) {
+        return AVERROR(ENOMEM);
+    }
+    pFormatCtx->interrupt_callback.callback = interruptCallback;
+    pFormatCtx->interrupt_callback.opaque = this;
+    if ((ret = avformat_open_input(&pFormatCtx, url, iformat, NULL)) < 0) {
+        av_log(NULL, AV_LOG_WARNING, "reverse: could not open %s\n", url);
+        return ret;
+    }
+    if (streamIndex >= (int) pFormatCtx->nb_streams || pFormatCtx->streams[streamIndex]->id != streamId) {
+        if ((ret = avformat_find_stream_info(pFormatCtx, NULL)) < 0) {
+            return ret;
+        }
+    }
+    // 按照流的id找到同一路视频流，其他流的数据包都丢弃
+    for (int i = 0; i < (int) pFormatCtx->nb_streams; i++) {
+        if (index < 0 && pFormatCtx->streams[i]->id == streamId
+            && pFormatCtx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+            index = i;
+        } else {
+            pFormatCtx->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+    if (index < 0) {
+        return AVERROR_STREAM_NOT_FOUND;
+    }
+    streamIndex = index;
+    timeBase = pFormatCtx->streams[index]->time_base;
+    if (pFormatCtx->streams[index]->start_time != AV_NOPTS_VALUE) {
+        streamStartPts = pFormatCtx->streams[index]->start_time;
+    }
+
+    pCodecCtx = avcodec_alloc_context3(codec);
+    if (!pCodecCtx) {
+        return AVERROR(ENOMEM);
+    }
+    if ((ret = avcodec_parameters_to_context(pCodecCtx, codecpar)) < 0) {
+        return ret;
+    }
+    av_codec_set_pkt_timebase(pCodecCtx, timeBase);
+    av_dict_set(&opts, "threads", "auto", 0);
+    av_dict_set(&opts, "refcounted_frames", "1", 0);
+    ret = avcodec_open2(pCodecCtx, codec, &opts);
+    av_dict_free(&opts);
+    return ret;
+}
+
+/**
+ * 按上一段的帧数估计GOP长度，选择能让整个GOP放进一个GOP缓冲的最小缩小倍数
+ * @return
+ */
+int ReverseDecoder::chooseDownscale() {
+    int frames = FFMAX(gopFrames, 1);
+    int64_t budget = playerState->reverseBufferMemory / 2;
+    int format = codecpar->format >= 0 ? codecpar->format : AV_PIX_FMT_YUV420P;
+    for (int scale = 0; scale < REVERSE_MAX_DOWNSCALE; scale++) {
+        if ((int64_t) frames * getFrameBytes(codecpar->width, codecpar->height, format, scale) <= budget) {
+            return scale;
+        }
+    }
+    return REVERSE_MAX_DOWNSCALE;
+}
+
+int ReverseDecoder::getFrameBytes(int width, int height, int format, int downscale) {
+    if (downscale > 0) {
+        width = FFMAX((width >> downscale) & ~1, 2);
+        height = FFMAX((height >> downscale) & ~1, 2);
+        format = AV_PIX_FMT_YUV420P;
+    }
+    return FFMAX(av_image_get_buffer_size((AVPixelFormat) format, width, height, 1), 0);
+}
+
+/**
+ * 不缩小时只增加引用计数，缩小时转换成YUV420P，同步器可以直接上传纹理
+ * @param vp
+ * @param frame
+ * @param downscale
+ * @return
+ */
+int ReverseDecoder::storeFrame(Frame *vp, AVFrame *frame, int downscale) {
+    int ret = 0;
+    if (downscale == 0) {
+        ret = av_frame_ref(vp->frame, frame);
+    } else {
+        int width = FFMAX((frame->width >> downscale) & ~1, 2);
+        int height = FFMAX((frame->height >> downscale) & ~1, 2);
+        swsContext = sws_getCachedContext(swsContext, frame->width, frame->height, (AVPixelFormat) frame->format,
+                                          width, height, AV_PIX_FMT_YUV420P, SWS_FAST_BILINEAR, NULL, NULL, NULL);
+        if (!swsContext) {
+            return AVERROR(EINVAL);
+        }
+        vp->frame->format = AV_PIX_FMT_YUV420P;
+        vp->frame->width = width;
+        vp->frame->height = height;
+        if ((ret = av_frame_get_buffer(vp->frame, 32)) >= 0) {
+            sws_scale(swsContext, (uint8_t const *const *) frame->data, frame->linesize, 0, frame->height,
+                      vp->frame->data, vp->frame->linesize);
+            ret = av_frame_copy_props(vp->frame, frame);
+        }
+    }
+    if (ret < 0) {
+        av_frame_unref(vp->frame);
+        return ret;
+    }
+    vp->width = vp->frame->width;
+    vp->height = vp->frame->height;
+    vp->format = vp->frame->format;
+    vp->pts = frame->pts * av_q2d(timeBase);
+    vp->duration = frameDuration;
+    vp->uploaded = 0;
+    vp->seekFrame = 0;
+    return 0;
+}
+
+void ReverseDecoder::clearGop(ReverseGop *gop) {
+    for (int i = 0; i < gop->count; i++) {
+        av_frame_unref(gop->frames[(gop->head + i) % gop->capacity].frame);
+    }
+    mMutex.lock();
+    gop->head = 0;
+    gop->count = 0;
+    gop->bytes = 0;
+    gop->ready = false;
+    mMutex.unlock();
+}
+
+/**
+ * 定位到endPts之前最近的关键帧，一直解码到endPts，缓冲满了以后丢弃最早的帧
+ * 解码出来的帧都不早于endPts时说明定位到的关键帧不够靠前，下一次再往前多退一些
+ * @param gop
+ * @param frame
+ * @param packet
+ * @return
+ */
+int ReverseDecoder::decodeGop(ReverseGop *gop, AVFrame *frame, AVPacket *packet) {
+    int64_t target = FFMAX(endPts - 1 - retreat, streamStartPts);
+    int ret = avformat_seek_file(pFormatCtx, streamIndex, INT64_MIN, target, target, 0);
+    if (ret < 0) {
+        ret = av_seek_frame(pFormatCtx, streamIndex, target, AVSEEK_FLAG_BACKWARD);
+    }
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_ERROR, "reverse: error while seeking to %lld\n", (long long) target);
+        return ret;
+    }
+    avcodec_flush_buffers(pCodecCtx);
+
+    downscale = chooseDownscale();
+    int frameBytes = getFrameBytes(codecpar->width, codecpar->height,
+                                   codecpar->format >= 0 ? codecpar->format : AV_PIX_FMT_YUV420P, downscale);
+    gop->capacity = (int) av_clip64(playerState->reverseBufferMemory / 2 / FFMAX(frameBytes, 1),
+                                    1, REVERSE_GOP_MAX_FRAMES);
+    gop->head = 0;
+    gop->count = 0;
+    gop->bytes = 0;
+
+    int decoded = 0;
+    bool draining = false;
+    int64_t startTime = av_gettime_relative();
+    for (;;) {
+        if (abortRequest || playerState->abortRequest) {
+            ret = -1;
+            break;
+        }
+        ret = avcodec_receive_frame(pCodecCtx, frame);
+        if (ret >= 0) {
+            int64_t pts = av_frame_get_best_effort_timestamp(frame);
+            if (pts != AV_NOPTS_VALUE && pts >= endPts) {
+                av_frame_unref(frame);
+                ret = 0;
+                break;
+            }
+            if (pts != AV_NOPTS_VALUE) {
+                decoded++;
+                // 缓冲满了丢弃最早的帧，这些帧下一次从同一个关键帧重新解码
+                if (gop->count == gop->capacity) {
+                    Frame *oldest = &gop->frames[gop->head];
+                    int64_t bytes = getFrameBytes(oldest->width, oldest->height, oldest->format, 0);
+                    av_frame_unref(oldest->frame);
+                    mMutex.lock();
+                    gop->head = (gop->head + 1) % gop->capacity;
+                    gop->count--;
+                    gop->bytes -= bytes;
+                    mMutex.unlock();
+                }
+                Frame *vp = &gop->frames[(gop->head + gop->count) % gop->capacity];
+                frame->pts = pts;
+                if (storeFrame(vp, frame, downscale) >= 0) {
+                    mMutex.lock();
+                    gop->count++;
+                    gop->bytes += getFrameBytes(vp->width, vp->height, vp->format, 0);
+                    peakBytes = FFMAX(peakBytes, gops[0].bytes + gops[1].bytes + shownBytes);
+                    mMutex.unlock();
+                }
+            }
+            av_frame_unref(frame);
+            continue;
+        }
+        if (ret == AVERROR_EOF || draining) {
+            ret = 0;
+            break;
+        }
+        ret = av_read_frame(pFormatCtx, packet);
+        if (ret < 0) {
+            // 读到结尾，取出解码器中剩下的帧
+            if (ret == AVERROR_EOF || avio_feof(pFormatCtx->pb)) {
+                avcodec_send_packet(pCodecCtx, NULL);
+                draining = true;
+                continue;
+            }
+            break;
+        }
+        if (packet->stream_index == streamIndex) {
+            avcodec_send_packet(pCodecCtx, packet);
+        }
+        av_packet_unref(packet);
+    }
+    decodeTime += av_gettime_relative() - startTime;
+    decodedFrames += decoded;
+
+    if (ret < 0) {
+        clearGop(gop);
+        return ret;
+    }
+    if (decoded > 0) {
+        gopFrames = decoded;
+    }
+    if (gop->count == 0) {
+        // 已经从开头解码过了，没有更早的帧
+        if (target <= streamStartPts) {
+            mMutex.lock();
+            finished = true;
+            mMutex.unlock();
+            return 0;
+        }
+        int64_t step = (int64_t) (REVERSE_SEEK_STEP / av_q2d(timeBase));
+        retreat = retreat > 0 ? retreat * 2 : FFMAX(step, 1);
+        return 0;
+    }
+    if (decoded > gop->count) {
+        redecodeCount++;
+    }
+    retreat = 0;
+    endPts = gop->frames[gop->head].frame->pts;
+    return gop->count;
+}
+
+void ReverseDecoder::run() {
+    AVFrame *frame = av_frame_alloc();
+    AVPacket *packet = av_packet_alloc();
+    int ret = -1;
+
+    if (frame && packet) {
+        ret = openInput();
+    }
+    if (ret < 0) {
+        LOGE("倒放解码器打开失败：%d", ret);
+    } else {
+        endPts = (int64_t) llround(startPosition / av_q2d(timeBase));
+    }
+
+    while (ret >= 0) {
+        mMutex.lock();
+        while (!abortRequest && !finished && gops[fillIndex].ready) {
+            mCondition.wait(mMutex);
+        }
+        bool done = abortRequest || finished;
+        mMutex.unlock();
+        if (done) {
+            break;
+        }
+        ret = decodeGop(&gops[fillIndex], frame, packet);
+        if (ret > 0) {
+            mMutex.lock();
+            gops[fillIndex].ready = true;
+            fillIndex = (fillIndex + 1) % 2;
+            mMutex.unlock();
+        }
+    }
+
+    // 出错以后不再有新的帧，同步器取完已经解码的帧以后结束倒放
+    mMutex.lock();
+    if (ret < 0 && !abortRequest) {
+        finished = true;
+    }
+    mMutex.unlock();
+
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+}
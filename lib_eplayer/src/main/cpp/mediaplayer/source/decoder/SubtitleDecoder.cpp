@@ -0,0 +1,330 @@
+
+#include "SubtitleDecoder.h"
+
+extern "C" {
+#include "libavutil/bprint.h"
+};
+
+SubtitleDecoder::SubtitleDecoder(AVFormatContext *externalCtx, AVCodecContext *avctx,
+                                 AVStream *stream, int streamIndex, PlayerState *playerState)
+        : MediaDecoder(avctx, stream, streamIndex, playerState) {
+    this->externalCtx = externalCtx;
+    // 字幕不需要保留最后一帧，显示中的字幕由同步器决定什么时候取出
+    frameQueue = new FrameQueue(SUBPICTURE_QUEUE_SIZE, 0);
+    mExit = true;
+    decodeThread = NULL;
+    startTime = 0;
+    externalEof = false;
+    externalSeekPos = AV_NOPTS_VALUE;
+    serial = 0;
+}
+
+SubtitleDecoder::~SubtitleDecoder() {
+    mMutex.lock();
+    if (frameQueue) {
+        frameQueue->flush();
+        delete frameQueue;
+        frameQueue = NULL;
+    }
+    if (externalCtx) {
+        avformat_close_input(&externalCtx);
+        externalCtx = NULL;
+    }
+    mMutex.unlock();
+}
+
+void SubtitleDecoder::start() {
+    MediaDecoder::start();
+
+    if (frameQueue) {
+        frameQueue->start();
+    }
+
+    if (!decodeThread) {
+        LOGD("开启字幕解码线程");
+        decodeThread = new Thread(this);
+        decodeThread->start();
+        mExit = false;
+    }
+}
+
+void SubtitleDecoder::stop() {
+    MediaDecoder::stop();
+    if (frameQueue) {
+        frameQueue->abort();
+    }
+    mMutex.lock();
+    while (!mExit) {
+        mCondition.wait(mMutex);
+    }
+    mMutex.unlock();
+    if (decodeThread) {
+        decodeThread->join();
+        delete decodeThread;
+        LOGD("删除字幕解码线程");
+        decodeThread = NULL;
+    }
+}
+
+void SubtitleDecoder::flush() {
+    mMutex.lock();
+    serial++;
+    MediaDecoder::flush();
+    if (frameQueue) {
+        frameQueue->flush();
+    }
+    mCondition.signal();
+    mMutex.unlock();
+}
+
+/**
+ * 结束时间在目标之前的字幕会被丢弃，外挂字幕还需要重新定位字幕文件
+ * @param target
+ */
+void SubtitleDecoder::setSeekTarget(int64_t target) {
+    MediaDecoder::setSeekTarget(target);
+    if (externalCtx) {
+        mMutex.lock();
+        externalSeekPos = target - startTime;
+        mCondition.signal();
+        mMutex.unlock();
+    }
+}
+
+void SubtitleDecoder::setStartTime(int64_t startTime) {
+    this->startTime = startTime != AV_NOPTS_VALUE ? startTime : 0;
+}
+
+bool SubtitleDecoder::isExternal() {
+    return externalCtx != NULL;
+}
+
+int SubtitleDecoder::getSerial() {
+    return serial;
+}
+
+int SubtitleDecoder::getFrameSize() {
+    Mutex::Autolock lock(mMutex);
+    return frameQueue ? frameQueue->getFrameSize() : 0;
+}
+
+FrameQueue *SubtitleDecoder::getFrameQueue() {
+    Mutex::Autolock lock(mMutex);
+    return frameQueue;
+}
+
+void SubtitleDecoder::run() {
+    decodeSubtitle();
+}
+
+int SubtitleDecoder::readExternalPacket(AVPacket *pkt) {
+    for (;;) {
+        if (abortRequest || playerState->abortRequest) {
+            return -1;
+        }
+
+        int64_t target = externalSeekPos.exchange(AV_NOPTS_VALUE);
+        if (target != AV_NOPTS_VALUE) {
+            // 字幕解复用器会把整个文件读进内存，定位只是移动读位置
+            if (avformat_seek_file(externalCtx, -1, INT64_MIN, target, target, 0) < 0) {
+                LOGE("外挂字幕定位失败");
+            }
+            externalEof = false;
+        }
+
+        if (externalEof) {
+            mMutex.lock();
+            if (!abortRequest && externalSeekPos == AV_NOPTS_VALUE) {
+                mCondition.wait(mMutex);
+            }
+            mMutex.unlock();
+            continue;
+        }
+
+        int ret = av_read_frame(externalCtx, pkt);
+        if (ret < 0) {
+            externalEof = true;
+            continue;
+        }
+        if (pkt->stream_index != streamIndex) {
+            av_packet_unref(pkt);
+            continue;
+        }
+        return 1;
+    }
+}
+
+/**
+ * 解码字幕数据包并放入帧队列
+ * 字幕的显示时间是数据包的时间戳加上start_display_time，结束时间未知时一直显示到下一条字幕
+ * @return
+ */
+int SubtitleDecoder::decodeSubtitle() {
+    AVPacket *packet = av_packet_alloc();
+    AVSubtitle sub;
+    int gotSubtitle;
+    int ret = 0;
+
+    if (!packet) {
+        mMutex.lock();
+        mExit = true;
+        mCondition.signal();
+        mMutex.unlock();
+        return AVERROR(ENOMEM);
+    }
+
+    for (;;) {
+
+        if (abortRequest || playerState->abortRequest) {
+            ret = -1;
+            break;
+        }
+
+        if (playerState->seekRequest) {
+            playerState->waitForSeek(&abortRequest);
+            continue;
+        }
+
+        int decodeSerial = serial;
+        if (externalCtx) {
+            ret = readExternalPacket(packet);
+        } else {
+            ret = getPacket(packet);
+        }
+        if (ret < 0) {
+            break;
+        }
+
+        int64_t packetPts = packet->pts;
+        gotSubtitle = 0;
+        mCodecMutex.lock();
+        ret = avcodec_decode_subtitle2(pCodecCtx, &sub, &gotSubtitle, packet);
+        mCodecMutex.unlock();
+        av_packet_unref(packet);
+        if (ret < 0) {
+            // 单条字幕损坏不影响后面的字幕
+            LOGE("字幕解码失败: %d", ret);
+            continue;
+        }
+        if (!gotSubtitle) {
+            continue;
+        }
+
+        double pts = NAN;
+        if (sub.pts != AV_NOPTS_VALUE) {
+            pts = sub.pts / (double) AV_TIME_BASE;
+        } else if (packetPts != AV_NOPTS_VALUE) {
+            pts = packetPts * av_q2d(pStream->time_base);
+        }
+        if (isnan(pts)) {
+            avsubtitle_free(&sub);
+            continue;
+        }
+        pts += (startTime + sub.start_display_time * 1000LL) / (double) AV_TIME_BASE;
+        double duration = NAN;
+        if (sub.end_display_time > sub.start_display_time && sub.end_display_time != UINT32_MAX) {
+            duration = (sub.end_display_time - sub.start_display_time) / 1000.0;
+        }
+
+        // 定位以后已经结束的字幕不再显示，没有结束时间的字幕要保留到下一条字幕出现
+        if (!isnan(duration) && isBeforeSeekTarget(pts + duration)) {
+            avsubtitle_free(&sub);
+            continue;
+        }
+
+        Frame *sp = frameQueue->peekWritable();
+        if (!sp) {
+            avsubtitle_free(&sub);
+            ret = -1;
+            break;
+        }
+        // 等待空位期间清空过，这条字幕已经过期
+        if (decodeSerial != serial) {
+            avsubtitle_free(&sub);
+            continue;
+        }
+        sp->sub = sub;
+        sp->pts = pts;
+        sp->duration = duration;
+        sp->width = pCodecCtx->width;
+        sp->height = pCodecCtx->height;
+        sp->format = sub.format;
+        sp->uploaded = 0;
+        sp->seekFrame = 0;
+        frameQueue->pushFrame();
+    }
+
+    av_packet_free(&packet);
+
+    mMutex.lock();
+    mExit = true;
+    mCondition.signal();
+    mMutex.unlock();
+
+    return ret;
+}
+
+/**
+ * ASS事件的格式是ReadOrder,Layer,Style,Name,MarginL,MarginR,MarginV,Effect,Text
+ * 旧版本的格式带有"Dialogue:"前缀和开始结束时间，多一个字段
+ * @param sub
+ * @return
+ */
+char *SubtitleDecoder::getSubtitleText(const AVSubtitle *sub) {
+    AVBPrint buf;
+    char *result = NULL;
+
+    av_bprint_init(&buf, 0, AV_BPRINT_SIZE_UNLIMITED);
+    for (unsigned int i = 0; i < sub->num_rects; i++) {
+        const AVSubtitleRect *rect = sub->rects[i];
+        const char *text = NULL;
+        if (rect->type == SUBTITLE_ASS && rect->ass) {
+            text = rect->ass;
+            int fields = 8;
+            if (!strncmp(text, "Dialogue:", 9)) {
+                text += 9;
+                fields = 9;
+            }
+            for (int j = 0; j < fields && text; j++) {
+                text = strchr(text, ',');
+                if (text) {
+                    text++;
+                }
+            }
+        } else if (rect->type == SUBTITLE_TEXT) {
+            text = rect->text;
+        }
+        if (!text || !*text) {
+            continue;
+        }
+
+        if (buf.len > 0) {
+            av_bprint_chars(&buf, '\n', 1);
+        }
+        int braces = 0; // ASS的样式标签在大括号中
+        for (const char *p = text; *p; p++) {
+            if (*p == '{') {
+                braces++;
+            } else if (*p == '}' && braces > 0) {
+                braces--;
+            } else if (braces > 0 || *p == '\r') {
+                continue;
+            } else if (*p == '\\' && (p[1] == 'N' || p[1] == 'n')) {
+                av_bprint_chars(&buf, '\n', 1);
+                p++;
+            } else if (*p == '\\' && p[1] == 'h') {
+                av_bprint_chars(&buf, ' ', 1);
+                p++;
+            } else {
+                av_bprint_chars(&buf, *p, 1);
+            }
+        }
+    }
+
+    if (buf.len > 0 && av_bprint_is_complete(&buf)) {
+        av_bprint_finalize(&buf, &result);
+    } else {
+        av_bprint_finalize(&buf, NULL);
+    }
+    return result;
+}
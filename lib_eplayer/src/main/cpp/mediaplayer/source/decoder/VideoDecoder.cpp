@@ -10,6 +10,25 @@ VideoDecoder::VideoDecoder(AVFormatContext *pFormatCtx, AVCodecContext *avctx,
     mExit = true;
     decodeThread = NULL;
     masterClock = NULL;
+    // 视频帧使用缓冲池分配，跨帧和定位复用图像内存
+    framePool = new VideoFramePool();
+    framePool->attach(avctx);
+    avgDecodeTime = 0;
+    decodeJitter = 0;
+    shrinkFrames = 0;
+    seekFrameRequest = false;
+    seekCompletePos = AV_NOPTS_VALUE;
+    defaultSkipFrame = avctx->skip_frame;
+    defaultSkipLoopFilter = avctx->skip_loop_filter;
+    catchUpMode = false;
+    decoderLevel = DECODER_LEVEL_NONE;
+    decodeLoad = 0;
+    lastFramePts = NAN;
+    rateLevel = DECODER_LEVEL_NONE;
+    appliedLevel = DECODER_LEVEL_NONE;
+    overloadFrames = 0;
+    recoverFrames = 0;
+    droppedFrames = 0;
     // 旋转角度
     AVDictionaryEntry *entry = av_dict_get(stream->metadata, "rotate", NULL, AV_DICT_MATCH_CASE);
     if (entry && entry->value) {
@@ -29,6 +48,12 @@ VideoDecoder::~VideoDecoder() {
         frameQueue = NULL;
     }
     masterClock = NULL;
+    // 解码上下文在基类中释放，先恢复默认的分配方式
+    if (framePool) {
+        framePool->detach(pCodecCtx);
+        delete framePool;
+        framePool = NULL;
+    }
     mMutex.unlock();
 }
 
@@ -56,6 +81,10 @@ void VideoDecoder::start() {
 
 void VideoDecoder::stop() {
     MediaDecoder::stop();
+    // 唤醒等待共享解码调度器工作槽的解码线程
+    if (playerState->sharedDecoderPool) {
+        DecoderScheduler::getInstance()->wakeUp();
+    }
 
     if (frameQueue) {
         frameQueue->abort();
@@ -79,6 +108,8 @@ void VideoDecoder::flush() {
     if (frameQueue) {
         frameQueue->flush();
     }
+    seekCompletePos = AV_NOPTS_VALUE;
+    seekFrameRequest = true;
     mCondition.signal();
     mMutex.unlock();
 }
@@ -103,12 +134,229 @@ AVFormatContext *VideoDecoder::getFormatContext() {
     return pFormatCtx;
 }
 
+/**
+ * 精确定位，定位完成的消息在目标帧放入帧队列以后才发出
+ * @param target
+ */
+void VideoDecoder::setSeekTarget(int64_t target) {
+    seekCompletePos = target;
+    MediaDecoder::setSeekTarget(target);
+}
+
+/**
+ * 数据包显示结束的时间在精确定位目标之前，说明解码出来的帧一定会被丢弃
+ * @param packet
+ * @return
+ */
+bool VideoDecoder::isCatchUpPacket(AVPacket *packet) {
+    int64_t target = seekTarget;
+    int64_t timestamp = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+    if (target == AV_NOPTS_VALUE || timestamp == AV_NOPTS_VALUE) {
+        return false;
+    }
+    double endTime = (timestamp + FFMAX(packet->duration, 0)) * av_q2d(pStream->time_base);
+    return endTime * AV_TIME_BASE <= target;
+}
+
+/**
+ * 定位以后的第一帧已经放入帧队列，精确定位时在这里通知定位完成，显示耗时由同步器在显示这一帧时通知
+ */
+void VideoDecoder::onSeekFrameReady() {
+    seekFrameRequest = false;
+    int64_t target = seekCompletePos.exchange(AV_NOPTS_VALUE);
+    LOGD("定位到第一帧解码耗时%lldms", (long long) (av_gettime_relative() - playerState->seekStartTime) / 1000);
+    // 已经有新的定位请求，旧的定位位置不再通知
+    if (playerState->seekRequest) {
+        return;
+    }
+    if (playerState->messageQueue && target != AV_NOPTS_VALUE) {
+        playerState->messageQueue->postMessage(MSG_SEEK_COMPLETE,
+                                               (int) av_rescale(target, 1000, AV_TIME_BASE), 0);
+    }
+}
+
+int VideoDecoder::getDroppedFrames() {
+    return droppedFrames;
+}
+
+VideoFramePool *VideoDecoder::getFramePool() {
+    Mutex::Autolock lock(mMutex);
+    return framePool;
+}
+
 void VideoDecoder::run() {
     decodeVideo();
 }
 
+/**
+ * 根据每帧解码耗时的均值和抖动估算需要缓冲的帧数，在内存上限以内调整帧队列深度，内存上限包括逐帧后退的历史记录
+ * 深度增加立即生效，减小需要连续一段时间都不需要那么深才生效
+ * @param decodeTime 这一帧的解码耗时，单位微秒
+ * @param duration 帧时长，单位秒
+ * @param frameBytes 一帧图像占用的内存
+ */
+void VideoDecoder::updateQueueDepth(int64_t decodeTime, double duration, int frameBytes) {
+    if (duration <= 0 || frameBytes <= 0) {
+        return;
+    }
+    double cost = decodeTime / 1000000.0;
+    if (avgDecodeTime <= 0) {
+        avgDecodeTime = cost;
+    }
+    // 跟RTP抖动的计算方式一样，使用1/16的平滑系数
+    decodeJitter += (fabs(cost - avgDecodeTime) - decodeJitter) / 16.0;
+    avgDecodeTime += (cost - avgDecodeTime) / 16.0;
+
+    // 实时流保持浅队列，降低延时
+    if (playerState->realTime) {
+        return;
+    }
+
+    // 倍速播放时帧的显示时长会缩短
+    double displayDuration = duration / FFMAX(playerState->playbackRate, 0.1f);
+    double peak = avgDecodeTime + DECODE_JITTER_FACTOR * decodeJitter;
+    int wanted = VIDEO_QUEUE_SIZE + (int) ceil(FFMAX(peak - displayDuration, 0) / displayDuration);
+    // 逐帧后退的历史记录一直引用着最近显示过的帧，帧队列可以使用的内存要扣除这一部分
+    int64_t memory = playerState->videoQueueMemory - (int64_t) playerState->stepCacheFrames * frameBytes;
+    int budget = (int) FFMIN(FFMAX(memory, 0) / frameBytes, FRAME_QUEUE_SIZE);
+    wanted = FFMIN(wanted, FFMAX(budget, VIDEO_QUEUE_SIZE));
+
+    int current = frameQueue->getMaxSize();
+    if (wanted > current) {
+        shrinkFrames = 0;
+        frameQueue->setMaxSize(wanted);
+        LOGD("解码耗时%.1fms，抖动%.1fms，帧队列深度增加到%d", avgDecodeTime * 1000, decodeJitter * 1000, wanted);
+    } else if (wanted < current) {
+        if (++shrinkFrames >= VIDEO_QUEUE_SHRINK_FRAMES) {
+            shrinkFrames = 0;
+            frameQueue->setMaxSize(current - 1);
+            LOGD("解码耗时%.1fms，抖动%.1fms，帧队列深度减小到%d", avgDecodeTime * 1000, decodeJitter * 1000, current - 1);
+        }
+    } else {
+        shrinkFrames = 0;
+    }
+}
+
+/**
+ * 解码耗时接近帧显示时长时，帧队列会被同步线程逐渐取空，晚到的帧被丢弃时解码的代价已经付出了
+ * 这时按等级逐级减少解码器的工作量，不再过载以后再逐级恢复，每次只变化一级
+ * 跳帧以后一个输出帧对应多个数据包的解码耗时，所以负载按两个输出帧之间的时间戳间隔计算
+ * @param decodeTime 自上一帧输出以来的解码耗时，单位微秒
+ * @param pts 帧的时间戳，单位秒
+ * @param duration 帧时长，单位秒
+ */
+void VideoDecoder::updateDecoderLevel(int64_t decodeTime, double pts, double duration) {
+    double interval = duration;
+    if (!isnan(pts) && !isnan(lastFramePts) && pts > lastFramePts && pts - lastFramePts < AV_NOSYNC_THRESHOLD) {
+        interval = pts - lastFramePts;
+    }
+    lastFramePts = pts;
+    if (!playerState->decoderGovernor || interval <= 0 || catchUpMode) {
+        return;
+    }
+    double load = decodeTime / 1000000.0 / (interval / FFMAX(playerState->playbackRate, 0.1f));
+    decodeLoad += (load - decodeLoad) / 16.0;
+
+    int queued = frameQueue->getFrameSize();
+    int depth = frameQueue->getMaxSize();
+    int level = decoderLevel;
+    if (decodeLoad > DECODER_OVERLOAD_RATIO && queued <= depth / 2) {
+        recoverFrames = 0;
+        if (++overloadFrames >= DECODER_ESCALATE_FRAMES && level < DECODER_LEVEL_SKIP_NONKEY) {
+            level++;
+        }
+    } else if (decodeLoad < DECODER_RECOVER_RATIO && queued >= depth - 1) {
+        overloadFrames = 0;
+        if (++recoverFrames >= DECODER_RECOVER_FRAMES && level > DECODER_LEVEL_NONE) {
+            level--;
+        }
+    } else {
+        overloadFrames = 0;
+        recoverFrames = 0;
+    }
+    if (level == decoderLevel) {
+        return;
+    }
+    overloadFrames = 0;
+    recoverFrames = 0;
+    decoderLevel = level;
+    LOGD("解码负载%.2f，帧队列%d/%d，降级等级变为%d", decodeLoad, queued, depth, level);
+    if (playerState->messageQueue) {
+        playerState->messageQueue->postMessage(MSG_DECODER_LEVEL_CHANGED, level, (int) (avgDecodeTime * 1000));
+    }
+}
+
+/**
+ * 倍速播放时帧的显示间隔按播放速度缩短，显示帧率超过屏幕刷新率的部分在同步器中也会被丢弃，
+ * 与其解码出来再丢弃，不如直接跳过非参考帧，速度再快时只解码关键帧
+ * 跟降级等级不同，播放速度变化时立即生效
+ * @param duration 帧时长，单位秒
+ */
+void VideoDecoder::updateRateLevel(double duration) {
+    double rate = playerState->playbackRate * playerState->liveCatchUpRate;
+    int level = DECODER_LEVEL_NONE;
+    if (playerState->keyframeOnlyRate > 0 && rate >= playerState->keyframeOnlyRate) {
+        level = DECODER_LEVEL_SKIP_NONKEY;
+    } else if (rate > 1.0 && playerState->displayRefreshRate > 0 && duration > 0
+               && rate / duration > playerState->displayRefreshRate) {
+        level = DECODER_LEVEL_SKIP_NONREF;
+    }
+    if (level != rateLevel) {
+        LOGD("播放速度%.2f倍，倍速跳帧等级变为%d", rate, level);
+        rateLevel = level;
+    }
+}
+
+/**
+ * 降级等级、倍速跳帧等级和追赶定位目标的跳帧参数取较强的一个，都不低于解码器原来的设置
+ * 追赶定位目标时不跳过环路滤波，目标帧从参考帧预测，参考帧不去块会让目标帧和之后整个GOP都带上块效应
+ * @param catchUp
+ */
+void VideoDecoder::applySkipMode(bool catchUp) {
+    AVDiscard skipFrame = defaultSkipFrame;
+    AVDiscard skipLoopFilter = defaultSkipLoopFilter;
+    int level = FFMAX(decoderLevel, rateLevel);
+    if (level >= DECODER_LEVEL_SKIP_NONREF_FILTER) {
+        skipLoopFilter = (AVDiscard) FFMAX(skipLoopFilter, AVDISCARD_NONREF);
+    }
+    if (level >= DECODER_LEVEL_SKIP_ALL_FILTER) {
+        skipLoopFilter = AVDISCARD_ALL;
+    }
+    if (level >= DECODER_LEVEL_SKIP_NONREF) {
+        skipFrame = (AVDiscard) FFMAX(skipFrame, AVDISCARD_NONREF);
+    }
+    if (level >= DECODER_LEVEL_SKIP_NONKEY) {
+        skipFrame = (AVDiscard) FFMAX(skipFrame, AVDISCARD_NONKEY);
+    }
+    if (catchUp) {
+        skipFrame = (AVDiscard) FFMAX(skipFrame, AVDISCARD_NONREF);
+    }
+    pCodecCtx->skip_frame = skipFrame;
+    pCodecCtx->skip_loop_filter = skipLoopFilter;
+    catchUpMode = catchUp;
+    appliedLevel = level;
+}
+
+/**
+ * 优先级在每次获取时读取，播放过程中修改优先级立即生效
+ * @return
+ */
+bool VideoDecoder::acquireWorker() {
+    if (!playerState->sharedDecoderPool) {
+        return true;
+    }
+    return DecoderScheduler::getInstance()->acquire(playerState->decodePriority, &abortRequest);
+}
+
+void VideoDecoder::releaseWorker() {
+    if (playerState->sharedDecoderPool) {
+        DecoderScheduler::getInstance()->release();
+    }
+}
+
 /**
  * 解码视频数据包并放入帧队列
+ * 每次先把解码器中所有可用的帧都取出来，解码器返回EAGAIN以后再送入下一个数据包
  * @return
  */
 int VideoDecoder::decodeVideo() {
@@ -116,9 +364,15 @@ int VideoDecoder::decodeVideo() {
     Frame *vp;
     int got_picture;
     int ret = 0;
+    bool packetPending = false;     // 数据包未能送入解码器，需要在取帧以后重新送入
+    int64_t decodeTime = 0;         // 自上一帧输出以来解码器的耗时，不包括等待数据包和帧队列的时间
+    int64_t startTime;
+    int serial = 0;                 // 取帧时的清空序列号
 
     AVRational tb = pStream->time_base;
     AVRational frame_rate = av_guess_frame_rate(pFormatCtx, pStream, NULL);
+    // 帧时长，单位秒，猜不出帧率时为0
+    double frameDuration = frame_rate.num && frame_rate.den ? av_q2d((AVRational) {frame_rate.den, frame_rate.num}) : 0;
 
     if (!frame) {
         mExit = true;
@@ -143,59 +397,130 @@ int VideoDecoder::decodeVideo() {
         }
 
         if (playerState->seekRequest) {
+            // 定位以后解码器会被清空，未送入的数据包也要丢弃
+            if (packetPending) {
+                av_packet_unref(packet);
+                packetPending = false;
+            }
+            // 阻塞到定位完成，不再空转
+            playerState->waitForSeek(&abortRequest);
             continue;
         }
 
-        /*取数据，如果没有数据会阻塞，这是一个生产者消费者模式*/
-        if (packetQueue->getPacket(packet) < 0) { // 可能会被阻塞
+        // 取出解码器中已经解码好的帧，只锁住当前解码器，等待工作槽的时间不计入解码耗时
+        if (!acquireWorker()) {
             ret = -1;
             break;
         }
+        startTime = av_gettime_relative();
+        mCodecMutex.lock();
+        serial = flushSerial;
+        ret = avcodec_receive_frame(pCodecCtx, frame);
+        mCodecMutex.unlock();
+        decodeTime += av_gettime_relative() - startTime;
+        releaseWorker();
+
+        if (ret == AVERROR_EOF) {
+            // 空数据包送入以后解码器已经排空，重置解码器以便继续解码
+            mCodecMutex.lock();
+            avcodec_flush_buffers(pCodecCtx);
+            mCodecMutex.unlock();
+            // 精确定位的目标超过了最后一帧，不再等待目标帧
+            if (seekCompletePos != AV_NOPTS_VALUE) {
+                seekTarget = AV_NOPTS_VALUE;
+                onSeekFrameReady();
+            }
+        } else if (ret < 0 && ret != AVERROR(EAGAIN)) {
+            av_frame_unref(frame);
+        }
 
-        playerState->mMutex.lock();
-        // 送去解码
-        ret = avcodec_send_packet(pCodecCtx, packet);
-        if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
-            av_packet_unref(packet);
-            playerState->mMutex.unlock();
+        if (ret < 0) {
+            // 解码器需要新的数据包
+            if (!packetPending) {
+                /*取数据，如果没有数据会阻塞，这是一个生产者消费者模式*/
+                if (getPacket(packet) < 0) { // 可能会被阻塞
+                    ret = -1;
+                    break;
+                }
+            }
+            // 精确定位追赶目标帧时，目标之前的数据包跳过非参考帧
+            bool catchUp = isCatchUpPacket(packet);
+            updateRateLevel(frameDuration);
+            // 送去解码
+            if (!acquireWorker()) {
+                av_packet_unref(packet);
+                packetPending = false;
+                ret = -1;
+                break;
+            }
+            startTime = av_gettime_relative();
+            mCodecMutex.lock();
+            if (catchUp != catchUpMode || FFMAX(decoderLevel, rateLevel) != appliedLevel) {
+                applySkipMode(catchUp);
+            }
+            ret = avcodec_send_packet(pCodecCtx, packet);
+            mCodecMutex.unlock();
+            decodeTime += av_gettime_relative() - startTime;
+            releaseWorker();
+            if (ret == AVERROR(EAGAIN)) {
+                packetPending = true;
+            } else {
+                packetPending = false;
+                av_packet_unref(packet);
+            }
             continue;
         }
-        // 得到解码帧
-        ret = avcodec_receive_frame(pCodecCtx, frame);
-        playerState->mMutex.unlock();
 
-        if (ret < 0 && ret != AVERROR_EOF) {
+        // 解码正常
+        got_picture = 1;
+        updateQueueDepth(decodeTime, frameDuration,
+                         av_image_get_buffer_size((AVPixelFormat) frame->format, frame->width, frame->height, 1));
+        int64_t bestPts = av_frame_get_best_effort_timestamp(frame);
+        updateDecoderLevel(decodeTime, bestPts == AV_NOPTS_VALUE ? NAN : bestPts * av_q2d(tb), frameDuration);
+        decodeTime = 0;
+
+        // 取帧以后已经发生了定位，过时的帧不能清除新的定位目标
+        if (isStaleFrame(serial)) {
+            // 没有送入的数据包是取这一帧之前拿到的，同样属于定位之前
+            if (packetPending) {
+                av_packet_unref(packet);
+                packetPending = false;
+            }
             av_frame_unref(frame);
-            av_packet_unref(packet);
             continue;
-        } else { // 解码正常
-            got_picture = 1;
-            // 是否重排pts，默认情况下需要重排pts的
-            if (playerState->reorderVideoPts == 1) {
-                frame->pts = av_frame_get_best_effort_timestamp(frame);
-            } else if (!playerState->reorderVideoPts) {
-                frame->pts = frame->pkt_dts;
-            }
+        }
+        // 精确定位时丢弃目标之前的帧，不放入帧队列也不上传纹理
+        if (isBeforeSeekTarget(bestPts == AV_NOPTS_VALUE ? NAN : bestPts * av_q2d(tb) + frameDuration)) {
+            av_frame_unref(frame);
+            continue;
+        }
+        // 是否重排pts，默认情况下需要重排pts的
+        if (playerState->reorderVideoPts == 1) {
+            frame->pts = av_frame_get_best_effort_timestamp(frame);
+        } else if (!playerState->reorderVideoPts) {
+            frame->pts = frame->pkt_dts;
+        }
 
-            // 丢帧处理
-            if (masterClock != NULL) {
-                double dpts = NAN;
+        // 丢帧处理
+        if (masterClock != NULL) {
+            double dpts = NAN;
 
+            if (frame->pts != AV_NOPTS_VALUE) {
+                dpts = av_q2d(pStream->time_base) * frame->pts;
+            }
+            // 计算帧的长宽比
+            frame->sample_aspect_ratio = av_guess_sample_aspect_ratio(pFormatCtx, pStream, frame);
+            // 是否需要做舍帧操作，主要看音视频同步是否差距过大
+            // 定位以后的第一帧不能丢弃
+            if (!seekFrameRequest && (playerState->frameDrop > 0 ||
+                (playerState->frameDrop > 0 && playerState->syncType != AV_SYNC_VIDEO))) {
                 if (frame->pts != AV_NOPTS_VALUE) {
-                    dpts = av_q2d(pStream->time_base) * frame->pts;
-                }
-                // 计算帧的长宽比
-                frame->sample_aspect_ratio = av_guess_sample_aspect_ratio(pFormatCtx, pStream, frame);
-                // 是否需要做舍帧操作，主要看音视频同步是否差距过大
-                if (playerState->frameDrop > 0 ||
-                    (playerState->frameDrop > 0 && playerState->syncType != AV_SYNC_VIDEO)) {
-                    if (frame->pts != AV_NOPTS_VALUE) {
-                        double diff = dpts - masterClock->getClock();
-                        if (!isnan(diff) && fabs(diff) < AV_NOSYNC_THRESHOLD && diff < 0 &&
-                            packetQueue->getPacketSize() > 0) {
-                            av_frame_unref(frame);
-                            got_picture = 0;
-                        }
+                    double diff = dpts - masterClock->getClock();
+                    if (!isnan(diff) && fabs(diff) < AV_NOSYNC_THRESHOLD && diff < 0 &&
+                        packetQueue->getPacketSize() > 0) {
+                        av_frame_unref(frame);
+                        got_picture = 0;
+                        droppedFrames++;
                     }
                 }
             }
@@ -208,6 +533,15 @@ int VideoDecoder::decodeVideo() {
                 ret = -1;
                 break;
             }
+            // 等待期间发生了定位，这一帧已经过时，不能拿来完成新的定位
+            if (isStaleFrame(serial)) {
+                if (packetPending) {
+                    av_packet_unref(packet);
+                    packetPending = false;
+                }
+                av_frame_unref(frame);
+                continue;
+            }
 
             // 复制参数
             vp->uploaded = 0;
@@ -216,15 +550,18 @@ int VideoDecoder::decodeVideo() {
             vp->format = frame->format;
             vp->pts = (frame->pts == AV_NOPTS_VALUE) ? NAN : frame->pts * av_q2d(tb);
             // 计算一帧的时长
-            vp->duration = frame_rate.num && frame_rate.den ? av_q2d((AVRational) {frame_rate.den, frame_rate.num}) : 0;
+            vp->duration = frameDuration;
+            vp->seekFrame = seekFrameRequest ? 1 : 0;
             av_frame_move_ref(vp->frame, frame); //移动引用的意思
             // 写入数据成功，这是一个生产者消费者模式的队列
             frameQueue->pushFrame();
+            if (seekFrameRequest) {
+                onSeekFrameReady();
+            }
         }
 
-        // 释放数据包和缓冲帧的引用，防止内存泄漏
+        // 释放缓冲帧的引用，防止内存泄漏
         av_frame_unref(frame);
-        av_packet_unref(packet);
     }
 
     av_frame_free(&frame);
@@ -232,10 +569,15 @@ int VideoDecoder::decodeVideo() {
     frame = NULL;
 
     // 本身指针packet是操作了一个内存空间的，用完之后要是否，否则内存泄漏
+    av_packet_unref(packet);
     av_packet_free(&packet);
     av_free(packet);
     packet = NULL;
 
+    LOGD("视频帧缓冲请求%lld次，分配内存%lld次，复用%lld次，重建缓冲池%lld次",
+         (long long) framePool->getRequestCount(), (long long) framePool->getAllocCount(),
+         (long long) framePool->getPoolHitCount(), (long long) framePool->getRebuildCount());
+
     // 等待线程结束后再删除线程对象
     mExit = true;
     mCondition.signal();
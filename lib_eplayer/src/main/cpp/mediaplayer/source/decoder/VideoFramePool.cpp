@@ -0,0 +1,159 @@
+
+#include "VideoFramePool.h"
+
+VideoFramePool::VideoFramePool() {
+    pool = NULL;
+    format = AV_PIX_FMT_NONE;
+    width = 0;
+    height = 0;
+    planes = 0;
+    memset(linesize, 0, sizeof(linesize));
+    memset(offset, 0, sizeof(offset));
+    requestCount = 0;
+    allocCount = 0;
+    rebuildCount = 0;
+}
+
+VideoFramePool::~VideoFramePool() {
+    // 还被帧引用的缓冲会在释放引用以后回收
+    av_buffer_pool_uninit(&pool);
+}
+
+void VideoFramePool::attach(AVCodecContext *avctx) {
+    avctx->opaque = this;
+    avctx->get_buffer2 = getBuffer2;
+}
+
+void VideoFramePool::detach(AVCodecContext *avctx) {
+    if (avctx->opaque == this) {
+        avctx->get_buffer2 = avcodec_default_get_buffer2;
+        avctx->opaque = NULL;
+    }
+}
+
+int64_t VideoFramePool::getRequestCount() {
+    Mutex::Autolock lock(mMutex);
+    return requestCount;
+}
+
+int64_t VideoFramePool::getAllocCount() {
+    Mutex::Autolock lock(mMutex);
+    return allocCount;
+}
+
+int64_t VideoFramePool::getPoolHitCount() {
+    Mutex::Autolock lock(mMutex);
+    return requestCount - allocCount;
+}
+
+int64_t VideoFramePool::getRebuildCount() {
+    Mutex::Autolock lock(mMutex);
+    return rebuildCount;
+}
+
+int VideoFramePool::getBuffer2(AVCodecContext *avctx, AVFrame *frame, int flags) {
+    VideoFramePool *framePool = (VideoFramePool *) avctx->opaque;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((AVPixelFormat) frame->format);
+    // 硬解码、调色板格式以及不支持直接渲染的解码器使用默认的分配方式
+    if (!framePool || !desc || avctx->hwaccel
+        || !(avctx->codec->capabilities & AV_CODEC_CAP_DR1)
+        || (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL))) {
+        return avcodec_default_get_buffer2(avctx, frame, flags);
+    }
+    return framePool->getBuffer(avctx, frame);
+}
+
+/**
+ * 缓冲池没有空闲缓冲时调用，统计实际分配内存的次数
+ * @param opaque
+ * @param size
+ * @return
+ */
+AVBufferRef *VideoFramePool::allocBuffer(void *opaque, int size) {
+    VideoFramePool *framePool = (VideoFramePool *) opaque;
+    // 只会在getBuffer持有锁时调用
+    framePool->allocCount++;
+    return av_buffer_alloc(size);
+}
+
+int VideoFramePool::getBuffer(AVCodecContext *avctx, AVFrame *frame) {
+    Mutex::Autolock lock(mMutex);
+    int ret = updatePool(avctx, frame);
+    if (ret < 0) {
+        return ret;
+    }
+
+    frame->buf[0] = av_buffer_pool_get(pool);
+    if (!frame->buf[0]) {
+        return AVERROR(ENOMEM);
+    }
+    requestCount++;
+
+    // 所有平面放在同一块缓冲中
+    for (int i = 0; i < 4; i++) {
+        if (i < planes) {
+            frame->data[i] = frame->buf[0]->data + offset[i];
+            frame->linesize[i] = linesize[i];
+        } else {
+            frame->data[i] = NULL;
+            frame->linesize[i] = 0;
+        }
+    }
+    frame->extended_data = frame->data;
+    return 0;
+}
+
+/**
+ * 按照解码器的对齐要求计算每个平面的行宽和偏移，跟ffmpeg默认的分配方式一致
+ * @param avctx
+ * @param frame
+ * @return
+ */
+int VideoFramePool::updatePool(AVCodecContext *avctx, AVFrame *frame) {
+    if (pool && format == frame->format && width == frame->width && height == frame->height) {
+        return 0;
+    }
+
+    int w = frame->width;
+    int h = frame->height;
+    int linesizeAlign[AV_NUM_DATA_POINTERS];
+    int lines[4];
+    int unaligned;
+    int ret;
+    avcodec_align_dimensions2(avctx, &w, &h, linesizeAlign);
+    do {
+        // 行宽不满足对齐要求时，增加宽度重新计算
+        ret = av_image_fill_linesizes(lines, (AVPixelFormat) frame->format, w);
+        if (ret < 0) {
+            return ret;
+        }
+        w += w & ~(w - 1);
+        unaligned = 0;
+        for (int i = 0; i < 4; i++) {
+            unaligned |= lines[i] % linesizeAlign[i];
+        }
+    } while (unaligned);
+
+    uint8_t *data[4];
+    int size = av_image_fill_pointers(data, (AVPixelFormat) frame->format, h, NULL, lines);
+    if (size < 0) {
+        return size;
+    }
+
+    // 旧的缓冲池在所有缓冲归还以后释放
+    av_buffer_pool_uninit(&pool);
+    pool = av_buffer_pool_init2(size + FRAME_POOL_PADDING, this, allocBuffer, NULL);
+    if (!pool) {
+        return AVERROR(ENOMEM);
+    }
+    planes = av_pix_fmt_count_planes((AVPixelFormat) frame->format);
+    for (int i = 0; i < 4; i++) {
+        linesize[i] = lines[i];
+        offset[i] = data[i] - data[0];
+    }
+    format = frame->format;
+    width = frame->width;
+    height = frame->height;
+    rebuildCount++;
+    return 0;
+}
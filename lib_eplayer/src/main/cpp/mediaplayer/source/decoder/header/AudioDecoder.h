@@ -13,6 +13,8 @@ public:
 
     int getAudioFrame(AVFrame *frame);
 
+    void changeStream(AVCodecContext *avctx, AVStream *stream, int streamIndex) override;
+
 private:
     bool packetPending; // 一次解码无法全部消耗完AVPacket中的数据的标志
     AVPacket *packet;
@@ -0,0 +1,61 @@
+
+#ifndef EPLAYER_DECODERSCHEDULER_H
+#define EPLAYER_DECODERSCHEDULER_H
+
+#include <mutex>
+#include "Mutex.h"
+#include "Condition.h"
+
+// 解码优先级，多个播放器同时解码时优先级高的先得到工作槽
+#define DECODE_PRIORITY_BACKGROUND 0    // 不可见的播放器，比如列表中滑出屏幕的
+#define DECODE_PRIORITY_VISIBLE 1       // 可见的播放器
+#define DECODE_PRIORITY_FOCUSED 2       // 获得焦点的播放器
+#define DECODE_PRIORITY_COUNT 3
+
+/**
+ * 进程内共享的解码调度器，所有开启共享解码池的播放器的视频解码都要先拿到工作槽
+ * 工作槽数量等于CPU核数，同时解码的播放器不会超过核数，有高优先级的播放器在等待时低优先级的不能拿到工作槽
+ * 另外根据同时使用调度器的播放器数量限制每个解码器的FFmpeg内部线程数
+ */
+class DecoderScheduler {
+public:
+    static DecoderScheduler *getInstance();
+
+    // 播放器开始使用调度器，用于计算每个解码器的内部线程数
+    void attach();
+
+    // 播放器不再使用调度器
+    void detach();
+
+    // 每个解码器可以使用的FFmpeg内部线程数
+    int getCodecThreadCount();
+
+    // 获取工作槽，abort为调用线程的退出标志，退出时返回false
+    bool acquire(int priority, const bool *abort);
+
+    // 释放工作槽
+    void release();
+
+    // 唤醒所有等待工作槽的线程，用于解码器退出
+    void wakeUp();
+
+private:
+    DecoderScheduler();
+
+    virtual ~DecoderScheduler();
+
+    bool hasHigherWaiter(int priority);
+
+private:
+    static DecoderScheduler *instance;
+    static std::mutex mutex;
+
+    Mutex mMutex;
+    Condition mCondition;
+    int workerCount;                            // 工作槽数量
+    int busyWorkers;                            // 正在使用的工作槽数量
+    int playerCount;                            // 使用调度器的播放器数量
+    int waiters[DECODE_PRIORITY_COUNT];         // 各优先级正在等待的线程数量
+};
+
+#endif //EPLAYER_DECODERSCHEDULER_H
@@ -21,6 +21,9 @@ public:
 
     int pushPacket(AVPacket *pkt);
 
+    // 送入空数据包，解码器取到以后排空缓存的帧
+    int pushNullPacket();
+
     int getPacketSize();
 
     int getStreamIndex();
@@ -33,17 +36,55 @@ public:
 
     int hasEnoughPackets();
 
+    // 队列中数据包的时长是否达到seconds，数据包没有时长时按数量估算
+    int hasBufferedDuration(double seconds);
+
+    int isBelowLowWatermark();
+
+    // 丢弃还没有解码的数据包，解码器状态保留，下一个关键帧以后可以继续解码
+    void dropPackets();
+
+    // 缓冲进度，0~1，缓冲时长达到bufferingSeconds或者数据包达到高水位时为1
+    double getBufferingProgress();
+
+    // 队列相对高水位的填充程度，0~1，字节数和时长取较大的一个
+    double getQueueLevel();
+
+    // 清空的次数，每次定位清空解码器时增加
+    int getFlushSerial();
+
+    // 设置精确定位的目标位置，单位AV_TIME_BASE，到达目标之前的帧都会被丢弃
+    virtual void setSeekTarget(int64_t target);
+
+    // 切换到同类型的另一路媒体流，旧的解码上下文和数据包都会被释放，调用前需要先停止取数据的线程
+    virtual void changeStream(AVCodecContext *avctx, AVStream *stream, int streamIndex);
+
     virtual void run();
 
+protected:
+    // 从数据包队列取数据，并在低于低水位时唤醒读数据包线程
+    int getPacket(AVPacket *pkt);
+
+    const QueueWatermark *getWatermark();
+
+    // 帧是否在精确定位目标之前，到达目标以后清除定位目标
+    bool isBeforeSeekTarget(double endTime);
+
+    // 帧从解码器取出以后解码器是否被清空过，或者又有了新的定位请求
+    bool isStaleFrame(int serial);
+
 protected:
     Mutex mMutex;
     Condition mCondition;
+    Mutex mCodecMutex;              // 解码上下文锁，只保护当前解码器，音视频解码可以并行
     bool abortRequest;
     PlayerState *playerState;
     PacketQueue *packetQueue;       // 数据包队列
     AVCodecContext *pCodecCtx;
     AVStream *pStream;
     int streamIndex;
+    std::atomic<int64_t> seekTarget;    // 精确定位的目标位置，AV_NOPTS_VALUE表示没有精确定位
+    std::atomic<int> flushSerial;       // 清空序列号，在解码上下文锁内修改
 };
 
 #endif //EPLAYER_MEDIADECODER_H
@@ -0,0 +1,122 @@
+
+#ifndef EPLAYER_REVERSEDECODER_H
+#define EPLAYER_REVERSEDECODER_H
+
+#include "AndroidLog.h"
+#include "PlayerState.h"
+#include "FrameQueue.h"
+
+// 每个GOP缓冲最多缓冲的帧数
+#define REVERSE_GOP_MAX_FRAMES 300
+// 内存不够时图像最多缩小到宽高的1/(1 << REVERSE_MAX_DOWNSCALE)
+#define REVERSE_MAX_DOWNSCALE 2
+// 定位以后没有解码出需要的帧时，往前多退的时长，单位秒，每次失败翻倍
+#define REVERSE_SEEK_STEP 1.0
+
+/**
+ * GOP缓冲，按时间戳升序保存一段连续的帧，倒放时从最晚的一帧开始取
+ */
+typedef struct ReverseGop {
+    Frame frames[REVERSE_GOP_MAX_FRAMES];
+    int capacity;           // 这一段解码时允许缓冲的帧数，按内存上限计算
+    int head;               // 最早一帧的下标
+    int count;              // 还没有取出的帧数
+    int64_t bytes;          // 缓冲的帧占用的内存
+    bool ready;             // 已经解码完成，可以显示
+} ReverseGop;
+
+/**
+ * 倒放解码器，使用独立的解复用器和解码器，不影响正放的读数据包线程和解码器
+ * 每次定位到要显示的帧之前的关键帧，把关键帧到上一段开头之间的帧解码到GOP缓冲，再按时间戳从大到小交给同步器显示
+ * 两个GOP缓冲轮流使用，同步器显示一个GOP时解码线程已经在解码前一个GOP
+ * 一个GOP放不进内存上限时先缩小图像，缩小到最小还放不下时只保留GOP末尾能放下的帧，前面的帧下一次从同一个关键帧重新解码
+ */
+class ReverseDecoder : public Runnable {
+public:
+    ReverseDecoder(PlayerState *playerState, AVFormatContext *pFormatCtx, AVStream *stream,
+                   AVCodecContext *videoCtx);
+
+    virtual ~ReverseDecoder();
+
+    // 从position开始往前倒放，单位秒，position这一帧本身不再显示
+    void start(double position);
+
+    void stop();
+
+    // 开始倒放的位置，单位秒
+    double getStartPosition();
+
+    // 接下来要显示的帧，offset为0时是下一帧，为1时是再下一帧，还没有解码出来时返回NULL，需要在同一个线程中调用popFrame
+    Frame *peekFrame(int offset);
+
+    // 取出下一帧作为正在显示的帧
+    void popFrame();
+
+    // 正在显示的帧，还没有显示过时返回NULL
+    Frame *getShownFrame();
+
+    // 已经倒放到文件开头或者解码出错，所有帧都已经取出
+    bool isFinished();
+
+    void run() override;
+
+private:
+    int openInput();
+
+    // 解码一段到GOP缓冲，返回缓冲的帧数，没有需要的帧时返回0，出错或者退出时返回负数
+    int decodeGop(ReverseGop *gop, AVFrame *frame, AVPacket *packet);
+
+    // 按上一段解码的帧数选择缩小倍数，使一个GOP能够放进内存上限
+    int chooseDownscale();
+
+    // 缩小以后一帧占用的内存
+    int getFrameBytes(int width, int height, int format, int downscale);
+
+    // 把解码出来的帧保存到缓冲中，需要缩小时转换成YUV420P
+    int storeFrame(Frame *vp, AVFrame *frame, int downscale);
+
+    void clearGop(ReverseGop *gop);
+
+    static int interruptCallback(void *opaque);
+
+private:
+    Mutex mMutex;
+    Condition mCondition;
+    Thread *decodeThread;                   // 倒放解码线程
+    bool abortRequest;
+    bool finished;                          // 已经到达开头或者出错，不再解码
+
+    PlayerState *playerState;
+    char *url;                              // 文件路径，使用独立的解复用器打开
+    AVInputFormat *iformat;                 // 封装格式
+    int streamId;                           // 视频流的id，用于在独立的解复用器中找到同一路流
+    int streamIndex;
+    AVRational timeBase;
+    AVCodecParameters *codecpar;            // 视频流的编解码参数
+    const AVCodec *codec;                   // 正放使用的解码器
+    double frameDuration;                   // 帧时长，单位秒
+    int64_t streamStartPts;                 // 视频流的起始时间戳，单位timeBase
+
+    AVFormatContext *pFormatCtx;            // 独立的解复用上下文
+    AVCodecContext *pCodecCtx;              // 独立的解码上下文
+    SwsContext *swsContext;                 // 缩小图像用的转换上下文
+
+    ReverseGop gops[2];                     // 两个GOP缓冲轮流使用
+    int fillIndex;                          // 解码线程正在填充的缓冲
+    int presentIndex;                       // 同步器正在取帧的缓冲
+    Frame shownFrame;                       // 正在显示的帧，从GOP缓冲中移出来，GOP缓冲可以马上重新填充
+    int64_t shownBytes;
+
+    double startPosition;                   // 开始倒放的位置，单位秒
+    int64_t endPts;                         // 下一段只解码这个时间戳之前的帧，单位timeBase
+    int64_t retreat;                        // 定位位置在endPts之前多退的时长，单位timeBase
+    int gopFrames;                          // 上一段从关键帧解码到endPts的帧数，用于估计GOP长度
+    int downscale;                          // 当前的缩小倍数
+
+    int decodedFrames;                      // 统计：解码出来的帧数
+    int redecodeCount;                      // 统计：GOP放不下需要分段重复解码的次数
+    int64_t decodeTime;                     // 统计：解码耗时，单位微秒
+    int64_t peakBytes;                      // 统计：缓冲内存的峰值
+};
+
+#endif //EPLAYER_REVERSEDECODER_H
@@ -0,0 +1,64 @@
+
+#ifndef EPLAYER_SUBTITLEDECODER_H
+#define EPLAYER_SUBTITLEDECODER_H
+
+#include "MediaDecoder.h"
+#include "PlayerState.h"
+
+/**
+ * 字幕解码器，解码得到的AVSubtitle放在帧队列的Frame::sub中，由同步器按主时钟取出显示
+ * 文件内的字幕流由读数据包线程送入数据包，外挂字幕文件由解码线程自己读取
+ */
+class SubtitleDecoder : public MediaDecoder {
+public:
+    // externalCtx不为NULL时表示外挂字幕，解码器负责关闭
+    SubtitleDecoder(AVFormatContext *externalCtx, AVCodecContext *avctx,
+                    AVStream *stream, int streamIndex, PlayerState *playerState);
+
+    virtual ~SubtitleDecoder();
+
+    void start() override;
+
+    void stop() override;
+
+    void flush() override;
+
+    // 外挂字幕在这里跟着主文件定位
+    void setSeekTarget(int64_t target) override;
+
+    // 外挂字幕的时间轴加上主文件的起始时间，单位AV_TIME_BASE
+    void setStartTime(int64_t startTime);
+
+    bool isExternal();
+
+    // 每次清空加一，同步器据此判断正在显示的字幕是否已经失效
+    int getSerial();
+
+    int getFrameSize();
+
+    FrameQueue *getFrameQueue();
+
+    // 取出文本字幕的文字，去掉ASS的样式标签，返回的字符串需要使用av_free释放，没有文字时返回NULL
+    static char *getSubtitleText(const AVSubtitle *sub);
+
+    void run() override;
+
+private:
+    // 解码字幕并放入帧队列
+    int decodeSubtitle();
+
+    // 从外挂字幕文件读取数据包，读到文件末尾以后等待定位或者退出
+    int readExternalPacket(AVPacket *pkt);
+
+private:
+    AVFormatContext *externalCtx;           // 外挂字幕的解复用上下文
+    FrameQueue *frameQueue;                 // 字幕帧队列
+    bool mExit;                             // 退出标志
+    Thread *decodeThread;                   // 解码线程
+    int64_t startTime;                      // 外挂字幕的时间偏移，单位AV_TIME_BASE
+    bool externalEof;                       // 外挂字幕已经读到文件末尾
+    std::atomic<int64_t> externalSeekPos;   // 外挂字幕需要定位到的位置，AV_NOPTS_VALUE表示不需要定位
+    std::atomic<int> serial;                // 清空序号
+};
+
+#endif //EPLAYER_SUBTITLEDECODER_H
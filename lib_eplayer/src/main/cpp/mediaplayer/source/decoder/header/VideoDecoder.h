@@ -6,6 +6,14 @@
 #include "MediaDecoder.h"
 #include "PlayerState.h"
 #include "MediaClock.h"
+#include "VideoFramePool.h"
+
+// 视频解码降级等级，解码跟不上时逐级提升，恢复以后逐级降低
+#define DECODER_LEVEL_NONE 0                // 正常解码
+#define DECODER_LEVEL_SKIP_NONREF_FILTER 1  // 非参考帧跳过环路滤波
+#define DECODER_LEVEL_SKIP_ALL_FILTER 2     // 所有帧跳过环路滤波
+#define DECODER_LEVEL_SKIP_NONREF 3         // 跳过非参考帧
+#define DECODER_LEVEL_SKIP_NONKEY 4         // 只解码关键帧
 
 class VideoDecoder : public MediaDecoder {
 public:
@@ -23,6 +31,8 @@ public:
 
     void flush() override;
 
+    void setSeekTarget(int64_t target) override;
+
     int getFrameSize();
 
     int getRotate();
@@ -31,12 +41,40 @@ public:
 
     AVFormatContext *getFormatContext();
 
+    // 解码以后因为落后主时钟而丢弃的帧数
+    int getDroppedFrames();
+
+    VideoFramePool *getFramePool();
+
     void run() override;
 
 private:
     // 解码视频帧
     int decodeVideo();
 
+    // 数据包是否在精确定位目标之前，用于追赶目标帧时跳过非参考帧
+    bool isCatchUpPacket(AVPacket *packet);
+
+    // 定位以后的第一帧已经放入帧队列
+    void onSeekFrameReady();
+
+    // 根据解码耗时的抖动调整帧队列深度
+    void updateQueueDepth(int64_t decodeTime, double duration, int frameBytes);
+
+    // 根据解码负载和帧队列的填充程度调整降级等级
+    void updateDecoderLevel(int64_t decodeTime, double pts, double duration);
+
+    // 根据播放速度调整跳帧等级，显示帧率超过屏幕刷新率时跳过非参考帧，速度足够快时只解码关键帧
+    void updateRateLevel(double duration);
+
+    // 按降级等级、倍速跳帧等级和是否正在追赶定位目标设置解码器的跳帧参数，需要持有解码上下文锁
+    void applySkipMode(bool catchUp);
+
+    // 开启共享解码调度器时先拿到工作槽才能操作解码器，退出时返回false
+    bool acquireWorker();
+
+    void releaseWorker();
+
 private:
     AVFormatContext *pFormatCtx;    // 解复用上下文
     FrameQueue *frameQueue;         // 帧队列
@@ -45,6 +83,25 @@ private:
     bool mExit;                     // 退出标志
     Thread *decodeThread;           // 解码线程
     MediaClock *masterClock;        // 主时钟
+    VideoFramePool *framePool;      // 视频帧缓冲池
+
+    double avgDecodeTime;           // 每帧平均解码耗时，单位秒
+    double decodeJitter;            // 解码耗时的平均偏差，单位秒
+    int shrinkFrames;               // 连续需要更小深度的帧数
+
+    std::atomic<bool> seekFrameRequest;     // 定位以后是否还没有输出第一帧
+    std::atomic<int64_t> seekCompletePos;   // 精确定位的目标，到达以后才通知定位完成
+    AVDiscard defaultSkipFrame;             // 解码器原来的skip_frame
+    AVDiscard defaultSkipLoopFilter;        // 解码器原来的skip_loop_filter
+    bool catchUpMode;                       // 是否正在跳帧追赶定位目标
+    int decoderLevel;                       // 降级等级
+    double decodeLoad;                      // 解码耗时占帧显示时长的平均比例
+    double lastFramePts;                    // 上一个输出帧的时间戳，单位秒
+    int rateLevel;                          // 按播放速度决定的跳帧等级，跟降级等级取较高的一个
+    int appliedLevel;                       // 已经设置到解码器上的降级等级
+    int overloadFrames;                     // 连续过载的帧数
+    int recoverFrames;                      // 连续恢复的帧数
+    std::atomic<int> droppedFrames;         // 统计：解码以后落后主时钟丢弃的帧数
 };
 
 #endif //EPLAYER_VIDEODECODER_H
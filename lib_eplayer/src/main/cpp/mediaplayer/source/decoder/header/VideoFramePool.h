@@ -0,0 +1,70 @@
+
+#ifndef EPLAYER_VIDEOFRAMEPOOL_H
+#define EPLAYER_VIDEOFRAMEPOOL_H
+
+#include "Mutex.h"
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+#include "libavutil/buffer.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/pixdesc.h"
+};
+
+// 帧缓冲末尾额外的填充大小，防止解码器越界读取
+#define FRAME_POOL_PADDING (16 + 64 - 1)
+
+/**
+ * 视频帧缓冲池，替换解码器默认的get_buffer2，按照宽高和像素格式复用图像内存
+ * 分辨率或者像素格式变化时重建缓冲池，旧的缓冲在所有引用释放以后才会回收
+ */
+class VideoFramePool {
+public:
+    VideoFramePool();
+
+    virtual ~VideoFramePool();
+
+    // 安装到解码上下文
+    void attach(AVCodecContext *avctx);
+
+    // 从解码上下文中移除，恢复默认的分配方式
+    void detach(AVCodecContext *avctx);
+
+    // 请求帧缓冲的次数
+    int64_t getRequestCount();
+
+    // 实际分配内存的次数
+    int64_t getAllocCount();
+
+    // 从缓冲池中直接复用的次数
+    int64_t getPoolHitCount();
+
+    // 缓冲池重建次数
+    int64_t getRebuildCount();
+
+private:
+    static int getBuffer2(AVCodecContext *avctx, AVFrame *frame, int flags);
+
+    static AVBufferRef *allocBuffer(void *opaque, int size);
+
+    int getBuffer(AVCodecContext *avctx, AVFrame *frame);
+
+    // 宽高或者像素格式变化时重建缓冲池
+    int updatePool(AVCodecContext *avctx, AVFrame *frame);
+
+private:
+    Mutex mMutex;                           // 帧线程解码时get_buffer2会被多个线程调用
+    AVBufferPool *pool;
+    int format;                             // 当前缓冲池对应的像素格式
+    int width;                              // 当前缓冲池对应的宽度
+    int height;                             // 当前缓冲池对应的高度
+    int planes;                             // 平面数量
+    int linesize[4];                        // 每个平面的行宽
+    ptrdiff_t offset[4];                    // 每个平面在缓冲中的偏移
+
+    int64_t requestCount;
+    int64_t allocCount;
+    int64_t rebuildCount;
+};
+
+#endif //EPLAYER_VIDEOFRAMEPOOL_H
@@ -31,4 +31,8 @@ int VideoDevice::onUpdateARGB(uint8_t *rgba, int pitch) {
 
 int VideoDevice::onRequestRender(bool flip) {
     return 0;
-}
\ No newline at end of file
+}
+
+int VideoDevice::onUpdateSubtitle(uint8_t *rgba, int width, int height, float x, float y, float w, float h) {
+    return 0;
+}
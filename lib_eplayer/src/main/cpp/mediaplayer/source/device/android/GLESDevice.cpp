@@ -28,6 +28,7 @@ GLESDevice::GLESDevice() {
     filterInfo.name = nullptr;
     filterInfo.id = -1;
     filterChange = true;
+    mSubtitleFilter = NULL;
 
     resetVertices();
     resetTexVertices();
@@ -50,6 +51,9 @@ void GLESDevice::surfaceChanged(int width, int height) {
         GLOutFilter *glOutFilter = (GLOutFilter *) nodeList->findNode(NODE_DISPLAY)->glFilter;
         glOutFilter->nativeSurfaceChanged(width, height);
     }
+    if (mSubtitleFilter) {
+        mSubtitleFilter->nativeSurfaceChanged(width, height);
+    }
     mMutex.unlock();
 }
 
@@ -97,6 +101,11 @@ void GLESDevice::terminate(bool releaseContext) {
             mRenderNode->destroy();
             delete mRenderNode;
         }
+        if (mSubtitleFilter) { // 释放字幕滤镜
+            mSubtitleFilter->destroyProgram();
+            delete mSubtitleFilter;
+            mSubtitleFilter = NULL;
+        }
         eglHelper->release();
         delete eglHelper;
         if (mWindow) {
@@ -339,12 +348,50 @@ int GLESDevice::onRequestRender(bool flip) {
         // mRenderNode->drawFrame(mVideoTexture);
         // 从渲染节点链表中的节点依次对纹理数据进行处理，并最后显示
         nodeList->drawFrame(texture, vertices, textureVertices);
+        // 字幕叠加在最终画面上，字幕纹理只在字幕变化时上传
+        if (mSubtitleFilter && mSubtitleFilter->hasSubtitle()) {
+            mSubtitleFilter->drawSubtitle();
+        }
         eglHelper->swapBuffers(eglSurface);
     }
     mMutex.unlock();
     return 0;
 }
 
+/**
+ * 字幕变化时由同步线程调用，纹理上传需要在渲染线程的EGL上下文中完成
+ * @param rgba
+ * @param width
+ * @param height
+ * @param x
+ * @param y
+ * @param w
+ * @param h
+ * @return
+ */
+int GLESDevice::onUpdateSubtitle(uint8_t *rgba, int width, int height, float x, float y, float w, float h) {
+    if (!mHaveEGlContext) {
+        return -1;
+    }
+    mMutex.lock();
+    if (mRenderNode != NULL && eglSurface != EGL_NO_SURFACE) {
+        eglHelper->makeCurrent(eglSurface);
+        if (!mSubtitleFilter && rgba) {
+            mSubtitleFilter = new GLSubtitleFilter();
+        }
+        if (mSubtitleFilter) {
+            // 跟显示节点使用相同的适配矩阵，视频宽高变化以后重新计算
+            mSubtitleFilter->setTextureSize(mVideoTexture->frameWidth, mVideoTexture->frameHeight);
+            mSubtitleFilter->setDisplaySize(mSurfaceWidth, mSurfaceHeight);
+            mSubtitleFilter->initProgram();
+            mSubtitleFilter->nativeSurfaceChanged(mSurfaceWidth, mSurfaceHeight);
+            mSubtitleFilter->setSubtitle(rgba, width, height, x, y, w, h);
+        }
+    }
+    mMutex.unlock();
+    return 0;
+}
+
 void GLESDevice::resetVertices() {
     const float *verticesCoord = CoordinateUtils::getVertexCoordinates();
     for (int i = 0; i < 8; ++i) {
@@ -8,6 +8,7 @@
 #include <RenderNodeList.h>
 #include "render/common/header/EglHelper.h"
 #include "InputRenderNode.h"
+#include "GLSubtitleFilter.h"
 
 class GLESDevice : public VideoDevice {
 public:
@@ -36,6 +37,8 @@ public:
 
     int onRequestRender(bool flip) override;
 
+    int onUpdateSubtitle(uint8_t *rgba, int width, int height, float x, float y, float w, float h) override;
+
 
     // 改变滤镜
     void changeFilter(RenderNodeType type, const char *filterName);
@@ -74,6 +77,7 @@ private:
     RenderNodeList *nodeList;           // 滤镜链
     FilterInfo filterInfo;              // 滤镜信息
     bool filterChange;                  // 切换滤镜
+    GLSubtitleFilter *mSubtitleFilter;  // 字幕叠加滤镜，在渲染线程中创建
 
 
 };
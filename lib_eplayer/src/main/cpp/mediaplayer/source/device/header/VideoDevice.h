@@ -31,5 +31,8 @@ public:
     // 请求渲染
     virtual int onRequestRender(bool flip);
 
+    // 更新字幕图像，rgba为预乘透明度的RGBA数据，为NULL时清除字幕，位置和大小以视频宽高归一化
+    virtual int onUpdateSubtitle(uint8_t *rgba, int width, int height, float x, float y, float w, float h);
+
 };
 #endif //EPLAYER_VIDEODEVICE_H
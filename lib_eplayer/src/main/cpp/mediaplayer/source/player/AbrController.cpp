@@ -0,0 +1,354 @@
+
+#include "AbrController.h"
+#include <AndroidLog.h>
+
+extern "C" {
+#include "libavutil/time.h"
+};
+
+AbrController::AbrController(PlayerState *playerState) {
+    this->playerState = playerState;
+    pFormatCtx = NULL;
+    variants = NULL;
+    variantCount = 0;
+    current = 0;
+    pending = -1;
+    pendingStartTime = 0;
+    lastSwitchTime = 0;
+    decoderVideoIndex = -1;
+    decoderAudioIndex = -1;
+    fastEstimate = 0;
+    slowEstimate = 0;
+    sampleBytes = 0;
+    sampleTime = 0;
+    totalBytes = 0;
+    lastVideoTs = AV_NOPTS_VALUE;
+    lastAudioTs = AV_NOPTS_VALUE;
+    audioResumeTs = AV_NOPTS_VALUE;
+}
+
+AbrController::~AbrController() {
+    av_freep(&variants);
+}
+
+/**
+ * HLS解复用器为主播放列表中的每一路码流创建一个AVProgram，码率保存在variant_bitrate中
+ * 只保留跟解码器使用的媒体流编码格式相同的码流，切换时不需要重新创建解码器
+ * @param pFormatCtx
+ * @param videoIndex 视频解码器使用的媒体流
+ * @param audioIndex 音频解码器使用的媒体流
+ * @return
+ */
+int AbrController::open(AVFormatContext *pFormatCtx, int videoIndex, int audioIndex) {
+    if (!av_match_name("hls", pFormatCtx->iformat->name) || pFormatCtx->nb_programs < 2) {
+        return -1;
+    }
+    if (videoIndex < 0 && audioIndex < 0) {
+        return -1;
+    }
+    variants = (AbrVariant *) av_mallocz_array(pFormatCtx->nb_programs, sizeof(AbrVariant));
+    if (!variants) {
+        return AVERROR(ENOMEM);
+    }
+    this->pFormatCtx = pFormatCtx;
+    decoderVideoIndex = videoIndex;
+    decoderAudioIndex = audioIndex;
+
+    for (int i = 0; i < pFormatCtx->nb_programs; i++) {
+        AVProgram *program = pFormatCtx->programs[i];
+        AbrVariant variant = {0, -1, -1};
+        AVDictionaryEntry *entry = av_dict_get(program->metadata, "variant_bitrate", NULL, 0);
+        if (!entry || (variant.bitrate = strtoll(entry->value, NULL, 10)) <= 0) {
+            continue;
+        }
+        for (int j = 0; j < program->nb_stream_indexes; j++) {
+            int index = program->stream_index[j];
+            AVCodecParameters *par = pFormatCtx->streams[index]->codecpar;
+            if (par->codec_type == AVMEDIA_TYPE_VIDEO && variant.videoIndex < 0) {
+                variant.videoIndex = index;
+            } else if (par->codec_type == AVMEDIA_TYPE_AUDIO && variant.audioIndex < 0) {
+                variant.audioIndex = index;
+            }
+        }
+        // 解码器需要的媒体流都要有，并且编码格式相同
+        if ((videoIndex >= 0 && (variant.videoIndex < 0
+                                 || pFormatCtx->streams[variant.videoIndex]->codecpar->codec_id
+                                    != pFormatCtx->streams[videoIndex]->codecpar->codec_id))
+            || (audioIndex >= 0 && (variant.audioIndex < 0
+                                    || pFormatCtx->streams[variant.audioIndex]->codecpar->codec_id
+                                       != pFormatCtx->streams[audioIndex]->codecpar->codec_id))) {
+            continue;
+        }
+        if (videoIndex < 0) {
+            variant.videoIndex = -1;
+        }
+        if (audioIndex < 0) {
+            variant.audioIndex = -1;
+        }
+        // 按码率插入排序，媒体流完全相同的码流只保留一个
+        bool duplicated = false;
+        for (int j = 0; j < variantCount; j++) {
+            duplicated |= variants[j].videoIndex == variant.videoIndex && variants[j].audioIndex == variant.audioIndex;
+        }
+        if (duplicated) {
+            continue;
+        }
+        int pos = variantCount++;
+        while (pos > 0 && variants[pos - 1].bitrate > variant.bitrate) {
+            variants[pos] = variants[pos - 1];
+            pos--;
+        }
+        variants[pos] = variant;
+    }
+
+    current = -1;
+    for (int i = 0; i < variantCount; i++) {
+        if (variants[i].videoIndex == videoIndex && variants[i].audioIndex == audioIndex) {
+            current = i;
+            break;
+        }
+    }
+    if (current < 0 || variantCount < 2) {
+        return -1;
+    }
+
+    // 解复用器只下载没有被丢弃的媒体流所在的播放列表，其他码流先全部丢弃
+    for (int i = 0; i < variantCount; i++) {
+        if (i != current) {
+            setDiscard(i, AVDISCARD_ALL);
+        }
+    }
+    lastSwitchTime = getCurrentTime();
+    av_log(NULL, AV_LOG_INFO, "abr: %d variants, start with %" PRId64 "bps\n", variantCount,
+           variants[current].bitrate);
+    return 0;
+}
+
+/**
+ * 吞吐量按读数据包的耗时计算，读数据包线程因为队列已满而休眠的时间不计算在内
+ * @param bytes
+ * @param elapsed
+ */
+void AbrController::addSample(int bytes, int64_t elapsed) {
+    sampleBytes += bytes;
+    sampleTime += elapsed;
+    totalBytes += bytes;
+    if (sampleTime < ABR_SAMPLE_DURATION) {
+        return;
+    }
+    double seconds = sampleTime / 1000000.0;
+    double bps = sampleBytes * 8 / seconds;
+    // 按采样时长加权的指数滑动平均
+    double fastAlpha = pow(0.5, seconds / ABR_FAST_HALF_LIFE);
+    double slowAlpha = pow(0.5, seconds / ABR_SLOW_HALF_LIFE);
+    fastEstimate = fastEstimate > 0 ? fastAlpha * fastEstimate + (1 - fastAlpha) * bps : bps;
+    slowEstimate = slowEstimate > 0 ? slowAlpha * slowEstimate + (1 - slowAlpha) * bps : bps;
+    sampleBytes = 0;
+    sampleTime = 0;
+}
+
+int64_t AbrController::getBandwidth() {
+    return (int64_t) FFMIN(fastEstimate, slowEstimate);
+}
+
+int64_t AbrController::getCurrentTime() {
+    return av_gettime_relative();
+}
+
+/**
+ * 选择吞吐量能够承受的最高码流，队列填充程度不够时不提高码率
+ * @param queueLevel
+ * @return
+ */
+int AbrController::selectVariant(double queueLevel) {
+    if (totalBytes < ABR_MIN_TOTAL_BYTES) {
+        return current;
+    }
+    double usable = getBandwidth() * (queueLevel < ABR_PANIC_LEVEL ? ABR_PANIC_FACTOR : ABR_SAFETY_FACTOR);
+    int target = 0;
+    for (int i = 1; i < variantCount; i++) {
+        if (variants[i].bitrate <= usable) {
+            target = i;
+        }
+    }
+    if (target > current && queueLevel < ABR_UP_LEVEL) {
+        return current;
+    }
+    return target;
+}
+
+void AbrController::update(double queueLevel) {
+    int64_t now = getCurrentTime();
+    if (pending >= 0) {
+        // 新码流迟迟没有送来切换点，或者提高码率的过程中缓冲快要耗尽，放弃切换
+        if (now - pendingStartTime > ABR_SWITCH_TIMEOUT
+            || (pending > current && queueLevel < ABR_PANIC_LEVEL)) {
+            av_log(NULL, AV_LOG_INFO, "abr: cancel switching to %" PRId64 "bps\n", variants[pending].bitrate);
+            int cancelled = pending;
+            pending = -1;
+            setDiscard(cancelled, AVDISCARD_ALL);
+        }
+        return;
+    }
+    int target = selectVariant(queueLevel);
+    if (target == current) {
+        return;
+    }
+    // 降低码率立即切换，提高码率需要间隔一段时间，防止来回切换
+    if (target > current && now - lastSwitchTime < ABR_SWITCH_INTERVAL) {
+        return;
+    }
+    startSwitch(target);
+}
+
+/**
+ * 打开新码流的媒体流，HLS解复用器会从当前时间所在的分片开始下载新码流
+ * @param variant
+ */
+void AbrController::startSwitch(int variant) {
+    av_log(NULL, AV_LOG_INFO, "abr: switch %" PRId64 "bps -> %" PRId64 "bps, bandwidth %" PRId64 "bps\n",
+           variants[current].bitrate, variants[variant].bitrate, getBandwidth());
+    pending = variant;
+    pendingStartTime = getCurrentTime();
+    setDiscard(variant, AVDISCARD_DEFAULT);
+}
+
+/**
+ * 新码流已经送来切换点，丢弃旧码流
+ */
+void AbrController::commitSwitch() {
+    int previous = current;
+    current = pending;
+    pending = -1;
+    setDiscard(previous, AVDISCARD_ALL);
+    // 新旧码流的音频有重叠，新码流的音频要接在已经送给解码器的音频后面
+    if (variants[previous].audioIndex != variants[current].audioIndex) {
+        audioResumeTs = lastAudioTs;
+    }
+    lastSwitchTime = getCurrentTime();
+    LOGD("切换码流完成，码率%lldbps", (long long) variants[current].bitrate);
+    if (playerState->messageQueue) {
+        playerState->messageQueue->postMessage(MSG_VARIANT_CHANGED, (int) (variants[current].bitrate / 1000),
+                                               current);
+    }
+}
+
+/**
+ * 设置码流中媒体流的丢弃标志，当前码流也在使用的媒体流(比如共用的音频)不会被丢弃
+ * @param variant
+ * @param discard
+ */
+void AbrController::setDiscard(int variant, enum AVDiscard discard) {
+    int indexes[2] = {variants[variant].videoIndex, variants[variant].audioIndex};
+    for (int i = 0; i < 2; i++) {
+        int index = indexes[i];
+        if (index < 0) {
+            continue;
+        }
+        if (discard == AVDISCARD_ALL && (isStreamOf(current, index) || (pending >= 0 && isStreamOf(pending, index)))) {
+            continue;
+        }
+        pFormatCtx->streams[index]->discard = discard;
+    }
+}
+
+bool AbrController::isStreamOf(int variant, int streamIndex) {
+    return variants[variant].videoIndex == streamIndex || variants[variant].audioIndex == streamIndex;
+}
+
+bool AbrController::isVariantStream(int streamIndex) {
+    for (int i = 0; i < variantCount; i++) {
+        if (isStreamOf(i, streamIndex)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int64_t AbrController::getTimestamp(AVPacket *pkt) {
+    int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+    if (ts == AV_NOPTS_VALUE) {
+        return AV_NOPTS_VALUE;
+    }
+    return av_rescale_q(ts, pFormatCtx->streams[pkt->stream_index]->time_base, AV_TIME_BASE_Q);
+}
+
+/**
+ * 把数据包映射到解码器使用的媒体流上，时间基不同时转换时间戳
+ * @param pkt
+ * @param decoderIndex
+ */
+void AbrController::remap(AVPacket *pkt, int decoderIndex) {
+    if (pkt->stream_index == decoderIndex) {
+        return;
+    }
+    AVRational src = pFormatCtx->streams[pkt->stream_index]->time_base;
+    AVRational dst = pFormatCtx->streams[decoderIndex]->time_base;
+    if (av_cmp_q(src, dst)) {
+        av_packet_rescale_ts(pkt, src, dst);
+    }
+    pkt->stream_index = decoderIndex;
+}
+
+/**
+ * 切换过程中新旧码流的数据包交错到达，切换点之前只使用旧码流，切换点之后只使用新码流
+ * 有视频时切换点是时间戳不早于已经送出的视频的关键帧，纯音频时是时间戳在已经送出的音频之后的数据包
+ * 分片对齐的码流在同一时间都是关键帧，解复用器在时间戳相同时先输出排在前面的播放列表，
+ * 如果要求严格在已经送出的视频之后，排在后面的码流永远等不到切换点，所以允许同一时间的关键帧，这一帧会重复一次
+ * @param pkt
+ * @return
+ */
+bool AbrController::mapPacket(AVPacket *pkt) {
+    int index = pkt->stream_index;
+    if (!isVariantStream(index)) {
+        return true;
+    }
+    int64_t ts = getTimestamp(pkt);
+    if (pending >= 0 && !isStreamOf(current, index) && isStreamOf(pending, index)) {
+        AbrVariant *target = &variants[pending];
+        bool switchPoint;
+        if (target->videoIndex >= 0) {
+            switchPoint = index == target->videoIndex && (pkt->flags & AV_PKT_FLAG_KEY) && ts != AV_NOPTS_VALUE
+                          && (lastVideoTs == AV_NOPTS_VALUE || ts >= lastVideoTs);
+        } else {
+            switchPoint = ts != AV_NOPTS_VALUE && (lastAudioTs == AV_NOPTS_VALUE || ts > lastAudioTs);
+        }
+        if (!switchPoint) {
+            return false;
+        }
+        commitSwitch();
+    }
+    if (!isStreamOf(current, index)) {
+        return false;
+    }
+
+    AbrVariant *variant = &variants[current];
+    if (index == variant->videoIndex) {
+        if (ts != AV_NOPTS_VALUE && (lastVideoTs == AV_NOPTS_VALUE || ts > lastVideoTs)) {
+            lastVideoTs = ts;
+        }
+        remap(pkt, decoderVideoIndex);
+    } else if (index == variant->audioIndex) {
+        if (audioResumeTs != AV_NOPTS_VALUE) {
+            if (ts != AV_NOPTS_VALUE && ts <= audioResumeTs) {
+                return false;
+            }
+            audioResumeTs = AV_NOPTS_VALUE;
+        }
+        if (ts != AV_NOPTS_VALUE) {
+            lastAudioTs = ts;
+        }
+        remap(pkt, decoderAudioIndex);
+    }
+    return true;
+}
+
+void AbrController::flush() {
+    lastVideoTs = AV_NOPTS_VALUE;
+    lastAudioTs = AV_NOPTS_VALUE;
+    audioResumeTs = AV_NOPTS_VALUE;
+    // 定位以后所有打开的码流都从目标位置开始，不需要再等切换点
+    if (pending >= 0) {
+        commitSwitch();
+    }
+}
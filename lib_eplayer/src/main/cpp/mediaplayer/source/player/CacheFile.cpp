@@ -0,0 +1,86 @@
+
+#include <string.h>
+#include <sys/stat.h>
+#include "CacheFile.h"
+
+extern "C" {
+#include "libavutil/avstring.h"
+};
+
+// FNV-1a哈希，用于计算文件标识
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+static uint64_t hashBytes(uint64_t hash, const void *data, size_t size) {
+    const uint8_t *p = (const uint8_t *) data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+uint64_t computeFileKey(const char *url, int64_t size, int64_t fallback) {
+    const char *path = url;
+    av_strstart(url, "file:", &path);
+    struct stat st;
+    uint64_t key = hashBytes(FNV_OFFSET_BASIS, url, strlen(url));
+    key = hashBytes(key, &size, sizeof(size));
+    if (stat(path, &st) == 0) {
+        int64_t mtime = st.st_mtime;
+        key = hashBytes(key, &mtime, sizeof(mtime));
+    } else {
+        key = hashBytes(key, &fallback, sizeof(fallback));
+    }
+    return key;
+}
+
+void writeVarint(FILE *file, uint64_t value) {
+    while (value >= 0x80) {
+        fputc((int) ((value & 0x7f) | 0x80), file);
+        value >>= 7;
+    }
+    fputc((int) value, file);
+}
+
+int readVarint(FILE *file, uint64_t *value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = fgetc(file);
+        if (c == EOF) {
+            return -1;
+        }
+        result |= (uint64_t) (c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            *value = result;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// 绝对值小的负数也只占用很少的字节
+void writeSignedVarint(FILE *file, int64_t value) {
+    writeVarint(file, ((uint64_t) value << 1) ^ (uint64_t) (value >> 63));
+}
+
+int readSignedVarint(FILE *file, int64_t *value) {
+    uint64_t v;
+    if (readVarint(file, &v) < 0) {
+        return -1;
+    }
+    *value = (int64_t) (v >> 1) ^ -(int64_t) (v & 1);
+    return 0;
+}
+
+int commitCacheFile(FILE *file, const char *tmpPath, const char *path) {
+    int ret = ferror(file) ? -1 : 0;
+    if (fclose(file) != 0) {
+        ret = -1;
+    }
+    if (ret == 0 && rename(tmpPath, path) == 0) {
+        return 0;
+    }
+    remove(tmpPath);
+    return -1;
+}
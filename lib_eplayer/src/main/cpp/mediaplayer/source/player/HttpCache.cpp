@@ -0,0 +1,517 @@
+
+#include "HttpCache.h"
+#include "CacheFile.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <utime.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <vector>
+#include <algorithm>
+
+extern "C" {
+#include "libavutil/avstring.h"
+};
+
+// 分块表文件的标识
+static const char HTTP_CACHE_MAGIC[4] = {'E', 'H', 'C', 'M'};
+
+/**
+ * 缓存目录中的一个缓存文件，用于淘汰
+ */
+typedef struct CacheEntry {
+    char *dataPath;
+    int64_t size;           // 实际占用的磁盘空间
+    time_t lastUsed;        // 最近使用时间，打开缓存时更新
+} CacheEntry;
+
+static bool compareLastUsed(const CacheEntry &a, const CacheEntry &b) {
+    return a.lastUsed < b.lastUsed;
+}
+
+HttpCache::HttpCache() {
+    url = NULL;
+    cacheDir = NULL;
+    maxCacheSize = 0;
+    fileKey = 0;
+    dataPath = NULL;
+    mapPath = NULL;
+    network = NULL;
+    networkOptions = NULL;
+    interruptCallback.callback = NULL;
+    interruptCallback.opaque = NULL;
+    networkPos = 0;
+    fillStart = 0;
+    dataFd = -1;
+    writeError = false;
+    fileSize = 0;
+    position = 0;
+    blockMap = NULL;
+    blockCount = 0;
+    unsavedBlocks = 0;
+    context = NULL;
+}
+
+HttpCache::~HttpCache() {
+    close();
+    if (context) {
+        av_freep(&context->buffer);
+        avio_context_free(&context);
+    }
+    av_dict_free(&networkOptions);
+    av_freep(&url);
+    av_freep(&cacheDir);
+    av_freep(&dataPath);
+    av_freep(&mapPath);
+}
+
+bool HttpCache::isSupported(const char *url) {
+    const char *protocol = avio_find_protocol_name(url);
+    // HLS的分片由解复用器自己下载，不经过这里
+    return protocol && (!strcmp(protocol, "http") || !strcmp(protocol, "https")) && !av_match_ext(url, "m3u8");
+}
+
+/**
+ * 连接服务器拿到文件大小，文件大小和分块表记录的不一致时说明服务器上的文件已经变化，丢弃原来的缓存
+ * @param url
+ * @param cacheDir 缓存目录
+ * @param maxCacheSize 缓存目录大小上限
+ * @param interruptCallback 播放器的中断回调
+ * @param options 协议参数，网络连接使用掉的参数会被移除
+ * @return
+ */
+int HttpCache::open(const char *url, const char *cacheDir, int64_t maxCacheSize,
+                    const AVIOInterruptCB *interruptCallback, AVDictionary **options) {
+    int ret;
+    uint8_t *ioBuffer;
+
+    if (!cacheDir) {
+        return -1;
+    }
+    this->url = av_strdup(url);
+    this->cacheDir = av_strdup(cacheDir);
+    this->maxCacheSize = maxCacheSize;
+    if (interruptCallback) {
+        this->interruptCallback = *interruptCallback;
+    }
+    if (options) {
+        av_dict_copy(&networkOptions, *options, 0);
+    }
+    if ((ret = avio_open2(&network, url, AVIO_FLAG_READ, &this->interruptCallback, options)) < 0) {
+        return ret;
+    }
+    fileSize = avio_size(network);
+    if (fileSize <= 0 || !(network->seekable & AVIO_SEEKABLE_NORMAL)) {
+        return -1;
+    }
+
+    fileKey = computeFileKey(url, -1, 0);
+    dataPath = av_asprintf("%s/%016" PRIx64 "%s", cacheDir, fileKey, HTTP_CACHE_DATA_SUFFIX);
+    mapPath = av_asprintf("%s/%016" PRIx64 "%s", cacheDir, fileKey, HTTP_CACHE_MAP_SUFFIX);
+    blockCount = (fileSize + HTTP_CACHE_BLOCK_SIZE - 1) / HTTP_CACHE_BLOCK_SIZE;
+    blockMap = (uint8_t *) av_mallocz((size_t) ((blockCount + 7) / 8));
+    if (!dataPath || !mapPath || !blockMap) {
+        return AVERROR(ENOMEM);
+    }
+
+    // 持有目录锁时其他播放器不能打开同一个缓存，也不能淘汰缓存
+    int dirFd = lockCacheDir();
+    if ((ret = openDataFile()) == 0 && loadMap(blockMap) < 0) {
+        memset(blockMap, 0, (size_t) ((blockCount + 7) / 8));
+        ret = resetDataFile();
+    }
+    unlockCacheDir(dirFd);
+    if (ret < 0) {
+        return ret;
+    }
+    // 更新最近使用时间
+    utime(dataPath, NULL);
+
+    ioBuffer = (uint8_t *) av_malloc(HTTP_CACHE_IO_BUFFER_SIZE);
+    if (!ioBuffer) {
+        return AVERROR(ENOMEM);
+    }
+    context = avio_alloc_context(ioBuffer, HTTP_CACHE_IO_BUFFER_SIZE, 0, this, readPacket, NULL, seekPacket);
+    if (!context) {
+        av_free(ioBuffer);
+        return AVERROR(ENOMEM);
+    }
+    context->seekable = AVIO_SEEKABLE_NORMAL;
+
+    // 已经全部缓存，不需要保持网络连接
+    bool complete = true;
+    for (int64_t i = 0; i < blockCount && complete; i++) {
+        complete = isCached(i);
+    }
+    if (complete) {
+        avio_closep(&network);
+    }
+    return 0;
+}
+
+/**
+ * 打开缓存数据文件并加共享锁，持有共享锁的缓存正在使用，其他播放器淘汰缓存时不会删除
+ * 加锁之前文件可能刚好被淘汰删除，这时路径已经指向别的文件或者不存在，需要重新打开
+ * @return
+ */
+int HttpCache::openDataFile() {
+    struct stat fdStat, pathStat;
+    for (;;) {
+        dataFd = ::open(dataPath, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (dataFd < 0) {
+            return AVERROR(errno);
+        }
+        if (flock(dataFd, LOCK_SH) < 0) {
+            int err = errno;
+            ::close(dataFd);
+            dataFd = -1;
+            return AVERROR(err);
+        }
+        if (fstat(dataFd, &fdStat) == 0 && stat(dataPath, &pathStat) == 0
+            && fdStat.st_dev == pathStat.st_dev && fdStat.st_ino == pathStat.st_ino) {
+            return 0;
+        }
+        ::close(dataFd);
+        dataFd = -1;
+    }
+}
+
+/**
+ * 没有可用的分块表时重新创建稀疏文件，需要持有目录锁
+ * 其他播放器可能已经缓存了分块但是还没有保存分块表，只有拿到排它锁，也就是没有其他播放器打开时才能清空，
+ * 否则只在文件大小不对时扩展文件，已经写入的数据保留，分块表在保存时合并
+ * @return
+ */
+int HttpCache::resetDataFile() {
+    int ret = 0;
+    if (flock(dataFd, LOCK_EX | LOCK_NB) == 0) {
+        if (ftruncate64(dataFd, 0) < 0 || ftruncate64(dataFd, fileSize) < 0) {
+            ret = AVERROR(errno);
+        }
+    } else {
+        struct stat st;
+        if (fstat(dataFd, &st) < 0) {
+            ret = AVERROR(errno);
+        } else if (st.st_size < fileSize && ftruncate64(dataFd, fileSize) < 0) {
+            ret = AVERROR(errno);
+        }
+    }
+    // 转换锁不是原子的，加排它锁失败时原来的共享锁也可能已经释放，持有目录锁时重新加锁不会有其他播放器插进来
+    if (flock(dataFd, LOCK_SH) < 0 && ret == 0) {
+        ret = AVERROR(errno);
+    }
+    return ret;
+}
+
+/**
+ * 锁住缓存目录，打开缓存、保存分块表和淘汰缓存在多个播放器之间互斥
+ * @return 目录的文件描述符，加锁失败时返回-1，这时不加锁继续
+ */
+int HttpCache::lockCacheDir() {
+    int fd = ::open(cacheDir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0 && flock(fd, LOCK_EX) < 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+void HttpCache::unlockCacheDir(int fd) {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+AVIOContext *HttpCache::getContext() {
+    return context;
+}
+
+void HttpCache::close() {
+    if (network) {
+        avio_closep(&network);
+    }
+    if (dataFd >= 0) {
+        saveMap();
+        ::close(dataFd);
+        dataFd = -1;
+        evict();
+    }
+    av_freep(&blockMap);
+}
+
+int HttpCache::readPacket(void *opaque, uint8_t *buf, int size) {
+    return ((HttpCache *) opaque)->read(buf, size);
+}
+
+int64_t HttpCache::seekPacket(void *opaque, int64_t offset, int whence) {
+    return ((HttpCache *) opaque)->seek(offset, whence);
+}
+
+int HttpCache::connect() {
+    AVDictionary *options = NULL;
+    av_dict_copy(&options, networkOptions, 0);
+    int ret = avio_open2(&network, url, AVIO_FLAG_READ, &interruptCallback, &options);
+    av_dict_free(&options);
+    if (ret < 0) {
+        return ret;
+    }
+    if (avio_size(network) != fileSize) {
+        av_log(NULL, AV_LOG_WARNING, "http cache: %s changed on server\n", url);
+        avio_closep(&network);
+        return AVERROR(EIO);
+    }
+    networkPos = 0;
+    fillStart = 0;
+    return 0;
+}
+
+bool HttpCache::isCached(int64_t block) {
+    return (blockMap[block >> 3] & (1 << (block & 7))) != 0;
+}
+
+void HttpCache::setCached(int64_t block) {
+    if (isCached(block)) {
+        return;
+    }
+    blockMap[block >> 3] |= 1 << (block & 7);
+    if (++unsavedBlocks >= HTTP_CACHE_SAVE_BLOCKS) {
+        saveMap();
+    }
+}
+
+/**
+ * 读取数据，已缓存的分块从缓存文件读取，其他的从网络读取并写入缓存文件
+ * @param buf
+ * @param size
+ * @return
+ */
+int HttpCache::read(uint8_t *buf, int size) {
+    if (position >= fileSize) {
+        return AVERROR_EOF;
+    }
+    int64_t block = position / HTTP_CACHE_BLOCK_SIZE;
+
+    if (isCached(block)) {
+        // 连续的已缓存分块一次读完
+        int64_t end = block;
+        while (end < blockCount && isCached(end) && end * HTTP_CACHE_BLOCK_SIZE < position + size) {
+            end++;
+        }
+        int len = (int) FFMIN(size, FFMIN(end * HTTP_CACHE_BLOCK_SIZE, fileSize) - position);
+        ssize_t n = pread64(dataFd, buf, (size_t) len, position);
+        if (n > 0) {
+            position += n;
+            return (int) n;
+        }
+        // 缓存文件损坏，改为从网络读取
+        blockMap[block >> 3] &= ~(1 << (block & 7));
+    }
+
+    int ret;
+    if (!network && (ret = connect()) < 0) {
+        return ret;
+    }
+    if (networkPos != position) {
+        int64_t pos = avio_seek(network, position, SEEK_SET);
+        if (pos < 0) {
+            return (int) pos;
+        }
+        networkPos = fillStart = position;
+    }
+    // 只读到分块末尾，下一个分块可能已经缓存
+    int len = (int) FFMIN(size, (block + 1) * HTTP_CACHE_BLOCK_SIZE - position);
+    ret = avio_read(network, buf, len);
+    if (ret <= 0) {
+        return ret == 0 ? AVERROR_EOF : ret;
+    }
+    if (!writeError && pwrite64(dataFd, buf, (size_t) ret, position) != ret) {
+        av_log(NULL, AV_LOG_WARNING, "http cache: write failed, stop caching\n");
+        writeError = true;
+    }
+    position += ret;
+    networkPos += ret;
+    int64_t blockEnd = FFMIN((block + 1) * HTTP_CACHE_BLOCK_SIZE, fileSize);
+    if (!writeError && fillStart <= block * HTTP_CACHE_BLOCK_SIZE && networkPos >= blockEnd) {
+        setCached(block);
+    }
+    return ret;
+}
+
+/**
+ * 定位只移动读位置，网络连接在下一次需要从网络读取时才定位
+ * @param offset
+ * @param whence
+ * @return
+ */
+int64_t HttpCache::seek(int64_t offset, int whence) {
+    int64_t target;
+
+    if (whence & AVSEEK_SIZE) {
+        return fileSize;
+    }
+    switch (whence & ~AVSEEK_FORCE) {
+        case SEEK_SET: {
+            target = offset;
+            break;
+        }
+        case SEEK_CUR: {
+            target = position + offset;
+            break;
+        }
+        case SEEK_END: {
+            target = fileSize + offset;
+            break;
+        }
+        default: {
+            return AVERROR(EINVAL);
+        }
+    }
+    if (target < 0) {
+        return AVERROR(EINVAL);
+    }
+    position = target;
+    return target;
+}
+
+/**
+ * 读取分块表，文件标识或者文件大小不一致时返回-1
+ * @param map
+ * @return
+ */
+int HttpCache::loadMap(uint8_t *map) {
+    FILE *file = fopen(mapPath, "rb");
+    if (!file) {
+        return -1;
+    }
+    char magic[4];
+    uint64_t key, size, blockSize, mapSize;
+    int ret = -1;
+    do {
+        if (fread(magic, 1, sizeof(magic), file) != sizeof(magic)
+            || memcmp(magic, HTTP_CACHE_MAGIC, sizeof(magic))) {
+            break;
+        }
+        if (fgetc(file) != HTTP_CACHE_VERSION) {
+            break;
+        }
+        if (readVarint(file, &key) < 0 || key != fileKey
+            || readVarint(file, &size) < 0 || size != (uint64_t) fileSize
+            || readVarint(file, &blockSize) < 0 || blockSize != HTTP_CACHE_BLOCK_SIZE
+            || readVarint(file, &mapSize) < 0 || mapSize != (uint64_t) ((blockCount + 7) / 8)) {
+            break;
+        }
+        if (fread(map, 1, (size_t) mapSize, file) != mapSize) {
+            break;
+        }
+        ret = 0;
+    } while (false);
+    fclose(file);
+    return ret;
+}
+
+/**
+ * 保存分块表，先合并其他播放器已经保存的记录，读取、合并和写入在目录锁内完成，不会互相覆盖
+ * @return
+ */
+int HttpCache::saveMap() {
+    if (!blockMap || !mapPath) {
+        return -1;
+    }
+    int dirFd = lockCacheDir();
+    int ret = writeMap();
+    unlockCacheDir(dirFd);
+    return ret;
+}
+
+int HttpCache::writeMap() {
+    size_t mapSize = (size_t) ((blockCount + 7) / 8);
+    uint8_t *saved = (uint8_t *) av_malloc(mapSize);
+    if (saved && loadMap(saved) == 0) {
+        for (size_t i = 0; i < mapSize; i++) {
+            blockMap[i] |= saved[i];
+        }
+    }
+    av_free(saved);
+
+    char *tmpPath = av_asprintf("%s.tmp", mapPath);
+    if (!tmpPath) {
+        return AVERROR(ENOMEM);
+    }
+    FILE *file = fopen(tmpPath, "wb");
+    if (!file) {
+        av_free(tmpPath);
+        return -1;
+    }
+    fwrite(HTTP_CACHE_MAGIC, 1, sizeof(HTTP_CACHE_MAGIC), file);
+    fputc(HTTP_CACHE_VERSION, file);
+    writeVarint(file, fileKey);
+    writeVarint(file, (uint64_t) fileSize);
+    writeVarint(file, HTTP_CACHE_BLOCK_SIZE);
+    writeVarint(file, mapSize);
+    fwrite(blockMap, 1, mapSize, file);
+    int ret = commitCacheFile(file, tmpPath, mapPath);
+    av_free(tmpPath);
+    unsavedBlocks = 0;
+    return ret;
+}
+
+/**
+ * 按最近使用时间从旧到新删除缓存，正在使用的缓存不删除
+ * 其他播放器正在使用的缓存持有共享锁，拿不到排它锁时跳过，删除完成以后才释放排它锁
+ * 淘汰期间持有目录锁，其他播放器不会在删除前后打开同一个缓存
+ */
+void HttpCache::evict() {
+    if (maxCacheSize <= 0) {
+        return;
+    }
+    int dirFd = lockCacheDir();
+    DIR *dir = opendir(cacheDir);
+    if (!dir) {
+        unlockCacheDir(dirFd);
+        return;
+    }
+    std::vector<CacheEntry> entries;
+    int64_t total = 0;
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        const char *suffix = strrchr(ent->d_name, '.');
+        if (!suffix || strcmp(suffix, HTTP_CACHE_DATA_SUFFIX)) {
+            continue;
+        }
+        char *path = av_asprintf("%s/%s", cacheDir, ent->d_name);
+        struct stat st;
+        if (!path || stat(path, &st) < 0) {
+            av_free(path);
+            continue;
+        }
+        // 稀疏文件按实际占用的块计算大小
+        CacheEntry entry = {path, (int64_t) st.st_blocks * 512, st.st_mtime};
+        total += entry.size;
+        entries.push_back(entry);
+    }
+    closedir(dir);
+
+    std::sort(entries.begin(), entries.end(), compareLastUsed);
+    for (size_t i = 0; i < entries.size(); i++) {
+        CacheEntry &entry = entries[i];
+        if (total > maxCacheSize && strcmp(entry.dataPath, dataPath)) {
+            int fd = ::open(entry.dataPath, O_RDONLY | O_CLOEXEC);
+            if (fd >= 0 && flock(fd, LOCK_EX | LOCK_NB) == 0) {
+                size_t length = strlen(entry.dataPath) - strlen(HTTP_CACHE_DATA_SUFFIX);
+                char *entryMapPath = av_asprintf("%.*s%s", (int) length, entry.dataPath, HTTP_CACHE_MAP_SUFFIX);
+                remove(entry.dataPath);
+                if (entryMapPath) {
+                    remove(entryMapPath);
+                    av_free(entryMapPath);
+                }
+                total -= entry.size;
+            }
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+        av_free(entry.dataPath);
+    }
+    unlockCacheDir(dirFd);
+}
@@ -0,0 +1,414 @@
+
+#include <inttypes.h>
+#include <AndroidLog.h>
+#include "KeyframeIndex.h"
+#include "CacheFile.h"
+
+extern "C" {
+#include "libavutil/avstring.h"
+#include "libavutil/time.h"
+};
+
+// 索引文件中允许的最大关键帧数量，防止读取损坏的文件时分配过多内存
+#define KEYFRAME_INDEX_MAX_COUNT (1 << 22)
+
+static const char KEYFRAME_INDEX_MAGIC[4] = {'E', 'K', 'F', 'I'};
+
+KeyframeIndex::KeyframeIndex() {
+    entries = NULL;
+    entriesSize = 0;
+    count = 0;
+    complete = false;
+    dirty = false;
+    url = NULL;
+    iformat = NULL;
+    streamId = 0;
+    streamIndex = -1;
+    timeBase = (AVRational) {1, AV_TIME_BASE};
+    playbackRun.pts = AV_NOPTS_VALUE;
+    playbackRun.packets = 0;
+    indexPath = NULL;
+    fileKey = 0;
+    scanThread = NULL;
+    abortScan = false;
+}
+
+KeyframeIndex::~KeyframeIndex() {
+    stopScan();
+    av_freep(&entries);
+    av_freep(&url);
+    av_freep(&indexPath);
+}
+
+/**
+ * 绑定媒体流，文件标识由路径、文件大小和修改时间组成，网络文件使用路径、大小和时长
+ * @param pFormatCtx
+ * @param streamIndex 视频流索引
+ * @param url
+ * @param indexDir 索引文件目录，为NULL时只在内存中建立索引
+ * @return
+ */
+int KeyframeIndex::open(AVFormatContext *pFormatCtx, int streamIndex, const char *url, const char *indexDir) {
+    AVInputFormat *fmt = pFormatCtx->iformat;
+    // 只有按字节定位可靠的封装格式才能使用字节偏移定位
+    if (!(fmt->flags & AVFMT_TS_DISCONT) || (fmt->flags & AVFMT_NO_BYTE_SEEK) || !strcmp("ogg", fmt->name)) {
+        return -1;
+    }
+    if (!pFormatCtx->pb || !(pFormatCtx->pb->seekable & AVIO_SEEKABLE_NORMAL)) {
+        return -1;
+    }
+    if (streamIndex < 0 || streamIndex >= pFormatCtx->nb_streams) {
+        return -1;
+    }
+
+    Mutex::Autolock lock(mMutex);
+    AVStream *stream = pFormatCtx->streams[streamIndex];
+    this->streamIndex = streamIndex;
+    this->streamId = stream->id;
+    this->timeBase = stream->time_base;
+    this->iformat = fmt;
+    this->url = av_strdup(url);
+
+    // 计算文件标识
+    fileKey = computeFileKey(url, avio_size(pFormatCtx->pb), pFormatCtx->duration);
+
+    if (indexDir) {
+        indexPath = av_asprintf("%s/%016" PRIx64 "%s", indexDir, fileKey, KEYFRAME_INDEX_SUFFIX);
+        if (load() == 0) {
+            LOGD("加载关键帧索引%s，共%d个关键帧%s", indexPath, count, complete ? "(完整)" : "");
+        }
+    }
+    return 0;
+}
+
+/**
+ * 播放时记录关键帧，只在读数据包线程中调用
+ * @param pkt
+ */
+void KeyframeIndex::addPacket(AVPacket *pkt) {
+    if (pkt->stream_index != streamIndex) {
+        return;
+    }
+    addKeyframe(&playbackRun, pkt, timeBase);
+}
+
+void KeyframeIndex::discontinue() {
+    Mutex::Autolock lock(mMutex);
+    playbackRun.pts = AV_NOPTS_VALUE;
+    playbackRun.packets = 0;
+}
+
+/**
+ * 记录关键帧，连续读到两个关键帧时更新前一个关键帧的GOP长度
+ * @param keyframeRun
+ * @param pkt
+ * @param timeBase
+ */
+void KeyframeIndex::addKeyframe(KeyframeRun *keyframeRun, AVPacket *pkt, AVRational timeBase) {
+    Mutex::Autolock lock(mMutex);
+    if (keyframeRun->pts != AV_NOPTS_VALUE) {
+        keyframeRun->packets++;
+    }
+    if (!(pkt->flags & AV_PKT_FLAG_KEY) || pkt->pos < 0) {
+        return;
+    }
+    int64_t timestamp = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+    if (timestamp == AV_NOPTS_VALUE) {
+        keyframeRun->pts = AV_NOPTS_VALUE;
+        return;
+    }
+    int64_t pts = av_rescale_q(timestamp, timeBase, AV_TIME_BASE_Q);
+    int index = insertEntry(pts, pkt->pos);
+    if (index < 0) {
+        return;
+    }
+    // 前一个关键帧必须紧挨着当前关键帧，否则说明索引中有来自其他位置的关键帧
+    if (keyframeRun->pts != AV_NOPTS_VALUE && index > 0 && entries[index - 1].pts == keyframeRun->pts
+        && entries[index - 1].gopLength != keyframeRun->packets) {
+        entries[index - 1].gopLength = keyframeRun->packets;
+        dirty = true;
+    }
+    keyframeRun->pts = pts;
+    keyframeRun->packets = 0;
+}
+
+/**
+ * 二分查找时间戳不大于pts的最后一个关键帧
+ * @param pts
+ * @return 没有找到时返回-1
+ */
+int KeyframeIndex::findEntry(int64_t pts) {
+    int low = 0;
+    int high = count - 1;
+    int result = -1;
+    while (low <= high) {
+        int mid = (low + high) >> 1;
+        if (entries[mid].pts <= pts) {
+            result = mid;
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return result;
+}
+
+int KeyframeIndex::insertEntry(int64_t pts, int64_t pos) {
+    int index = findEntry(pts);
+    if (index >= 0 && entries[index].pts == pts) {
+        return index;
+    }
+    index++;
+    KeyframeEntry *newEntries = (KeyframeEntry *) av_fast_realloc(entries, &entriesSize,
+                                                                   (count + 1) * sizeof(KeyframeEntry));
+    if (!newEntries) {
+        return -1;
+    }
+    entries = newEntries;
+    if (index < count) {
+        memmove(&entries[index + 1], &entries[index], (count - index) * sizeof(KeyframeEntry));
+    }
+    entries[index].pts = pts;
+    entries[index].pos = pos;
+    entries[index].gopLength = 0;
+    count++;
+    dirty = true;
+    return index;
+}
+
+/**
+ * 查找目标位置之前最近的关键帧
+ * 边播放边建立的索引可能有空缺，只有连续读到下一个关键帧并且下一个关键帧在目标之后时才可用
+ * @param target 单位AV_TIME_BASE
+ * @param entry
+ * @return
+ */
+bool KeyframeIndex::lookup(int64_t target, KeyframeEntry *entry) {
+    Mutex::Autolock lock(mMutex);
+    int index = findEntry(target);
+    if (index < 0) {
+        return false;
+    }
+    bool found;
+    if (index + 1 < count) {
+        found = entries[index].gopLength > 0 && entries[index + 1].pts > target;
+    } else {
+        found = complete;
+    }
+    if (found) {
+        *entry = entries[index];
+    }
+    return found;
+}
+
+void KeyframeIndex::startScan() {
+    Mutex::Autolock lock(mMutex);
+    if (scanThread || complete || !url) {
+        return;
+    }
+    abortScan = false;
+    scanThread = new Thread(this, Priority_Low);
+    scanThread->start();
+}
+
+void KeyframeIndex::stopScan() {
+    abortScan = true;
+    if (scanThread) {
+        scanThread->join();
+        delete scanThread;
+        scanThread = NULL;
+    }
+}
+
+int KeyframeIndex::interruptCallback(void *opaque) {
+    return ((KeyframeIndex *) opaque)->abortScan ? 1 : 0;
+}
+
+/**
+ * 后台扫描线程，使用独立的解复用上下文读取整个文件，只保留视频流
+ */
+void KeyframeIndex::run() {
+    AVFormatContext *ic = avformat_alloc_context();
+    AVPacket pkt;
+    int index = -1;
+    int ret;
+    KeyframeRun scanRun = {AV_NOPTS_VALUE, 0};
+
+    if (!ic) {
+        return;
+    }
+    ic->interrupt_callback.callback = interruptCallback;
+    ic->interrupt_callback.opaque = this;
+    if ((ret = avformat_open_input(&ic, url, iformat, NULL)) < 0) {
+        av_log(NULL, AV_LOG_WARNING, "keyframe scan: could not open %s\n", url);
+        return;
+    }
+    if ((ret = avformat_find_stream_info(ic, NULL)) < 0) {
+        avformat_close_input(&ic);
+        return;
+    }
+    // 按照流的id找到同一路视频流
+    for (int i = 0; i < ic->nb_streams; i++) {
+        if (ic->streams[i]->id == streamId && ic->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+            index = i;
+        } else {
+            ic->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+    if (index < 0) {
+        avformat_close_input(&ic);
+        return;
+    }
+
+    int64_t startTime = av_gettime_relative();
+    AVRational scanTimeBase = ic->streams[index]->time_base;
+    while (!abortScan) {
+        if ((ret = av_read_frame(ic, &pkt)) < 0) {
+            break;
+        }
+        if (pkt.stream_index == index) {
+            addKeyframe(&scanRun, &pkt, scanTimeBase);
+        }
+        av_packet_unref(&pkt);
+    }
+
+    if (ret == AVERROR_EOF && !abortScan) {
+        mMutex.lock();
+        // 最后一个关键帧的GOP一直到文件结尾
+        int last = scanRun.pts != AV_NOPTS_VALUE ? findEntry(scanRun.pts) : -1;
+        if (last >= 0 && entries[last].pts == scanRun.pts) {
+            entries[last].gopLength = FFMAX(scanRun.packets + 1, 1);
+        }
+        complete = true;
+        dirty = true;
+        mMutex.unlock();
+        // 不使用LOGD，关闭日志时startTime会成为未使用的变量
+        av_log(NULL, AV_LOG_INFO, "keyframe index: scanned %d keyframes in %lldms\n", getKeyframeCount(),
+               (long long) ((av_gettime_relative() - startTime) / 1000));
+        save();
+    }
+    avformat_close_input(&ic);
+}
+
+/**
+ * 加载索引文件，文件标识不一致时丢弃
+ * @return
+ */
+int KeyframeIndex::load() {
+    FILE *file = fopen(indexPath, "rb");
+    if (!file) {
+        return -1;
+    }
+    char magic[4];
+    int version, flags;
+    uint64_t key = 0, number;
+    int ret = -1;
+    do {
+        if (fread(magic, 1, sizeof(magic), file) != sizeof(magic)
+            || memcmp(magic, KEYFRAME_INDEX_MAGIC, sizeof(magic))) {
+            break;
+        }
+        version = fgetc(file);
+        flags = fgetc(file);
+        if (version != KEYFRAME_INDEX_VERSION || flags == EOF) {
+            break;
+        }
+        if (readVarint(file, &key) < 0 || key != fileKey) {
+            break;
+        }
+        if (readVarint(file, &number) < 0 || number > KEYFRAME_INDEX_MAX_COUNT) {
+            break;
+        }
+        KeyframeEntry *newEntries = (KeyframeEntry *) av_fast_realloc(entries, &entriesSize,
+                                                                       number * sizeof(KeyframeEntry));
+        if (!newEntries && number > 0) {
+            break;
+        }
+        entries = newEntries;
+        int64_t pts = 0, pos = 0, delta;
+        uint64_t gop;
+        int i;
+        for (i = 0; i < (int) number; i++) {
+            if (readSignedVarint(file, &delta) < 0) {
+                break;
+            }
+            pts += delta;
+            if (readSignedVarint(file, &delta) < 0) {
+                break;
+            }
+            pos += delta;
+            if (readVarint(file, &gop) < 0) {
+                break;
+            }
+            // 时间戳必须是递增的
+            if (i > 0 && pts <= entries[i - 1].pts) {
+                break;
+            }
+            entries[i].pts = pts;
+            entries[i].pos = pos;
+            entries[i].gopLength = (int) gop;
+        }
+        if (i != (int) number) {
+            break;
+        }
+        count = (int) number;
+        complete = (flags & 1) != 0;
+        dirty = false;
+        ret = 0;
+    } while (false);
+    fclose(file);
+    if (ret < 0) {
+        count = 0;
+        complete = false;
+    }
+    return ret;
+}
+
+/**
+ * 保存索引文件，先写入临时文件再重命名，防止写到一半时留下损坏的文件
+ * @return
+ */
+int KeyframeIndex::save() {
+    Mutex::Autolock lock(mMutex);
+    if (!indexPath || !dirty || count == 0) {
+        return 0;
+    }
+    char *tmpPath = av_asprintf("%s.tmp", indexPath);
+    if (!tmpPath) {
+        return AVERROR(ENOMEM);
+    }
+    FILE *file = fopen(tmpPath, "wb");
+    if (!file) {
+        av_free(tmpPath);
+        return -1;
+    }
+    fwrite(KEYFRAME_INDEX_MAGIC, 1, sizeof(KEYFRAME_INDEX_MAGIC), file);
+    fputc(KEYFRAME_INDEX_VERSION, file);
+    fputc(complete ? 1 : 0, file);
+    writeVarint(file, fileKey);
+    writeVarint(file, (uint64_t) count);
+    int64_t pts = 0, pos = 0;
+    for (int i = 0; i < count; i++) {
+        writeSignedVarint(file, entries[i].pts - pts);
+        writeSignedVarint(file, entries[i].pos - pos);
+        writeVarint(file, (uint64_t) FFMAX(entries[i].gopLength, 0));
+        pts = entries[i].pts;
+        pos = entries[i].pos;
+    }
+    int ret = commitCacheFile(file, tmpPath, indexPath);
+    if (ret == 0) {
+        dirty = false;
+    }
+    av_free(tmpPath);
+    return ret;
+}
+
+int KeyframeIndex::getKeyframeCount() {
+    Mutex::Autolock lock(mMutex);
+    return count;
+}
+
+bool KeyframeIndex::isComplete() {
+    Mutex::Autolock lock(mMutex);
+    return complete;
+}
@@ -0,0 +1,98 @@
+
+#include "LiveLatencyController.h"
+#include <math.h>
+#include <AndroidLog.h>
+
+LiveLatencyController::LiveLatencyController(PlayerState *playerState) {
+    this->playerState = playerState;
+    videoIndex = -1;
+    masterIndex = -1;
+    timeBase = (AVRational) {0, 1};
+    skipToKeyframe = false;
+    resumePosition = NAN;
+    latency = NAN;
+}
+
+LiveLatencyController::~LiveLatencyController() {
+
+}
+
+/**
+ * 绑定媒体流
+ * @param videoIndex 视频解码器使用的媒体流
+ * @param audioIndex 音频解码器使用的媒体流
+ * @param timeBase 计算延时使用的媒体流的时间基准，有音频时是音频流的，没有音频时是视频流的
+ */
+void LiveLatencyController::open(int videoIndex, int audioIndex, AVRational timeBase) {
+    this->videoIndex = videoIndex;
+    this->masterIndex = audioIndex >= 0 ? audioIndex : videoIndex;
+    this->timeBase = timeBase;
+    skipToKeyframe = false;
+    resumePosition = NAN;
+    latency = NAN;
+}
+
+/**
+ * 检查读到的数据包
+ * @param pkt
+ * @param clock 主时钟，单位秒
+ * @return LIVE_*的组合
+ */
+int LiveLatencyController::check(const AVPacket *pkt, double clock) {
+    int result = LIVE_KEEP_PACKET;
+    bool isVideo = videoIndex >= 0 && pkt->stream_index == videoIndex;
+    if (skipToKeyframe) {
+        if (!isVideo || !(pkt->flags & AV_PKT_FLAG_KEY)) {
+            return LIVE_DROP_PACKET;
+        }
+        skipToKeyframe = false;
+        result |= LIVE_RESUME_VIDEO;
+    }
+
+    int64_t timestamp = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+    if (masterIndex < 0 || pkt->stream_index != masterIndex || timestamp == AV_NOPTS_VALUE) {
+        return result;
+    }
+    double position = timestamp * av_q2d(timeBase);
+    // 丢弃以后主时钟还停在旧的位置，积压的数据包还在送来，这时计算的延时会一直超过上限
+    // 要等主时钟播放到保留下来的数据包以后再计算
+    if (!isnan(resumePosition)) {
+        if (isinf(resumePosition)) {
+            resumePosition = position;
+        }
+        if (isnan(clock) || clock < resumePosition) {
+            return result;
+        }
+        resumePosition = NAN;
+    }
+    if (isnan(clock) || playerState->pauseRequest || playerState->buffering) {
+        return result;
+    }
+    latency = position - clock;
+
+    if (latency > playerState->liveMaxLatency) {
+        LOGD("直播延时%.2fs超过上限，丢弃缓冲的数据包", latency);
+        result |= LIVE_DROP_QUEUE;
+        // 当前数据包不是关键帧时要等到下一个关键帧，否则解码出来的是花屏
+        if (videoIndex >= 0 && !(isVideo && (pkt->flags & AV_PKT_FLAG_KEY))) {
+            skipToKeyframe = true;
+            result |= LIVE_DROP_PACKET;
+        }
+        resumePosition = (result & LIVE_DROP_PACKET) ? INFINITY : position;
+        return result;
+    }
+
+    if (latency > playerState->liveTargetLatency + LIVE_LATENCY_TOLERANCE) {
+        if (playerState->liveCatchUpRate != LIVE_CATCH_UP_RATE) {
+            LOGD("直播延时%.2fs，开始追赶", latency);
+            playerState->liveCatchUpRate = LIVE_CATCH_UP_RATE;
+        }
+    } else if (latency <= playerState->liveTargetLatency) {
+        playerState->liveCatchUpRate = 1.0f;
+    }
+    return result;
+}
+
+double LiveLatencyController::getLatency() {
+    return latency;
+}
@@ -43,6 +43,41 @@ static int lockmgrCallback(void **mtx, enum AVLockOp op) {
     return 1;
 }
 
+/**
+ * 各封装格式的探测参数，文件头中带有完整编解码参数的格式只需要很少的数据，没有全局头的格式需要多读一些
+ */
+typedef struct ProbeDefaults {
+    const char *format;             // 封装格式名称
+    int64_t probeSize;              // 探测数据量，单位byte
+    int64_t analyzeDuration;        // 探测时长，单位微秒
+} ProbeDefaults;
+
+static const ProbeDefaults PROBE_DEFAULTS[] = {
+        {"mov",      1024 * 1024,     500 * 1000},
+        {"matroska", 1024 * 1024,     500 * 1000},
+        {"avi",      1024 * 1024,     1000 * 1000},
+        {"flv",      512 * 1024,      1000 * 1000},
+        {"mp3",      64 * 1024,       500 * 1000},
+        {"aac",      64 * 1024,       500 * 1000},
+        {"wav",      64 * 1024,       500 * 1000},
+        {"mpegts",   2 * 1024 * 1024, 2000 * 1000},
+        {"mpeg",     2 * 1024 * 1024, 2000 * 1000},
+};
+
+/**
+ * 打开文件以后才知道封装格式，在avformat_find_stream_info之前设置探测参数
+ * @param pFormatCtx
+ */
+static void setupProbeDefaults(AVFormatContext *pFormatCtx) {
+    for (int i = 0; i < FF_ARRAY_ELEMS(PROBE_DEFAULTS); i++) {
+        if (av_match_name(PROBE_DEFAULTS[i].format, pFormatCtx->iformat->name)) {
+            pFormatCtx->probesize = PROBE_DEFAULTS[i].probeSize;
+            pFormatCtx->max_analyze_duration = PROBE_DEFAULTS[i].analyzeDuration;
+            return;
+        }
+    }
+}
+
 MediaPlayer::MediaPlayer() {
     av_register_all();
     avformat_network_init();
@@ -51,9 +86,19 @@ MediaPlayer::MediaPlayer() {
     mDuration = -1;
     audioDecoder = NULL;
     videoDecoder = NULL;
+    subtitleDecoder = NULL;
     pFormatCtx = NULL;
     lastPaused = -1;
     attachmentRequest = 0;
+    trackRequest = 0;
+    trackRequestType = AVMEDIA_TYPE_UNKNOWN;
+    trackRequestIndex = -1;
+    reverseSeekRequest = 0;
+    reverseSeekPosition = 0;
+    reverseSeekMs = 0;
+    nbTrackStreams = 0;
+    streamLastDts = NULL;
+    streamResumeDts = NULL;
 
 #if defined(__ANDROID__)
     audioDevice = new SLESDevice();
@@ -64,7 +109,18 @@ MediaPlayer::MediaPlayer() {
 #endif
 
     mediaSync = new MediaSync(playerState);
+    reverseDecoder = NULL;
     audioResampler = NULL;
+    keyframeIndex = NULL;
+    readAheadIO = NULL;
+    mmapIO = NULL;
+    httpCache = NULL;
+    abrController = NULL;
+    liveLatencyController = NULL;
+    decoderPoolAttached = false;
+    preloadReserved = 0;
+    preloadPacketBytes = 0;
+    preloadNotified = false;
     readThread = NULL;
     mExit = true;
 
@@ -84,6 +140,7 @@ MediaPlayer::~MediaPlayer() {
 status_t MediaPlayer::reset() {
     // 先停止
     stop();
+    releaseReverseDecoder();
     if (mediaSync) {
         mediaSync->reset();
         delete mediaSync;
@@ -91,6 +148,10 @@ status_t MediaPlayer::reset() {
     }
     if (audioDecoder != NULL) {
         audioDecoder->stop();
+        // 音频解码线程还在使用解码器，需要先退出
+        if (audioResampler) {
+            audioResampler->stop();
+        }
         delete audioDecoder;
         audioDecoder = NULL;
     }
@@ -99,6 +160,17 @@ status_t MediaPlayer::reset() {
         delete videoDecoder;
         videoDecoder = NULL;
     }
+    if (subtitleDecoder != NULL) {
+        subtitleDecoder->stop();
+        delete subtitleDecoder;
+        subtitleDecoder = NULL;
+    }
+    if (decoderPoolAttached) {
+        DecoderScheduler::getInstance()->detach();
+        decoderPoolAttached = false;
+    }
+    // 预加载以后没有开始播放就释放了
+    finishPreload();
     if (audioDevice != NULL) {
         audioDevice->stop();
         delete audioDevice;
@@ -108,11 +180,42 @@ status_t MediaPlayer::reset() {
         delete audioResampler;
         audioResampler = NULL;
     }
+    if (keyframeIndex) {
+        delete keyframeIndex;
+        keyframeIndex = NULL;
+    }
+    if (abrController) {
+        delete abrController;
+        abrController = NULL;
+    }
+    if (liveLatencyController) {
+        delete liveLatencyController;
+        liveLatencyController = NULL;
+    }
+    av_freep(&streamLastDts);
+    av_freep(&streamResumeDts);
+    nbTrackStreams = 0;
+    trackRequest = 0;
+    reverseSeekRequest = 0;
     if (pFormatCtx != NULL) {
         avformat_close_input(&pFormatCtx);
         avformat_free_context(pFormatCtx);
         pFormatCtx = NULL;
     }
+    // 自定义的AVIOContext不会被avformat_close_input释放，需要在关闭解复用器以后释放
+    if (readAheadIO) {
+        delete readAheadIO;
+        readAheadIO = NULL;
+    }
+    // 预读I/O在磁盘缓存之上读取，需要先停止预读
+    if (httpCache) {
+        delete httpCache;
+        httpCache = NULL;
+    }
+    if (mmapIO) {
+        delete mmapIO;
+        mmapIO = NULL;
+    }
     if (playerState) {
         delete playerState;
         playerState = NULL;
@@ -167,23 +270,31 @@ status_t MediaPlayer::prepareAsync() {
 }
 
 void MediaPlayer::start() {
+    resyncAfterStep();
     Mutex::Autolock lock(mMutex);
     playerState->abortRequest = 0;
     playerState->pauseRequest = 0;
     mExit = false;
     mCondition.signal(); //通知
+    playerState->signalGate();
+    wakeUpReadThread();
 }
 
 void MediaPlayer::pause() {
     Mutex::Autolock lock(mMutex);
     playerState->pauseRequest = 1;
     mCondition.signal();
+    playerState->signalGate();
+    wakeUpReadThread();
 }
 
 void MediaPlayer::resume() {
+    resyncAfterStep();
     Mutex::Autolock lock(mMutex);
     playerState->pauseRequest = 0;
     mCondition.signal();
+    playerState->signalGate();
+    wakeUpReadThread();
 }
 
 void MediaPlayer::stop() {
@@ -191,6 +302,8 @@ void MediaPlayer::stop() {
     playerState->abortRequest = 1;
     mCondition.signal();
     mMutex.unlock();
+    playerState->signalGate();
+    wakeUpReadThread();
 
     mMutex.lock();
     while (!mExit) {
@@ -217,29 +330,208 @@ void MediaPlayer::seekTo(float timeMs) {
         return;
     }
 
-    // 等待上一次操作完成
+    int64_t start_time = 0;
+    int64_t seek_pos = av_rescale(timeMs, AV_TIME_BASE, 1000);
+    start_time = pFormatCtx ? pFormatCtx->start_time : 0;
+    if (start_time > 0 && start_time != AV_NOPTS_VALUE) {
+        seek_pos += start_time;
+    }
+    // 倒放时由读数据包线程从新的位置重新开始倒放，新位置的第一帧显示以后通知定位完成
+    // 还没有处理的倒放定位请求直接被覆盖
+    if (playerState->reversePlayback) {
+        mMutex.lock();
+        reverseSeekPosition = seek_pos / (double) AV_TIME_BASE;
+        reverseSeekMs = (int) timeMs;
+        reverseSeekRequest = 1;
+        mCondition.signal();
+        mMutex.unlock();
+        wakeUpReadThread();
+        return;
+    }
+    requestSeek(seek_pos, false);
+}
+
+/**
+ * 发出定位请求，由读数据包线程处理
+ * @param seekPos 定位位置，单位AV_TIME_BASE，已经包含文件的起始时间
+ * @param accurate 是否强制精确定位
+ */
+void MediaPlayer::requestSeek(int64_t seekPos, bool accurate) {
+    // 不等待上一次定位完成，新的定位位置直接覆盖还没有处理完的定位请求，拖动进度条时只有最后一次定位会显示出来
     mMutex.lock();
-    while (playerState->seekRequest) {
-        mCondition.wait(mMutex);
+    playerState->seekPos = seekPos;
+    playerState->seekRel = 0;
+    playerState->seekFlags &= ~AVSEEK_FLAG_BYTE;
+    playerState->seekAccurate = accurate ? 1 : 0;
+    playerState->seekStartTime = av_gettime_relative();
+    playerState->seekSerial++;
+    // 有定位请求
+    playerState->seekRequest = 1;
+    mCondition.signal();
+    mMutex.unlock();
+    wakeUpReadThread();
+}
+
+/**
+ * 逐帧步进需要暂停并且已经显示过视频帧，实时流不支持
+ * @return
+ */
+status_t MediaPlayer::stepForward() {
+    double pts, duration;
+    mMutex.lock();
+    if (!videoDecoder || !playerState->pauseRequest || playerState->realTime || playerState->reversePlayback
+        || !mediaSync->getShownFrame(&pts, &duration)) {
+        mMutex.unlock();
+        return INVALID_OPERATION;
     }
+    playerState->stepRequest++;
     mMutex.unlock();
+    playerState->signalGate();
+    return NO_ERROR;
+}
 
-    if (!playerState->seekRequest) {
-        int64_t start_time = 0;
-        int64_t seek_pos = av_rescale(timeMs, AV_TIME_BASE, 1000);
-        start_time = pFormatCtx ? pFormatCtx->start_time : 0;
-        if (start_time > 0 && start_time != AV_NOPTS_VALUE) {
-            seek_pos += start_time;
-        }
-        // 设置定位位置
-        playerState->seekPos = seek_pos;
-        playerState->seekRel = 0;
-        playerState->seekFlags &= ~AVSEEK_FLAG_BYTE;
-        // 有定位请求
-        playerState->seekRequest = 1;
-        mCondition.signal();
+/**
+ * 最近显示过的帧中有前一帧时直接显示，否则精确定位到前一帧，定位完成以后前进一帧显示出来
+ * @return
+ */
+status_t MediaPlayer::stepBackward() {
+    double pts, duration;
+    mMutex.lock();
+    if (!videoDecoder || !playerState->pauseRequest || playerState->realTime || playerState->reversePlayback
+        || !mediaSync->getShownFrame(&pts, &duration)) {
+        mMutex.unlock();
+        return INVALID_OPERATION;
     }
+    if (mediaSync->hasPreviousFrame(playerState->stepRequest)) {
+        playerState->stepRequest--;
+        mMutex.unlock();
+        playerState->signalGate();
+        return NO_ERROR;
+    }
+    mMutex.unlock();
+    // 定位到前一帧的中间，前一帧之前的帧都会被丢弃
+    double target = pts - (duration > 0 ? duration : 1.0 / 30) / 2;
+    if (target < 0) {
+        return INVALID_OPERATION;
+    }
+    requestSeek((int64_t) (target * AV_TIME_BASE), true);
+    playerState->stepRequest = 1;
+    playerState->signalGate();
+    return NO_ERROR;
+}
+
+/**
+ * 逐帧步进以后音频还停在暂停时的位置，继续播放之前精确定位到正在显示的帧
+ */
+void MediaPlayer::resyncAfterStep() {
+    playerState->stepRequest = 0;
+    double steppedPts = mediaSync ? mediaSync->takeSteppedPts() : NAN;
+    if (isnan(steppedPts)) {
+        return;
+    }
+    double pts, duration;
+    if (!mediaSync->getShownFrame(&pts, &duration) || pts != steppedPts) {
+        duration = 0;
+    }
+    // 定位到帧的中间，显示的这一帧之前的帧都会被丢弃
+    requestSeek((int64_t) ((steppedPts + duration / 2) * AV_TIME_BASE), true);
+}
 
+/**
+ * 开始倒放时从正在显示的帧往前解码，读数据包线程停止读取，音频静音
+ * 结束倒放时精确定位到倒放停下的帧，从那里继续正放
+ * @param reverse
+ * @return
+ */
+status_t MediaPlayer::setReverse(bool reverse) {
+    double pts, duration;
+    if (!reverse) {
+        if (!playerState->reversePlayback) {
+            return NO_ERROR;
+        }
+        if (!mediaSync->getShownFrame(&pts, &duration)) {
+            pts = mediaSync->getMasterClock();
+            duration = 0;
+        }
+        releaseReverseDecoder();
+        // 先发出定位请求再清除倒放标志，同步器不会再显示帧队列中倒放之前的帧
+        if (!isnan(pts)) {
+            requestSeek((int64_t) ((pts + duration / 2) * AV_TIME_BASE), true);
+        }
+        mMutex.lock();
+        playerState->reversePlayback = 0;
+        reverseSeekRequest = 0;
+        mMutex.unlock();
+        // 读数据包线程可能在清除倒放标志之前已经重新开始了倒放
+        releaseReverseDecoder();
+        wakeUpReadThread();
+        return NO_ERROR;
+    }
+
+    if (playerState->reversePlayback) {
+        return NO_ERROR;
+    }
+    // 倒放需要能够定位，封面和实时流不支持，还没有处理完的定位请求也不能确定起点
+    if (!videoDecoder || playerState->realTime || mDuration < 0 || playerState->seekRequest
+        || (videoDecoder->getStream()->disposition & AV_DISPOSITION_ATTACHED_PIC)
+        || !mediaSync->getShownFrame(&pts, &duration)) {
+        return INVALID_OPERATION;
+    }
+    // 逐帧步进的状态作废，从正在显示的帧开始倒放
+    playerState->stepRequest = 0;
+    mediaSync->takeSteppedPts();
+    playerState->reversePlayback = 1;
+    startReverse(pts, -1);
+    return NO_ERROR;
+}
+
+int MediaPlayer::isReverse() {
+    return playerState->reversePlayback;
+}
+
+void MediaPlayer::startReverse(double position, int seekPosition) {
+    ReverseDecoder *decoder = new ReverseDecoder(playerState, pFormatCtx, videoDecoder->getStream(),
+                                                 videoDecoder->getCodecContext());
+    decoder->start(position);
+    mMutex.lock();
+    // 读数据包线程重新开始倒放时，倒放可能已经结束
+    if (!playerState->reversePlayback) {
+        mMutex.unlock();
+        decoder->stop();
+        delete decoder;
+        return;
+    }
+    reverseDecoder = decoder;
+    mediaSync->setReverseDecoder(decoder, seekPosition);
+    mMutex.unlock();
+}
+
+void MediaPlayer::releaseReverseDecoder() {
+    mMutex.lock();
+    ReverseDecoder *decoder = reverseDecoder;
+    reverseDecoder = NULL;
+    if (decoder && mediaSync) {
+        mediaSync->setReverseDecoder(NULL, -1);
+    }
+    mMutex.unlock();
+    if (!decoder) {
+        return;
+    }
+    decoder->stop();
+    delete decoder;
+}
+
+/**
+ * 倒放时的定位在读数据包线程中处理，停止旧的倒放解码线程需要等待线程退出，不能阻塞UI线程
+ */
+void MediaPlayer::restartReverse() {
+    mMutex.lock();
+    double position = reverseSeekPosition;
+    int seekMs = reverseSeekMs;
+    reverseSeekRequest = 0;
+    mMutex.unlock();
+    releaseReverseDecoder();
+    startReverse(position, seekMs);
 }
 
 void MediaPlayer::setLooping(int looping) {
@@ -354,6 +646,127 @@ int MediaPlayer::getMetadata(AVDictionary **metadata) {
     return NO_ERROR;
 }
 
+/**
+ * 文本字幕由上层显示，位图字幕叠加在画面上
+ * @param stream
+ * @return
+ */
+static int getStreamTrackType(AVStream *stream) {
+    switch (stream->codecpar->codec_type) {
+        case AVMEDIA_TYPE_VIDEO: {
+            return MEDIA_TRACK_TYPE_VIDEO;
+        }
+        case AVMEDIA_TYPE_AUDIO: {
+            return MEDIA_TRACK_TYPE_AUDIO;
+        }
+        case AVMEDIA_TYPE_SUBTITLE: {
+            const AVCodecDescriptor *desc = avcodec_descriptor_get(stream->codecpar->codec_id);
+            if (desc && (desc->props & AV_CODEC_PROP_TEXT_SUB)) {
+                return MEDIA_TRACK_TYPE_TIMEDTEXT;
+            }
+            return MEDIA_TRACK_TYPE_SUBTITLE;
+        }
+        default: {
+            return MEDIA_TRACK_TYPE_UNKNOWN;
+        }
+    }
+}
+
+int MediaPlayer::getTrackCount() {
+    Mutex::Autolock lock(mMutex);
+    return pFormatCtx ? pFormatCtx->nb_streams : 0;
+}
+
+int MediaPlayer::getTrackType(int index) {
+    Mutex::Autolock lock(mMutex);
+    if (!pFormatCtx || index < 0 || index >= pFormatCtx->nb_streams) {
+        return MEDIA_TRACK_TYPE_UNKNOWN;
+    }
+    return getStreamTrackType(pFormatCtx->streams[index]);
+}
+
+const char *MediaPlayer::getTrackLanguage(int index) {
+    Mutex::Autolock lock(mMutex);
+    if (!pFormatCtx || index < 0 || index >= pFormatCtx->nb_streams) {
+        return "und";
+    }
+    AVDictionaryEntry *entry = av_dict_get(pFormatCtx->streams[index]->metadata, "language", NULL, 0);
+    return entry && entry->value[0] ? entry->value : "und";
+}
+
+/**
+ * 外挂字幕不在轨道列表中，选中外挂字幕时字幕轨道返回-1
+ * @param trackType
+ * @return
+ */
+int MediaPlayer::getSelectedTrack(int trackType) {
+    Mutex::Autolock lock(mMutex);
+    if (!pFormatCtx) {
+        return -1;
+    }
+    MediaDecoder *decoder = NULL;
+    if (trackType == MEDIA_TRACK_TYPE_VIDEO) {
+        decoder = videoDecoder;
+    } else if (trackType == MEDIA_TRACK_TYPE_AUDIO) {
+        decoder = audioDecoder;
+    } else if (subtitleDecoder && !subtitleDecoder->isExternal()) {
+        decoder = subtitleDecoder;
+    }
+    if (!decoder || getStreamTrackType(pFormatCtx->streams[decoder->getStreamIndex()]) != trackType) {
+        return -1;
+    }
+    return decoder->getStreamIndex();
+}
+
+/**
+ * 音频输出设备是按打开时的音频流创建的，没有音频时不能再选择音频
+ * 自适应码率按码流切换音频流，开启时不能手动切换音频
+ * @param index
+ * @param select
+ * @return
+ */
+status_t MediaPlayer::selectTrack(int index, bool select) {
+    mMutex.lock();
+    if (!pFormatCtx || index < 0 || index >= pFormatCtx->nb_streams) {
+        mMutex.unlock();
+        return BAD_VALUE;
+    }
+    // 倒放时读数据包线程停止读取，不能切换轨道
+    if (playerState->reversePlayback) {
+        mMutex.unlock();
+        return INVALID_OPERATION;
+    }
+    enum AVMediaType type = pFormatCtx->streams[index]->codecpar->codec_type;
+    if (type == AVMEDIA_TYPE_AUDIO) {
+        if (!select || !audioDecoder || abrController) {
+            mMutex.unlock();
+            return INVALID_OPERATION;
+        }
+    } else if (type == AVMEDIA_TYPE_SUBTITLE) {
+        if (playerState->subtitleDisable) {
+            mMutex.unlock();
+            return INVALID_OPERATION;
+        }
+        // 取消选择的不是当前字幕时什么都不用做
+        if (!select && (!subtitleDecoder || subtitleDecoder->isExternal()
+                        || subtitleDecoder->getStreamIndex() != index)) {
+            mMutex.unlock();
+            return NO_ERROR;
+        }
+    } else {
+        mMutex.unlock();
+        return INVALID_OPERATION;
+    }
+    // 还没有处理的切换请求直接被覆盖
+    trackRequestType = type;
+    trackRequestIndex = select ? index : -1;
+    trackRequest = 1;
+    mCondition.signal();
+    mMutex.unlock();
+    wakeUpReadThread();
+    return NO_ERROR;
+}
+
 static int avformat_interrupt_cb(void *ctx) {
     PlayerState *playerState = (PlayerState *) ctx;
     if (playerState->abortRequest) {
@@ -378,8 +791,7 @@ void MediaPlayer::run() {
 
 void MediaPlayer::notifyErrorMsg(const char *msg) {
     if (playerState->messageQueue) {
-        playerState->messageQueue->postMessage(MSG_ERROR, 0, 0, (void *) msg,
-                                               sizeof(msg) / msg[0]);
+        playerState->messageQueue->postMessage(MSG_ERROR, 0, 0, (void *) msg, (int) strlen(msg) + 1);
     }
 }
 
@@ -445,9 +857,12 @@ int MediaPlayer::demux() {
     AVDictionaryEntry *t;
     AVDictionary **opts;
     int scan_all_pmts_set = 0;
+    int probe_opts_set = 0;
+    StreamInfoCache streamInfoCache;
 
     // 线程加锁
     mMutex.lock();
+    playerState->openStartTime = av_gettime_relative();
 
     do {
         // 解封装功能结构体
@@ -483,6 +898,17 @@ int MediaPlayer::demux() {
             pFormatCtx->skip_initial_bytes = playerState->offset;
         }
 
+        // 直播低延时模式，减少探测的数据量，解复用器内部不缓冲数据包，没有单独设置时才使用默认值
+        if (playerState->liveMode) {
+            av_dict_set_int(&playerState->format_opts, "probesize", LIVE_PROBE_SIZE, AV_DICT_DONT_OVERWRITE);
+            av_dict_set_int(&playerState->format_opts, "analyzeduration", LIVE_ANALYZE_DURATION,
+                            AV_DICT_DONT_OVERWRITE);
+            pFormatCtx->flags |= AVFMT_FLAG_NOBUFFER;
+        }
+        // 单独设置过探测参数时不使用各封装格式的默认值
+        probe_opts_set = av_dict_get(playerState->format_opts, "probesize", NULL, 0) != NULL
+                         || av_dict_get(playerState->format_opts, "analyzeduration", NULL, 0) != NULL;
+
         // 设置rtmp/rtsp的超时值
         if (av_stristart(playerState->url, "rtmp", NULL) ||
             av_stristart(playerState->url, "rtsp", NULL)) {
@@ -491,6 +917,58 @@ int MediaPlayer::demux() {
             av_dict_set(&playerState->format_opts, "timeout", NULL, 0); //设置为null
         }
 
+        // 本地文件优先使用内存映射，映射失败时回退到预读I/O
+        if (playerState->mmapIO && MmapIO::isSupported(playerState->url)) {
+            mmapIO = new MmapIO();
+            if (mmapIO->open(playerState->url) == 0) {
+                pFormatCtx->pb = mmapIO->getContext();
+            } else {
+                av_log(NULL, AV_LOG_WARNING, "%s: mmap failed, fall back to read\n", playerState->url);
+                delete mmapIO;
+                mmapIO = NULL;
+            }
+        }
+
+        // http点播使用磁盘缓存，服务器不支持按范围请求时回退到普通的读取方式
+        if (playerState->httpCacheDir && !playerState->liveMode && HttpCache::isSupported(playerState->url)) {
+            AVDictionary *options = NULL;
+            av_dict_copy(&options, playerState->format_opts, 0);
+            httpCache = new HttpCache();
+            if (httpCache->open(playerState->url, playerState->httpCacheDir, playerState->httpCacheSize,
+                                &pFormatCtx->interrupt_callback, &options) == 0) {
+                av_dict_free(&playerState->format_opts);
+                playerState->format_opts = options;
+            } else {
+                av_log(NULL, AV_LOG_WARNING, "%s: http cache disabled\n", playerState->url);
+                av_dict_free(&options);
+                delete httpCache;
+                httpCache = NULL;
+            }
+        }
+
+        // 本地文件和http使用预读I/O，有磁盘缓存时在缓存之上预读，直播低延时模式下不预读
+        if (!pFormatCtx->pb && playerState->readAheadSize > 0 && !playerState->liveMode
+            && (httpCache || ReadAheadIO::isSupported(playerState->url))) {
+            readAheadIO = new ReadAheadIO();
+            if (httpCache) {
+                ret = readAheadIO->open(httpCache->getContext(), playerState->readAheadSize,
+                                        &pFormatCtx->interrupt_callback, playerState->messageQueue);
+            } else {
+                ret = readAheadIO->open(playerState->url, playerState->readAheadSize, &pFormatCtx->interrupt_callback,
+                                        &playerState->format_opts, playerState->messageQueue);
+            }
+            if (ret < 0) {
+                LOGE("打开文件失败");
+                printError(playerState->url, ret);
+                ret = -1;
+                break;
+            }
+            pFormatCtx->pb = readAheadIO->getContext();
+        }
+        if (!pFormatCtx->pb && httpCache) {
+            pFormatCtx->pb = httpCache->getContext();
+        }
+
         // 参数说明：
         // AVFormatContext **ps, 格式化的上下文。要注意，如果传入的是一个AVFormatContext*的指针，则该空间须自己手动清理，若传入的指针为空，则FFmpeg会内部自己创建
         // const char *url, 传入的地址。支持http,RTSP,以及普通的本地文件。地址最终会存入到AVFormatContext结构体当中
@@ -506,7 +984,7 @@ int MediaPlayer::demux() {
             ret = -1;
             break;
         }
-        LOGE("打开文件成功");
+        LOGD("打开文件成功，耗时%lldms", (long long) (av_gettime_relative() - playerState->openStartTime) / 1000);
         // 通知文件已打开
         if (playerState->messageQueue) {
             playerState->messageQueue->postMessage(MSG_OPEN_INPUT);
@@ -530,26 +1008,42 @@ int MediaPlayer::demux() {
         }
         // 插入全局的附加信息
         av_format_inject_global_side_data(pFormatCtx);
-        // 设置媒体流信息参数
-        opts = setupStreamInfoOptions(pFormatCtx, playerState->codec_opts);
-
-        /*查找媒体流信息*/
-        ret = avformat_find_stream_info(pFormatCtx, opts);
-        // 释放字典内存
-        if (opts != NULL) {
-            for (int i = 0; i < pFormatCtx->nb_streams; i++) {
-                if (opts[i] != NULL) {
-                    av_dict_free(&opts[i]);
+        if (!probe_opts_set) {
+            setupProbeDefaults(pFormatCtx);
+        }
+
+        // 之前打开过的文件直接使用缓存的媒体流信息，不需要再探测
+        bool streamInfoCached = false;
+        if (!playerState->liveMode
+            && streamInfoCache.open(pFormatCtx, playerState->url, playerState->streamInfoCacheDir) == 0) {
+            streamInfoCached = streamInfoCache.apply(pFormatCtx) == 0;
+        }
+
+        if (!streamInfoCached) {
+            // 设置媒体流信息参数
+            opts = setupStreamInfoOptions(pFormatCtx, playerState->codec_opts);
+
+            /*查找媒体流信息*/
+            ret = avformat_find_stream_info(pFormatCtx, opts);
+            // 释放字典内存
+            if (opts != NULL) {
+                for (int i = 0; i < pFormatCtx->nb_streams; i++) {
+                    if (opts[i] != NULL) {
+                        av_dict_free(&opts[i]);
+                    }
                 }
+                av_freep(&opts);
             }
-            av_freep(&opts);
-        }
 
-        if (ret < 0) {
-            av_log(NULL, AV_LOG_WARNING, "%s: could not find codec parameters\n", playerState->url);
-            ret = -1;
-            break;
+            if (ret < 0) {
+                av_log(NULL, AV_LOG_WARNING, "%s: could not find codec parameters\n", playerState->url);
+                ret = -1;
+                break;
+            }
+            streamInfoCache.save(pFormatCtx);
         }
+        LOGD("%s媒体流信息，耗时%lldms", streamInfoCached ? "使用缓存的" : "探测",
+             (long long) (av_gettime_relative() - playerState->openStartTime) / 1000);
 
         // 查找媒体流信息回调
         if (playerState->messageQueue) {
@@ -557,7 +1051,7 @@ int MediaPlayer::demux() {
         }
 
         // 判断是否实时流，判断是否需要设置无限缓冲区
-        playerState->realTime = isRealTime(pFormatCtx);
+        playerState->realTime = isRealTime(pFormatCtx) || playerState->liveMode;
         // 如果是实时流和偏移量 < 0
         if (playerState->infiniteBuffer < 0 && playerState->realTime) {
             playerState->infiniteBuffer = 1;
@@ -664,10 +1158,10 @@ int MediaPlayer::prepareDecoder() {
 
     /*准备视频和音频的解码器*/
     if (audioIndex >= 0) {
-        prepareDecoder(audioIndex);
+        prepareDecoder(pFormatCtx, audioIndex);
     }
     if (videoIndex >= 0) {
-        prepareDecoder(videoIndex);
+        prepareDecoder(pFormatCtx, videoIndex);
     }
 
     // 创建音视频解码器失败
@@ -676,6 +1170,38 @@ int MediaPlayer::prepareDecoder() {
         ret = -1;
         return ret;
     }
+
+    // 字幕打开失败不影响播放，外挂字幕打开失败时使用文件内的字幕流
+    if (!playerState->subtitleDisable) {
+        if (playerState->subtitleFile) {
+            openSubtitleFile(playerState->subtitleFile);
+        }
+        if (!subtitleDecoder) {
+            int subtitleIndex = av_find_best_stream(pFormatCtx, AVMEDIA_TYPE_SUBTITLE, -1,
+                                                    videoIndex >= 0 ? videoIndex : audioIndex, NULL, 0);
+            if (subtitleIndex >= 0) {
+                prepareDecoder(pFormatCtx, subtitleIndex);
+            }
+        }
+    }
+    // 多码流的HLS开启自适应码率，没有用到的码流不再下载
+    if (playerState->abr) {
+        abrController = new AbrController(playerState);
+        if (abrController->open(pFormatCtx, videoDecoder ? videoDecoder->getStreamIndex() : -1,
+                                audioDecoder ? audioDecoder->getStreamIndex() : -1) < 0) {
+            delete abrController;
+            abrController = NULL;
+        }
+    }
+    // 直播低延时模式，有音频时按音频计算延时
+    if (playerState->liveMode && (audioDecoder || videoDecoder)) {
+        MediaDecoder *decoder = audioDecoder ? (MediaDecoder *) audioDecoder : (MediaDecoder *) videoDecoder;
+        liveLatencyController = new LiveLatencyController(playerState);
+        liveLatencyController->open(videoDecoder ? videoDecoder->getStreamIndex() : -1,
+                                    audioDecoder ? audioDecoder->getStreamIndex() : -1,
+                                    decoder->getStream()->time_base);
+    }
+
     // 准备解码器消息通知
     if (playerState->messageQueue) {
         playerState->messageQueue->postMessage(MSG_PREPARE_DECODER);
@@ -728,6 +1254,10 @@ void MediaPlayer::startDecode() {
             playerState->syncType = AV_SYNC_EXTERNAL;
         }
     }
+
+    if (subtitleDecoder != NULL) {
+        subtitleDecoder->start();
+    }
 }
 
 /**
@@ -736,6 +1266,8 @@ void MediaPlayer::startDecode() {
  */
 int MediaPlayer::openMediaDevice() {
     int ret = 0;
+    // 音频解码线程通知当前位置时需要减去起始时间
+    mediaSync->setStartTime(pFormatCtx->start_time);
     // 打开音频输出设备
     if (audioDecoder != NULL) {
         LOGD("打开音频设备");
@@ -770,6 +1302,7 @@ int MediaPlayer::openMediaDevice() {
     }
 
     /*开始视频的同步播放*/
+    mediaSync->setSubtitleDecoder(subtitleDecoder);
     mediaSync->start(videoDecoder, audioDecoder);
 
     /*等待开始，当mediaplayer调用start或resume方法的时候，pauseRequest就为true*/
@@ -778,10 +1311,12 @@ int MediaPlayer::openMediaDevice() {
         if (playerState->messageQueue) {
             playerState->messageQueue->postMessage(MSG_REQUEST_START);
         }
-        // 循环等待开始
-        while ((!playerState->abortRequest) && playerState->pauseRequest) {
-            av_usleep(10 * 1000);
+        // 预加载时不等待开始，继续读数据包并解码出第一帧，缓冲到预加载的目标以后读数据包线程再休眠
+        if (playerState->preload && startPreload()) {
+            return ret;
         }
+        // 等待开始，start或者stop时会被唤醒
+        playerState->waitForResume(NULL);
     }
 
     if (playerState->messageQueue) {
@@ -797,13 +1332,37 @@ int MediaPlayer::openMediaDevice() {
  */
 int MediaPlayer::readAvPackets() {
     // 读数据包流程
-    eof = 0;
+    playerState->eof = 0;
     int ret = 0;
     AVPacket pkt1, *pkt = &pkt1;
     int64_t stream_start_time;
     int playInRange = 0;
     int64_t pkt_ts;
     int waitToSeek = 0;
+    KeyframeEntry keyframe;
+
+    // 切换轨道回退重读时按媒体流跳过已经读过的数据包
+    av_freep(&streamLastDts);
+    av_freep(&streamResumeDts);
+    nbTrackStreams = pFormatCtx->nb_streams;
+    streamLastDts = (int64_t *) av_malloc_array(nbTrackStreams, sizeof(int64_t));
+    streamResumeDts = (int64_t *) av_malloc_array(nbTrackStreams, sizeof(int64_t));
+    for (int i = 0; streamLastDts && streamResumeDts && i < nbTrackStreams; i++) {
+        streamLastDts[i] = AV_NOPTS_VALUE;
+        streamResumeDts[i] = AV_NOPTS_VALUE;
+    }
+
+    // 建立视频关键帧索引，定位时直接跳到关键帧的字节偏移
+    if (videoDecoder && !keyframeIndex) {
+        keyframeIndex = new KeyframeIndex();
+        if (keyframeIndex->open(pFormatCtx, videoDecoder->getStreamIndex(), playerState->url,
+                                playerState->keyframeIndexDir) < 0) {
+            delete keyframeIndex;
+            keyframeIndex = NULL;
+        } else if (playerState->keyframeIndexScan) {
+            keyframeIndex->startScan();
+        }
+    }
 
     /*循环读取数据包压入队列，以供播放音视频*/
     for (;;) {
@@ -821,43 +1380,97 @@ int MediaPlayer::readAvPackets() {
             } else {
                 av_read_play(pFormatCtx);
             }
+            // 预加载的播放器开始播放，第一帧已经在帧队列中，起播耗时从开始播放算起
+            if (!playerState->pauseRequest && preloadReserved > 0) {
+                finishPreload();
+                playerState->openStartTime = av_gettime_relative();
+                if (playerState->messageQueue) {
+                    playerState->messageQueue->postMessage(MSG_STARTED);
+                }
+            }
         }
 
 #if CONFIG_RTSP_DEMUXER || CONFIG_MMSH_PROTOCOL
         if (playerState->pauseRequest &&
             (!strcmp(pFormatCtx->iformat->name, "rtsp") ||
              (pFormatCtx->pb && !strncmp(url, "mmsh:", 5)))) {
-            av_usleep(10 * 1000);
+            playerState->waitForResume(NULL);
             continue;
         }
 #endif
         /*处理定位请求*/
         if (playerState->seekRequest) {
+            // 取出当前的定位请求，处理过程中可能会有新的请求覆盖它
+            mMutex.lock();
             int64_t seek_target = playerState->seekPos;
+            int64_t seek_rel = playerState->seekRel;
+            int seek_flags = playerState->seekFlags;
+            int seek_serial = playerState->seekSerial;
+            int seek_accurate = playerState->seekAccurate;
+            mMutex.unlock();
+            // 精确定位需要有视频流，先定位到目标之前的关键帧，再解码到目标帧
+            bool accurateSeek = (playerState->accurateSeek || seek_accurate) && videoDecoder
+                                && !(seek_flags & AVSEEK_FLAG_BYTE) && !seek_rel;
             // seekRel默认为0
-            int64_t seek_min =
-                    playerState->seekRel > 0 ? seek_target - playerState->seekRel + 2 : INT64_MIN;
-            int64_t seek_max =
-                    playerState->seekRel < 0 ? seek_target - playerState->seekRel - 2 : INT64_MAX;
+            int64_t seek_min = seek_rel > 0 ? seek_target - seek_rel + 2 : INT64_MIN;
+            int64_t seek_max = seek_rel < 0 ? seek_target - seek_rel - 2
+                                            : (accurateSeek ? seek_target : INT64_MAX);
             // 定位
             playerState->mMutex.lock();
-            // avformat_seek_file定位
-            ret = avformat_seek_file(pFormatCtx, -1, seek_min, seek_target, seek_max,
-                                     playerState->seekFlags);
+            ret = -1;
+            // 关键帧索引中有目标之前最近的关键帧时，直接按字节偏移定位，不需要解复用器再查找
+            if (keyframeIndex && !seek_rel && !(seek_flags & AVSEEK_FLAG_BYTE)
+                && keyframeIndex->lookup(seek_target, &keyframe)) {
+                ret = avformat_seek_file(pFormatCtx, -1, INT64_MIN, keyframe.pos, INT64_MAX, AVSEEK_FLAG_BYTE);
+            }
+            if (ret < 0) {
+                // avformat_seek_file定位
+                ret = avformat_seek_file(pFormatCtx, -1, seek_min, seek_target, seek_max, seek_flags);
+            }
             playerState->mMutex.unlock();
+            // 定位以后读取的关键帧跟之前的不连续
+            if (keyframeIndex) {
+                keyframeIndex->discontinue();
+            }
+            if (abrController) {
+                abrController->flush();
+            }
             if (ret < 0) {
                 av_log(NULL, AV_LOG_ERROR, "%s: error while seeking\n", playerState->url);
             } else {
+                // 定位以后不再跳过切换轨道时读过的数据包
+                for (int i = 0; streamResumeDts && i < nbTrackStreams; i++) {
+                    streamResumeDts[i] = AV_NOPTS_VALUE;
+                }
+                // 逐帧后退缓存的帧属于定位之前的位置
+                mediaSync->clearFrameHistory();
                 // 定位时清空原来的缓冲区
                 if (audioDecoder) {
                     audioDecoder->flush();
                 }
+                if (audioResampler) {
+                    audioResampler->flush();
+                }
                 if (videoDecoder) {
                     videoDecoder->flush();
                 }
+                // 字幕总是丢弃目标之前已经结束的字幕，外挂字幕同时定位字幕文件
+                if (subtitleDecoder) {
+                    subtitleDecoder->flush();
+                    if (!(seek_flags & AVSEEK_FLAG_BYTE)) {
+                        subtitleDecoder->setSeekTarget(seek_target);
+                    }
+                }
+                // 丢弃目标之前的帧，视频解码器解码到目标帧以后通知定位完成
+                if (accurateSeek) {
+                    if (audioDecoder) {
+                        audioDecoder->setSeekTarget(seek_target);
+                    }
+                    videoDecoder->setSeekTarget(seek_target);
+                }
 
                 // 更新外部时钟值
-                if (playerState->seekFlags & AVSEEK_FLAG_BYTE) {
+                if (seek_flags & AVSEEK_FLAG_BYTE) {
                     mediaSync->updateExternalClock(NAN);
                 } else {
                     mediaSync->updateExternalClock(seek_target / (double) AV_TIME_BASE);
@@ -867,16 +1480,48 @@ int MediaPlayer::readAvPackets() {
             }
 
             attachmentRequest = 1;
-            playerState->seekRequest = 0;
+            playerState->eof = 0;
+            // 定位过程中有新的定位请求，保留定位请求标志，下一次循环直接定位到新的位置，旧的位置不再解码和通知
+            mMutex.lock();
+            bool superseded = (seek_serial != playerState->seekSerial);
+            if (!superseded) {
+                playerState->seekRequest = 0;
+            }
             mCondition.signal();
-            eof = 0;
-            // 定位完成回调通知
-            if (playerState->messageQueue) {
+            mMutex.unlock();
+            // 定位完成，唤醒等待定位的解码线程
+            if (!superseded) {
+                playerState->signalGate();
+            }
+            if (superseded) {
+                continue;
+            }
+            // 定位完成回调通知，精确定位成功时由视频解码器通知
+            if (playerState->messageQueue && (ret < 0 || !accurateSeek)) {
                 playerState->messageQueue->postMessage(MSG_SEEK_COMPLETE,
                                                        (int) av_rescale(seek_target, 1000, AV_TIME_BASE), ret);
             }
         }
 
+        /*处理切换轨道请求*/
+        if (trackRequest) {
+            mMutex.lock();
+            int trackType = trackRequestType;
+            int trackIndex = trackRequestIndex;
+            trackRequest = 0;
+            mMutex.unlock();
+            switchTrack(trackType, trackIndex);
+        }
+
+        // 倒放时由倒放解码器自己读取和解码，结束倒放的定位请求会唤醒这里
+        if (playerState->reversePlayback) {
+            if (reverseSeekRequest) {
+                restartReverse();
+            }
+            waitForReverse();
+            continue;
+        }
+
         // 取得封面数据包
         if (attachmentRequest) {
             if (videoDecoder &&
@@ -891,24 +1536,29 @@ int MediaPlayer::readAvPackets() {
             attachmentRequest = 0;
         }
 
-        /*暂停会在这里循环*/
+        /*暂停会在这里休眠*/
         // 如果队列中存在足够的数据包，则等待消耗
         // 备注：这里要等待一定时长的缓冲队列，要不然会导致OpenSLES播放音频出现卡顿等现象
-        // 暂停的时候，也会一直执行里面的continue，因为队列满了但没消耗
-        if (playerState->infiniteBuffer < 1 &&
-            ((audioDecoder ? audioDecoder->getMemorySize() : 0) +
-             (videoDecoder ? videoDecoder->getMemorySize() : 0) > MAX_QUEUE_SIZE
-             || (!audioDecoder || audioDecoder->hasEnoughPackets()) &&
-                (!videoDecoder || videoDecoder->hasEnoughPackets()))) {
-            // 当播放器执行暂停的时候，也会不断执行这里，因为暂停的时候音视频就会停止消耗数据，然后音视频队列就会超过最大值从而等待
-            // 然后也就暂停了从文件中读取数据
-            // LOGE("暂停");
+        // 暂停的时候音视频就会停止消耗数据，队列达到高水位以后读数据包线程就会休眠，直到解码器消耗到低水位才被唤醒
+        if (isQueueFull()) {
+            if (preloadReserved > 0 && !preloadNotified) {
+                preloadNotified = true;
+                if (playerState->messageQueue) {
+                    playerState->messageQueue->postMessage(MSG_PRELOAD_COMPLETE, (int) (preloadReserved / 1024));
+                }
+            }
+            waitForQueueDrain();
             continue;
         }
 
         /*读取数据包*/
         if (!waitToSeek) { // 没有等待定位
+            int64_t readStartTime = av_gettime_relative();
             ret = av_read_frame(pFormatCtx, pkt); //返回0即为OK，小于0就是出错了或者读到了文件的结尾
+            // 自适应码率按读数据包的耗时估计吞吐量
+            if (ret >= 0 && abrController) {
+                abrController->addSample(pkt->size, av_gettime_relative() - readStartTime);
+            }
         } else {
             ret = -1;
         }
@@ -918,12 +1568,16 @@ int MediaPlayer::readAvPackets() {
         if (ret < 0) {
 
             // 如果没能读出数据包，判断是否是结尾
-            if ((ret == AVERROR_EOF || avio_feof(pFormatCtx->pb)) && !eof) {
+            if ((ret == AVERROR_EOF || avio_feof(pFormatCtx->pb)) && !playerState->eof) {
+                // 排空视频解码器，精确定位的目标超过最后一帧时，解码线程在解码器排空以后结束定位
+                if (videoDecoder) {
+                    videoDecoder->pushNullPacket();
+                }
                 // 通知播放完成
                 if (playerState->messageQueue) {
                     playerState->messageQueue->postMessage(MSG_COMPLETED);
                 }
-                eof = 1;
+                playerState->eof = 1;
             }
             // 读取出错，则直接退出，退出for循环
             if (pFormatCtx->pb && pFormatCtx->pb->error) {
@@ -941,16 +1595,18 @@ int MediaPlayer::readAvPackets() {
                     ret = AVERROR_EOF;
                     break;
                 }
-//                else if (eof == 1) { // 播放完毕退出
+//                else if (playerState->eof == 1) { // 播放完毕退出
 //                    break;
 //                }
             }
-            // 睡眠10毫秒
-            av_usleep(10 * 1000);
+            // 读到结尾时结束缓冲
+            mediaSync->updateBuffering();
+            // 等待播放结束或者控制请求
+            waitAtEndOfFile();
             // 如果读取失败或者播放完毕以后还不退出，则继续下一个循环
             continue; // 如果不退出就来个空循环
         } else {
-            eof = 0;
+            playerState->eof = 0;
         }
 
         // 计算pkt的pts是否处于播放范围内
@@ -963,11 +1619,46 @@ int MediaPlayer::readAvPackets() {
                       (double) (playerState->startTime != AV_NOPTS_VALUE ? playerState->startTime : 0) / 1000000
                       <= ((double) playerState->duration / 1000000);
 
+        // 直播延时过大时丢弃数据包
+        if (liveLatencyController && checkLiveLatency(pkt)) {
+            av_packet_unref(pkt);
+            continue;
+        }
+
+        // 自适应码率，切换码流时丢弃切换点两边多余的数据包，新码流的数据包映射到解码器的媒体流上
+        if (abrController) {
+            if (!abrController->mapPacket(pkt)) {
+                av_packet_unref(pkt);
+                continue;
+            }
+            double queueLevel = 1.0;
+            if (audioDecoder) {
+                queueLevel = FFMIN(queueLevel, audioDecoder->getQueueLevel());
+            }
+            if (videoDecoder) {
+                queueLevel = FFMIN(queueLevel, videoDecoder->getQueueLevel());
+            }
+            abrController->update(queueLevel);
+        }
+
+        // 切换轨道回退重读时，其他媒体流已经读过的数据包不再重复送入
+        if (skipRefilledPacket(pkt)) {
+            av_packet_unref(pkt);
+            continue;
+        }
+
         /*将音频或者视频数据包压入队列*/
         if (playInRange && audioDecoder && pkt->stream_index == audioDecoder->getStreamIndex()) {
             audioDecoder->pushPacket(pkt);
+            playerState->switchingAudio = 0;
         } else if (playInRange && videoDecoder && pkt->stream_index == videoDecoder->getStreamIndex()) {
+            if (keyframeIndex) {
+                keyframeIndex->addPacket(pkt);
+            }
             videoDecoder->pushPacket(pkt);
+        } else if (playInRange && subtitleDecoder && !subtitleDecoder->isExternal()
+                   && pkt->stream_index == subtitleDecoder->getStreamIndex()) {
+            subtitleDecoder->pushPacket(pkt);
         } else {
             av_packet_unref(pkt);
         }
@@ -975,16 +1666,33 @@ int MediaPlayer::readAvPackets() {
         if (!playInRange) {
             waitToSeek = 1;
         }
+        // 更新缓冲状态，没有视频时同步线程不会启动，只能由读数据包线程检查
+        mediaSync->updateBuffering();
     }
-    LOGD("循环结束");
+    LOGD("循环结束，读数据包线程因队列已满休眠%lld次，共%lld毫秒",
+         (long long) playerState->readBlockCount, (long long) (playerState->readBlockTime / 1000));
     /*循环结束*/
 
+    // 保存播放过程中建立的关键帧索引
+    if (keyframeIndex) {
+        keyframeIndex->stopScan();
+        keyframeIndex->save();
+    }
+
     if (audioDecoder) {
         audioDecoder->stop();
     }
+    // 音频解码线程需要在音频解码器停止以后才能退出
+    if (audioResampler) {
+        LOGD("音频回调取不到PCM数据%lld次", (long long) audioResampler->getUnderrunCount());
+        audioResampler->stop();
+    }
     if (videoDecoder) {
         videoDecoder->stop();
     }
+    if (subtitleDecoder) {
+        subtitleDecoder->stop();
+    }
     if (audioDevice) {
         audioDevice->stop();
     }
@@ -997,8 +1705,264 @@ int MediaPlayer::readAvPackets() {
     return ret;
 }
 
+/**
+ * 数据包队列是否已满，总大小超过上限或者音视频队列都达到高水位
+ * @return
+ */
+bool MediaPlayer::isQueueFull() {
+    // 预加载时只缓冲到预加载的目标，开始播放以后再按水位线读取
+    if (preloadReserved > 0 && playerState->pauseRequest && isPreloadFull()) {
+        return true;
+    }
+    if (playerState->infiniteBuffer >= 1) {
+        return false;
+    }
+    // 缓冲期间不受高水位限制，一直读到缓冲足够或者内存达到上限
+    if (playerState->buffering) {
+        return (audioDecoder ? audioDecoder->getMemorySize() : 0) +
+               (videoDecoder ? videoDecoder->getMemorySize() : 0) > MAX_QUEUE_SIZE;
+    }
+    return (audioDecoder ? audioDecoder->getMemorySize() : 0) +
+           (videoDecoder ? videoDecoder->getMemorySize() : 0) > MAX_QUEUE_SIZE
+           || (!audioDecoder || audioDecoder->hasEnoughPackets()) &&
+              (!videoDecoder || videoDecoder->hasEnoughPackets());
+}
+
+/**
+ * 读数据包线程休眠，解码器消耗到低水位、定位、暂停状态变化以及退出时会被唤醒
+ */
+void MediaPlayer::waitForQueueDrain() {
+    playerState->mBufferMutex.lock();
+    playerState->bufferWaiting = 1;
+    int64_t startTime = av_gettime_relative();
+    playerState->readBlockCount++;
+    while (!playerState->abortRequest && !playerState->seekRequest && !trackRequest
+           && playerState->pauseRequest == lastPaused && isQueueFull()) {
+        playerState->mBufferCondition.wait(playerState->mBufferMutex);
+    }
+    playerState->bufferWaiting = 0;
+    playerState->readBlockTime += av_gettime_relative() - startTime;
+    playerState->mBufferMutex.unlock();
+}
+
+/**
+ * 读到文件末尾以后等待，需要定时检查是否已经播放完，定位、暂停状态变化以及退出时会被立即唤醒
+ */
+void MediaPlayer::waitAtEndOfFile() {
+    playerState->mBufferMutex.lock();
+    if (!playerState->abortRequest && !playerState->seekRequest && !trackRequest
+        && playerState->pauseRequest == lastPaused) {
+        playerState->mBufferCondition.waitRelative(playerState->mBufferMutex, READ_EOF_WAIT_TIMEOUT);
+    }
+    playerState->mBufferMutex.unlock();
+}
+
+void MediaPlayer::waitForReverse() {
+    playerState->mBufferMutex.lock();
+    while (!playerState->abortRequest && !playerState->seekRequest && playerState->reversePlayback
+           && !reverseSeekRequest) {
+        playerState->mBufferCondition.wait(playerState->mBufferMutex);
+    }
+    playerState->mBufferMutex.unlock();
+}
+
+/**
+ * 直播低延时模式下检查延时，由控制器决定是否丢弃，这里处理解码器队列和视频计时
+ * @param pkt
+ * @return
+ */
+bool MediaPlayer::checkLiveLatency(AVPacket *pkt) {
+    int result = liveLatencyController->check(pkt, mediaSync->getMasterClock());
+    if (result & LIVE_RESUME_VIDEO) {
+        mediaSync->refreshVideoTimer();
+    }
+    if (result & LIVE_DROP_QUEUE) {
+        if (audioDecoder) {
+            audioDecoder->dropPackets();
+        }
+        if (videoDecoder) {
+            videoDecoder->dropPackets();
+        }
+    }
+    return (result & LIVE_DROP_PACKET) != 0;
+}
+
+/**
+ * 数据包按码率估算，视频帧按帧队列的默认深度估算，预算不足时同时预加载的播放器数量就受到限制
+ * @return
+ */
+bool MediaPlayer::startPreload() {
+    int64_t packetBytes = PRELOAD_PACKET_BYTES;
+    if (pFormatCtx->bit_rate > 0) {
+        packetBytes = (int64_t) (pFormatCtx->bit_rate / 8 * playerState->preloadSeconds);
+    }
+    int64_t frameBytes = 0;
+    if (videoDecoder) {
+        AVCodecParameters *codecpar = videoDecoder->getStream()->codecpar;
+        int size = av_image_get_buffer_size((AVPixelFormat) codecpar->format, codecpar->width, codecpar->height, 1);
+        frameBytes = size > 0 ? (int64_t) size * VIDEO_QUEUE_SIZE : 0;
+    }
+    if (!PreloadManager::getInstance()->reserve(packetBytes + frameBytes)) {
+        LOGD("预加载内存预算不足，等待开始以后再读取数据包");
+        return false;
+    }
+    preloadReserved = packetBytes + frameBytes;
+    preloadPacketBytes = packetBytes;
+    preloadNotified = false;
+    LOGD("开始预加载，预算%lldKB", (long long) (preloadReserved / 1024));
+    return true;
+}
 
-int MediaPlayer::prepareDecoder(int streamIndex) {
+void MediaPlayer::finishPreload() {
+    if (preloadReserved > 0) {
+        PreloadManager::getInstance()->release(preloadReserved);
+        preloadReserved = 0;
+    }
+}
+
+/**
+ * 数据包达到预算或者每一路流都缓冲到预加载时长
+ * @return
+ */
+bool MediaPlayer::isPreloadFull() {
+    if ((audioDecoder ? audioDecoder->getMemorySize() : 0) +
+        (videoDecoder ? videoDecoder->getMemorySize() : 0) >= preloadPacketBytes) {
+        return true;
+    }
+    return (!audioDecoder || audioDecoder->hasBufferedDuration(playerState->preloadSeconds)) &&
+           (!videoDecoder || videoDecoder->hasBufferedDuration(playerState->preloadSeconds));
+}
+
+/**
+ * 音频只替换音频解码器的解码上下文，重采样器遇到新的音频格式会重新初始化，音频输出设备不需要重新打开
+ * 字幕解码器有自己的解码线程，直接关闭旧的再创建新的
+ * 视频和其他媒体流不受影响，只有切换的轨道从主时钟的位置重新读取
+ * @param mediaType
+ * @param streamIndex
+ */
+void MediaPlayer::switchTrack(int mediaType, int streamIndex) {
+    if (mediaType == AVMEDIA_TYPE_AUDIO) {
+        if (!audioDecoder || !audioResampler || streamIndex == audioDecoder->getStreamIndex()) {
+            return;
+        }
+        // 先停止音频解码器，重采样线程才不会阻塞在取数据包中，切换期间音频回调输出静音
+        playerState->switchingAudio = 1;
+        audioDecoder->stop();
+        audioResampler->stop();
+        mMutex.lock();
+        int ret = prepareDecoder(pFormatCtx, streamIndex);
+        mMutex.unlock();
+        audioResampler->flush();
+        audioDecoder->start();
+        audioResampler->start();
+        if (ret < 0) {
+            // 打开失败时继续播放原来的音频流
+            av_log(NULL, AV_LOG_WARNING, "failed to switch to audio stream %d\n", streamIndex);
+            return;
+        }
+    } else if (mediaType == AVMEDIA_TYPE_SUBTITLE) {
+        if (subtitleDecoder && !subtitleDecoder->isExternal() && subtitleDecoder->getStreamIndex() == streamIndex) {
+            return;
+        }
+        // 同步线程不再使用旧的字幕解码器以后才能释放
+        mediaSync->setSubtitleDecoder(NULL);
+        mMutex.lock();
+        if (subtitleDecoder) {
+            subtitleDecoder->stop();
+            delete subtitleDecoder;
+            subtitleDecoder = NULL;
+        }
+        if (streamIndex >= 0 && prepareDecoder(pFormatCtx, streamIndex) < 0) {
+            av_log(NULL, AV_LOG_WARNING, "failed to switch to subtitle stream %d\n", streamIndex);
+        }
+        mMutex.unlock();
+        if (!subtitleDecoder) {
+            return;
+        }
+        subtitleDecoder->start();
+        mediaSync->setSubtitleDecoder(subtitleDecoder);
+    } else {
+        return;
+    }
+    refillTrack(streamIndex);
+}
+
+/**
+ * 数据包队列中的数据已经领先主时钟一段时间，直接从读取位置开始会缺少这段时间的声音或者字幕
+ * 回退到主时钟之前的关键帧重新读取，其他媒体流跳过已经读过的数据包，新轨道丢弃主时钟之前的帧
+ * 实时流不能回退，新轨道从读取位置开始
+ * @param streamIndex
+ */
+void MediaPlayer::refillTrack(int streamIndex) {
+    if (playerState->realTime || !streamLastDts || !streamResumeDts) {
+        return;
+    }
+    double clock = mediaSync->getMasterClock();
+    if (isnan(clock)) {
+        return;
+    }
+    int64_t target = (int64_t) (clock * AV_TIME_BASE);
+    KeyframeEntry keyframe;
+    int ret = -1;
+    playerState->mMutex.lock();
+    if (keyframeIndex && keyframeIndex->lookup(target, &keyframe)) {
+        ret = avformat_seek_file(pFormatCtx, -1, INT64_MIN, keyframe.pos, INT64_MAX, AVSEEK_FLAG_BYTE);
+    }
+    if (ret < 0) {
+        ret = avformat_seek_file(pFormatCtx, -1, INT64_MIN, target, target, 0);
+    }
+    playerState->mMutex.unlock();
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_WARNING, "%s: could not refill stream %d\n", playerState->url, streamIndex);
+        return;
+    }
+    if (keyframeIndex) {
+        keyframeIndex->discontinue();
+    }
+    if (abrController) {
+        abrController->flush();
+    }
+    for (int i = 0; i < nbTrackStreams; i++) {
+        streamResumeDts[i] = i == streamIndex ? AV_NOPTS_VALUE : streamLastDts[i];
+    }
+    if (audioDecoder && audioDecoder->getStreamIndex() == streamIndex) {
+        audioDecoder->setSeekTarget(target);
+    } else if (subtitleDecoder && subtitleDecoder->getStreamIndex() == streamIndex) {
+        subtitleDecoder->setSeekTarget(target);
+    }
+    playerState->eof = 0;
+}
+
+/**
+ * dts在同一路媒体流中单调递增，没有时间戳的数据包无法判断，直接结束跳过
+ * @param pkt
+ * @return
+ */
+bool MediaPlayer::skipRefilledPacket(AVPacket *pkt) {
+    if (!streamLastDts || !streamResumeDts || pkt->stream_index < 0 || pkt->stream_index >= nbTrackStreams) {
+        return false;
+    }
+    int64_t timestamp = pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+    if (streamResumeDts[pkt->stream_index] != AV_NOPTS_VALUE) {
+        if (timestamp != AV_NOPTS_VALUE && timestamp <= streamResumeDts[pkt->stream_index]) {
+            return true;
+        }
+        // 追上切换之前的读取位置
+        streamResumeDts[pkt->stream_index] = AV_NOPTS_VALUE;
+    }
+    if (timestamp != AV_NOPTS_VALUE) {
+        streamLastDts[pkt->stream_index] = timestamp;
+    }
+    return false;
+}
+
+void MediaPlayer::wakeUpReadThread() {
+    playerState->mBufferMutex.lock();
+    playerState->mBufferCondition.signal();
+    playerState->mBufferMutex.unlock();
+}
+
+int MediaPlayer::prepareDecoder(AVFormatContext *formatCtx, int streamIndex) {
     AVCodecContext *avctx; // 解码上下文
     AVCodec *codec = NULL; // 解码器
     AVDictionary *opts = NULL; // 参数字典
@@ -1006,7 +1970,7 @@ int MediaPlayer::prepareDecoder(int streamIndex) {
     int ret = 0;
     const char *forcedCodecName = NULL;
 
-    if (streamIndex < 0 || streamIndex >= pFormatCtx->nb_streams) {
+    if (streamIndex < 0 || streamIndex >= formatCtx->nb_streams) {
         return -1;
     }
 
@@ -1018,25 +1982,25 @@ int MediaPlayer::prepareDecoder(int streamIndex) {
 
     do {
         /*复制解码上下文参数*/
-        ret = avcodec_parameters_to_context(avctx, pFormatCtx->streams[streamIndex]->codecpar);
+        ret = avcodec_parameters_to_context(avctx, formatCtx->streams[streamIndex]->codecpar);
         if (ret < 0) {
             break;
         }
 
         // 设置时钟基准
-        av_codec_set_pkt_timebase(avctx, pFormatCtx->streams[streamIndex]->time_base);
+        av_codec_set_pkt_timebase(avctx, formatCtx->streams[streamIndex]->time_base);
 
         // 优先使用指定的解码器
         switch (avctx->codec_type) {
             case AVMEDIA_TYPE_AUDIO: {
-                LOGE("音频时间基%d,%d", pFormatCtx->streams[streamIndex]->time_base.den,
-                     pFormatCtx->streams[streamIndex]->time_base.num);
+                LOGE("音频时间基%d,%d", formatCtx->streams[streamIndex]->time_base.den,
+                     formatCtx->streams[streamIndex]->time_base.num);
                 forcedCodecName = playerState->audioCodecName;
                 break;
             }
             case AVMEDIA_TYPE_VIDEO: {
-                LOGE("视频时间基%d,%d", pFormatCtx->streams[streamIndex]->time_base.den,
-                     pFormatCtx->streams[streamIndex]->time_base.num);
+                LOGE("视频时间基%d,%d", formatCtx->streams[streamIndex]->time_base.den,
+                     formatCtx->streams[streamIndex]->time_base.num);
                 forcedCodecName = playerState->videoCodecName;
                 break;
             }
@@ -1091,10 +2055,19 @@ int MediaPlayer::prepareDecoder(int streamIndex) {
 #endif
 
         // 过滤解码参数
-        opts = filterCodecOptions(playerState->codec_opts, avctx->codec_id, pFormatCtx,
-                                  pFormatCtx->streams[streamIndex], codec);
+        opts = filterCodecOptions(playerState->codec_opts, avctx->codec_id, formatCtx,
+                                  formatCtx->streams[streamIndex], codec);
+        if (playerState->sharedDecoderPool && avctx->codec_type == AVMEDIA_TYPE_VIDEO && !decoderPoolAttached) {
+            DecoderScheduler::getInstance()->attach();
+            decoderPoolAttached = true;
+        }
         if (!av_dict_get(opts, "threads", NULL, 0)) {
-            av_dict_set(&opts, "threads", "auto", 0);
+            // 共享解码调度器时CPU核数由所有播放器平分，避免每个视频解码器都按核数开线程
+            if (decoderPoolAttached && avctx->codec_type == AVMEDIA_TYPE_VIDEO) {
+                av_dict_set_int(&opts, "threads", DecoderScheduler::getInstance()->getCodecThreadCount(), 0);
+            } else {
+                av_dict_set(&opts, "threads", "auto", 0);
+            }
         }
 
         if (stream_lowres) {
@@ -1104,6 +2077,10 @@ int MediaPlayer::prepareDecoder(int streamIndex) {
         if (avctx->codec_type == AVMEDIA_TYPE_VIDEO || avctx->codec_type == AVMEDIA_TYPE_AUDIO) {
             av_dict_set(&opts, "refcounted_frames", "1", 0);
         }
+        // 视频帧缓冲池是线程安全的，帧线程解码时可以直接在解码线程中分配
+        if (avctx->codec_type == AVMEDIA_TYPE_VIDEO) {
+            avctx->thread_safe_callbacks = 1;
+        }
 
         /*打开解码器*/
         if ((ret = avcodec_open2(avctx, codec, &opts)) < 0) {
@@ -1116,27 +2093,41 @@ int MediaPlayer::prepareDecoder(int streamIndex) {
         }
 
         // 根据解码器类型创建解码器
-        pFormatCtx->streams[streamIndex]->discard = AVDISCARD_DEFAULT; // 抛弃无用的数据比如像0大小的packet
+        formatCtx->streams[streamIndex]->discard = AVDISCARD_DEFAULT; // 抛弃无用的数据比如像0大小的packet
 
         /*根据解码器类型，创建对应的解码器*/
         switch (avctx->codec_type) {
             case AVMEDIA_TYPE_AUDIO: {
                 if (audioDecoder == NULL) {
-                    audioDecoder = new AudioDecoder(avctx, pFormatCtx->streams[streamIndex], streamIndex, playerState);
+                    audioDecoder = new AudioDecoder(avctx, formatCtx->streams[streamIndex], streamIndex, playerState);
+                } else {
+                    // 如果已经有解码器了，就替换解码器的解码上下文，用于切换音频轨道
+                    audioDecoder->changeStream(avctx, formatCtx->streams[streamIndex], streamIndex);
                 }
-                // 如果已经有解码器了，就重置解码器的参数
                 break;
             }
 
             case AVMEDIA_TYPE_VIDEO: {
                 if (videoDecoder == NULL) {
-                    videoDecoder = new VideoDecoder(pFormatCtx, avctx, pFormatCtx->streams[streamIndex], streamIndex,
+                    videoDecoder = new VideoDecoder(formatCtx, avctx, formatCtx->streams[streamIndex], streamIndex,
                                                     playerState);
                 }
                 attachmentRequest = 1;
                 break;
             }
 
+            case AVMEDIA_TYPE_SUBTITLE: {
+                if (subtitleDecoder == NULL) {
+                    // 外挂字幕的解复用上下文交给字幕解码器，时间轴对齐到主文件的起始时间
+                    subtitleDecoder = new SubtitleDecoder(formatCtx != pFormatCtx ? formatCtx : NULL, avctx,
+                                                          formatCtx->streams[streamIndex], streamIndex, playerState);
+                    if (formatCtx != pFormatCtx) {
+                        subtitleDecoder->setStartTime(pFormatCtx->start_time);
+                    }
+                }
+                break;
+            }
+
             default: {
                 break;
             }
@@ -1145,7 +2136,9 @@ int MediaPlayer::prepareDecoder(int streamIndex) {
 
     // 准备失败，则需要释放创建的解码上下文
     if (ret < 0) {
-        if (playerState->messageQueue) {
+        // 字幕打开失败只是不显示字幕，切换音频轨道失败时继续使用原来的音频
+        if (playerState->messageQueue && avctx->codec_type != AVMEDIA_TYPE_SUBTITLE
+            && !(avctx->codec_type == AVMEDIA_TYPE_AUDIO && audioDecoder)) {
             const char errorMsg[] = "failed to open stream!";
             playerState->messageQueue->postMessage(MSG_ERROR, 0, 0, (void *) errorMsg, sizeof(errorMsg) / errorMsg[0]);
         }
@@ -1157,6 +2150,41 @@ int MediaPlayer::prepareDecoder(int streamIndex) {
     return ret;
 }
 
+/**
+ * 外挂字幕文件一般很小，解复用器打开时会把所有字幕读进内存
+ * @param filename
+ * @return
+ */
+int MediaPlayer::openSubtitleFile(const char *filename) {
+    AVFormatContext *formatCtx = NULL;
+    int ret = avformat_open_input(&formatCtx, filename, NULL, NULL);
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_WARNING, "could not open subtitle file %s\n", filename);
+        return ret;
+    }
+    do {
+        if ((ret = avformat_find_stream_info(formatCtx, NULL)) < 0) {
+            break;
+        }
+        int streamIndex = av_find_best_stream(formatCtx, AVMEDIA_TYPE_SUBTITLE, -1, -1, NULL, 0);
+        if (streamIndex < 0) {
+            ret = streamIndex;
+            break;
+        }
+        for (int i = 0; i < formatCtx->nb_streams; ++i) {
+            formatCtx->streams[i]->discard = AVDISCARD_ALL;
+        }
+        ret = prepareDecoder(formatCtx, streamIndex);
+    } while (false);
+
+    // 成功时由字幕解码器负责关闭
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_WARNING, "no usable subtitle in %s\n", filename);
+        avformat_close_input(&formatCtx);
+    }
+    return ret;
+}
+
 /**
  * 音频取pcm数据的回调方法
  * @param opaque
@@ -1249,7 +2277,11 @@ int MediaPlayer::openAudioDevice(int64_t wanted_channel_layout, int wanted_nb_ch
         audioResampler = new AudioResampler(playerState, audioDecoder, mediaSync);
     }
     // 设置需要重采样的参数
-    audioResampler->setResampleParams(&spec, wanted_channel_layout);
+    if (audioResampler->setResampleParams(&spec, wanted_channel_layout) < 0) {
+        return -1;
+    }
+    // 开启音频解码线程，提前填充PCM队列
+    audioResampler->start();
 
     return spec.size;
 }
@@ -1261,13 +2293,11 @@ int MediaPlayer::openAudioDevice(int64_t wanted_channel_layout, int wanted_nb_ch
  */
 void MediaPlayer::pcmQueueCallback(uint8_t *stream, int len) {
     if (!audioResampler) {
-        memset(stream, 0, sizeof(len));
+        memset(stream, 0, (size_t) len);
         return;
     }
+    // 音频回调中不能加锁，当前位置由音频解码线程通知
     audioResampler->pcmQueueCallback(stream, len);
-    if (playerState->messageQueue && playerState->syncType != AV_SYNC_VIDEO) {
-        playerState->messageQueue->postMessage(MSG_CURRENT_POSITON, getCurrentPosition(), playerState->videoDuration);
-    }
 }
 
 
@@ -0,0 +1,192 @@
+
+#include "MmapIO.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+extern "C" {
+#include "libavutil/avstring.h"
+};
+
+MmapIO::MmapIO() {
+    fd = -1;
+    fileSize = 0;
+    position = 0;
+    window = NULL;
+    windowStart = 0;
+    windowLength = 0;
+    windowSize = 0;
+    context = NULL;
+}
+
+MmapIO::~MmapIO() {
+    if (context) {
+        av_freep(&context->buffer);
+        avio_context_free(&context);
+    }
+    unmapWindow();
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+bool MmapIO::isSupported(const char *url) {
+    const char *protocol = avio_find_protocol_name(url);
+    return protocol && !strcmp(protocol, "file") && strcmp(url, "-") && !av_strstart(url, "pipe:", NULL);
+}
+
+/**
+ * 打开并映射文件，空文件和无法映射的文件(比如管道、字符设备)返回错误
+ * @param url
+ * @return
+ */
+int MmapIO::open(const char *url) {
+    const char *path = url;
+    uint8_t *ioBuffer;
+
+    av_strstart(url, "file:", &path);
+    fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return AVERROR(errno);
+    }
+    fileSize = lseek64(fd, 0, SEEK_END);
+    if (fileSize <= 0) {
+        return AVERROR(EINVAL);
+    }
+    windowSize = sizeof(void *) >= 8 ? (size_t) fileSize : MMAP_WINDOW_SIZE;
+    int ret = mapWindow(0);
+    if (ret < 0) {
+        return ret;
+    }
+
+    ioBuffer = (uint8_t *) av_malloc(MMAP_IO_BUFFER_SIZE);
+    if (!ioBuffer) {
+        return AVERROR(ENOMEM);
+    }
+    context = avio_alloc_context(ioBuffer, MMAP_IO_BUFFER_SIZE, 0, this, readPacket, NULL, seekPacket);
+    if (!context) {
+        av_free(ioBuffer);
+        return AVERROR(ENOMEM);
+    }
+    context->seekable = AVIO_SEEKABLE_NORMAL;
+    // 较大的读取不经过AVIOContext的缓冲，直接从映射区拷贝
+    context->direct = 1;
+    return 0;
+}
+
+AVIOContext *MmapIO::getContext() {
+    return context;
+}
+
+int MmapIO::readPacket(void *opaque, uint8_t *buf, int size) {
+    return ((MmapIO *) opaque)->read(buf, size);
+}
+
+int64_t MmapIO::seekPacket(void *opaque, int64_t offset, int whence) {
+    return ((MmapIO *) opaque)->seek(offset, whence);
+}
+
+/**
+ * 映射包含pos的窗口，起始位置按页对齐，顺序读取时由内核预读后面的页
+ * 文件变小以后超出文件的部分不能映射，否则读取时会触发SIGBUS，所以先按文件的当前大小截断
+ * @param pos
+ * @return
+ */
+int MmapIO::mapWindow(int64_t pos) {
+    struct stat64 st;
+    if (fstat64(fd, &st) < 0) {
+        return AVERROR(errno);
+    }
+    if (st.st_size < fileSize) {
+        av_log(NULL, AV_LOG_WARNING, "mmap io: file shrank from %lld to %lld\n",
+               (long long) fileSize, (long long) st.st_size);
+        fileSize = st.st_size;
+    }
+    if (pos >= fileSize) {
+        return AVERROR_EOF;
+    }
+    int64_t pageSize = sysconf(_SC_PAGESIZE);
+    int64_t start = windowSize >= (size_t) fileSize ? 0 : pos - pos % pageSize;
+    size_t length = (size_t) FFMIN((int64_t) windowSize, fileSize - start);
+
+    unmapWindow();
+    void *addr = mmap64(NULL, length, PROT_READ, MAP_SHARED, fd, start);
+    if (addr == MAP_FAILED) {
+        int err = errno;
+        av_log(NULL, AV_LOG_WARNING, "mmap io: could not map %zu bytes at %lld\n", length, (long long) start);
+        return AVERROR(err);
+    }
+    madvise(addr, length, MADV_SEQUENTIAL);
+    window = (uint8_t *) addr;
+    windowStart = start;
+    windowLength = length;
+    return 0;
+}
+
+void MmapIO::unmapWindow() {
+    if (window) {
+        munmap(window, windowLength);
+        window = NULL;
+        windowLength = 0;
+    }
+}
+
+int MmapIO::read(uint8_t *buf, int size) {
+    if (position >= fileSize) {
+        return AVERROR_EOF;
+    }
+    if (position < windowStart || position >= windowStart + (int64_t) windowLength) {
+        int ret = mapWindow(position);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    int len = (int) FFMIN(size, windowStart + (int64_t) windowLength - position);
+    memcpy(buf, window + (position - windowStart), len);
+    position += len;
+    return len;
+}
+
+/**
+ * 定位只移动读位置，跳转到不连续的位置时提前通知内核读入目标位置的页
+ * @param offset
+ * @param whence
+ * @return
+ */
+int64_t MmapIO::seek(int64_t offset, int whence) {
+    int64_t target;
+
+    if (whence & AVSEEK_SIZE) {
+        return fileSize;
+    }
+    switch (whence & ~AVSEEK_FORCE) {
+        case SEEK_SET: {
+            target = offset;
+            break;
+        }
+        case SEEK_CUR: {
+            target = position + offset;
+            break;
+        }
+        case SEEK_END: {
+            target = fileSize + offset;
+            break;
+        }
+        default: {
+            return AVERROR(EINVAL);
+        }
+    }
+    if (target < 0) {
+        return AVERROR(EINVAL);
+    }
+    if (target != position && target >= windowStart && target < windowStart + (int64_t) windowLength) {
+        int64_t pageSize = sysconf(_SC_PAGESIZE);
+        int64_t offsetInWindow = (target - windowStart) - (target - windowStart) % pageSize;
+        size_t length = (size_t) FFMIN(MMAP_WILLNEED_SIZE, (int64_t) windowLength - offsetInWindow);
+        madvise(window + offsetInWindow, length, MADV_WILLNEED);
+    }
+    position = target;
+    return target;
+}
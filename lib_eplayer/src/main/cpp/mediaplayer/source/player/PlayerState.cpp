@@ -1,6 +1,7 @@
 
 #include <AndroidLog.h>
 #include "PlayerState.h"
+#include "PreloadManager.h"
 
 PlayerState::PlayerState() {
     init();
@@ -9,6 +10,10 @@ PlayerState::PlayerState() {
 
 PlayerState::~PlayerState() {
     reset();
+    av_freep(&keyframeIndexDir);
+    av_freep(&streamInfoCacheDir);
+    av_freep(&httpCacheDir);
+    av_freep(&subtitleFile);
     if (messageQueue) {
         messageQueue->release();
         delete messageQueue;
@@ -32,6 +37,10 @@ void PlayerState::init() {
 
     audioCodecName = NULL;
     videoCodecName = NULL;
+    keyframeIndexDir = NULL;
+    streamInfoCacheDir = NULL;
+    httpCacheDir = NULL;
+    subtitleFile = NULL;
     messageQueue = new AVMessageQueue();
 }
 
@@ -67,22 +76,101 @@ void PlayerState::reset() {
     audioDisable = 0;
     videoDisable = 0;
     displayDisable = 0;
+    subtitleDisable = 0;
     fast = 0;
     genpts = 0;
     lowres = 0;
     playbackRate = 1.0;
     playbackPitch = 1.0;
+    displayRefreshRate = DISPLAY_REFRESH_RATE;
+    keyframeOnlyRate = KEYFRAME_ONLY_RATE;
     seekRequest = 0;
     seekFlags = 0;
     seekPos = 0;
     seekRel = 0;
     seekRel = 0;
+    seekStartTime = 0;
+    seekSerial = 0;
+    accurateSeek = 0;
+    seekAccurate = 0;
+    stepRequest = 0;
+    stepCacheFrames = STEP_CACHE_FRAMES;
+    reversePlayback = 0;
+    reverseBufferMemory = REVERSE_BUFFER_MEMORY;
+    keyframeIndexScan = 0;
     autoExit = 0;
     loop = 0;
     mute = 0;
     frameDrop = 1;
     reorderVideoPts = 1;
     videoDuration = 0;
+    audioWatermark.highBytes = AUDIO_HIGH_WATER_BYTES;
+    audioWatermark.lowBytes = AUDIO_LOW_WATER_BYTES;
+    audioWatermark.highSeconds = HIGH_WATER_SECONDS;
+    audioWatermark.lowSeconds = LOW_WATER_SECONDS;
+    videoWatermark.highBytes = VIDEO_HIGH_WATER_BYTES;
+    videoWatermark.lowBytes = VIDEO_LOW_WATER_BYTES;
+    videoWatermark.highSeconds = HIGH_WATER_SECONDS;
+    videoWatermark.lowSeconds = LOW_WATER_SECONDS;
+    bufferWaiting = 0;
+    readBlockCount = 0;
+    readBlockTime = 0;
+    pcmQueueDepth = PCM_QUEUE_DEPTH;
+    videoQueueMemory = VIDEO_QUEUE_MEMORY_BUDGET;
+    eof = 0;
+    buffering = 0;
+    bufferingSeconds = BUFFERING_RESUME_SECONDS;
+    switchingAudio = 0;
+    liveMode = 0;
+    liveTargetLatency = LIVE_TARGET_LATENCY;
+    liveMaxLatency = LIVE_MAX_LATENCY;
+    liveCatchUpRate = 1.0f;
+    openStartTime = 0;
+    readAheadSize = READ_AHEAD_BUFFER_SIZE;
+    mmapIO = 0;
+    httpCacheSize = HTTP_CACHE_MAX_SIZE;
+    abr = 1;
+    sharedDecoderPool = 0;
+    decodePriority = DECODE_PRIORITY_VISIBLE;
+    preload = 0;
+    decoderGovernor = 1;
+    preloadSeconds = PRELOAD_SECONDS;
+}
+
+/**
+ * 解码器消耗数据包以后调用，只有读数据包线程正在等待时才加锁通知
+ */
+void PlayerState::notifyBufferDrained() {
+    if (bufferWaiting) {
+        mBufferMutex.lock();
+        mBufferCondition.signal();
+        mBufferMutex.unlock();
+    }
+}
+
+/**
+ * 修改pauseRequest、seekRequest、abortRequest或者工作线程自己的退出标志以后调用
+ */
+void PlayerState::signalGate() {
+    mGateMutex.lock();
+    mGateCondition.broadcast();
+    mGateMutex.unlock();
+}
+
+void PlayerState::waitForSeek(const bool *abort) {
+    mGateMutex.lock();
+    while (!abortRequest && seekRequest && !(abort && *abort)) {
+        mGateCondition.wait(mGateMutex);
+    }
+    mGateMutex.unlock();
+}
+
+void PlayerState::waitForResume(const bool *abort) {
+    mGateMutex.lock();
+    while (!abortRequest && pauseRequest && !stepRequest && !(abort && *abort)) {
+        mGateCondition.wait(mGateMutex);
+    }
+    mGateMutex.unlock();
 }
 
 void PlayerState::setOption(int category, const char *type, const char *option) {
@@ -150,6 +238,18 @@ void PlayerState::parse_string(const char *type, const char *option) {
         audioCodecName = av_strdup(option);
     } else if (!strcmp("vcodec", type)) {   // 指定视频解码器名称
         videoCodecName = av_strdup(option);
+    } else if (!strcmp("keyframe-index-dir", type)) { // 关键帧索引文件目录
+        av_freep(&keyframeIndexDir);
+        keyframeIndexDir = av_strdup(option);
+    } else if (!strcmp("stream-info-cache-dir", type)) { // 媒体流信息缓存目录
+        av_freep(&streamInfoCacheDir);
+        streamInfoCacheDir = av_strdup(option);
+    } else if (!strcmp("http-cache-dir", type)) { // http点播的磁盘缓存目录
+        av_freep(&httpCacheDir);
+        httpCacheDir = av_strdup(option);
+    } else if (!strcmp("subtitle-file", type)) { // 外挂字幕文件
+        av_freep(&subtitleFile);
+        subtitleFile = av_strdup(option);
     } else if (!strcmp("sync", type)) { // 制定同步类型
         if (!strcmp("audio", option)) {
             syncType = AV_SYNC_AUDIO;
@@ -173,6 +273,8 @@ void PlayerState::parse_int(const char *type, int64_t option) {
         audioDisable = (option != 0) ? 1 : 0;
     } else if (!strcmp("vn", type)) { // 禁用视频
         videoDisable = (option != 0) ? 1 : 0;
+    } else if (!strcmp("sn", type)) { // 禁用字幕
+        subtitleDisable = (option != 0) ? 1 : 0;
     } else if (!strcmp("bytes", type)) { // 以字节方式定位
         seekByBytes = (option > 0) ? 1 : ((option < 0) ? -1 : 0);
     } else if (!strcmp("nodisp", type)) { // 不显示
@@ -191,6 +293,66 @@ void PlayerState::parse_int(const char *type, int64_t option) {
         frameDrop = (option != 0) ? 1 : 0;
     } else if (!strcmp("infbuf", type)) { // 无限缓冲区标志
         infiniteBuffer = (option > 0) ? 1 : ((option < 0) ? -1 : 0);
+    } else if (!strcmp("video-high-water-bytes", type)) { // 视频队列高水位字节数
+        videoWatermark.highBytes = (int) option;
+    } else if (!strcmp("video-low-water-bytes", type)) { // 视频队列低水位字节数
+        videoWatermark.lowBytes = (int) option;
+    } else if (!strcmp("video-high-water-ms", type)) { // 视频队列高水位时长
+        videoWatermark.highSeconds = option / 1000.0;
+    } else if (!strcmp("video-low-water-ms", type)) { // 视频队列低水位时长
+        videoWatermark.lowSeconds = option / 1000.0;
+    } else if (!strcmp("audio-high-water-bytes", type)) { // 音频队列高水位字节数
+        audioWatermark.highBytes = (int) option;
+    } else if (!strcmp("audio-low-water-bytes", type)) { // 音频队列低水位字节数
+        audioWatermark.lowBytes = (int) option;
+    } else if (!strcmp("audio-high-water-ms", type)) { // 音频队列高水位时长
+        audioWatermark.highSeconds = option / 1000.0;
+    } else if (!strcmp("audio-low-water-ms", type)) { // 音频队列低水位时长
+        audioWatermark.lowSeconds = option / 1000.0;
+    } else if (!strcmp("pcm-queue-depth", type)) { // PCM队列缓冲块数
+        pcmQueueDepth = (int) option;
+    } else if (!strcmp("video-queue-memory", type)) { // 视频帧队列内存上限
+        videoQueueMemory = option;
+    } else if (!strcmp("buffering-ms", type)) { // 结束缓冲需要缓冲的时长
+        bufferingSeconds = option / 1000.0;
+    } else if (!strcmp("live-mode", type)) { // 直播低延时模式
+        liveMode = (option != 0) ? 1 : 0;
+    } else if (!strcmp("live-latency-ms", type)) { // 直播目标延时
+        liveTargetLatency = option / 1000.0;
+    } else if (!strcmp("live-max-latency-ms", type)) { // 直播延时上限
+        liveMaxLatency = option / 1000.0;
+    } else if (!strcmp("accurate-seek", type)) { // 精确定位
+        accurateSeek = (option != 0) ? 1 : 0;
+    } else if (!strcmp("step-cache-frames", type)) { // 逐帧后退缓存的视频帧数量
+        stepCacheFrames = (int) FFMIN(FFMAX(option, 0), 64);
+    } else if (!strcmp("reverse-buffer-memory", type)) { // 倒放GOP缓冲的内存上限
+        reverseBufferMemory = FFMAX(option, 0);
+    } else if (!strcmp("keyframe-index-scan", type)) { // 后台扫描关键帧索引
+        keyframeIndexScan = (option != 0) ? 1 : 0;
+    } else if (!strcmp("read-ahead-size", type)) { // 预读缓冲大小
+        readAheadSize = (int) FFMAX(option, 0);
+    } else if (!strcmp("mmap-io", type)) { // 本地文件使用内存映射读取，文件在映射期间被截断时进程会收到SIGBUS，只用于不会变化的文件
+        mmapIO = (option != 0) ? 1 : 0;
+    } else if (!strcmp("http-cache-size", type)) { // http磁盘缓存目录的大小上限
+        httpCacheSize = option;
+    } else if (!strcmp("abr", type)) { // HLS自适应码率
+        abr = (option != 0) ? 1 : 0;
+    } else if (!strcmp("shared-decoder-pool", type)) { // 多个播放器共享解码调度器
+        sharedDecoderPool = (option != 0) ? 1 : 0;
+    } else if (!strcmp("decode-priority", type)) { // 共享解码调度器中的优先级，播放过程中可以修改
+        decodePriority = (int) FFMIN(FFMAX(option, DECODE_PRIORITY_BACKGROUND), DECODE_PRIORITY_FOCUSED);
+    } else if (!strcmp("decoder-governor", type)) { // 解码过载时降级
+        decoderGovernor = (option != 0) ? 1 : 0;
+    } else if (!strcmp("display-refresh-rate", type)) { // 屏幕刷新率
+        displayRefreshRate = (int) FFMAX(option, 0);
+    } else if (!strcmp("keyframe-only-rate", type)) { // 只解码关键帧的播放速度，按百分比设置，800表示8倍速
+        keyframeOnlyRate = FFMAX(option, 0) / 100.0;
+    } else if (!strcmp("preload", type)) { // 预加载
+        preload = (option != 0) ? 1 : 0;
+    } else if (!strcmp("preload-duration-ms", type)) { // 预加载缓冲的时长
+        preloadSeconds = option / 1000.0;
+    } else if (!strcmp("preload-memory-budget", type)) { // 所有播放器预加载的内存预算，进程内共享
+        PreloadManager::getInstance()->setBudget(option);
     } else {
         LOGE("unknown option - '%s'", type);
     }
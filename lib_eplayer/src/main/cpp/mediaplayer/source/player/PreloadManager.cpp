@@ -0,0 +1,52 @@
+
+#include "PreloadManager.h"
+
+PreloadManager *PreloadManager::instance;
+std::mutex PreloadManager::mutex;
+
+PreloadManager::PreloadManager() {
+    budget = PRELOAD_MEMORY_BUDGET;
+    reserved = 0;
+    preloadCount = 0;
+}
+
+PreloadManager::~PreloadManager() {
+}
+
+PreloadManager *PreloadManager::getInstance() {
+    if (!instance) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!instance) {
+            instance = new(std::nothrow) PreloadManager();
+        }
+    }
+    return instance;
+}
+
+void PreloadManager::setBudget(int64_t budget) {
+    Mutex::Autolock lock(mMutex);
+    this->budget = budget > 0 ? budget : 0;
+}
+
+bool PreloadManager::reserve(int64_t bytes) {
+    Mutex::Autolock lock(mMutex);
+    if (bytes <= 0 || reserved + bytes > budget) {
+        return false;
+    }
+    reserved += bytes;
+    preloadCount++;
+    return true;
+}
+
+void PreloadManager::release(int64_t bytes) {
+    Mutex::Autolock lock(mMutex);
+    reserved = reserved > bytes ? reserved - bytes : 0;
+    if (preloadCount > 0) {
+        preloadCount--;
+    }
+}
+
+int PreloadManager::getPreloadCount() {
+    Mutex::Autolock lock(mMutex);
+    return preloadCount;
+}
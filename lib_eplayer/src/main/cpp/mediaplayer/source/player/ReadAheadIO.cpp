@@ -0,0 +1,332 @@
+
+#include "ReadAheadIO.h"
+
+ReadAheadIO::ReadAheadIO() {
+    ioThread = NULL;
+    abortRequest = false;
+    source = NULL;
+    ownSource = false;
+    context = NULL;
+    userInterrupt.callback = NULL;
+    userInterrupt.opaque = NULL;
+    ringBuffer = NULL;
+    capacity = 0;
+    bufferStart = 0;
+    readPos = 0;
+    writePos = 0;
+    fileSize = -1;
+    needSeek = false;
+    seekSerial = 0;
+    eof = false;
+    error = 0;
+    messageQueue = NULL;
+    notifiedPercent = -1;
+}
+
+ReadAheadIO::~ReadAheadIO() {
+    stop();
+    if (context) {
+        av_freep(&context->buffer);
+        avio_context_free(&context);
+    }
+    if (source && ownSource) {
+        avio_closep(&source);
+    }
+    av_freep(&ringBuffer);
+}
+
+/**
+ * rtsp等协议由解复用器自己建立连接，不能替换成自定义的AVIOContext
+ * HLS的解复用器自己下载分片，替换以后分片请求拿不到headers等协议参数
+ * @param url
+ * @return
+ */
+bool ReadAheadIO::isSupported(const char *url) {
+    const char *protocol = avio_find_protocol_name(url);
+    if (!protocol || av_match_ext(url, "m3u8")) {
+        return false;
+    }
+    return !strcmp(protocol, "file") || !strcmp(protocol, "http") || !strcmp(protocol, "https");
+}
+
+/**
+ * 打开底层的AVIOContext，创建交给解复用器的AVIOContext并开启I/O线程
+ * @param url
+ * @param bufferSize 环形缓冲大小
+ * @param interruptCallback 播放器的中断回调，退出时中断底层的读取
+ * @param options 协议参数
+ * @param messageQueue 用于通知缓冲区填充情况，可以为NULL
+ * @return
+ */
+int ReadAheadIO::open(const char *url, int bufferSize, const AVIOInterruptCB *interruptCallback,
+                      AVDictionary **options, AVMessageQueue *messageQueue) {
+    int ret;
+
+    if (interruptCallback) {
+        userInterrupt = *interruptCallback;
+    }
+    AVIOInterruptCB cb = {ReadAheadIO::interruptCallback, this};
+    if ((ret = avio_open2(&source, url, AVIO_FLAG_READ, &cb, options)) < 0) {
+        return ret;
+    }
+    ownSource = true;
+    return start(bufferSize, messageQueue);
+}
+
+/**
+ * 在调用者打开的AVIOContext(比如http磁盘缓存)之上预读，source由调用者在停止预读以后释放
+ * @param source
+ * @param bufferSize 环形缓冲大小
+ * @param interruptCallback 播放器的中断回调
+ * @param messageQueue 用于通知缓冲区填充情况，可以为NULL
+ * @return
+ */
+int ReadAheadIO::open(AVIOContext *source, int bufferSize, const AVIOInterruptCB *interruptCallback,
+                      AVMessageQueue *messageQueue) {
+    if (interruptCallback) {
+        userInterrupt = *interruptCallback;
+    }
+    this->source = source;
+    ownSource = false;
+    return start(bufferSize, messageQueue);
+}
+
+/**
+ * 分配环形缓冲，创建交给解复用器的AVIOContext并开启I/O线程
+ * @param bufferSize
+ * @param messageQueue
+ * @return
+ */
+int ReadAheadIO::start(int bufferSize, AVMessageQueue *messageQueue) {
+    uint8_t *ioBuffer;
+
+    fileSize = avio_size(source);
+
+    capacity = bufferSize;
+    ringBuffer = (uint8_t *) av_malloc(capacity);
+    ioBuffer = (uint8_t *) av_malloc(READ_AHEAD_IO_BUFFER_SIZE);
+    if (!ringBuffer || !ioBuffer) {
+        av_free(ioBuffer);
+        return AVERROR(ENOMEM);
+    }
+    context = avio_alloc_context(ioBuffer, READ_AHEAD_IO_BUFFER_SIZE, 0, this, readPacket, NULL, seekPacket);
+    if (!context) {
+        av_free(ioBuffer);
+        return AVERROR(ENOMEM);
+    }
+    context->seekable = source->seekable;
+    this->messageQueue = messageQueue;
+
+    ioThread = new Thread(this);
+    ioThread->start();
+    return 0;
+}
+
+AVIOContext *ReadAheadIO::getContext() {
+    return context;
+}
+
+void ReadAheadIO::stop() {
+    mMutex.lock();
+    abortRequest = true;
+    mCondition.broadcast();
+    mMutex.unlock();
+    if (ioThread) {
+        ioThread->join();
+        delete ioThread;
+        ioThread = NULL;
+    }
+}
+
+int64_t ReadAheadIO::getBufferedBytes() {
+    Mutex::Autolock lock(mMutex);
+    return writePos - readPos;
+}
+
+int ReadAheadIO::getFillPercent() {
+    Mutex::Autolock lock(mMutex);
+    return capacity > 0 ? (int) ((writePos - readPos) * 100 / capacity) : 0;
+}
+
+int ReadAheadIO::readPacket(void *opaque, uint8_t *buf, int size) {
+    return ((ReadAheadIO *) opaque)->read(buf, size);
+}
+
+int64_t ReadAheadIO::seekPacket(void *opaque, int64_t offset, int whence) {
+    return ((ReadAheadIO *) opaque)->seek(offset, whence);
+}
+
+int ReadAheadIO::interruptCallback(void *opaque) {
+    return ((ReadAheadIO *) opaque)->isInterrupted() ? 1 : 0;
+}
+
+bool ReadAheadIO::isInterrupted() {
+    if (abortRequest) {
+        return true;
+    }
+    return userInterrupt.callback && userInterrupt.callback(userInterrupt.opaque);
+}
+
+/**
+ * 解复用器读取数据，缓冲区为空时等待I/O线程，只有底层出错或者读到文件末尾时才返回错误
+ * @param buf
+ * @param size
+ * @return
+ */
+int ReadAheadIO::read(uint8_t *buf, int size) {
+    Mutex::Autolock lock(mMutex);
+    while (writePos == readPos) {
+        if (error < 0) {
+            return error;
+        }
+        if (eof) {
+            return AVERROR_EOF;
+        }
+        if (isInterrupted()) {
+            return AVERROR_EXIT;
+        }
+        mCondition.waitRelative(mMutex, READ_AHEAD_WAIT_TIMEOUT);
+    }
+
+    int total = (int) FFMIN(size, writePos - readPos);
+    int copied = 0;
+    // 数据可能跨过环形缓冲的末尾，分两段拷贝
+    while (copied < total) {
+        int offset = (int) (readPos % capacity);
+        int len = FFMIN(total - copied, capacity - offset);
+        memcpy(buf + copied, ringBuffer + offset, len);
+        copied += len;
+        readPos += len;
+    }
+    mCondition.broadcast();
+    return copied;
+}
+
+/**
+ * 定位，缓冲区内的定位只移动读位置，缓冲区外的定位清空缓冲，由I/O线程定位底层
+ * @param offset
+ * @param whence
+ * @return
+ */
+int64_t ReadAheadIO::seek(int64_t offset, int whence) {
+    Mutex::Autolock lock(mMutex);
+    int64_t target;
+
+    if (whence & AVSEEK_SIZE) {
+        return fileSize >= 0 ? fileSize : AVERROR(ENOSYS);
+    }
+    switch (whence & ~AVSEEK_FORCE) {
+        case SEEK_SET: {
+            target = offset;
+            break;
+        }
+        case SEEK_CUR: {
+            target = readPos + offset;
+            break;
+        }
+        case SEEK_END: {
+            if (fileSize < 0) {
+                return AVERROR(ENOSYS);
+            }
+            target = fileSize + offset;
+            break;
+        }
+        default: {
+            return AVERROR(EINVAL);
+        }
+    }
+    if (target < 0) {
+        return AVERROR(EINVAL);
+    }
+
+    if (target >= bufferStart && target <= writePos) {
+        readPos = target;
+    } else {
+        if (!source->seekable) {
+            return AVERROR(ENOSYS);
+        }
+        bufferStart = readPos = writePos = target;
+        eof = false;
+        error = 0;
+        needSeek = true;
+        seekSerial++;
+    }
+    mCondition.broadcast();
+    return target;
+}
+
+/**
+ * 缓冲区填充百分比变化较大或者填满、读空时通知
+ */
+void ReadAheadIO::notifyFillLevel() {
+    int percent = (int) ((writePos - readPos) * 100 / capacity);
+    if (abs(percent - notifiedPercent) < READ_AHEAD_NOTIFY_STEP && percent != 100 && percent != 0) {
+        return;
+    }
+    if (percent == notifiedPercent) {
+        return;
+    }
+    notifiedPercent = percent;
+    if (messageQueue) {
+        messageQueue->postMessage(MSG_READ_AHEAD_UPDATE, (int) ((writePos - readPos) / 1024), percent);
+    }
+}
+
+/**
+ * I/O线程，保持写位置领先读位置，读位置之前保留一部分数据用于向后定位
+ * 读取底层时不持有锁，期间有缓冲区外的定位时丢弃读到的数据
+ */
+void ReadAheadIO::run() {
+    int backCapacity = capacity / READ_AHEAD_BACK_RATIO;
+
+    mMutex.lock();
+    while (!abortRequest) {
+        if (needSeek) {
+            needSeek = false;
+            int serial = seekSerial;
+            int64_t target = writePos;
+            mMutex.unlock();
+            int64_t ret = avio_seek(source, target, SEEK_SET);
+            mMutex.lock();
+            if (serial == seekSerial && ret < 0) {
+                error = (int) ret;
+                mCondition.broadcast();
+            }
+            continue;
+        }
+
+        int64_t ahead = writePos - readPos;
+        if (eof || error < 0 || ahead >= capacity - backCapacity) {
+            mCondition.wait(mMutex);
+            continue;
+        }
+
+        // 一次只写到环形缓冲的末尾，写入区域原有的数据不能再用于定位
+        int offset = (int) (writePos % capacity);
+        int len = (int) FFMIN(READ_AHEAD_CHUNK_SIZE, capacity - backCapacity - ahead);
+        len = FFMIN(len, capacity - offset);
+        bufferStart = FFMAX(bufferStart, writePos + len - capacity);
+        int serial = seekSerial;
+        mMutex.unlock();
+
+        int ret = avio_read(source, ringBuffer + offset, len);
+
+        mMutex.lock();
+        if (serial != seekSerial) {
+            continue;
+        }
+        if (ret == AVERROR_EOF || ret == 0) {
+            eof = true;
+        } else if (ret < 0) {
+            if (!abortRequest) {
+                av_log(NULL, AV_LOG_WARNING, "read ahead: read error %d\n", ret);
+            }
+            error = ret;
+        } else {
+            writePos += ret;
+        }
+        notifyFillLevel();
+        mCondition.broadcast();
+    }
+    mMutex.unlock();
+}
@@ -0,0 +1,377 @@
+
+#include <inttypes.h>
+#include <AndroidLog.h>
+#include "StreamInfoCache.h"
+#include "CacheFile.h"
+
+extern "C" {
+#include "libavutil/avstring.h"
+};
+
+// 缓存文件中允许的最大媒体流数量和附加数据大小，防止读取损坏的文件时分配过多内存
+#define STREAM_INFO_MAX_STREAMS 64
+#define STREAM_INFO_MAX_EXTRADATA (1 << 20)
+
+static const char STREAM_INFO_CACHE_MAGIC[4] = {'E', 'S', 'I', 'C'};
+
+static void writeRational(FILE *file, AVRational q) {
+    writeSignedVarint(file, q.num);
+    writeSignedVarint(file, q.den);
+}
+
+static int readInt(FILE *file, int *value) {
+    int64_t v;
+    if (readSignedVarint(file, &v) < 0) {
+        return -1;
+    }
+    *value = (int) v;
+    return 0;
+}
+
+static int readRational(FILE *file, AVRational *q) {
+    if (readInt(file, &q->num) < 0 || readInt(file, &q->den) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 缓存中的一路媒体流
+ */
+typedef struct CachedStream {
+    int id;
+    AVRational timeBase;
+    AVRational rFrameRate;
+    AVRational avgFrameRate;
+    int64_t startTime;
+    int64_t duration;
+    AVCodecParameters *par;
+} CachedStream;
+
+/**
+ * 打开文件时参数还不完整的媒体流，需要avformat_find_stream_info探测
+ * 直接填回缓存的参数只改变codecpar，解复用器内部的解码上下文不会跟着更新，这种情况不使用缓存
+ * @param par 打开文件时创建的媒体流参数
+ * @param cached 缓存的媒体流参数
+ * @return
+ */
+static bool needsProbe(const AVCodecParameters *par, const AVCodecParameters *cached) {
+    if (cached->extradata_size > 0 && par->extradata_size <= 0) {
+        return true;
+    }
+    if (par->codec_type == AVMEDIA_TYPE_VIDEO) {
+        return !par->width || !par->height;
+    }
+    if (par->codec_type == AVMEDIA_TYPE_AUDIO) {
+        return !par->sample_rate || !par->channels;
+    }
+    return false;
+}
+
+static void writeCodecParameters(FILE *file, const AVCodecParameters *par) {
+    writeSignedVarint(file, par->codec_type);
+    writeVarint(file, (uint64_t) par->codec_id);
+    writeVarint(file, par->codec_tag);
+    writeSignedVarint(file, par->format);
+    writeSignedVarint(file, par->bit_rate);
+    writeSignedVarint(file, par->bits_per_coded_sample);
+    writeSignedVarint(file, par->bits_per_raw_sample);
+    writeSignedVarint(file, par->profile);
+    writeSignedVarint(file, par->level);
+    writeSignedVarint(file, par->width);
+    writeSignedVarint(file, par->height);
+    writeRational(file, par->sample_aspect_ratio);
+    writeSignedVarint(file, par->field_order);
+    writeSignedVarint(file, par->color_range);
+    writeSignedVarint(file, par->color_primaries);
+    writeSignedVarint(file, par->color_trc);
+    writeSignedVarint(file, par->color_space);
+    writeSignedVarint(file, par->chroma_location);
+    writeSignedVarint(file, par->video_delay);
+    writeVarint(file, par->channel_layout);
+    writeSignedVarint(file, par->channels);
+    writeSignedVarint(file, par->sample_rate);
+    writeSignedVarint(file, par->block_align);
+    writeSignedVarint(file, par->frame_size);
+    writeSignedVarint(file, par->initial_padding);
+    writeSignedVarint(file, par->trailing_padding);
+    writeSignedVarint(file, par->seek_preroll);
+    writeVarint(file, (uint64_t) FFMAX(par->extradata_size, 0));
+    if (par->extradata_size > 0) {
+        fwrite(par->extradata, 1, (size_t) par->extradata_size, file);
+    }
+}
+
+static int readCodecParameters(FILE *file, AVCodecParameters *par) {
+    int64_t v;
+    uint64_t u;
+    int value;
+    if (readInt(file, &value) < 0) {
+        return -1;
+    }
+    par->codec_type = (enum AVMediaType) value;
+    if (readVarint(file, &u) < 0) {
+        return -1;
+    }
+    par->codec_id = (enum AVCodecID) u;
+    if (readVarint(file, &u) < 0) {
+        return -1;
+    }
+    par->codec_tag = (uint32_t) u;
+    if (readInt(file, &par->format) < 0 || readSignedVarint(file, &v) < 0) {
+        return -1;
+    }
+    par->bit_rate = v;
+    if (readInt(file, &par->bits_per_coded_sample) < 0 || readInt(file, &par->bits_per_raw_sample) < 0
+        || readInt(file, &par->profile) < 0 || readInt(file, &par->level) < 0
+        || readInt(file, &par->width) < 0 || readInt(file, &par->height) < 0
+        || readRational(file, &par->sample_aspect_ratio) < 0) {
+        return -1;
+    }
+    if (readInt(file, &value) < 0) {
+        return -1;
+    }
+    par->field_order = (enum AVFieldOrder) value;
+    if (readInt(file, &value) < 0) {
+        return -1;
+    }
+    par->color_range = (enum AVColorRange) value;
+    if (readInt(file, &value) < 0) {
+        return -1;
+    }
+    par->color_primaries = (enum AVColorPrimaries) value;
+    if (readInt(file, &value) < 0) {
+        return -1;
+    }
+    par->color_trc = (enum AVColorTransferCharacteristic) value;
+    if (readInt(file, &value) < 0) {
+        return -1;
+    }
+    par->color_space = (enum AVColorSpace) value;
+    if (readInt(file, &value) < 0) {
+        return -1;
+    }
+    par->chroma_location = (enum AVChromaLocation) value;
+    if (readInt(file, &par->video_delay) < 0 || readVarint(file, &par->channel_layout) < 0
+        || readInt(file, &par->channels) < 0 || readInt(file, &par->sample_rate) < 0
+        || readInt(file, &par->block_align) < 0 || readInt(file, &par->frame_size) < 0
+        || readInt(file, &par->initial_padding) < 0 || readInt(file, &par->trailing_padding) < 0
+        || readInt(file, &par->seek_preroll) < 0) {
+        return -1;
+    }
+    if (readVarint(file, &u) < 0 || u > STREAM_INFO_MAX_EXTRADATA) {
+        return -1;
+    }
+    if (u > 0) {
+        par->extradata = (uint8_t *) av_mallocz((size_t) u + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (!par->extradata) {
+            return -1;
+        }
+        par->extradata_size = (int) u;
+        if (fread(par->extradata, 1, (size_t) u, file) != u) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+StreamInfoCache::StreamInfoCache() {
+    cachePath = NULL;
+    fileKey = 0;
+}
+
+StreamInfoCache::~StreamInfoCache() {
+    av_freep(&cachePath);
+}
+
+/**
+ * 文件标识的计算方式跟关键帧索引一致
+ * @param pFormatCtx
+ * @param url
+ * @param cacheDir
+ * @return
+ */
+int StreamInfoCache::open(AVFormatContext *pFormatCtx, const char *url, const char *cacheDir) {
+    if (!cacheDir || !url) {
+        return -1;
+    }
+    // 边读边创建媒体流的格式，打开以后还拿不到所有的媒体流
+    if (pFormatCtx->ctx_flags & AVFMTCTX_NOHEADER) {
+        return -1;
+    }
+    if (pFormatCtx->nb_streams == 0 || pFormatCtx->nb_streams > STREAM_INFO_MAX_STREAMS) {
+        return -1;
+    }
+    fileKey = computeFileKey(url, pFormatCtx->pb ? avio_size(pFormatCtx->pb) : -1, pFormatCtx->duration);
+    av_freep(&cachePath);
+    cachePath = av_asprintf("%s/%016" PRIx64 "%s", cacheDir, fileKey, STREAM_INFO_CACHE_SUFFIX);
+    return cachePath ? 0 : -1;
+}
+
+/**
+ * 缓存中的媒体流必须跟打开文件时创建的媒体流一一对应，否则不使用缓存
+ * 有媒体流在文件头中缺少附加数据、宽高或者采样率时也不使用缓存，仍然需要探测
+ * @param pFormatCtx
+ * @return
+ */
+int StreamInfoCache::apply(AVFormatContext *pFormatCtx) {
+    if (!cachePath) {
+        return -1;
+    }
+    FILE *file = fopen(cachePath, "rb");
+    if (!file) {
+        return -1;
+    }
+    char magic[4];
+    uint64_t key, number;
+    int64_t startTime = AV_NOPTS_VALUE, duration = AV_NOPTS_VALUE, bitRate = 0;
+    CachedStream *streams = NULL;
+    int count = 0;
+    int ret = -1;
+    do {
+        if (fread(magic, 1, sizeof(magic), file) != sizeof(magic)
+            || memcmp(magic, STREAM_INFO_CACHE_MAGIC, sizeof(magic))) {
+            break;
+        }
+        if (fgetc(file) != STREAM_INFO_CACHE_VERSION) {
+            break;
+        }
+        if (readVarint(file, &key) < 0 || key != fileKey) {
+            break;
+        }
+        if (readSignedVarint(file, &startTime) < 0 || readSignedVarint(file, &duration) < 0
+            || readSignedVarint(file, &bitRate) < 0) {
+            break;
+        }
+        if (readVarint(file, &number) < 0 || number != pFormatCtx->nb_streams) {
+            break;
+        }
+        streams = (CachedStream *) av_mallocz_array((size_t) number, sizeof(CachedStream));
+        if (!streams) {
+            break;
+        }
+        bool valid = true;
+        for (int i = 0; i < (int) number; i++) {
+            CachedStream *cached = &streams[i];
+            cached->par = avcodec_parameters_alloc();
+            if (!cached->par) {
+                valid = false;
+                break;
+            }
+            count++;
+            if (readInt(file, &cached->id) < 0 || readRational(file, &cached->timeBase) < 0
+                || readRational(file, &cached->rFrameRate) < 0 || readRational(file, &cached->avgFrameRate) < 0
+                || readSignedVarint(file, &cached->startTime) < 0 || readSignedVarint(file, &cached->duration) < 0
+                || readCodecParameters(file, cached->par) < 0) {
+                valid = false;
+                break;
+            }
+            // 跟打开文件时创建的媒体流对比，不一致说明文件已经变化
+            AVStream *st = pFormatCtx->streams[i];
+            valid = st->id == cached->id && st->codecpar->codec_type == cached->par->codec_type
+                    && st->codecpar->codec_id == cached->par->codec_id
+                    && av_cmp_q(st->time_base, cached->timeBase) == 0
+                    && !needsProbe(st->codecpar, cached->par);
+            if (!valid) {
+                break;
+            }
+        }
+        if (!valid) {
+            break;
+        }
+        ret = 0;
+    } while (false);
+    fclose(file);
+
+    if (ret == 0) {
+        for (int i = 0; i < count; i++) {
+            AVStream *st = pFormatCtx->streams[i];
+            CachedStream *cached = &streams[i];
+            // 文件头中已经有附加数据时以文件头为准，把它移到缓存的参数中再整体复制
+            if (st->codecpar->extradata_size > 0) {
+                av_freep(&cached->par->extradata);
+                cached->par->extradata = st->codecpar->extradata;
+                cached->par->extradata_size = st->codecpar->extradata_size;
+                st->codecpar->extradata = NULL;
+                st->codecpar->extradata_size = 0;
+            }
+            avcodec_parameters_copy(st->codecpar, cached->par);
+            if (!st->r_frame_rate.num) {
+                st->r_frame_rate = cached->rFrameRate;
+            }
+            if (!st->avg_frame_rate.num) {
+                st->avg_frame_rate = cached->avgFrameRate;
+            }
+            if (st->start_time == AV_NOPTS_VALUE) {
+                st->start_time = cached->startTime;
+            }
+            if (st->duration == AV_NOPTS_VALUE) {
+                st->duration = cached->duration;
+            }
+        }
+        if (pFormatCtx->start_time == AV_NOPTS_VALUE) {
+            pFormatCtx->start_time = startTime;
+        }
+        if (pFormatCtx->duration == AV_NOPTS_VALUE) {
+            pFormatCtx->duration = duration;
+        }
+        if (!pFormatCtx->bit_rate) {
+            pFormatCtx->bit_rate = bitRate;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        avcodec_parameters_free(&streams[i].par);
+    }
+    av_free(streams);
+    return ret;
+}
+
+/**
+ * 保存媒体流参数，先写入临时文件再重命名
+ * @param pFormatCtx
+ * @return
+ */
+int StreamInfoCache::save(AVFormatContext *pFormatCtx) {
+    if (!cachePath) {
+        return 0;
+    }
+    // 探测不完整的参数不保存，下次打开时还需要重新探测
+    for (int i = 0; i < pFormatCtx->nb_streams; i++) {
+        AVCodecParameters *par = pFormatCtx->streams[i]->codecpar;
+        if (par->codec_id == AV_CODEC_ID_NONE
+            || (par->codec_type == AVMEDIA_TYPE_VIDEO && (!par->width || !par->height || par->format < 0))
+            || (par->codec_type == AVMEDIA_TYPE_AUDIO && (!par->sample_rate || !par->channels || par->format < 0))) {
+            return -1;
+        }
+    }
+    char *tmpPath = av_asprintf("%s.tmp", cachePath);
+    if (!tmpPath) {
+        return AVERROR(ENOMEM);
+    }
+    FILE *file = fopen(tmpPath, "wb");
+    if (!file) {
+        av_free(tmpPath);
+        return -1;
+    }
+    fwrite(STREAM_INFO_CACHE_MAGIC, 1, sizeof(STREAM_INFO_CACHE_MAGIC), file);
+    fputc(STREAM_INFO_CACHE_VERSION, file);
+    writeVarint(file, fileKey);
+    writeSignedVarint(file, pFormatCtx->start_time);
+    writeSignedVarint(file, pFormatCtx->duration);
+    writeSignedVarint(file, pFormatCtx->bit_rate);
+    writeVarint(file, pFormatCtx->nb_streams);
+    for (int i = 0; i < pFormatCtx->nb_streams; i++) {
+        AVStream *st = pFormatCtx->streams[i];
+        writeSignedVarint(file, st->id);
+        writeRational(file, st->time_base);
+        writeRational(file, st->r_frame_rate);
+        writeRational(file, st->avg_frame_rate);
+        writeSignedVarint(file, st->start_time);
+        writeSignedVarint(file, st->duration);
+        writeCodecParameters(file, st->codecpar);
+    }
+    int ret = commitCacheFile(file, tmpPath, cachePath);
+    av_free(tmpPath);
+    return ret;
+}
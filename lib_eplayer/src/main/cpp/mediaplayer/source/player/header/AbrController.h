@@ -0,0 +1,112 @@
+
+#ifndef EPLAYER_ABRCONTROLLER_H
+#define EPLAYER_ABRCONTROLLER_H
+
+#include "PlayerState.h"
+
+extern "C" {
+#include "libavformat/avformat.h"
+};
+
+// 吞吐量采样的最小时长，单位微秒
+#define ABR_SAMPLE_DURATION (100 * 1000)
+// 快速和慢速两个吞吐量估计的半衰期，单位秒，取两者中较小的一个
+#define ABR_FAST_HALF_LIFE 2.0
+#define ABR_SLOW_HALF_LIFE 10.0
+// 至少下载这么多数据以后才开始切换码流
+#define ABR_MIN_TOTAL_BYTES (256 * 1024)
+// 选择码流时只使用吞吐量的一部分，缓冲快要耗尽时更保守
+#define ABR_SAFETY_FACTOR 0.8
+#define ABR_PANIC_FACTOR 0.5
+// 数据包队列相对高水位的填充程度，低于PANIC时立即降低码率，高于UP时才允许提高码率
+#define ABR_PANIC_LEVEL 0.25
+#define ABR_UP_LEVEL 0.75
+// 两次提高码率之间的最小间隔，单位微秒
+#define ABR_SWITCH_INTERVAL (8 * 1000 * 1000)
+// 新码流一直没有送来切换点时放弃切换，单位微秒
+#define ABR_SWITCH_TIMEOUT (15 * 1000 * 1000)
+
+/**
+ * HLS主播放列表中的一路码流，对应解复用器中的一个AVProgram
+ */
+typedef struct AbrVariant {
+    int64_t bitrate;        // 码率，单位bps
+    int videoIndex;         // 视频流索引，没有视频时为-1
+    int audioIndex;         // 音频流索引，没有音频时为-1
+} AbrVariant;
+
+/**
+ * HLS自适应码率控制器，根据读数据包的吞吐量和数据包队列的填充程度选择码流
+ * 切换时先打开新码流，等新码流送来切换点(视频关键帧)以后再丢弃旧码流，新码流的数据包映射到解码器原来的媒体流上，解码器不需要清空
+ * 只在读数据包线程中使用
+ */
+class AbrController {
+public:
+    AbrController(PlayerState *playerState);
+
+    virtual ~AbrController();
+
+    // 绑定解码器使用的媒体流，不是多码流的HLS或者没有可以切换的码流时返回-1
+    int open(AVFormatContext *pFormatCtx, int videoIndex, int audioIndex);
+
+    // 记录一次读数据包的数据量和耗时，耗时单位微秒
+    void addSample(int bytes, int64_t elapsed);
+
+    // 根据吞吐量和队列填充程度决定是否切换码流
+    void update(double queueLevel);
+
+    // 处理读到的数据包，返回false时丢弃，返回true时数据包可能已经映射到解码器的媒体流上
+    bool mapPacket(AVPacket *pkt);
+
+    // 定位以后时间戳不连续，正在切换时直接完成切换
+    void flush();
+
+    // 当前的吞吐量估计，单位bps
+    int64_t getBandwidth();
+
+protected:
+    // 切换间隔和超时使用的时钟，单位微秒
+    virtual int64_t getCurrentTime();
+
+private:
+    int selectVariant(double queueLevel);
+
+    void startSwitch(int variant);
+
+    void commitSwitch();
+
+    void setDiscard(int variant, enum AVDiscard discard);
+
+    bool isStreamOf(int variant, int streamIndex);
+
+    bool isVariantStream(int streamIndex);
+
+    void remap(AVPacket *pkt, int decoderIndex);
+
+    int64_t getTimestamp(AVPacket *pkt);
+
+private:
+    PlayerState *playerState;
+    AVFormatContext *pFormatCtx;
+
+    AbrVariant *variants;                   // 按码率从低到高排序
+    int variantCount;
+    int current;                            // 当前码流
+    int pending;                            // 正在切换的目标码流，没有时为-1
+    int64_t pendingStartTime;               // 开始切换的时间
+    int64_t lastSwitchTime;                 // 上一次完成切换的时间
+    int decoderVideoIndex;                  // 视频解码器使用的媒体流
+    int decoderAudioIndex;                  // 音频解码器使用的媒体流
+
+    double fastEstimate;                    // 快速吞吐量估计，单位bps
+    double slowEstimate;                    // 慢速吞吐量估计，单位bps
+    int64_t sampleBytes;                    // 当前采样的数据量
+    int64_t sampleTime;                     // 当前采样的耗时
+    int64_t totalBytes;                     // 累计数据量
+
+    int64_t lastVideoTs;                    // 上一个送给解码器的视频时间戳，单位AV_TIME_BASE
+    int64_t lastAudioTs;                    // 上一个送给解码器的音频时间戳，单位AV_TIME_BASE
+    int64_t audioResumeTs;                  // 切换以后新码流的音频要超过这个时间戳才送给解码器
+};
+
+#endif //EPLAYER_ABRCONTROLLER_H
@@ -0,0 +1,28 @@
+
+#ifndef EPLAYER_CACHEFILE_H
+#define EPLAYER_CACHEFILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ * 本地缓存文件(关键帧索引、媒体流信息等)的公共工具
+ */
+
+// 计算文件标识，由路径、文件大小和修改时间组成，拿不到修改时间(网络文件)时用fallback代替
+uint64_t computeFileKey(const char *url, int64_t size, int64_t fallback);
+
+// 写入变长整数，数值越小占用的字节越少
+void writeVarint(FILE *file, uint64_t value);
+
+int readVarint(FILE *file, uint64_t *value);
+
+// 有符号整数使用zigzag编码
+void writeSignedVarint(FILE *file, int64_t value);
+
+int readSignedVarint(FILE *file, int64_t *value);
+
+// 关闭临时文件并重命名为目标文件，失败时删除临时文件，防止写到一半时留下损坏的文件
+int commitCacheFile(FILE *file, const char *tmpPath, const char *path);
+
+#endif //EPLAYER_CACHEFILE_H
@@ -0,0 +1,107 @@
+
+#ifndef EPLAYER_HTTPCACHE_H
+#define EPLAYER_HTTPCACHE_H
+
+extern "C" {
+#include "libavformat/avformat.h"
+};
+
+// 缓存数据文件和分块表文件的扩展名
+#define HTTP_CACHE_DATA_SUFFIX ".hcd"
+#define HTTP_CACHE_MAP_SUFFIX ".hcm"
+// 分块表文件版本号，格式变化时需要增加
+#define HTTP_CACHE_VERSION 1
+// 缓存分块大小，一个分块完整下载以后才标记为已缓存
+#define HTTP_CACHE_BLOCK_SIZE (256 * 1024)
+// 每新缓存这么多分块保存一次分块表，异常退出时不会丢失全部记录
+#define HTTP_CACHE_SAVE_BLOCKS 32
+// AVIOContext的缓冲大小
+#define HTTP_CACHE_IO_BUFFER_SIZE (32 * 1024)
+
+/**
+ * http点播的磁盘缓存，按字节范围缓存已经下载过的数据，重播和向后定位时不再重复下载
+ * 数据保存在和文件一样大的稀疏文件中，另外用分块表记录哪些分块已经完整缓存
+ * 缓存目录超过大小上限时按最近使用时间淘汰其他文件的缓存，打开的缓存数据文件持有共享锁，不会被淘汰
+ * 只在预读I/O线程中使用，不需要加锁，多个播放器同时缓存同一个文件时保存分块表会合并各自的记录
+ * 打开缓存、保存分块表和淘汰缓存时对缓存目录加排它锁，多个播放器之间不会互相破坏
+ */
+class HttpCache {
+public:
+    HttpCache();
+
+    virtual ~HttpCache();
+
+    static bool isSupported(const char *url);
+
+    // 连接服务器并打开缓存文件，服务器不支持按范围请求或者拿不到文件大小时返回负数
+    int open(const char *url, const char *cacheDir, int64_t maxCacheSize,
+             const AVIOInterruptCB *interruptCallback, AVDictionary **options);
+
+    // 交给上层使用的AVIOContext
+    AVIOContext *getContext();
+
+    // 关闭缓存并保存分块表
+    void close();
+
+private:
+    static int readPacket(void *opaque, uint8_t *buf, int size);
+
+    static int64_t seekPacket(void *opaque, int64_t offset, int whence);
+
+    int read(uint8_t *buf, int size);
+
+    int64_t seek(int64_t offset, int whence);
+
+    // 打开缓存数据文件并加共享锁
+    int openDataFile();
+
+    // 连接服务器，全部缓存以后断开的连接在需要时重新建立
+    int connect();
+
+    bool isCached(int64_t block);
+
+    void setCached(int64_t block);
+
+    // 没有可用的分块表时重新创建缓存数据文件，其他播放器正在使用时只扩展不清空
+    int resetDataFile();
+
+    int lockCacheDir();
+
+    void unlockCacheDir(int fd);
+
+    int loadMap(uint8_t *map);
+
+    int saveMap();
+
+    // 合并并写入分块表，需要持有目录锁
+    int writeMap();
+
+    // 淘汰最久没有使用的缓存，直到总大小不超过上限
+    void evict();
+
+private:
+    char *url;
+    char *cacheDir;
+    int64_t maxCacheSize;                   // 缓存目录大小上限
+    uint64_t fileKey;                       // 文件标识
+    char *dataPath;                         // 缓存数据文件路径
+    char *mapPath;                          // 分块表文件路径
+
+    AVIOContext *network;                   // 网络连接
+    AVDictionary *networkOptions;           // 重新连接时使用的协议参数
+    AVIOInterruptCB interruptCallback;
+    int64_t networkPos;                     // 网络连接的读位置
+    int64_t fillStart;                      // 网络连接连续下载的起始位置，用于判断分块是否下载完整
+
+    int dataFd;                             // 缓存数据文件
+    bool writeError;                        // 写入缓存失败以后不再写入
+    int64_t fileSize;
+    int64_t position;                       // 当前读位置
+    uint8_t *blockMap;                      // 分块表，每一位表示一个分块
+    int64_t blockCount;
+    int unsavedBlocks;                      // 上次保存以后新缓存的分块数量
+
+    AVIOContext *context;
+};
+
+#endif //EPLAYER_HTTPCACHE_H
@@ -0,0 +1,104 @@
+
+#ifndef EPLAYER_KEYFRAMEINDEX_H
+#define EPLAYER_KEYFRAMEINDEX_H
+
+#include "Mutex.h"
+#include "Thread.h"
+
+extern "C" {
+#include "libavformat/avformat.h"
+};
+
+// 索引文件的扩展名
+#define KEYFRAME_INDEX_SUFFIX ".kfi"
+// 索引文件版本号，格式变化时需要增加
+#define KEYFRAME_INDEX_VERSION 1
+
+/**
+ * 关键帧索引条目
+ */
+typedef struct KeyframeEntry {
+    int64_t pts;            // 关键帧时间戳，单位AV_TIME_BASE
+    int64_t pos;            // 关键帧数据包在文件中的字节偏移
+    int gopLength;          // 到下一个关键帧之间的数据包数量，0表示还不知道下一个关键帧
+} KeyframeEntry;
+
+/**
+ * 连续读取数据包时的关键帧序列，只有连续读到的两个关键帧之间才能确定没有其他关键帧
+ */
+typedef struct KeyframeRun {
+    int64_t pts;            // 上一个关键帧的时间戳，AV_NOPTS_VALUE表示序列已经中断
+    int packets;            // 上一个关键帧以后读到的数据包数量
+} KeyframeRun;
+
+/**
+ * 视频流的关键帧索引，记录关键帧时间戳到字节偏移的映射
+ * 播放时边读边建立索引，也可以在后台线程中扫描整个文件，索引保存在以文件标识命名的索引文件中
+ * 只用于支持按字节定位的封装格式(mpegts/mpeg-ps/flv等)，mp4等格式的解复用器自带完整的索引
+ */
+class KeyframeIndex : public Runnable {
+public:
+    KeyframeIndex();
+
+    virtual ~KeyframeIndex();
+
+    // 绑定媒体流，计算文件标识并加载已有的索引文件，不支持按字节定位时返回-1
+    int open(AVFormatContext *pFormatCtx, int streamIndex, const char *url, const char *indexDir);
+
+    // 读数据包线程读取到数据包时调用
+    void addPacket(AVPacket *pkt);
+
+    // 定位以后连续读取中断
+    void discontinue();
+
+    // 查找目标位置之前最近的关键帧，只有确定目标和关键帧之间没有其他关键帧时才返回true
+    bool lookup(int64_t target, KeyframeEntry *entry);
+
+    // 开启后台扫描
+    void startScan();
+
+    // 停止后台扫描
+    void stopScan();
+
+    // 保存索引文件
+    int save();
+
+    int getKeyframeCount();
+
+    bool isComplete();
+
+    void run() override;
+
+private:
+    void addKeyframe(KeyframeRun *keyframeRun, AVPacket *pkt, AVRational timeBase);
+
+    int findEntry(int64_t pts);
+
+    int insertEntry(int64_t pts, int64_t pos);
+
+    int load();
+
+    static int interruptCallback(void *opaque);
+
+private:
+    Mutex mMutex;
+    KeyframeEntry *entries;                 // 按时间戳排序的关键帧
+    unsigned int entriesSize;               // 已分配的内存大小
+    int count;                              // 关键帧数量
+    bool complete;                          // 是否已经扫描完整个文件
+    bool dirty;                             // 是否有未保存的修改
+
+    char *url;                              // 文件路径，后台扫描时使用
+    AVInputFormat *iformat;                 // 封装格式，后台扫描时使用
+    int streamId;                           // 视频流的id，用于在后台扫描时找到同一路流
+    int streamIndex;
+    AVRational timeBase;
+    KeyframeRun playbackRun;                // 播放时读取的关键帧序列
+    char *indexPath;                        // 索引文件路径，为NULL时不保存
+    uint64_t fileKey;                       // 文件标识
+
+    Thread *scanThread;                     // 后台扫描线程
+    bool abortScan;
+};
+
+#endif //EPLAYER_KEYFRAMEINDEX_H
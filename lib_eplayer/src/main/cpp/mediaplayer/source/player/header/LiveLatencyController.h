@@ -0,0 +1,47 @@
+
+#ifndef EPLAYER_LIVELATENCYCONTROLLER_H
+#define EPLAYER_LIVELATENCYCONTROLLER_H
+
+#include "PlayerState.h"
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+};
+
+// 检查数据包的结果，可以组合
+#define LIVE_KEEP_PACKET 0x0                // 正常送入解码器
+#define LIVE_DROP_PACKET 0x1                // 丢弃当前数据包
+#define LIVE_DROP_QUEUE 0x2                 // 丢弃解码器队列中缓冲的数据包
+#define LIVE_RESUME_VIDEO 0x4               // 等到了视频关键帧，需要重新开始视频计时
+
+/**
+ * 直播低延时控制器，延时 = 最新读到的主时钟对应流的数据包时间戳 - 主时钟
+ * 超过目标延时时加快播放速度追赶，超过上限时丢弃缓冲的数据包，并且一直丢弃到下一个视频关键帧
+ * 只在读数据包线程中使用，丢弃数据包由调用者根据返回值处理
+ */
+class LiveLatencyController {
+public:
+    LiveLatencyController(PlayerState *playerState);
+
+    virtual ~LiveLatencyController();
+
+    // 绑定媒体流，有音频时按音频计算延时，没有音频时按视频计算，没有的媒体流传-1
+    void open(int videoIndex, int audioIndex, AVRational timeBase);
+
+    // 检查读到的数据包，clock是主时钟，单位秒，返回LIVE_*的组合
+    int check(const AVPacket *pkt, double clock);
+
+    // 最近一次计算的延时，单位秒，还没有计算过时为NAN
+    double getLatency();
+
+private:
+    PlayerState *playerState;
+    int videoIndex;                         // 视频流索引，没有视频时为-1
+    int masterIndex;                        // 计算延时使用的媒体流
+    AVRational timeBase;                    // 计算延时使用的媒体流的时间基准
+    bool skipToKeyframe;                    // 丢弃缓冲的数据包以后，等待下一个视频关键帧
+    double resumePosition;                  // 丢弃以后第一个保留的数据包的时间，主时钟到达之前不计算延时，单位秒
+    double latency;                         // 最近一次计算的延时
+};
+
+#endif //EPLAYER_LIVELATENCYCONTROLLER_H
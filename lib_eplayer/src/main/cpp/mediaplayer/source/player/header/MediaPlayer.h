@@ -7,6 +7,7 @@
 #include "PlayerState.h"
 #include "AudioDecoder.h"
 #include "VideoDecoder.h"
+#include "SubtitleDecoder.h"
 
 #if defined(__ANDROID__)
 #include "SLESDevice.h"
@@ -19,7 +20,22 @@
 #include <android/native_window_jni.h>
 #include "MediaSync.h"
 #include "convertor/AudioResampler.h"
-
+#include "KeyframeIndex.h"
+#include "StreamInfoCache.h"
+#include "ReadAheadIO.h"
+#include "MmapIO.h"
+#include "HttpCache.h"
+#include "AbrController.h"
+#include "LiveLatencyController.h"
+#include "PreloadManager.h"
+#include "ReverseDecoder.h"
+
+// 轨道类型，取值跟Android MediaPlayer.TrackInfo的MEDIA_TRACK_TYPE_*一致
+#define MEDIA_TRACK_TYPE_UNKNOWN 0
+#define MEDIA_TRACK_TYPE_VIDEO 1
+#define MEDIA_TRACK_TYPE_AUDIO 2
+#define MEDIA_TRACK_TYPE_TIMEDTEXT 3        // 文本字幕，通过MSG_TIMED_TEXT通知
+#define MEDIA_TRACK_TYPE_SUBTITLE 4         // 位图字幕，叠加在视频画面上
 
 class MediaPlayer : public Runnable {
 public:
@@ -47,6 +63,17 @@ public:
 
     void seekTo(float timeMs);
 
+    // 暂停时前进一帧
+    status_t stepForward();
+
+    // 暂停时后退一帧
+    status_t stepBackward();
+
+    // 开始或者结束倒放，倒放速度跟随播放速度，音频静音
+    status_t setReverse(bool reverse);
+
+    int isReverse();
+
     void setLooping(int looping);
 
     void setVolume(float leftVolume, float rightVolume);
@@ -73,6 +100,21 @@ public:
 
     int getMetadata(AVDictionary **metadata);
 
+    // 轨道数量，轨道序号就是文件中媒体流的索引
+    int getTrackCount();
+
+    // 轨道类型，MEDIA_TRACK_TYPE_*
+    int getTrackType(int index);
+
+    // 轨道的语言，没有语言信息时返回"und"，返回的字符串在重置播放器之前有效
+    const char *getTrackLanguage(int index);
+
+    // 当前选中的轨道，没有时返回-1
+    int getSelectedTrack(int trackType);
+
+    // 选择或者取消选择轨道，只能切换音频和字幕，取消选择只支持字幕，切换在读数据包线程中异步完成
+    status_t selectTrack(int index, bool select);
+
     AVMessageQueue *getMessageQueue();
 
     PlayerState *getPlayerState();
@@ -103,10 +145,64 @@ private:
     // 获取AV数据
     int readAvPackets();
 
+    // 数据包队列是否已满
+    bool isQueueFull();
+
+    // 队列已满时阻塞读数据包线程，直到解码器消耗到低水位或者有控制请求
+    void waitForQueueDrain();
+
+    // 读到文件末尾以后阻塞读数据包线程，超时或者有控制请求时返回
+    void waitAtEndOfFile();
+
+    // 唤醒等待队列消耗的读数据包线程
+    void wakeUpReadThread();
+
+    // 发出定位请求，位置单位AV_TIME_BASE，accurate为true时不管是否开启精确定位都解码到目标帧
+    void requestSeek(int64_t seekPos, bool accurate);
+
+    // 逐帧步进以后继续播放时，从正在显示的帧重新定位
+    void resyncAfterStep();
+
+    // 从position开始倒放，单位秒，seekPosition为倒放时的定位位置，单位毫秒，第一帧显示以后通知定位完成，不是定位时为-1
+    void startReverse(double position, int seekPosition);
+
+    // 停止倒放解码器并从同步器上移除，不改变倒放状态
+    void releaseReverseDecoder();
+
+    // 倒放期间读数据包线程休眠，结束倒放的定位请求、倒放时的定位请求或者退出时返回
+    void waitForReverse();
+
+    // 处理倒放时的定位请求，停止旧的倒放解码器，从新的位置重新开始倒放
+    void restartReverse();
+
+    // 直播低延时模式下检查延时，返回true时丢弃这个数据包
+    bool checkLiveLatency(AVPacket *pkt);
+
+    // 在读数据包线程中切换音频或者字幕轨道，streamIndex为-1时关闭字幕
+    void switchTrack(int mediaType, int streamIndex);
+
+    // 切换轨道以后回退到主时钟的位置重新读取，新轨道从当前播放位置开始解码
+    void refillTrack(int streamIndex);
+
+    // 回退重读期间其他媒体流已经送入过的数据包，返回true时丢弃这个数据包
+    bool skipRefilledPacket(AVPacket *pkt);
+
+    // 申请预加载的内存预算，申请不到时不预加载
+    bool startPreload();
+
+    // 开始播放或者退出时归还预加载的内存预算
+    void finishPreload();
+
+    // 预加载是否已经缓冲到目标
+    bool isPreloadFull();
+
     int startPlayer();
 
     // prepare decoder with stream_index
-    int prepareDecoder(int streamIndex);
+    int prepareDecoder(AVFormatContext *formatCtx, int streamIndex);
+
+    // 打开外挂字幕文件并创建字幕解码器
+    int openSubtitleFile(const char *filename);
 
     // open an audio output device
     int openAudioDevice(int64_t wanted_channel_layout, int wanted_nb_channels,
@@ -121,20 +217,40 @@ private:
 
     AudioDecoder *audioDecoder;             // 音频解码器
     VideoDecoder *videoDecoder;             // 视频解码器
+    SubtitleDecoder *subtitleDecoder;       // 字幕解码器
     bool mExit;                             // state for reading packets thread exited if not
 
     // 解复用处理
     AVFormatContext *pFormatCtx;            // 解码上下文
     int64_t mDuration;                      // 文件总时长，单位毫秒
     int lastPaused;                         // 上一次暂停状态
-    int eof;                                // 数据包读到结尾标志
     int attachmentRequest;                  // 视频封面数据包请求
+    int trackRequest;                       // 切换轨道请求
+    int trackRequestType;                   // 请求切换的媒体类型，AVMediaType
+    int trackRequestIndex;                  // 请求切换到的媒体流，关闭字幕时为-1
+    int reverseSeekRequest;                 // 倒放时的定位请求，由读数据包线程重新开始倒放
+    double reverseSeekPosition;             // 倒放时的定位位置，单位秒，已经包含文件的起始时间
+    int reverseSeekMs;                      // 倒放时的定位位置，单位毫秒，用于通知定位完成
+    int nbTrackStreams;                     // 下面两个数组的长度
+    int64_t *streamLastDts;                 // 每路媒体流最后读到的数据包时间戳
+    int64_t *streamResumeDts;               // 回退重读时每路媒体流跳过到这个时间戳为止，AV_NOPTS_VALUE表示不跳过
 
     AudioDevice *audioDevice;               // 音频输出设备
 
     AudioResampler *audioResampler;         // 音频重采样器
+    KeyframeIndex *keyframeIndex;           // 视频关键帧索引
+    ReadAheadIO *readAheadIO;               // 预读I/O
+    MmapIO *mmapIO;                         // 内存映射I/O
+    HttpCache *httpCache;                   // http点播的磁盘缓存
+    AbrController *abrController;           // HLS自适应码率控制器
+    LiveLatencyController *liveLatencyController; // 直播低延时控制器
+    bool decoderPoolAttached;               // 是否已经加入共享解码调度器
+    int64_t preloadReserved;                // 预加载申请的内存预算，不在预加载时为0
+    int64_t preloadPacketBytes;             // 预加载的数据包内存上限
+    bool preloadNotified;                   // 是否已经通知预加载完成
 
     MediaSync *mediaSync;                   // 媒体同步器
+    ReverseDecoder *reverseDecoder;         // 倒放解码器，不在倒放时为NULL
 
 };
 #endif //EPLAYER_MEDIAPLAYER_H
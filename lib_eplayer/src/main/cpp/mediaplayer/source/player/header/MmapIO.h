@@ -0,0 +1,63 @@
+
+#ifndef EPLAYER_MMAPIO_H
+#define EPLAYER_MMAPIO_H
+
+extern "C" {
+#include "libavformat/avformat.h"
+};
+
+// AVIOContext的缓冲大小，只用于较小的读取
+#define MMAP_IO_BUFFER_SIZE (32 * 1024)
+// 32位进程每次映射的窗口大小，64位进程直接映射整个文件
+#define MMAP_WINDOW_SIZE (64 * 1024 * 1024)
+// 定位以后提前读入页缓存的数据量
+#define MMAP_WILLNEED_SIZE (2 * 1024 * 1024)
+
+/**
+ * 内存映射本地文件的AVIOContext，解复用器直接从映射区读取，不需要read系统调用
+ * AVIOContext使用direct模式，较大的读取直接从映射区拷贝到数据包，定位只是移动读位置
+ * 只在读数据包线程中使用，不需要加锁
+ * 访问映射区中已经不在文件里的页会触发SIGBUS，而不是返回读取错误，所以每次映射前按文件的当前大小截断窗口，
+ * 但映射以后文件再被截断或者存储被移除(下载中的文件、拔出SD卡或U盘)仍然会导致进程崩溃，只能用于不会变化的文件
+ */
+class MmapIO {
+public:
+    MmapIO();
+
+    virtual ~MmapIO();
+
+    // 是否是可以映射的本地文件
+    static bool isSupported(const char *url);
+
+    // 打开并映射文件，失败时返回负数，调用者可以回退到其他读取方式
+    int open(const char *url);
+
+    // 交给解复用器使用的AVIOContext
+    AVIOContext *getContext();
+
+private:
+    static int readPacket(void *opaque, uint8_t *buf, int size);
+
+    static int64_t seekPacket(void *opaque, int64_t offset, int whence);
+
+    int read(uint8_t *buf, int size);
+
+    int64_t seek(int64_t offset, int whence);
+
+    // 映射包含pos的窗口，映射前按文件的当前大小更新fileSize
+    int mapWindow(int64_t pos);
+
+    void unmapWindow();
+
+private:
+    int fd;
+    int64_t fileSize;                       // 文件大小
+    int64_t position;                       // 当前读位置
+    uint8_t *window;                        // 映射区
+    int64_t windowStart;                    // 映射区在文件中的起始位置
+    size_t windowLength;                    // 映射区长度
+    size_t windowSize;                      // 每次映射的窗口大小
+    AVIOContext *context;
+};
+
+#endif //EPLAYER_MMAPIO_H
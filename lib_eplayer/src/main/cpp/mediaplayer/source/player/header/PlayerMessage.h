@@ -18,15 +18,20 @@
 #define MSG_AUDIO_START                 0x55    // 开始音频解码
 #define MSG_AUDIO_RENDERING_START       0x56    // 音频渲染开始(播放开始)
 #define MSG_VIDEO_START                 0x57    // 开始视频解码
-#define MSG_VIDEO_RENDERING_START       0x58    // 视频渲染开始(渲染开始)
+#define MSG_VIDEO_RENDERING_START       0x58    // 视频渲染开始(渲染开始)，arg1为从打开文件到第一帧显示的耗时(ms)
 #define MSG_VIDEO_ROTATION_CHANGED      0x59    // 旋转角度变化
+#define MSG_VARIANT_CHANGED             0x5a    // 自适应码率切换了码流，arg1为新码流的码率(kbps)，arg2为码流序号
+#define MSG_DECODER_LEVEL_CHANGED       0x5b    // 视频解码降级等级变化，arg1为新的等级，arg2为平均解码耗时(ms)
 
 #define MSG_BUFFERING_START             0x60    // 缓冲开始
 #define MSG_BUFFERING_END               0x61    // 缓冲完成
 #define MSG_BUFFERING_UPDATE            0x62    // 缓冲更新
 #define MSG_BUFFERING_TIME_UPDATE       0x63    // 缓冲时间更新
+#define MSG_READ_AHEAD_UPDATE           0x64    // 预读缓冲更新，arg1为已缓冲的数据量(KB)，arg2为填充百分比
+#define MSG_PRELOAD_COMPLETE            0x65    // 预加载完成，arg1为占用的预加载内存预算(KB)
 
 #define MSG_SEEK_COMPLETE               0x70    // 定位完成
+#define MSG_SEEK_RENDERING_START        0x71    // 定位以后第一帧已经显示，arg1为最后一次定位请求到显示的耗时(ms)
 #define MSG_PLAYBACK_STATE_CHANGED      0x80    // 播放状态变更
 #define MSG_TIMED_TEXT                  0x90    // 字幕
 
@@ -2,6 +2,7 @@
 #ifndef PLAYERSTATE_H
 #define PLAYERSTATE_H
 
+#include <atomic>
 #include "Mutex.h"
 #include "Condition.h"
 #include "Thread.h"
@@ -19,18 +20,77 @@ extern "C" {
 #include "libavutil/avstring.h"
 };
 #include "AVMessageQueue.h"
+#include "DecoderScheduler.h"
 
 #define VIDEO_QUEUE_SIZE 3
+// 视频帧队列和逐帧后退历史记录占用内存的上限，用于限制帧队列自适应增长的深度
+#define VIDEO_QUEUE_MEMORY_BUDGET (64 * 1024 * 1024)
+// 估算解码耗时峰值时使用的抖动倍数
+#define DECODE_JITTER_FACTOR 4.0
+// 连续多少帧需要的深度都更小时，帧队列才缩小一级
+#define VIDEO_QUEUE_SHRINK_FRAMES 120
+// 解码降级：解码耗时占帧显示时长的平均比例超过这个值并且帧队列不到一半时视为过载
+#define DECODER_OVERLOAD_RATIO 0.9
+// 解码耗时占帧显示时长的平均比例低于这个值并且帧队列接近满时视为已经恢复
+#define DECODER_RECOVER_RATIO 0.5
+// 连续过载这么多帧以后提升一级降级等级，1/16的平滑系数需要大约这么多帧才能反映出新等级的耗时
+#define DECODER_ESCALATE_FRAMES 16
+// 连续恢复这么多帧以后降低一级降级等级
+#define DECODER_RECOVER_FRAMES 150
+// 屏幕刷新率的默认值，单位Hz，倍速播放时显示帧率不超过刷新率，超过时跳过非参考帧
+#define DISPLAY_REFRESH_RATE 60
+// 播放速度达到这个倍数时只解码关键帧
+#define KEYFRAME_ONLY_RATE 8.0
 #define SAMPLE_QUEUE_SIZE 9
 
 #define MAX_QUEUE_SIZE (15 * 1024 * 1024)
 #define MIN_FRAMES 25
 
+// 数据包队列水位线，高于高水位时读数据包线程休眠，低于低水位时由解码器唤醒
+#define VIDEO_HIGH_WATER_BYTES (12 * 1024 * 1024)
+#define VIDEO_LOW_WATER_BYTES (4 * 1024 * 1024)
+#define AUDIO_HIGH_WATER_BYTES (2 * 1024 * 1024)
+#define AUDIO_LOW_WATER_BYTES (512 * 1024)
+#define HIGH_WATER_SECONDS 1.0
+#define LOW_WATER_SECONDS 0.5
+// 缓冲开始以后，每一路流都缓冲到这个时长才结束缓冲，单位秒
+#define BUFFERING_RESUME_SECONDS 1.0
+// 逐帧后退缓存的最近显示过的视频帧数量
+#define STEP_CACHE_FRAMES 8
+// 倒放时两个GOP缓冲共用的内存上限，超过时先缩小图像，最小尺寸也放不下时分段重复解码
+#define REVERSE_BUFFER_MEMORY (96 * 1024 * 1024)
+
+// 直播低延时模式的目标延时，单位秒，延时按已经读到的最新数据包和主时钟的差值计算
+#define LIVE_TARGET_LATENCY 1.0
+// 延时超过这个上限时丢弃缓冲的GOP，直接跳到下一个关键帧
+#define LIVE_MAX_LATENCY 4.0
+// 延时超过目标多少秒以后开始追赶
+#define LIVE_LATENCY_TOLERANCE 0.3
+// 追赶时的音频播放速度
+#define LIVE_CATCH_UP_RATE 1.1f
+// 直播低延时模式的探测数据量和探测时长
+#define LIVE_PROBE_SIZE (32 * 1024)
+#define LIVE_ANALYZE_DURATION (500 * 1000)
+// 预读缓冲大小，I/O线程在这个范围内领先解复用器读取数据
+#define READ_AHEAD_BUFFER_SIZE (4 * 1024 * 1024)
+// http磁盘缓存目录的默认大小上限
+#define HTTP_CACHE_MAX_SIZE (512LL * 1024 * 1024)
+// 预加载时缓冲的时长，单位秒
+#define PRELOAD_SECONDS 1.0
+// 码率未知时预加载的数据包按这个大小估算
+#define PRELOAD_PACKET_BYTES (2 * 1024 * 1024)
+// 字幕帧队列深度
+#define SUBPICTURE_QUEUE_SIZE 16
+
 #define AUDIO_MIN_BUFFER_SIZE 512
+// 音频解码线程预先重采样的PCM缓冲块数
+#define PCM_QUEUE_DEPTH 8
 
 #define AUDIO_MAX_CALLBACKS_PER_SEC 30
 
 #define REFRESH_RATE 0.01
+// 读到文件末尾以后等待播放结束的检查间隔，单位纳秒，定位、暂停和退出会立即唤醒
+#define READ_EOF_WAIT_TIMEOUT (10 * 1000 * 1000)
 
 #define AV_SYNC_THRESHOLD_MIN 0.04
 
@@ -68,6 +128,16 @@ typedef enum {
     AV_SYNC_EXTERNAL,   // 同步到外部时钟
 } SyncType;
 
+/**
+ * 单个媒体流数据包队列的水位线，字节和时长两个维度
+ */
+typedef struct QueueWatermark {
+    int highBytes;          // 高水位字节数
+    int lowBytes;           // 低水位字节数
+    double highSeconds;     // 高水位时长，单位秒
+    double lowSeconds;      // 低水位时长，单位秒
+} QueueWatermark;
+
 struct AVDictionary {
     int count;
     //可用于配置音视频参数，此结构体是一个key-value的形式
@@ -87,6 +157,18 @@ public:
 
     void setOptionLong(int category, const char *type, int64_t option);
 
+    // 唤醒等待队列消耗的读数据包线程
+    void notifyBufferDrained();
+
+    // 暂停、继续、定位和退出状态变化以后唤醒在门限上等待的工作线程
+    void signalGate();
+
+    // 等待定位请求处理完成，abort为调用线程自己的退出标志，可以为NULL
+    void waitForSeek(const bool *abort);
+
+    // 等待暂停结束或者有逐帧步进请求，abort为调用线程自己的退出标志，可以为NULL
+    void waitForResume(const bool *abort);
+
 private:
     void init();
 
@@ -95,7 +177,7 @@ private:
     void parse_int(const char *type, int64_t option);
 
 public:
-    Mutex mMutex;                   // 操作互斥锁，主要是给seek操作、音视频解码以及清空解码上下文缓冲使用，不加锁会导致ffmpeg内部崩溃现象
+    Mutex mMutex;                   // 操作互斥锁，主要是给seek操作使用，音视频解码各自使用解码器内部的锁
     AVDictionary *sws_dict;         // 视频转码option参数
     AVDictionary *swr_opts;         // 音频重采样option参数
     AVDictionary *format_opts;      // 解复用option参数
@@ -111,6 +193,10 @@ public:
 
     const char *audioCodecName;     // 指定音频解码器名称
     const char *videoCodecName;     // 指定视频解码器名称
+    const char *keyframeIndexDir;   // 关键帧索引文件目录，为NULL时不保存索引
+    const char *streamInfoCacheDir; // 媒体流信息缓存目录，为NULL时每次都探测媒体流信息
+    const char *httpCacheDir;       // http点播的磁盘缓存目录，为NULL时不缓存
+    const char *subtitleFile;       // 外挂字幕文件，为NULL时使用文件内的字幕流
 
     int abortRequest;               // 退出标志
     int pauseRequest;               // 暂停标志
@@ -122,6 +208,7 @@ public:
     int audioDisable;               // 是否禁止音频流
     int videoDisable;               // 是否禁止视频流
     int displayDisable;             // 是否禁止显示
+    int subtitleDisable;            // 是否禁止字幕流
 
     int fast;                       // 解码上下文的AV_CODEC_FLAG2_FAST标志
     int genpts;                     // 解码上下文的AVFMT_FLAG_GENPTS标志
@@ -129,18 +216,59 @@ public:
 
     float playbackRate;             // 播放速度
     float playbackPitch;            // 播放音调
+    int displayRefreshRate;         // 屏幕刷新率，单位Hz，0表示不按刷新率限制显示帧率
+    double keyframeOnlyRate;        // 播放速度达到这个倍数时只解码关键帧，0表示不启用
 
     int seekByBytes;                // 是否以字节定位
     int seekRequest;                // 定位请求
     int seekFlags;                  // 定位标志
     int64_t seekPos;                // 定位位置
     int64_t seekRel;                // 定位偏移
+    int64_t seekStartTime;          // 最后一次定位请求的时间，用于统计定位耗时
+    int seekSerial;                 // 定位请求序号，每次定位请求加一，用于判断定位是否已经被新的请求取代
+    int accurateSeek;               // 精确定位，解码到目标帧以后才通知定位完成
+    int seekAccurate;               // 这一次定位请求强制精确定位，逐帧步进时使用
+    std::atomic<int> stepRequest;   // 暂停时逐帧步进的请求，正数是前进的帧数，负数是后退的帧数
+    int stepCacheFrames;            // 逐帧后退缓存的视频帧数量，0表示不缓存，每次后退都重新定位
+    int keyframeIndexScan;          // 是否在后台扫描整个文件建立关键帧索引
+    int reversePlayback;            // 正在倒放，倒放时读数据包线程停止读取，音频静音
+    int64_t reverseBufferMemory;    // 倒放GOP缓冲的内存上限，单位byte
 
     int autoExit;                   // 是否自动退出
     int loop;                       // 循环播放
     int mute;                       // 静音播放
     int frameDrop;                  // 舍帧操作
     int reorderVideoPts;            // 视频帧重排pts
+
+    QueueWatermark audioWatermark;  // 音频数据包队列水位线
+    QueueWatermark videoWatermark;  // 视频数据包队列水位线
+    Mutex mBufferMutex;             // 读数据包线程等待队列消耗的锁
+    Condition mBufferCondition;     // 读数据包线程等待队列消耗的条件变量
+    std::atomic<int> bufferWaiting; // 读数据包线程是否正在等待
+    int64_t readBlockCount;         // 读数据包线程因队列已满而休眠的次数
+    int64_t readBlockTime;          // 读数据包线程休眠的总时长，单位微秒
+    int pcmQueueDepth;              // PCM队列缓冲块数
+    int64_t videoQueueMemory;       // 视频帧队列内存上限，包括逐帧后退缓存的帧，单位byte
+    int eof;                        // 数据包读到结尾标志
+    int buffering;                  // 是否正在缓冲，缓冲期间时钟暂停，不消耗音频和视频帧
+    double bufferingSeconds;        // 结束缓冲需要缓冲的时长，单位秒
+    int switchingAudio;             // 正在切换音频轨道，新轨道的数据包送入之前音频队列为空不算缓冲
+    int liveMode;                   // 直播低延时模式
+    double liveTargetLatency;       // 直播目标延时，单位秒
+    double liveMaxLatency;          // 直播延时上限，超过以后丢弃GOP，单位秒
+    float liveCatchUpRate;          // 直播追赶延时的播放速度，跟playbackRate叠加
+    int64_t openStartTime;          // 开始打开文件的时间，用于统计起播耗时
+    int readAheadSize;              // 预读缓冲大小，单位byte，为0时不预读
+    int mmapIO;                     // 本地文件是否使用内存映射读取，默认关闭，文件可能被截断或者存储被移除时不能开启
+    int64_t httpCacheSize;          // http磁盘缓存目录的大小上限，单位byte
+    int abr;                        // 多码流的HLS是否开启自适应码率
+    int sharedDecoderPool;          // 是否和其他播放器共享解码调度器
+    std::atomic<int> decodePriority; // 共享解码调度器中的优先级
+    int preload;                    // 准备完成以后是否预加载，开始之前就解码出第一帧
+    int decoderGovernor;            // 解码跟不上时是否逐级跳过环路滤波和非参考帧
+    double preloadSeconds;          // 预加载缓冲的时长，单位秒
+    Mutex mGateMutex;               // 暂停/定位门限的锁，工作线程在暂停和定位期间阻塞在这里
+    Condition mGateCondition;       // 暂停/定位门限的条件变量
 };
 
 
@@ -0,0 +1,47 @@
+
+#ifndef EPLAYER_PRELOADMANAGER_H
+#define EPLAYER_PRELOADMANAGER_H
+
+#include <mutex>
+#include <stdint.h>
+#include "Mutex.h"
+
+// 所有预加载的播放器一共可以占用的内存，单位byte
+#define PRELOAD_MEMORY_BUDGET (48 * 1024 * 1024)
+
+/**
+ * 进程内的预加载内存预算，播放器预加载之前按估算的内存占用申请预算，申请不到时不预加载
+ * 同时预加载的播放器数量由预算决定，开始播放或者释放以后归还预算
+ */
+class PreloadManager {
+public:
+    static PreloadManager *getInstance();
+
+    // 设置内存预算，已经申请的预算不受影响
+    void setBudget(int64_t budget);
+
+    // 申请预算，剩余预算不足时返回false
+    bool reserve(int64_t bytes);
+
+    // 归还预算
+    void release(int64_t bytes);
+
+    // 正在预加载的播放器数量
+    int getPreloadCount();
+
+private:
+    PreloadManager();
+
+    virtual ~PreloadManager();
+
+private:
+    static PreloadManager *instance;
+    static std::mutex mutex;
+
+    Mutex mMutex;
+    int64_t budget;                 // 内存预算
+    int64_t reserved;               // 已经申请的预算
+    int preloadCount;               // 正在预加载的播放器数量
+};
+
+#endif //EPLAYER_PRELOADMANAGER_H
@@ -0,0 +1,103 @@
+
+#ifndef EPLAYER_READAHEADIO_H
+#define EPLAYER_READAHEADIO_H
+
+#include "Mutex.h"
+#include "Condition.h"
+#include "Thread.h"
+#include "AVMessageQueue.h"
+
+extern "C" {
+#include "libavformat/avformat.h"
+};
+
+// 解复用器每次从预读缓冲中读取的数据块大小
+#define READ_AHEAD_IO_BUFFER_SIZE (32 * 1024)
+// I/O线程每次从文件或者网络读取的最大数据量
+#define READ_AHEAD_CHUNK_SIZE (256 * 1024)
+// 保留在读位置之前的数据比例，用于缓冲区内的向后定位
+#define READ_AHEAD_BACK_RATIO 4
+// 等待数据时检查中断的间隔，单位纳秒
+#define READ_AHEAD_WAIT_TIMEOUT (10 * 1000 * 1000)
+// 缓冲区填充百分比变化超过这个值时通知
+#define READ_AHEAD_NOTIFY_STEP 10
+
+/**
+ * 预读的AVIOContext，I/O线程在环形缓冲中保持领先解复用器若干MB的数据，读文件或者网络变慢时不会直接阻塞读数据包线程
+ * 环形缓冲中保存[bufferStart, writePos)范围内的数据，落在这个范围内的定位只移动读位置，不产生新的I/O
+ */
+class ReadAheadIO : public Runnable {
+public:
+    ReadAheadIO();
+
+    virtual ~ReadAheadIO();
+
+    // 是否支持预读，只支持通过AVIOContext读取的本地文件和http
+    static bool isSupported(const char *url);
+
+    // 打开底层的AVIOContext并开启I/O线程，options中底层协议使用掉的参数会被移除
+    int open(const char *url, int bufferSize, const AVIOInterruptCB *interruptCallback,
+             AVDictionary **options, AVMessageQueue *messageQueue);
+
+    // 在已经打开的AVIOContext之上预读，不负责释放source
+    int open(AVIOContext *source, int bufferSize, const AVIOInterruptCB *interruptCallback,
+             AVMessageQueue *messageQueue);
+
+    // 交给解复用器使用的AVIOContext
+    AVIOContext *getContext();
+
+    // 停止I/O线程，关闭以后不能再读取
+    void stop();
+
+    // 读位置之后已经缓冲的数据量
+    int64_t getBufferedBytes();
+
+    // 缓冲区填充百分比
+    int getFillPercent();
+
+    void run() override;
+
+private:
+    int start(int bufferSize, AVMessageQueue *messageQueue);
+
+    static int readPacket(void *opaque, uint8_t *buf, int size);
+
+    static int64_t seekPacket(void *opaque, int64_t offset, int whence);
+
+    static int interruptCallback(void *opaque);
+
+    int read(uint8_t *buf, int size);
+
+    int64_t seek(int64_t offset, int whence);
+
+    bool isInterrupted();
+
+    void notifyFillLevel();
+
+private:
+    Mutex mMutex;
+    Condition mCondition;
+    Thread *ioThread;                       // I/O线程
+    bool abortRequest;
+
+    AVIOContext *source;                    // 底层的AVIOContext
+    bool ownSource;                         // 底层的AVIOContext是否由自己打开
+    AVIOContext *context;                   // 交给解复用器的AVIOContext
+    AVIOInterruptCB userInterrupt;          // 播放器的中断回调
+
+    uint8_t *ringBuffer;                    // 环形缓冲
+    int capacity;                           // 环形缓冲大小
+    int64_t bufferStart;                    // 环形缓冲中最早的数据在文件中的位置
+    int64_t readPos;                        // 解复用器的读位置
+    int64_t writePos;                       // I/O线程的写位置
+    int64_t fileSize;                       // 文件大小，未知时小于0
+    bool needSeek;                          // I/O线程需要把底层定位到writePos
+    int seekSerial;                         // 缓冲区外定位的序列号，I/O线程据此丢弃过期的数据
+    bool eof;                               // 底层已经读到文件末尾
+    int error;                              // 底层的读错误
+
+    AVMessageQueue *messageQueue;
+    int notifiedPercent;                    // 上一次通知的填充百分比
+};
+
+#endif //EPLAYER_READAHEADIO_H
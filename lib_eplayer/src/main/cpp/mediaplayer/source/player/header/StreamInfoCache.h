@@ -0,0 +1,40 @@
+
+#ifndef EPLAYER_STREAMINFOCACHE_H
+#define EPLAYER_STREAMINFOCACHE_H
+
+extern "C" {
+#include "libavformat/avformat.h"
+};
+
+// 媒体流信息缓存文件的扩展名
+#define STREAM_INFO_CACHE_SUFFIX ".esi"
+// 缓存文件版本号，格式变化时需要增加
+#define STREAM_INFO_CACHE_VERSION 1
+
+/**
+ * 媒体流信息缓存，保存avformat_find_stream_info探测出来的编解码参数
+ * 再次打开同一个文件时直接填回到媒体流中，跳过avformat_find_stream_info
+ * 只用于avformat_open_input就能创建出所有媒体流的封装格式(mp4/mkv/flv等)，mpegts这类边读边创建媒体流的格式不使用
+ * 文件头中的参数不完整，需要解码才能得到的媒体流也不使用，填回的参数不会同步到解复用器内部的解码上下文
+ */
+class StreamInfoCache {
+public:
+    StreamInfoCache();
+
+    virtual ~StreamInfoCache();
+
+    // 计算文件标识和缓存文件路径，不能使用缓存时返回-1
+    int open(AVFormatContext *pFormatCtx, const char *url, const char *cacheDir);
+
+    // 读取缓存并填回媒体流参数，成功时返回0，可以跳过avformat_find_stream_info
+    int apply(AVFormatContext *pFormatCtx);
+
+    // avformat_find_stream_info完成以后保存媒体流参数
+    int save(AVFormatContext *pFormatCtx);
+
+private:
+    char *cachePath;                // 缓存文件路径
+    uint64_t fileKey;               // 文件标识
+};
+
+#endif //EPLAYER_STREAMINFOCACHE_H
@@ -74,7 +74,7 @@ void AVMessageQueue::postMessage(int what, int arg1, int arg2, void *obj, int le
     msg.what = what;
     msg.arg1 = arg1;
     msg.arg2 = arg2;
-    msg.obj = av_malloc(sizeof(len));
+    msg.obj = av_malloc(len);
     memcpy(msg.obj, obj, len);
     msg.free = message_free;
     putMessage(&msg);
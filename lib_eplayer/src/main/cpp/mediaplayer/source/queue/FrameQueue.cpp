@@ -5,8 +5,8 @@ FrameQueue::FrameQueue(int max_size, int keep_last) {
     memset(queue, 0, sizeof(Frame) * FRAME_QUEUE_SIZE);
     this->max_size = FFMIN(max_size, FRAME_QUEUE_SIZE);
     this->keep_last = (keep_last != 0);
-    //为数组元素frame分配空间
-    for (int i = 0; i < this->max_size; ++i) {
+    //为数组元素frame分配空间，所有槽位都预先分配，调整深度时不需要重新分配
+    for (int i = 0; i < FRAME_QUEUE_SIZE; ++i) {
         queue[i].frame = av_frame_alloc();
     }
     abort_request = 1;
@@ -17,7 +17,7 @@ FrameQueue::FrameQueue(int max_size, int keep_last) {
 }
 
 FrameQueue::~FrameQueue() {
-    for (int i = 0; i < max_size; ++i) {
+    for (int i = 0; i < FRAME_QUEUE_SIZE; ++i) {
         Frame *vp = &queue[i];
         unrefFrame(vp);
         av_frame_free(&vp->frame);
@@ -39,11 +39,11 @@ void FrameQueue::abort() {
 }
 
 Frame *FrameQueue::currentFrame() {
-    return &queue[(rindex + show_index) % max_size];
+    return &queue[(rindex + show_index) % FRAME_QUEUE_SIZE];
 }
 
 Frame *FrameQueue::nextFrame() {
-    return &queue[(rindex + show_index + 1) % max_size];
+    return &queue[(rindex + show_index + 1) % FRAME_QUEUE_SIZE];
 }
 
 Frame *FrameQueue::lastFrame() {
@@ -73,7 +73,7 @@ Frame *FrameQueue::peekWritable() {
  * 在调用了peekWritable以后，会写入元素到数组中，写入成功以后调用这个方法，代表插入成功，然后改变一些数据值
  */
 void FrameQueue::pushFrame() {
-    if (++windex == max_size) {
+    if (++windex == FRAME_QUEUE_SIZE) {
         windex = 0;
     }
     mMutex.lock();
@@ -90,7 +90,7 @@ void FrameQueue::popFrame() {
         return;
     }
     unrefFrame(&queue[rindex]);
-    if (++rindex == max_size) {
+    if (++rindex == FRAME_QUEUE_SIZE) {
         rindex = 0;
     }
     mMutex.lock();
@@ -116,4 +116,17 @@ void FrameQueue::unrefFrame(Frame *vp) {
 
 int FrameQueue::getShowIndex() const {
     return show_index;
+}
+
+void FrameQueue::setMaxSize(int max_size) {
+    mMutex.lock();
+    // keep_last时至少需要保留正在显示的帧和下一帧
+    this->max_size = av_clip(max_size, keep_last ? 2 : 1, FRAME_QUEUE_SIZE);
+    mCondition.signal();
+    mMutex.unlock();
+}
+
+int FrameQueue::getMaxSize() {
+    Mutex::Autolock lock(mMutex);
+    return max_size;
 }
\ No newline at end of file
@@ -3,71 +3,159 @@
 
 PacketQueue::PacketQueue() {
     abort_request = 0;
-    first_pkt = NULL;
-    last_pkt = NULL;
-    nb_packets = 0;
-    size = 0;
-    duration = 0;
+    readRing = writeRing = createRing(PACKET_RING_INIT_CAPACITY);
+    readerWaiting = false;
+    writerWaiting = false;
+    pushed.packets = popped.packets = 0;
+    pushed.size = popped.size = 0;
+    pushed.duration = popped.duration = 0;
 }
 
 PacketQueue::~PacketQueue() {
     abort();
     flush();
+    // flush之后只剩下最后一段
+    while (readRing) {
+        PacketRing *next = readRing->next.load();
+        freeRing(readRing);
+        readRing = next;
+    }
+    writeRing = NULL;
 }
 
 /**
- * 入队数据包
+ * 创建一段环形缓冲，所有槽位一次性分配好
+ * @param capacity
+ * @return
+ */
+PacketRing *PacketQueue::createRing(unsigned int capacity) {
+    PacketRing *ring = new PacketRing();
+    ring->packets = (AVPacket *) av_mallocz(sizeof(AVPacket) * capacity);
+    ring->capacity = capacity;
+    ring->readIndex = 0;
+    ring->writeIndex = 0;
+    ring->next = NULL;
+    return ring;
+}
+
+void PacketQueue::freeRing(PacketRing *ring) {
+    av_freep(&ring->packets);
+    delete ring;
+}
+
+/**
+ * 累加统计值，调用线程是唯一修改者，普通的读写就够了
+ * @param stats
+ * @param pkt
+ */
+void PacketQueue::addStats(PacketQueueStats *stats, const AVPacket *pkt) {
+    stats->packets.store(stats->packets.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    stats->size.store(stats->size.load(std::memory_order_relaxed) + pkt->size + (int) sizeof(*pkt),
+                      std::memory_order_release);
+    stats->duration.store(stats->duration.load(std::memory_order_relaxed) + pkt->duration,
+                          std::memory_order_release);
+}
+
+/**
+ * 入队数据包，只在读数据包线程中调用
  * @param pkt
  * @return
  */
 int PacketQueue::put(AVPacket *pkt) {
-    // 一个队列元素，包括当前pkt和下一个pkt的指针
-    PacketList *pkt1;
-
     if (abort_request) {
         return -1;
     }
-    // 分配结构体内存
-    pkt1 = (PacketList *) av_malloc(sizeof(PacketList));
-    if (!pkt1) {
-        return -1;
+
+    PacketRing *ring = writeRing;
+    if (isFull()) {
+        if (ring->capacity < PACKET_RING_MAX_CAPACITY) {
+            // 扩容，新段链接到旧段的后面，消费者读完旧段以后会切换到新段
+            PacketRing *next = createRing(ring->capacity * 2);
+            if (!next->packets) {
+                freeRing(next);
+                return -1;
+            }
+            ring->next.store(next);
+            writeRing = ring = next;
+        } else {
+            // 已经达到上限，等待消费者取走数据
+            mMutex.lock();
+            writerWaiting = true;
+            while (!abort_request && isFull()) {
+                mCondition.wait(mMutex);
+            }
+            writerWaiting = false;
+            mMutex.unlock();
+            if (abort_request) {
+                return -1;
+            }
+        }
     }
-    // 赋值
-    pkt1->pkt = *pkt;
-    pkt1->next = NULL;
-
-    if (!last_pkt) { // 如果最后一个元素为null，代表当前是添加第一个pkt
-        first_pkt = pkt1;
-    } else {
-        // 连接到上一个元素的后面
-        last_pkt->next = pkt1; //最后元素的下一个元素的指针指向pkt1
+
+    unsigned int w = ring->writeIndex.load(std::memory_order_relaxed);
+    ring->packets[w & (ring->capacity - 1)] = *pkt;
+    // 先更新统计，再发布数据，保证消费者取出的数据包一定已经计入写入的累计值
+    addStats(&pushed, pkt);
+    ring->writeIndex.store(w + 1);
+
+    // 只有消费者在等待时才需要加锁通知
+    if (readerWaiting) {
+        mMutex.lock();
+        mCondition.signal();
+        mMutex.unlock();
     }
-    // 最后一个元素赋值为pkt1
-    last_pkt = pkt1;
-    nb_packets++; // 数据大小
-    size += pkt1->pkt.size + sizeof(*pkt1);
-    duration += pkt1->pkt.duration;
     return 0;
 }
 
+/**
+ * 取出一个数据包，读完一段以后切换到下一段并释放旧段
+ * @param pkt
+ * @return
+ */
+bool PacketQueue::pop(AVPacket *pkt) {
+    for (;;) {
+        PacketRing *ring = readRing;
+        unsigned int r = ring->readIndex.load(std::memory_order_relaxed);
+        if (r == ring->writeIndex.load()) {
+            PacketRing *next = ring->next.load();
+            if (!next) {
+                return false;
+            }
+            // 生产者在链接新段之前已经写完旧段，所以这里需要重新判断一次
+            if (r == ring->writeIndex.load()) {
+                readRing = next;
+                freeRing(ring);
+                continue;
+            }
+        }
+        *pkt = ring->packets[r & (ring->capacity - 1)];
+        ring->readIndex.store(r + 1);
+        addStats(&popped, pkt);
+        return true;
+    }
+}
+
+bool PacketQueue::isEmpty() {
+    Mutex::Autolock lock(mReadMutex);
+    PacketRing *ring = readRing;
+    return ring->readIndex.load() == ring->writeIndex.load() && !ring->next.load();
+}
+
+bool PacketQueue::isFull() {
+    PacketRing *ring = writeRing;
+    return ring->writeIndex.load(std::memory_order_relaxed) - ring->readIndex.load() >= ring->capacity;
+}
+
 /**
  * 入队数据包
  * @param pkt
  * @return
  */
 int PacketQueue::pushPacket(AVPacket *pkt) {
-    int ret;
-    // 线程安全
-    mMutex.lock();
-    ret = put(pkt);
-    // 通知阻塞的线程，比如取数据线程被阻塞的时候，这里可以通知它有数据可以取了，解除阻塞
-    mCondition.signal();
-    mMutex.unlock();
-
+    int ret = put(pkt);
     if (ret < 0) {
         av_packet_unref(pkt);
     }
-
     return ret;
 }
 
@@ -81,23 +169,17 @@ int PacketQueue::pushNullPacket(int stream_index) {
 }
 
 /**
- * 清空队列
+ * 清空队列，由读数据包线程调用，或者在生产者停止以后调用
  */
 void PacketQueue::flush() {
-    PacketList *pkt, *pkt1;
+    AVPacket pkt;
+    mReadMutex.lock();
+    while (pop(&pkt)) {
+        av_packet_unref(&pkt);
+    }
+    mReadMutex.unlock();
 
     mMutex.lock();
-    // pkt = first_pkt是最开始初始化条件，判断pkt是否为真，pkt = pkt1是执行括号后更新的条件
-    for (pkt = first_pkt; pkt; pkt = pkt1) {
-        pkt1 = pkt->next;
-        av_packet_unref(&pkt->pkt);
-        av_freep(&pkt);
-    }
-    last_pkt = NULL;
-    first_pkt = NULL;
-    nb_packets = 0;
-    size = 0;
-    duration = 0;
     mCondition.signal();
     mMutex.unlock();
 }
@@ -108,7 +190,7 @@ void PacketQueue::flush() {
 void PacketQueue::abort() {
     mMutex.lock();
     abort_request = 1;
-    mCondition.signal();
+    mCondition.broadcast();
     mMutex.unlock();
 }
 
@@ -138,53 +220,52 @@ int PacketQueue::getPacket(AVPacket *pkt) {
  * @return
  */
 int PacketQueue::getPacket(AVPacket *pkt, int block) {
-    PacketList *pkt1;
-    int ret;
-
-    mMutex.lock();
-
     for (;;) {
-        //如果禁止取数据，则break
+        //如果禁止取数据，则返回
         if (abort_request) {
-            ret = -1;
-            break;
+            return -1;
         }
-        // 取最前面的那个元素
-        pkt1 = first_pkt;
-        if (pkt1) { // 首元素是否为null，不为null代表队列有元素
-            first_pkt = pkt1->next; // 取出first_pkt，所以首元素变为下一个
-            if (!first_pkt) { // 没有元素了
-                last_pkt = NULL;
+
+        mReadMutex.lock();
+        bool got = pop(pkt);
+        mReadMutex.unlock();
+        if (got) {
+            // 生产者在等待空位时才需要通知
+            if (writerWaiting) {
+                mMutex.lock();
+                mCondition.signal();
+                mMutex.unlock();
             }
-            nb_packets--;
-            size -= pkt1->pkt.size + sizeof(*pkt1);
-            duration -= pkt1->pkt.duration;
-            *pkt = pkt1->pkt;
-            av_free(pkt1); // 释放
-            ret = 1;
-            break;
+            return 1;
         } else if (!block) { // 不阻塞
-            ret = 0;
-            break;
-        } else { // 阻塞
+            return 0;
+        }
+
+        // 阻塞，等待生产者写入数据
+        mMutex.lock();
+        readerWaiting = true;
+        while (!abort_request && isEmpty()) {
             mCondition.wait(mMutex);
         }
+        readerWaiting = false;
+        mMutex.unlock();
     }
-    mMutex.unlock();
-    return ret;
 }
 
+// 先读取出的累计值再读写入的累计值，差值不会是负数
 int PacketQueue::getPacketSize() {
-    Mutex::Autolock lock(mMutex);
-    return nb_packets;
+    int64_t out = popped.packets.load(std::memory_order_acquire);
+    return (int) (pushed.packets.load(std::memory_order_acquire) - out);
 }
 
 int PacketQueue::getSize() {
-    return size;
+    int64_t out = popped.size.load(std::memory_order_acquire);
+    return (int) (pushed.size.load(std::memory_order_acquire) - out);
 }
 
 int64_t PacketQueue::getDuration() {
-    return duration;
+    int64_t out = popped.duration.load(std::memory_order_acquire);
+    return pushed.duration.load(std::memory_order_acquire) - out;
 }
 
 int PacketQueue::isAbort() {
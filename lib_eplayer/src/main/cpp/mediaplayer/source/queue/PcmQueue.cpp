@@ -0,0 +1,104 @@
+
+#include "PcmQueue.h"
+
+PcmQueue::PcmQueue(int depth) {
+    if (depth < 2) {
+        depth = 2;
+    } else if (depth > PCM_QUEUE_MAX_DEPTH) {
+        depth = PCM_QUEUE_MAX_DEPTH;
+    }
+    this->depth = depth;
+    buffers = (PcmBuffer *) av_mallocz(sizeof(PcmBuffer) * depth);
+    rindex = 0;
+    windex = 0;
+    serial = 0;
+    writerWaiting = false;
+    abort_request = 1;
+}
+
+PcmQueue::~PcmQueue() {
+    abort();
+    for (int i = 0; i < depth; ++i) {
+        av_freep(&buffers[i].data);
+    }
+    av_freep(&buffers);
+}
+
+void PcmQueue::start() {
+    mMutex.lock();
+    abort_request = 0;
+    mCondition.signal();
+    mMutex.unlock();
+}
+
+void PcmQueue::abort() {
+    mMutex.lock();
+    abort_request = 1;
+    mCondition.broadcast();
+    mMutex.unlock();
+}
+
+void PcmQueue::flush() {
+    serial++;
+}
+
+/**
+ * 获取可写的缓冲块，只在音频解码线程中调用
+ * @return
+ */
+PcmBuffer *PcmQueue::peekWritable() {
+    unsigned int w = windex.load(std::memory_order_relaxed);
+    if (w - rindex.load() >= (unsigned int) depth) {
+        mMutex.lock();
+        writerWaiting = true;
+        while (!abort_request && w - rindex.load() >= (unsigned int) depth) {
+            // 消费者只用tryLock通知，可能会错过，所以带超时等待
+            mCondition.waitRelative(mMutex, PCM_QUEUE_WAIT_TIMEOUT);
+        }
+        writerWaiting = false;
+        mMutex.unlock();
+    }
+    if (abort_request) {
+        return NULL;
+    }
+    return &buffers[w % depth];
+}
+
+void PcmQueue::pushBuffer() {
+    windex.store(windex.load(std::memory_order_relaxed) + 1);
+}
+
+/**
+ * 获取可读的缓冲块，只在音频回调中调用，丢弃flush之前写入的数据
+ * @return
+ */
+PcmBuffer *PcmQueue::peekReadable() {
+    for (;;) {
+        unsigned int r = rindex.load(std::memory_order_relaxed);
+        if (r == windex.load()) {
+            return NULL;
+        }
+        PcmBuffer *buffer = &buffers[r % depth];
+        if (buffer->serial == serial) {
+            return buffer;
+        }
+        popBuffer();
+    }
+}
+
+void PcmQueue::popBuffer() {
+    rindex.store(rindex.load(std::memory_order_relaxed) + 1);
+    // 音频回调里不能阻塞，拿不到锁时由生产者超时重新检查
+    if (writerWaiting && mMutex.tryLock() == 0) {
+        mCondition.signal();
+        mMutex.unlock();
+    }
+}
+
+int PcmQueue::getSerial() {
+    return serial;
+}
+
+int PcmQueue::getBufferCount() {
+    return (int) (windex.load() - rindex.load());
+}
@@ -10,7 +10,8 @@ extern "C" {
 #include "libavcodec/avcodec.h"
 };
 
-#define FRAME_QUEUE_SIZE 10
+// 帧队列的槽位数，队列实际深度可以在运行时在这个范围内调整
+#define FRAME_QUEUE_SIZE 16
 
 typedef struct Frame {
     AVFrame *frame;
@@ -21,6 +22,7 @@ typedef struct Frame {
     int height;
     int format;
     int uploaded;
+    int seekFrame;        /* 是否是定位以后的第一帧 */
 } Frame;
 
 class FrameQueue {
@@ -52,6 +54,11 @@ public:
 
     int getShowIndex() const;
 
+    // 调整队列深度，缩小时已经写入的帧不会丢弃，等消费以后才会生效
+    void setMaxSize(int max_size);
+
+    int getMaxSize();
+
 private:
     void unrefFrame(Frame *vp);
 
@@ -63,7 +70,7 @@ private:
     int rindex;
     int windex;
     int size;
-    int max_size;
+    int max_size;                   // 当前允许的最大深度
     int keep_last;
     int show_index;
 };
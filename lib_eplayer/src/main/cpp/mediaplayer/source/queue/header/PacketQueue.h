@@ -2,7 +2,7 @@
 #ifndef EPLAYER_PACKETQUEUE_H
 #define EPLAYER_PACKETQUEUE_H
 
-#include <queue>
+#include <atomic>
 #include "Mutex.h"
 #include "Condition.h"
 
@@ -10,14 +10,35 @@ extern "C" {
 #include "libavcodec/avcodec.h"
 };
 
-typedef struct PacketList {
-    AVPacket pkt;
-    //此结构体包含一个pkt和下一个pkt的指针
-    struct PacketList *next;
-} PacketList;
+// 环形缓冲初始槽位数，必须是2的幂
+#define PACKET_RING_INIT_CAPACITY 256
+// 环形缓冲最大槽位数，超过以后生产者才会阻塞等待
+#define PACKET_RING_MAX_CAPACITY (64 * 1024)
+
+/**
+ * 预分配的环形缓冲段，写满以后会链接一个两倍大小的新段，消费者读完旧段以后再释放
+ */
+typedef struct PacketRing {
+    AVPacket *packets;                      // 预分配的数据包槽位
+    unsigned int capacity;                  // 槽位数量
+    std::atomic<unsigned int> readIndex;    // 读位置，只由消费者写入
+    std::atomic<unsigned int> writeIndex;   // 写位置，只由生产者写入
+    std::atomic<struct PacketRing *> next;  // 扩容后的下一段
+} PacketRing;
+
+/**
+ * 数据包数量、大小和时长的累计值，只有一个线程修改，读出再写回，不需要带锁的原子加法
+ * 队列中的数量是写入和取出两个累计值的差
+ */
+typedef struct PacketQueueStats {
+    std::atomic<int64_t> packets;
+    std::atomic<int64_t> size;
+    std::atomic<int64_t> duration;
+} PacketQueueStats;
 
 /**
  * 备注：这里不用std::queue是为了方便计算队列占用内存和队列的时长，在解码的时候要用到
+ * 单生产者(读数据包线程)/单消费者(解码线程)的无锁环形队列，只有队列为空或者已满时才会加锁等待
  */
 class PacketQueue {
 public:
@@ -57,14 +78,30 @@ public:
 private:
     int put(AVPacket *pkt);
 
+    // 取出一个数据包，调用前需要持有mReadMutex
+    bool pop(AVPacket *pkt);
+
+    bool isEmpty();
+
+    bool isFull();
+
+    static PacketRing *createRing(unsigned int capacity);
+
+    static void freeRing(PacketRing *ring);
+
+    static void addStats(PacketQueueStats *stats, const AVPacket *pkt);
+
 private:
-    Mutex mMutex;
+    Mutex mMutex;                           // 只在队列为空或者已满时等待使用
     Condition mCondition;
-    PacketList *first_pkt, *last_pkt;
-    int nb_packets;
-    int size;
-    int64_t duration;
-    int abort_request;
+    Mutex mReadMutex;                       // 消费端互斥，保证flush和getPacket不会同时取数据
+    PacketRing *readRing;                   // 消费者当前读取的段
+    PacketRing *writeRing;                  // 生产者当前写入的段
+    std::atomic<bool> readerWaiting;        // 消费者是否在等待数据
+    std::atomic<bool> writerWaiting;        // 生产者是否在等待空位
+    PacketQueueStats pushed;                // 写入的累计值，只由生产者修改
+    PacketQueueStats popped;                // 取出的累计值，只由消费者修改
+    std::atomic<int> abort_request;
 };
 
 #endif //EPLAYER_PACKETQUEUE_H
@@ -0,0 +1,74 @@
+
+#ifndef EPLAYER_PCMQUEUE_H
+#define EPLAYER_PCMQUEUE_H
+
+#include <atomic>
+#include "Mutex.h"
+#include "Condition.h"
+
+extern "C" {
+#include "libavutil/mem.h"
+};
+
+// PCM队列最大缓冲块数
+#define PCM_QUEUE_MAX_DEPTH 64
+// 生产者等待空位的超时时间，音频回调不会阻塞加锁，这里作为兜底，单位ns
+#define PCM_QUEUE_WAIT_TIMEOUT (10 * 1000 * 1000)
+
+/**
+ * 重采样后的PCM数据块
+ */
+typedef struct PcmBuffer {
+    uint8_t *data;              // PCM数据
+    unsigned int capacity;      // 已分配的大小
+    int size;                   // 数据大小
+    double clock;               // 这块数据播放完时的音频时钟
+    int serial;                 // 序列号，flush以后旧序列号的数据会被丢弃
+} PcmBuffer;
+
+/**
+ * 单生产者(音频解码线程)/单消费者(音频回调)的无锁PCM环形队列
+ * 消费者永远不会阻塞，生产者只在队列已满时等待
+ */
+class PcmQueue {
+public:
+    PcmQueue(int depth);
+
+    virtual ~PcmQueue();
+
+    void start();
+
+    void abort();
+
+    // 清空队列，只更新序列号，由消费者丢弃旧数据
+    void flush();
+
+    // 获取可写的缓冲块，队列已满时阻塞，终止时返回NULL
+    PcmBuffer *peekWritable();
+
+    // 写入完成
+    void pushBuffer();
+
+    // 获取可读的缓冲块，不阻塞，没有数据时返回NULL
+    PcmBuffer *peekReadable();
+
+    // 读取完成，归还缓冲块
+    void popBuffer();
+
+    int getSerial();
+
+    int getBufferCount();
+
+private:
+    Mutex mMutex;                           // 只在生产者等待空位时使用
+    Condition mCondition;
+    PcmBuffer *buffers;
+    int depth;
+    std::atomic<unsigned int> rindex;       // 读位置，只由消费者写入
+    std::atomic<unsigned int> windex;       // 写位置，只由生产者写入
+    std::atomic<int> serial;
+    std::atomic<bool> writerWaiting;
+    std::atomic<int> abort_request;
+};
+
+#endif //EPLAYER_PCMQUEUE_H
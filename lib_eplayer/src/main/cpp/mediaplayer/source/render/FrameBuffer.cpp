@@ -7,8 +7,8 @@ TextureAttributes FrameBuffer::defaultTextureAttributes = {
         .magFilter = GL_LINEAR,
         .wrapS = GL_CLAMP_TO_EDGE,
         .wrapT = GL_CLAMP_TO_EDGE,
-        .internalFormat = GL_RGBA,
         .format = GL_RGBA,
+        .internalFormat = GL_RGBA,
         .type = GL_UNSIGNED_BYTE
 };
 
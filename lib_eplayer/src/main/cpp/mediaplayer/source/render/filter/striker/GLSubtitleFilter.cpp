@@ -0,0 +1,79 @@
+
+#include "GLSubtitleFilter.h"
+
+// 字幕纹理坐标，字幕图像的第一行在纹理坐标的原点
+const static GLfloat SUBTITLE_COORD[] = {
+        0.0f, 1.0f, // 左下
+        1.0f, 1.0f, // 右下
+        0.0f, 0.0f, // 左上，原点
+        1.0f, 0.0f, // 右上
+};
+
+GLSubtitleFilter::GLSubtitleFilter() {
+    mSubtitleTexture = 0;
+    mHasSubtitle = false;
+    memset(mVertices, 0, sizeof(mVertices));
+}
+
+GLSubtitleFilter::~GLSubtitleFilter() {
+}
+
+void GLSubtitleFilter::destroyProgram() {
+    if (mSubtitleTexture) {
+        glDeleteTextures(1, &mSubtitleTexture);
+        mSubtitleTexture = 0;
+    }
+    mHasSubtitle = false;
+    GLOutFilter::destroyProgram();
+    setInitialized(false);
+}
+
+void GLSubtitleFilter::setSubtitle(uint8_t *rgba, int width, int height, float x, float y, float w, float h) {
+    if (!rgba || width <= 0 || height <= 0) {
+        mHasSubtitle = false;
+        return;
+    }
+    if (!mSubtitleTexture) {
+        glGenTextures(1, &mSubtitleTexture);
+        glBindTexture(GL_TEXTURE_2D, mSubtitleTexture);
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    } else {
+        glBindTexture(GL_TEXTURE_2D, mSubtitleTexture);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // 归一化坐标转换成顶点坐标，y轴方向相反
+    float left = -1.0f + 2.0f * x;
+    float right = -1.0f + 2.0f * (x + w);
+    float top = 1.0f - 2.0f * y;
+    float bottom = 1.0f - 2.0f * (y + h);
+    const float vertices[] = {
+            left, bottom,   // 左下
+            right, bottom,  // 右下
+            left, top,      // 左上
+            right, top,     // 右上
+    };
+    memcpy(mVertices, vertices, sizeof(mVertices));
+    mHasSubtitle = true;
+}
+
+bool GLSubtitleFilter::hasSubtitle() {
+    return mHasSubtitle;
+}
+
+void GLSubtitleFilter::drawSubtitle() {
+    if (!isInitialized() || !mHasSubtitle || displayWidth == 0 || displayHeight == 0) {
+        return;
+    }
+    glViewport(0, 0, displayWidth, displayHeight);
+    // 字幕像素已经预乘透明度
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    drawTexture(mSubtitleTexture, mVertices, SUBTITLE_COORD, false);
+    glDisable(GL_BLEND);
+}
@@ -0,0 +1,37 @@
+
+#ifndef EPLAYER_GLSUBTITLEFILTER_H
+#define EPLAYER_GLSUBTITLEFILTER_H
+
+#include "GLOutFilter.h"
+
+/**
+ * 字幕叠加滤镜，在显示节点输出画面以后把字幕纹理混合到屏幕上
+ * 字幕只在内容变化时上传一次纹理，每一帧只绘制一个四边形，顶点使用跟显示节点相同的适配矩阵，字幕跟着视频画面缩放
+ */
+class GLSubtitleFilter : public GLOutFilter {
+public:
+    GLSubtitleFilter();
+
+    virtual ~GLSubtitleFilter();
+
+    void destroyProgram() override;
+
+    /**
+     * 上传字幕图像，rgba为预乘透明度的RGBA数据，为NULL时清除字幕
+     * x、y、w、h是字幕图像在视频画面中的位置和大小，以视频宽高归一化到0~1，原点在左上角
+     */
+    void setSubtitle(uint8_t *rgba, int width, int height, float x, float y, float w, float h);
+
+    // 是否有需要显示的字幕
+    bool hasSubtitle();
+
+    // 混合绘制字幕，不清除屏幕
+    void drawSubtitle();
+
+private:
+    GLuint mSubtitleTexture;        // 字幕纹理对象
+    bool mHasSubtitle;              // 是否有字幕
+    float mVertices[8];             // 字幕四边形的顶点坐标
+};
+
+#endif //EPLAYER_GLSUBTITLEFILTER_H
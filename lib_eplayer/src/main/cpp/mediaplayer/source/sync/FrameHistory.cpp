@@ -0,0 +1,101 @@
+
+#include "FrameHistory.h"
+
+FrameHistory::FrameHistory(int capacity) {
+    this->capacity = FFMAX(capacity, 0);
+    frames = NULL;
+    if (this->capacity > 0) {
+        frames = (Frame *) av_mallocz_array((size_t) this->capacity, sizeof(Frame));
+        if (!frames) {
+            this->capacity = 0;
+        }
+    }
+    for (int i = 0; i < this->capacity; i++) {
+        frames[i].frame = av_frame_alloc();
+    }
+    head = 0;
+    count = 0;
+    position = -1;
+}
+
+FrameHistory::~FrameHistory() {
+    for (int i = 0; i < capacity; i++) {
+        av_frame_free(&frames[i].frame);
+    }
+    av_freep(&frames);
+}
+
+Frame *FrameHistory::at(int index) {
+    return &frames[(head + index) % capacity];
+}
+
+void FrameHistory::push(Frame *vp) {
+    if (capacity <= 0) {
+        return;
+    }
+    while (count > position + 1) {
+        av_frame_unref(at(--count)->frame);
+    }
+    if (count == capacity) {
+        av_frame_unref(at(0)->frame);
+        head = (head + 1) % capacity;
+        count--;
+    }
+    Frame *dst = at(count);
+    if (!dst->frame || av_frame_ref(dst->frame, vp->frame) < 0) {
+        position = count - 1;
+        return;
+    }
+    dst->pts = vp->pts;
+    dst->duration = vp->duration;
+    dst->width = vp->width;
+    dst->height = vp->height;
+    dst->format = vp->format;
+    dst->seekFrame = 0;
+    // 纹理中是帧队列中的同一帧，不需要再上传
+    dst->uploaded = 1;
+    position = count++;
+}
+
+/**
+ * 纹理中已经是别的帧，取出的帧需要重新上传
+ * @return
+ */
+Frame *FrameHistory::back() {
+    if (position <= 0) {
+        return NULL;
+    }
+    Frame *vp = at(--position);
+    vp->uploaded = 0;
+    return vp;
+}
+
+Frame *FrameHistory::forward() {
+    if (position < 0 || position >= count - 1) {
+        return NULL;
+    }
+    Frame *vp = at(++position);
+    vp->uploaded = 0;
+    return vp;
+}
+
+Frame *FrameHistory::current() {
+    return position >= 0 ? at(position) : NULL;
+}
+
+int FrameHistory::getPosition() {
+    return FFMAX(position, 0);
+}
+
+bool FrameHistory::isRewound() {
+    return position >= 0 && position < count - 1;
+}
+
+void FrameHistory::clear() {
+    for (int i = 0; i < count; i++) {
+        av_frame_unref(at(i)->frame);
+    }
+    head = 0;
+    count = 0;
+    position = -1;
+}
@@ -43,6 +43,15 @@ void MediaClock::setSpeed(double speed) {
     this->speed = speed;
 }
 
+void MediaClock::setPaused(int paused) {
+    if (this->paused == paused) {
+        return;
+    }
+    // 以当前值重新计时，恢复以后从暂停时的值继续走
+    setClock(getClock());
+    this->paused = paused;
+}
+
 void MediaClock::syncToSlave(MediaClock *slave) {
     double clock = getClock();
     double slave_clock = slave->getClock();
@@ -1,10 +1,12 @@
 
+#include <sys/resource.h>
 #include "MediaSync.h"
 
 MediaSync::MediaSync(PlayerState *playerState) {
     this->playerState = playerState;
     audioDecoder = NULL;
     videoDecoder = NULL;
+    subtitleDecoder = NULL;
     audioClock = new MediaClock();
     videoClock = new MediaClock();
     extClock = new MediaClock();
@@ -15,9 +17,35 @@ MediaSync::MediaSync(PlayerState *playerState) {
 
     forceRefresh = 0;
     maxFrameDuration = 10.0;
+    startTime = AV_NOPTS_VALUE;
     frameTimerRefresh = 1;
     frameTimer = 0;
-
+    bufferingPercent = 0;
+    firstFrameRendered = false;
+    shownSubtitle = NULL;
+    subtitleSerial = 0;
+    subtitleBitmapShown = false;
+    subtitleTextShown = false;
+    subtitleBuffer = NULL;
+    subtitleBufferSize = 0;
+    frameHistory = NULL;
+    historyShown = false;
+    steppedPts = NAN;
+    reverseDecoder = NULL;
+    reverseCompleted = false;
+    reverseSeekPosition = -1;
+    reverseFrames = 0;
+    reverseDropped = 0;
+    reverseFirstTime = 0;
+    reverseLastTime = 0;
+    lastShownTime = NAN;
+    statsSpeed = 0;
+    shownFrames = 0;
+    lateDropped = 0;
+    refreshDropped = 0;
+    decoderDropped = 0;
+    statsStartTime = 0;
+    statsStartCpu = 0;
 
     videoDevice = NULL;
     swsContext = NULL;
@@ -33,8 +61,19 @@ void MediaSync::reset() {
     playerState = NULL;
     videoDecoder = NULL;
     audioDecoder = NULL;
+    subtitleDecoder = NULL;
+    reverseDecoder = NULL;
+    shownSubtitle = NULL;
     videoDevice = NULL;
 
+    if (subtitleBuffer) {
+        av_freep(&subtitleBuffer);
+        subtitleBufferSize = 0;
+    }
+    if (frameHistory) {
+        delete frameHistory;
+        frameHistory = NULL;
+    }
     if (pFrameARGB) {
         av_frame_free(&pFrameARGB);
         av_free(pFrameARGB);
@@ -55,7 +94,12 @@ void MediaSync::start(VideoDecoder *videoDecoder, AudioDecoder *audioDecoder) {
     this->videoDecoder = videoDecoder;
     this->audioDecoder = audioDecoder;
     abortRequest = false;
-    mExit = false;
+    // 没有视频时不启动同步线程，stop不需要等待
+    mExit = !videoDecoder && !syncThread;
+    firstFrameRendered = false;
+    if (!frameHistory) {
+        frameHistory = new FrameHistory(playerState->stepCacheFrames);
+    }
     mCondition.signal();
     mMutex.unlock();
     if (videoDecoder && !syncThread) {
@@ -70,6 +114,7 @@ void MediaSync::stop() {
     abortRequest = true;
     mCondition.signal();
     mMutex.unlock();
+    playerState->signalGate();
 
     mMutex.lock();
     while (!mExit) {
@@ -82,6 +127,7 @@ void MediaSync::stop() {
         LOGD("删除同步线程");
         syncThread = NULL;
     }
+    updatePlaybackStats(true);
 }
 
 void MediaSync::setVideoDevice(VideoDevice *device) {
@@ -89,6 +135,44 @@ void MediaSync::setVideoDevice(VideoDevice *device) {
     this->videoDevice = device;
 }
 
+void MediaSync::setSubtitleDecoder(SubtitleDecoder *subtitleDecoder) {
+    Mutex::Autolock lock(mMutex);
+    this->subtitleDecoder = subtitleDecoder;
+    shownSubtitle = NULL;
+    // 切换字幕时旧的字幕可能还在显示，序号不一致以后由同步线程清除
+    subtitleSerial = -1;
+}
+
+/**
+ * 倒放时视频时钟暂停，只在显示倒放的帧时设置，结束倒放以后恢复走动
+ * @param reverseDecoder
+ */
+void MediaSync::setReverseDecoder(ReverseDecoder *reverseDecoder, int seekPosition) {
+    Mutex::Autolock lock(mMutex);
+    // 显示第一帧之前是启动和解码第一个GOP的时间，稳定以后的帧率从第一帧开始计算
+    if (this->reverseDecoder && reverseFrames > 1 && reverseLastTime > reverseFirstTime) {
+        LOGD("倒放显示%d帧，丢弃%d帧，平均%.1ffps", reverseFrames, reverseDropped,
+             (reverseFrames - 1) * 1000000.0 / (reverseLastTime - reverseFirstTime));
+    }
+    this->reverseDecoder = reverseDecoder;
+    reverseCompleted = false;
+    reverseSeekPosition = reverseDecoder ? seekPosition : -1;
+    reverseFrames = 0;
+    reverseDropped = 0;
+    reverseFirstTime = 0;
+    reverseLastTime = 0;
+    frameTimerRefresh = 1;
+    videoClock->setPaused(reverseDecoder ? 1 : 0);
+    if (reverseDecoder) {
+        videoClock->setClock(reverseDecoder->getStartPosition());
+        extClock->syncToSlave(videoClock);
+    }
+}
+
+void MediaSync::setStartTime(int64_t startTime) {
+    this->startTime = startTime;
+}
+
 void MediaSync::setMaxDuration(double maxDuration) {
     this->maxFrameDuration = maxDuration;
 }
@@ -109,6 +193,14 @@ void MediaSync::refreshVideoTimer() {
  * @param time 音频回调时间，单位也是秒
  */
 void MediaSync::updateAudioClock(double pts, double time) {
+    // 倒放时音频静音，音频时钟停在开始倒放的位置
+    if (playerState->reversePlayback) {
+        return;
+    }
+    double speed = getPlaybackSpeed();
+    if (audioClock->getSpeed() != speed) {
+        audioClock->setSpeed(speed);
+    }
     audioClock->setClock(pts, time);
     extClock->syncToSlave(audioClock);
 }
@@ -122,11 +214,14 @@ void MediaSync::updateExternalClock(double pts) {
 }
 
 /**
- * 默认以音频时钟为主时钟
+ * 默认以音频时钟为主时钟，倒放时音频静音，以视频时钟为主时钟
  * @return
  */
 double MediaSync::getMasterClock() {
     double val = 0;
+    if (playerState->reversePlayback) {
+        return videoClock->getClock();
+    }
     switch (playerState->syncType) {
         case AV_SYNC_VIDEO: {
             val = videoClock->getClock();
@@ -144,6 +239,75 @@ double MediaSync::getMasterClock() {
     return val;
 }
 
+/**
+ * 缓冲状态机，读数据包线程和同步线程都会调用
+ * 有数据包队列取空时开始缓冲并暂停时钟，每一路流都缓冲到bufferingSeconds、读到结尾或者队列内存达到上限时结束缓冲
+ */
+void MediaSync::updateBuffering() {
+    Mutex::Autolock lock(mMutex);
+    if (playerState->abortRequest) {
+        return;
+    }
+    if (!playerState->buffering) {
+        // 读到结尾、暂停、定位、切换音频轨道和倒放时队列为空是正常的
+        if (playerState->eof || playerState->pauseRequest || playerState->seekRequest
+            || playerState->switchingAudio || playerState->reversePlayback || !isStarving()) {
+            return;
+        }
+        playerState->buffering = 1;
+        bufferingPercent = 0;
+        setClockPaused(1);
+        LOGD("开始缓冲");
+        if (playerState->messageQueue) {
+            playerState->messageQueue->postMessage(MSG_BUFFERING_START);
+        }
+        return;
+    }
+
+    double progress = FFMIN(audioDecoder ? audioDecoder->getBufferingProgress() : 1.0,
+                            videoDecoder ? videoDecoder->getBufferingProgress() : 1.0);
+    int memorySize = (audioDecoder ? audioDecoder->getMemorySize() : 0) +
+                     (videoDecoder ? videoDecoder->getMemorySize() : 0);
+    if (playerState->eof || memorySize > MAX_QUEUE_SIZE) {
+        progress = 1.0;
+    }
+    int percent = (int) (progress * 100);
+    if (percent != bufferingPercent) {
+        bufferingPercent = percent;
+        if (playerState->messageQueue) {
+            playerState->messageQueue->postMessage(MSG_BUFFERING_UPDATE, percent, 0);
+        }
+    }
+    if (percent >= 100) {
+        playerState->buffering = 0;
+        setClockPaused(0);
+        // 缓冲期间没有显示视频帧，重新开始计时
+        frameTimerRefresh = 1;
+        LOGD("缓冲结束");
+        if (playerState->messageQueue) {
+            playerState->messageQueue->postMessage(MSG_BUFFERING_END);
+        }
+    }
+}
+
+/**
+ * 视频需要数据包队列和帧队列都为空，封面不算
+ * @return
+ */
+bool MediaSync::isStarving() {
+    if (videoDecoder && !(videoDecoder->getStream()->disposition & AV_DISPOSITION_ATTACHED_PIC)
+        && videoDecoder->getPacketSize() == 0 && videoDecoder->getFrameSize() == 0) {
+        return true;
+    }
+    return audioDecoder && audioDecoder->getPacketSize() == 0;
+}
+
+void MediaSync::setClockPaused(int paused) {
+    audioClock->setPaused(paused);
+    videoClock->setPaused(paused);
+    extClock->setPaused(paused);
+}
+
 MediaClock *MediaSync::getAudioClock() {
     return audioClock;
 }
@@ -168,15 +332,25 @@ void MediaSync::run() {
             break;
         }
 
+        /*暂停的时候会阻塞在这里，继续播放、逐帧步进或者退出时被唤醒*/
+        if (playerState->pauseRequest && !forceRefresh && !playerState->stepRequest) {
+            playerState->waitForResume(&abortRequest);
+            remaining_time = 0.0;
+            continue;
+        }
+
         if (remaining_time > 0.0) {
             av_usleep((int64_t) (remaining_time * 1000000.0));
         }
         remaining_time = REFRESH_RATE; //刷新率
 
-        /*暂停的时候会停留在这里*/
-        if (!playerState->pauseRequest || forceRefresh) {
-            refreshVideo(&remaining_time);
+        /*缓冲的时候停留在正在显示的那一帧*/
+        updateBuffering();
+        if (playerState->buffering) {
+            continue;
         }
+
+        refreshVideo(&remaining_time);
     }
 
     mExit = true;
@@ -185,12 +359,20 @@ void MediaSync::run() {
 
 void MediaSync::refreshVideo(double *remaining_time) {
     double time;
+    double speed = getPlaybackSpeed();
 
-    // 检查外部时钟
+    // 检查外部时钟，直播低延时模式下外部时钟跟随追赶速度，不再按队列长度微调
     if (!playerState->pauseRequest && playerState->realTime &&
-        playerState->syncType == AV_SYNC_EXTERNAL) {
+        playerState->syncType == AV_SYNC_EXTERNAL && !playerState->liveMode) {
         checkExternalClockSpeed();
     }
+    updateClockSpeed();
+    updatePlaybackStats(false);
+
+    // 暂停时逐帧步进，不按播放时机显示
+    if (playerState->pauseRequest && playerState->stepRequest) {
+        stepVideo();
+    }
 
     for (;;) {
 
@@ -198,6 +380,12 @@ void MediaSync::refreshVideo(double *remaining_time) {
             break;
         }
 
+        // 倒放时帧队列中的帧不再显示
+        if (playerState->reversePlayback) {
+            refreshReverse(remaining_time);
+            break;
+        }
+
         // 判断帧队列是否存在数据
         if (videoDecoder->getFrameSize() > 0) {
             double lastDuration, duration, delay;
@@ -210,6 +398,7 @@ void MediaSync::refreshVideo(double *remaining_time) {
             if (frameTimerRefresh) {
                 frameTimer = av_gettime_relative() / 1000000.0;
                 frameTimerRefresh = 0;
+                lastShownTime = NAN;
             }
 
             // 如果处于暂停状态，跳出循环，会一直播放正在显示的那一帧
@@ -217,8 +406,13 @@ void MediaSync::refreshVideo(double *remaining_time) {
                 break;
             }
 
-            // 计算上一帧时长，即当前正在播放帧的正常播放时长
-            lastDuration = calculateDuration(lastFrame, currentFrame);
+            // 有还没处理完的定位请求时，队列中的帧属于旧的定位位置，不再显示
+            if (playerState->seekRequest) {
+                break;
+            }
+
+            // 计算上一帧时长，即当前正在播放帧的正常播放时长，倍速播放时按播放速度缩短
+            lastDuration = calculateDuration(lastFrame, currentFrame) / speed;
             // 关键部位，计算延时，即到播放下一帧需要延时多长时间
             delay = calculateDelay(lastDuration);
             // 处理延时超过阈值的情况
@@ -261,7 +455,7 @@ void MediaSync::refreshVideo(double *remaining_time) {
             // 如果队列中还有数据，需要拿到下一帧，然后计算间隔，并判断是否需要进行舍帧操作
             if (videoDecoder->getFrameSize() > 1) {
                 Frame *nextFrame = videoDecoder->getFrameQueue()->nextFrame();
-                duration = calculateDuration(currentFrame, nextFrame);
+                duration = calculateDuration(currentFrame, nextFrame) / speed;
                 // 条件1：可跳帧并且不是同步到视频
                 // 条件2：当前帧未能及时播放，即播放完当前帧的时刻也小于当前系统时刻(time)，表示当前帧已经错过了播放时机，那么可能要弃帧了
                 // 结果： 舍弃一帧，不播放当前帧
@@ -270,6 +464,15 @@ void MediaSync::refreshVideo(double *remaining_time) {
                                                                                       AV_SYNC_VIDEO))) {
                     //舍弃上一帧，不播放当前帧，继续循环
                     videoDecoder->getFrameQueue()->popFrame();
+                    lateDropped++;
+                    continue;
+                }
+                // 显示帧率超过屏幕刷新率时，这一帧离上一帧的显示时机不到一个刷新间隔，显示出来也会马上被下一帧覆盖
+                // 留出10%的余量，帧间隔正好等于刷新间隔时不会因为计时误差丢帧
+                if (playerState->frameDrop && playerState->displayRefreshRate > 0 && !isnan(lastShownTime)
+                    && frameTimer - lastShownTime < 0.9 / playerState->displayRefreshRate) {
+                    videoDecoder->getFrameQueue()->popFrame();
+                    refreshDropped++;
                     continue;
                 }
             }
@@ -277,6 +480,9 @@ void MediaSync::refreshVideo(double *remaining_time) {
             /*播放当前帧时机已到*/
             // 取出并舍弃一帧，即上一帧 lastFrame，此时当前帧就变成了上一帧，所以下面renderVideo方法中取出当前帧播放的时候，调用的是lastFrame
             videoDecoder->getFrameQueue()->popFrame();
+            historyShown = false;
+            lastShownTime = frameTimer;
+            shownFrames++;
             // 当还需要延时的时候，即当前帧播放时机未到时，是执行不到这里的，所以延时阶段
             // forceRefresh为0，所以不会调用renderVideo方法，但是当延时到期以后，就会执行到这里，
             // 代表需要进行下一帧视频的渲染了，然后调用renderVideo方法，调用之后forceRefresh又为0
@@ -290,7 +496,7 @@ void MediaSync::refreshVideo(double *remaining_time) {
     // 如果是同步到视频时钟，在这里也通知当前时长
     if (playerState->messageQueue && playerState->syncType == AV_SYNC_VIDEO) {
         // 起始延时
-        int64_t start_time = videoDecoder->getFormatContext()->start_time;
+        int64_t start_time = startTime;
         int64_t start_diff = 0;
         if (start_time > 0 && start_time != AV_NOPTS_VALUE) {
             start_diff = av_rescale(start_time, 1000, AV_TIME_BASE);
@@ -313,14 +519,259 @@ void MediaSync::refreshVideo(double *remaining_time) {
         playerState->messageQueue->postMessage(MSG_CURRENT_POSITON, pos, playerState->videoDuration);
     }
 
+    // 字幕变化时会设置forceRefresh，重新绘制当前帧
+    updateSubtitle();
+
     /*渲染视频帧*/
     if (!playerState->displayDisable && forceRefresh && videoDecoder
-        && videoDecoder->getFrameQueue()->getShowIndex()) {
+        && (playerState->reversePlayback || videoDecoder->getFrameQueue()->getShowIndex())) {
         renderVideo(); //渲染
     }
     forceRefresh = 0;
 }
 
+/**
+ * 帧间隔按播放速度缩短，倍速倒放时解码不过来也靠丢弃错过显示时机的帧跟上
+ * 倒放到开头以后停在第一帧，通知播放完成
+ * @param remaining_time
+ */
+void MediaSync::refreshReverse(double *remaining_time) {
+    Mutex::Autolock lock(mMutex);
+    if (!reverseDecoder || playerState->pauseRequest) {
+        return;
+    }
+    double rate = FFMAX(playerState->playbackRate, 0.1f);
+
+    for (;;) {
+        Frame *nextFrame = reverseDecoder->peekFrame(0);
+        if (!nextFrame) {
+            if (!reverseCompleted && reverseDecoder->isFinished()) {
+                reverseCompleted = true;
+                LOGD("倒放到开头");
+                // 定位的位置之前没有帧可以显示
+                if (reverseSeekPosition >= 0 && playerState->messageQueue) {
+                    playerState->messageQueue->postMessage(MSG_SEEK_COMPLETE, reverseSeekPosition, 0);
+                }
+                reverseSeekPosition = -1;
+                if (playerState->messageQueue) {
+                    playerState->messageQueue->postMessage(MSG_COMPLETED);
+                }
+            }
+            break;
+        }
+        double time = av_gettime_relative() / 1000000.0;
+        if (frameTimerRefresh) {
+            frameTimer = time;
+            frameTimerRefresh = 0;
+        }
+        // 倒放时正在显示的帧比下一帧晚，间隔是两帧时间戳的差
+        Frame *shownFrame = reverseDecoder->getShownFrame();
+        double delay = shownFrame ? calculateDuration(nextFrame, shownFrame) / rate : 0;
+        if (isnan(frameTimer) || time < frameTimer) {
+            frameTimer = time;
+        }
+        if (time < frameTimer + delay) {
+            *remaining_time = FFMIN(frameTimer + delay - time, *remaining_time);
+            break;
+        }
+        frameTimer += delay;
+        if (delay > 0 && time - frameTimer > AV_SYNC_THRESHOLD_MAX) {
+            frameTimer = time;
+        }
+
+        // 下一帧也已经错过了显示时机，直接丢弃
+        Frame *followFrame = reverseDecoder->peekFrame(1);
+        if (followFrame && playerState->frameDrop > 0
+            && time > frameTimer + calculateDuration(followFrame, nextFrame) / rate) {
+            reverseDecoder->popFrame();
+            reverseDropped++;
+            continue;
+        }
+
+        reverseDecoder->popFrame();
+        shownFrame = reverseDecoder->getShownFrame();
+        if (shownFrame && !isnan(shownFrame->pts)) {
+            videoClock->setClock(shownFrame->pts);
+            extClock->syncToSlave(videoClock);
+        }
+        reverseLastTime = av_gettime_relative();
+        if (reverseFrames++ == 0) {
+            reverseFirstTime = reverseLastTime;
+        }
+        forceRefresh = 1;
+        // 同步到视频时钟时由refreshVideo统一通知
+        if (playerState->messageQueue && playerState->syncType != AV_SYNC_VIDEO) {
+            playerState->messageQueue->postMessage(MSG_CURRENT_POSITON, getCurrentPosition(),
+                                                   playerState->videoDuration);
+        }
+        break;
+    }
+}
+
+/**
+ * 字幕结束时间已到或者下一条字幕已经开始时取出，没有结束时间的字幕一直显示到下一条字幕
+ * 只有显示的字幕变化时才重新合成图像，字幕不变时每一帧只绘制已经上传的纹理
+ */
+void MediaSync::updateSubtitle() {
+    // 运行时切换字幕会替换字幕解码器
+    Mutex::Autolock lock(mMutex);
+    if (playerState->displayDisable) {
+        return;
+    }
+    // 倒放时不显示字幕
+    if (!subtitleDecoder || playerState->reversePlayback) {
+        clearSubtitle();
+        return;
+    }
+    // 定位清空了帧队列，正在显示的字幕已经被释放
+    int serial = subtitleDecoder->getSerial();
+    if (serial != subtitleSerial) {
+        subtitleSerial = serial;
+        shownSubtitle = NULL;
+        clearSubtitle();
+    }
+    if (playerState->seekRequest) {
+        return;
+    }
+    double clock = getMasterClock();
+    if (isnan(clock)) {
+        return;
+    }
+
+    FrameQueue *queue = subtitleDecoder->getFrameQueue();
+    while (queue->getFrameSize() > 0) {
+        Frame *sp = queue->currentFrame();
+        Frame *next = queue->getFrameSize() > 1 ? queue->nextFrame() : NULL;
+        if (!(!isnan(sp->duration) && clock > sp->pts + sp->duration) && !(next && clock >= next->pts)) {
+            break;
+        }
+        if (sp == shownSubtitle) {
+            shownSubtitle = NULL;
+            clearSubtitle();
+        }
+        queue->popFrame();
+    }
+
+    Frame *active = NULL;
+    if (queue->getFrameSize() > 0 && clock >= queue->currentFrame()->pts) {
+        active = queue->currentFrame();
+    }
+    if (active == shownSubtitle) {
+        return;
+    }
+    shownSubtitle = active;
+    if (!active || active->sub.num_rects == 0) {
+        clearSubtitle();
+    } else if (active->sub.format == 0) {
+        renderSubtitleBitmap(active);
+    } else {
+        char *text = SubtitleDecoder::getSubtitleText(&active->sub);
+        if (subtitleBitmapShown && videoDevice) {
+            videoDevice->onUpdateSubtitle(NULL, 0, 0, 0, 0, 0, 0);
+            subtitleBitmapShown = false;
+            forceRefresh = 1;
+        }
+        if (text && playerState->messageQueue) {
+            playerState->messageQueue->postMessage(MSG_TIMED_TEXT, 0, 0, text, (int) strlen(text) + 1);
+            subtitleTextShown = true;
+        } else if (subtitleTextShown && playerState->messageQueue) {
+            playerState->messageQueue->postMessage(MSG_TIMED_TEXT);
+            subtitleTextShown = false;
+        }
+        av_free(text);
+    }
+}
+
+/**
+ * 位图字幕的像素是调色板索引，调色板在data[1]中，每一项是0xAARRGGBB
+ * 所有矩形合成到它们的外接矩形中，位置按字幕画布的大小归一化，画布大小未知时使用视频的大小
+ * @param sp
+ */
+void MediaSync::renderSubtitleBitmap(Frame *sp) {
+    AVSubtitle *sub = &sp->sub;
+    int left = INT_MAX, top = INT_MAX, right = 0, bottom = 0;
+    for (unsigned int i = 0; i < sub->num_rects; i++) {
+        AVSubtitleRect *rect = sub->rects[i];
+        if (rect->type != SUBTITLE_BITMAP || rect->w <= 0 || rect->h <= 0 || !rect->data[0] || !rect->data[1]) {
+            continue;
+        }
+        left = FFMIN(left, rect->x);
+        top = FFMIN(top, rect->y);
+        right = FFMAX(right, rect->x + rect->w);
+        bottom = FFMAX(bottom, rect->y + rect->h);
+    }
+    if (left >= right || top >= bottom || !videoDevice) {
+        clearSubtitle();
+        return;
+    }
+
+    int width = right - left;
+    int height = bottom - top;
+    av_fast_malloc(&subtitleBuffer, &subtitleBufferSize, (size_t) width * height * 4);
+    if (!subtitleBuffer) {
+        subtitleBufferSize = 0;
+        clearSubtitle();
+        return;
+    }
+    memset(subtitleBuffer, 0, (size_t) width * height * 4);
+
+    for (unsigned int i = 0; i < sub->num_rects; i++) {
+        AVSubtitleRect *rect = sub->rects[i];
+        if (rect->type != SUBTITLE_BITMAP || rect->w <= 0 || rect->h <= 0 || !rect->data[0] || !rect->data[1]) {
+            continue;
+        }
+        const uint32_t *palette = (const uint32_t *) rect->data[1];
+        for (int y = 0; y < rect->h; y++) {
+            const uint8_t *src = rect->data[0] + y * rect->linesize[0];
+            uint8_t *dst = subtitleBuffer + ((rect->y - top + y) * width + (rect->x - left)) * 4;
+            for (int x = 0; x < rect->w; x++, dst += 4) {
+                uint32_t color = palette[src[x]];
+                int alpha = color >> 24;
+                if (!alpha) {
+                    continue;
+                }
+                // 预乘透明度以后按source-over叠加，矩形重叠时后面的覆盖前面的
+                int inverse = 255 - alpha;
+                dst[0] = (uint8_t) ((((color >> 16) & 0xff) * alpha + dst[0] * inverse) / 255);
+                dst[1] = (uint8_t) ((((color >> 8) & 0xff) * alpha + dst[1] * inverse) / 255);
+                dst[2] = (uint8_t) (((color & 0xff) * alpha + dst[2] * inverse) / 255);
+                dst[3] = (uint8_t) ((alpha * 255 + dst[3] * inverse) / 255);
+            }
+        }
+    }
+
+    int canvasWidth = sp->width;
+    int canvasHeight = sp->height;
+    if ((canvasWidth <= 0 || canvasHeight <= 0) && videoDecoder) {
+        canvasWidth = videoDecoder->getCodecContext()->width;
+        canvasHeight = videoDecoder->getCodecContext()->height;
+    }
+    canvasWidth = FFMAX(canvasWidth, right);
+    canvasHeight = FFMAX(canvasHeight, bottom);
+
+    if (subtitleTextShown && playerState->messageQueue) {
+        playerState->messageQueue->postMessage(MSG_TIMED_TEXT);
+        subtitleTextShown = false;
+    }
+    videoDevice->onUpdateSubtitle(subtitleBuffer, width, height,
+                                  left / (float) canvasWidth, top / (float) canvasHeight,
+                                  width / (float) canvasWidth, height / (float) canvasHeight);
+    subtitleBitmapShown = true;
+    forceRefresh = 1;
+}
+
+void MediaSync::clearSubtitle() {
+    if (subtitleBitmapShown && videoDevice) {
+        videoDevice->onUpdateSubtitle(NULL, 0, 0, 0, 0, 0, 0);
+        forceRefresh = 1;
+    }
+    subtitleBitmapShown = false;
+    if (subtitleTextShown && playerState->messageQueue) {
+        playerState->messageQueue->postMessage(MSG_TIMED_TEXT);
+    }
+    subtitleTextShown = false;
+}
+
 void MediaSync::checkExternalClockSpeed() {
     if ((videoDecoder && videoDecoder->getPacketSize() <= EXTERNAL_CLOCK_MIN_FRAMES) ||
             (audioDecoder && audioDecoder->getPacketSize() <= EXTERNAL_CLOCK_MIN_FRAMES)) {
@@ -336,6 +787,57 @@ void MediaSync::checkExternalClockSpeed() {
     }
 }
 
+double MediaSync::getPlaybackSpeed() {
+    return FFMAX(playerState->playbackRate, 0.1f) * playerState->liveCatchUpRate;
+}
+
+/**
+ * 三个时钟的速度都跟随播放速度，音频时钟和视频时钟走得一样快，倍速播放时才不会靠同步阈值来回校正
+ * 实时流非低延时模式下外部时钟由checkExternalClockSpeed按队列长度微调，不在这里设置
+ */
+void MediaSync::updateClockSpeed() {
+    Mutex::Autolock lock(mMutex);
+    double speed = getPlaybackSpeed();
+    if (videoClock->getSpeed() != speed) {
+        videoClock->setSpeed(speed);
+    }
+    if (!(playerState->realTime && playerState->syncType == AV_SYNC_EXTERNAL && !playerState->liveMode)
+        && extClock->getSpeed() != speed) {
+        extClock->setSpeed(speed);
+    }
+}
+
+/**
+ * CPU占用按整个进程的用户态和内核态时间计算，包括解复用、解码、音频和渲染线程，100%表示占满一个核
+ * 统计时长包括暂停的时间，测量时需要连续播放
+ * @param finish 停止播放，输出以后不再开始新的统计
+ */
+void MediaSync::updatePlaybackStats(bool finish) {
+    if (finish ? statsSpeed <= 0 : statsSpeed == getPlaybackSpeed()) {
+        return;
+    }
+    int64_t now = av_gettime_relative();
+    int64_t cpu = 0;
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        cpu = (int64_t) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000
+              + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+    }
+    int dropped = videoDecoder ? videoDecoder->getDroppedFrames() : 0;
+    if (statsSpeed > 0 && now > statsStartTime) {
+        LOGD("%.2f倍速播放%.1fs，显示%d帧，错过显示时机丢弃%d帧，解码后丢弃%d帧，超过刷新率丢弃%d帧，CPU占用%.1f%%",
+             statsSpeed, (now - statsStartTime) / 1000000.0, shownFrames, lateDropped,
+             dropped - decoderDropped, refreshDropped, (cpu - statsStartCpu) * 100.0 / (now - statsStartTime));
+    }
+    statsSpeed = finish ? 0 : getPlaybackSpeed();
+    shownFrames = 0;
+    lateDropped = 0;
+    refreshDropped = 0;
+    decoderDropped = dropped;
+    statsStartTime = now;
+    statsStartCpu = cpu;
+}
+
 /**
  *
  * @param delay 为上一帧视频的播放时长
@@ -381,8 +883,8 @@ long MediaSync::getCurrentPosition() {
         currentPosition = playerState->seekPos;
     } else {
 
-        // 起始延时
-        int64_t start_time = videoDecoder->getFormatContext()->start_time;
+        // 起始延时，没有视频时由音频解码线程调用，不能从视频解码器取
+        int64_t start_time = startTime;
 
         int64_t start_diff = 0;
         if (start_time > 0 && start_time != AV_NOPTS_VALUE) {
@@ -405,14 +907,128 @@ long MediaSync::getCurrentPosition() {
     return (long) currentPosition;
 }
 
+/**
+ * 前进时先回到后退以前显示过的帧，再从帧队列中取出新的帧，后退只能退到历史记录中最早的帧
+ * 帧队列中还没有下一帧时保留请求，等解码出来以后再显示
+ */
+void MediaSync::stepVideo() {
+    if (!videoDecoder || playerState->seekRequest) {
+        return;
+    }
+    Frame *vp = NULL;
+    mMutex.lock();
+    if (playerState->stepRequest < 0) {
+        playerState->stepRequest++;
+        vp = frameHistory ? frameHistory->back() : NULL;
+    } else if (historyShown && frameHistory && frameHistory->isRewound()) {
+        playerState->stepRequest--;
+        vp = frameHistory->forward();
+    }
+    if (vp) {
+        historyShown = true;
+    }
+    mMutex.unlock();
+
+    if (!vp && playerState->stepRequest > 0) {
+        if (videoDecoder->getFrameSize() == 0) {
+            // 已经读到结尾并且解码完，没有下一帧了
+            if (playerState->eof && videoDecoder->getPacketSize() == 0) {
+                playerState->stepRequest = 0;
+            }
+            return;
+        }
+        playerState->stepRequest--;
+        videoDecoder->getFrameQueue()->popFrame();
+        mMutex.lock();
+        historyShown = false;
+        vp = videoDecoder->getFrameQueue()->lastFrame();
+        mMutex.unlock();
+    }
+    if (!vp) {
+        return;
+    }
+
+    // 所有时钟都停在显示的帧上，字幕和播放进度跟着显示的帧走
+    mMutex.lock();
+    if (!isnan(vp->pts)) {
+        audioClock->setClock(vp->pts);
+        videoClock->setClock(vp->pts);
+        extClock->setClock(vp->pts);
+        steppedPts = vp->pts;
+    }
+    mMutex.unlock();
+    forceRefresh = 1;
+    if (playerState->messageQueue) {
+        playerState->messageQueue->postMessage(MSG_CURRENT_POSITON, getCurrentPosition(), playerState->videoDuration);
+    }
+}
+
+bool MediaSync::hasPreviousFrame(int pendingSteps) {
+    Mutex::Autolock lock(mMutex);
+    return frameHistory && frameHistory->getPosition() + pendingSteps > 0;
+}
+
+bool MediaSync::getShownFrame(double *pts, double *duration) {
+    Mutex::Autolock lock(mMutex);
+    if (!videoDecoder) {
+        return false;
+    }
+    Frame *vp = NULL;
+    if (reverseDecoder) {
+        vp = reverseDecoder->getShownFrame();
+    } else if (historyShown && frameHistory) {
+        vp = frameHistory->current();
+    } else if (videoDecoder->getFrameQueue()->getShowIndex()) {
+        vp = videoDecoder->getFrameQueue()->lastFrame();
+    }
+    if (!vp || isnan(vp->pts)) {
+        return false;
+    }
+    *pts = vp->pts;
+    *duration = vp->duration;
+    return true;
+}
+
+double MediaSync::takeSteppedPts() {
+    Mutex::Autolock lock(mMutex);
+    double pts = steppedPts;
+    steppedPts = NAN;
+    return pts;
+}
+
+/**
+ * 历史记录中的帧属于定位之前的位置，继续播放时也不再需要重新定位
+ */
+void MediaSync::clearFrameHistory() {
+    Mutex::Autolock lock(mMutex);
+    if (frameHistory) {
+        frameHistory->clear();
+    }
+    historyShown = false;
+    steppedPts = NAN;
+}
+
 void MediaSync::renderVideo() {
     mMutex.lock();
     if (!videoDecoder || !videoDevice) {
         mMutex.unlock();
         return;
     }
-    // 取出帧进行播放
+    // 取出帧进行播放，逐帧步进到历史记录中的帧时显示历史记录中的帧
     Frame *vp = videoDecoder->getFrameQueue()->lastFrame();
+    if (playerState->reversePlayback) {
+        // 倒放时显示倒放解码器的帧，不记录到逐帧后退的历史记录中
+        vp = reverseDecoder ? reverseDecoder->getShownFrame() : NULL;
+        if (!vp) {
+            mMutex.unlock();
+            return;
+        }
+    } else if (historyShown && frameHistory && frameHistory->current()) {
+        vp = frameHistory->current();
+    } else if (!vp->uploaded && frameHistory) {
+        // 第一次显示的帧记录下来，逐帧后退时使用
+        frameHistory->push(vp);
+    }
 
     int ret = 0;
     if (!vp->uploaded) {
@@ -533,6 +1149,31 @@ void MediaSync::renderVideo() {
         // 设置视频播放的时间戳
         videoDevice->setTimeStamp(isnan(vp->pts) ? 0 : vp->pts);
         videoDevice->onRequestRender(vp->frame->linesize[0] < 0);
+        // 第一帧已经显示，通知从开始打开文件到显示的起播耗时
+        if (!firstFrameRendered) {
+            firstFrameRendered = true;
+            int64_t latency = (av_gettime_relative() - playerState->openStartTime) / 1000;
+            LOGD("起播耗时%lldms", (long long) latency);
+            if (playerState->messageQueue) {
+                playerState->messageQueue->postMessage(MSG_VIDEO_RENDERING_START, (int) latency);
+            }
+        }
+        // 倒放时定位以后的第一帧已经显示，通知定位完成
+        if (playerState->reversePlayback && reverseSeekPosition >= 0) {
+            if (playerState->messageQueue) {
+                playerState->messageQueue->postMessage(MSG_SEEK_COMPLETE, reverseSeekPosition, 0);
+            }
+            reverseSeekPosition = -1;
+        }
+        // 定位以后的第一帧已经显示，通知最后一次定位请求到显示的耗时
+        if (vp->seekFrame) {
+            vp->seekFrame = 0;
+            int64_t latency = (av_gettime_relative() - playerState->seekStartTime) / 1000;
+            LOGD("定位到第一帧显示耗时%lldms", (long long) latency);
+            if (playerState->messageQueue && !playerState->seekRequest) {
+                playerState->messageQueue->postMessage(MSG_SEEK_RENDERING_START, (int) latency);
+            }
+        }
     }
     // 当文件没有音频的时候，用视频时间戳来通知当前播放时间
     if (audioDecoder == NULL && playerState->messageQueue) {
@@ -0,0 +1,48 @@
+
+#ifndef EPLAYER_FRAMEHISTORY_H
+#define EPLAYER_FRAMEHISTORY_H
+
+#include "FrameQueue.h"
+
+/**
+ * 最近显示过的视频帧，暂停时逐帧后退直接从这里取出，不需要重新定位解码
+ * 只增加帧缓冲的引用计数，跟帧队列共享图像内存，不是线程安全的，由同步器加锁
+ */
+class FrameHistory {
+public:
+    FrameHistory(int capacity);
+
+    virtual ~FrameHistory();
+
+    // 记录刚显示的帧，后退过时丢弃当前位置之后的记录，满了以后丢弃最早的帧
+    void push(Frame *vp);
+
+    // 后退一帧，没有更早的帧时返回NULL
+    Frame *back();
+
+    // 前进一帧，已经是最新的帧时返回NULL
+    Frame *forward();
+
+    // 当前位置的帧，没有记录时返回NULL
+    Frame *current();
+
+    // 当前位置之前还有多少帧
+    int getPosition();
+
+    // 是否后退过，当前位置之后还有记录
+    bool isRewound();
+
+    void clear();
+
+private:
+    Frame *at(int index);
+
+private:
+    Frame *frames;
+    int capacity;
+    int head;               // 最早一帧在数组中的下标
+    int count;              // 记录的帧数
+    int position;           // 当前位置相对最早一帧的偏移，没有记录时为-1
+};
+
+#endif //EPLAYER_FRAMEHISTORY_H
@@ -31,6 +31,9 @@ public:
     // 设置速度
     void setSpeed(double speed);
 
+    // 暂停或者恢复时钟，暂停期间时钟停在暂停时的值
+    void setPaused(int paused);
+
     // 同步到从属时钟
     void syncToSlave(MediaClock *slave);
 
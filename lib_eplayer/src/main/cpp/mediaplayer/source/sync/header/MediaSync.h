@@ -5,6 +5,9 @@
 #include "PlayerState.h"
 #include "VideoDecoder.h"
 #include "AudioDecoder.h"
+#include "SubtitleDecoder.h"
+#include "FrameHistory.h"
+#include "ReverseDecoder.h"
 
 #include "VideoDevice.h"
 
@@ -27,6 +30,16 @@ public:
     // 设置视频输出设备
     void setVideoDevice(VideoDevice *device);
 
+    // 设置字幕解码器，运行时切换字幕时会重新设置
+    void setSubtitleDecoder(SubtitleDecoder *subtitleDecoder);
+
+    // 开始或者结束倒放，倒放时显示倒放解码器输出的帧，视频时钟只在显示帧时更新
+    // seekPosition为倒放时的定位位置，单位毫秒，显示第一帧以后通知定位完成，不是定位时为-1
+    void setReverseDecoder(ReverseDecoder *reverseDecoder, int seekPosition);
+
+    // 设置起始时间，单位AV_TIME_BASE，计算当前位置时减去
+    void setStartTime(int64_t startTime);
+
     // 设置帧最大间隔
     void setMaxDuration(double maxDuration);
 
@@ -42,6 +55,9 @@ public:
     // 更新外部时钟
     void updateExternalClock(double pts);
 
+    // 更新缓冲状态，数据包队列取空时开始缓冲，缓冲足够以后结束
+    void updateBuffering();
+
     double getMasterClock();
 
 
@@ -57,15 +73,57 @@ public:
 
     void renderVideo();
 
+    // 最近显示过的帧中是否还有更早的帧，pendingSteps为还没有处理的步进请求
+    bool hasPreviousFrame(int pendingSteps);
+
+    // 正在显示的帧的时间戳和时长，还没有显示过帧时返回false
+    bool getShownFrame(double *pts, double *duration);
+
+    // 取出逐帧步进以后显示的帧的时间戳并清除，没有步进过时返回NAN
+    double takeSteppedPts();
+
+    // 定位以后清除最近显示过的帧
+    void clearFrameHistory();
+
 private:
+    // 暂停时逐帧前进或者后退一帧，并更新时钟
+    void stepVideo();
+
     void refreshVideo(double *remaining_time);
 
+    // 倒放时按时间戳从大到小显示倒放解码器输出的帧
+    void refreshReverse(double *remaining_time);
+
     void checkExternalClockSpeed();
 
+    // 播放速度，直播追赶延时的速度叠加在播放速度上
+    double getPlaybackSpeed();
+
+    // 视频时钟和外部时钟的速度跟随播放速度，音频时钟在音频回调中更新速度
+    void updateClockSpeed();
+
+    // 播放速度变化或者停止时输出这一段播放速度下的丢帧数和CPU占用，并重新开始统计
+    void updatePlaybackStats(bool finish);
+
     double calculateDelay(double delay);
 
     double calculateDuration(Frame *vp, Frame *nextvp);
 
+    // 是否有数据包队列已经取空
+    bool isStarving();
+
+    // 暂停或者恢复所有时钟
+    void setClockPaused(int paused);
+
+    // 按主时钟取出已经结束的字幕，显示的字幕变化时更新字幕图像或者通知字幕文字
+    void updateSubtitle();
+
+    // 把位图字幕合成为一张预乘透明度的RGBA图像交给视频输出设备
+    void renderSubtitleBitmap(Frame *sp);
+
+    // 清除正在显示的字幕
+    void clearSubtitle();
+
 
 private:
     PlayerState *playerState;               // 播放器状态
@@ -78,6 +136,7 @@ private:
 
     VideoDecoder *videoDecoder;             // 视频解码器
     AudioDecoder *audioDecoder;             // 视频解码器
+    SubtitleDecoder *subtitleDecoder;       // 字幕解码器
 
     Mutex mMutex;
     Condition mCondition;
@@ -85,8 +144,35 @@ private:
 
     int forceRefresh;                       // 强制刷新标志
     double maxFrameDuration;                // 最大帧延时
+    int64_t startTime;                      // 起始时间，单位AV_TIME_BASE
     int frameTimerRefresh;                  // 刷新时钟
     double frameTimer;                      // 视频时钟
+    int bufferingPercent;                   // 上一次通知的缓冲进度
+    bool firstFrameRendered;                // 是否已经显示过第一帧
+    Frame *shownSubtitle;                   // 正在显示的字幕，没有时为NULL
+    int subtitleSerial;                     // 正在显示的字幕所属的清空序号
+    bool subtitleBitmapShown;               // 视频输出设备上是否有字幕图像
+    bool subtitleTextShown;                 // 是否通知过还没有清除的字幕文字
+    uint8_t *subtitleBuffer;                // 位图字幕的合成缓冲
+    unsigned int subtitleBufferSize;
+    FrameHistory *frameHistory;             // 最近显示过的视频帧，用于逐帧后退
+    bool historyShown;                      // 正在显示的是历史记录中的帧，不是帧队列中的帧
+    double steppedPts;                      // 逐帧步进以后显示的帧的时间戳，继续播放时从这里重新定位
+    ReverseDecoder *reverseDecoder;         // 倒放解码器，不在倒放时为NULL
+    bool reverseCompleted;                  // 是否已经通知倒放到开头
+    int reverseSeekPosition;                // 倒放时的定位位置，单位毫秒，显示第一帧以后通知定位完成，没有时为-1
+    int reverseFrames;                      // 统计：倒放显示的帧数
+    int reverseDropped;                     // 统计：倒放时来不及显示丢弃的帧数
+    int64_t reverseFirstTime;               // 统计：倒放显示第一帧的时间
+    int64_t reverseLastTime;                // 统计：倒放显示最后一帧的时间
+    double lastShownTime;                   // 上一帧的显示时机，用于按屏幕刷新率限制显示帧率
+    double statsSpeed;                      // 统计：正在统计的播放速度，没有开始统计时为0
+    int shownFrames;                        // 统计：显示的帧数
+    int lateDropped;                        // 统计：错过显示时机丢弃的帧数
+    int refreshDropped;                     // 统计：超过屏幕刷新率丢弃的帧数
+    int decoderDropped;                     // 统计：开始统计时解码器已经丢弃的帧数
+    int64_t statsStartTime;                 // 统计：开始统计的时间，单位微秒
+    int64_t statsStartCpu;                  // 统计：开始统计时进程占用的CPU时间，单位微秒
 
     VideoDevice *videoDevice;               // 视频输出设备
 
@@ -229,6 +229,35 @@ public class AndroidMediaPlayer implements IMediaPlayer {
         }
     }
 
+    @Override
+    public void stepForward() throws IllegalStateException {
+        if (mMediaPlayer != null) {
+            mMediaPlayer.stepForward();
+        }
+    }
+
+    @Override
+    public void stepBackward() throws IllegalStateException {
+        if (mMediaPlayer != null) {
+            mMediaPlayer.stepBackward();
+        }
+    }
+
+    @Override
+    public void setReverse(boolean reverse) throws IllegalStateException {
+        if (mMediaPlayer != null) {
+            mMediaPlayer.setReverse(reverse);
+        }
+    }
+
+    @Override
+    public boolean isReverse() {
+        if (mMediaPlayer != null) {
+            return mMediaPlayer.isReverse();
+        }
+        return false;
+    }
+
     @Override
     public long getCurrentPosition() {
         if (mMediaPlayer != null) {
@@ -363,6 +392,36 @@ public class AndroidMediaPlayer implements IMediaPlayer {
         // do nothing
     }
 
+    @Override
+    public ETrackInfo[] getTrackInfo() {
+        if (mMediaPlayer != null) {
+            return mMediaPlayer.getTrackInfo();
+        }
+        return new ETrackInfo[0];
+    }
+
+    @Override
+    public void selectTrack(int index) {
+        if (mMediaPlayer != null) {
+            mMediaPlayer.selectTrack(index);
+        }
+    }
+
+    @Override
+    public void deselectTrack(int index) {
+        if (mMediaPlayer != null) {
+            mMediaPlayer.deselectTrack(index);
+        }
+    }
+
+    @Override
+    public int getSelectedTrack(int trackType) {
+        if (mMediaPlayer != null) {
+            return mMediaPlayer.getSelectedTrack(trackType);
+        }
+        return -1;
+    }
+
     @Override
     public void setOnPreparedListener(OnPreparedListener listener) {
         mOnPreparedListener = listener;
@@ -0,0 +1,34 @@
+package com.eplayer;
+
+/**
+ * 轨道信息，轨道类型的取值跟android.media.MediaPlayer.TrackInfo一致
+ */
+public class ETrackInfo {
+
+    public static final int MEDIA_TRACK_TYPE_UNKNOWN = 0;
+    public static final int MEDIA_TRACK_TYPE_VIDEO = 1;
+    public static final int MEDIA_TRACK_TYPE_AUDIO = 2;
+    // 文本字幕，通过OnTimedTextListener回调
+    public static final int MEDIA_TRACK_TYPE_TIMEDTEXT = 3;
+    // 位图字幕，直接叠加在视频画面上
+    public static final int MEDIA_TRACK_TYPE_SUBTITLE = 4;
+
+    private int mTrackType = MEDIA_TRACK_TYPE_UNKNOWN;
+    private String mLanguage = null;
+
+    public ETrackInfo(int trackType, String language) {
+        mTrackType = trackType;
+        mLanguage = language;
+    }
+
+    public int getTrackType() {
+        return mTrackType;
+    }
+
+    /**
+     * ISO-639-2语言代码，没有语言信息时为"und"
+     */
+    public String getLanguage() {
+        return mLanguage;
+    }
+}
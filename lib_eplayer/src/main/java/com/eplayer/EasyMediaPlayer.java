@@ -21,6 +21,7 @@ import com.eplayer.annotations.AccessedByNative;
 import java.io.FileDescriptor;
 import java.io.IOException;
 import java.lang.ref.WeakReference;
+import java.nio.charset.StandardCharsets;
 import java.util.Map;
 
 /**
@@ -634,6 +635,34 @@ public class EasyMediaPlayer implements IMediaPlayer {
 
     private native void _seekTo(float msec) throws IllegalStateException;
 
+    @Override
+    public void stepForward() throws IllegalStateException {
+        _stepForward();
+    }
+
+    private native void _stepForward() throws IllegalStateException;
+
+    @Override
+    public void stepBackward() throws IllegalStateException {
+        _stepBackward();
+    }
+
+    private native void _stepBackward() throws IllegalStateException;
+
+    @Override
+    public void setReverse(boolean reverse) throws IllegalStateException {
+        _setReverse(reverse);
+    }
+
+    private native void _setReverse(boolean reverse) throws IllegalStateException;
+
+    @Override
+    public boolean isReverse() {
+        return _isReverse();
+    }
+
+    private native boolean _isReverse();
+
     /**
      * Gets the current playback position.
      *
@@ -850,6 +879,41 @@ public class EasyMediaPlayer implements IMediaPlayer {
 
     private native void _setPitch(float pitch);
 
+    @Override
+    public ETrackInfo[] getTrackInfo() {
+        int count = _getTrackCount();
+        ETrackInfo[] trackInfo = new ETrackInfo[count];
+        for (int i = 0; i < count; i++) {
+            trackInfo[i] = new ETrackInfo(_getTrackType(i), _getTrackLanguage(i));
+        }
+        return trackInfo;
+    }
+
+    @Override
+    public void selectTrack(int index) {
+        _selectTrack(index, true);
+    }
+
+    @Override
+    public void deselectTrack(int index) {
+        _selectTrack(index, false);
+    }
+
+    @Override
+    public int getSelectedTrack(int trackType) {
+        return _getSelectedTrack(trackType);
+    }
+
+    private native int _getTrackCount();
+
+    private native int _getTrackType(int index);
+
+    private native String _getTrackLanguage(int index);
+
+    private native int _getSelectedTrack(int trackType);
+
+    private native void _selectTrack(int index, boolean select);
+
     // 渲染结点类型，跟Native层的RenderNodeType数值保持一致。
     private static final int NODE_NONE = -1;
     private static final int NODE_INPUT = 0;
@@ -1062,7 +1126,8 @@ public class EasyMediaPlayer implements IMediaPlayer {
                             mOnTimedTextListener.onTimedText(mMediaPlayer, null);
                         } else {
                             if (msg.obj instanceof byte[]) {
-                                ETimedText text = new ETimedText(new Rect(0, 0, 1, 1), (String) (msg.obj));
+                                ETimedText text = new ETimedText(new Rect(0, 0, 1, 1),
+                                        new String((byte[]) msg.obj, StandardCharsets.UTF_8));
                                 mOnTimedTextListener.onTimedText(mMediaPlayer, text);
                             }
                         }
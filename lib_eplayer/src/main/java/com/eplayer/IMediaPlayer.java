@@ -251,6 +251,45 @@ public interface IMediaPlayer {
      */
     public void seekTo(float msec) throws IllegalStateException;
 
+    /**
+     * Shows the next video frame while paused. The audio stays silent until
+     * playback is resumed, at which point it is resynchronized to the frame shown.
+     *
+     * @throws IllegalStateException if the player is not paused, has no video
+     * or is playing a live stream
+     */
+    public void stepForward() throws IllegalStateException;
+
+    /**
+     * Shows the previous video frame while paused. Recently shown frames are
+     * kept in a small cache (option "step-cache-frames"); stepping further back
+     * falls back to an accurate seek.
+     *
+     * @throws IllegalStateException if the player is not paused, has no video
+     * or is playing a live stream
+     */
+    public void stepBackward() throws IllegalStateException;
+
+    /**
+     * Starts or stops reverse playback. Reverse playback starts from the frame
+     * currently shown, follows the playback rate and keeps the audio muted.
+     * Seeking while reversing restarts reverse playback from the new position.
+     * A playback-complete event is sent when the beginning is reached. Stopping
+     * resumes forward playback from the last frame shown.
+     *
+     * @param reverse true to play backwards, false to play forwards again
+     * @throws IllegalStateException if the player has no video, is playing a
+     * live stream or has not shown a frame yet
+     */
+    public void setReverse(boolean reverse) throws IllegalStateException;
+
+    /**
+     * Checks whether the player is playing backwards.
+     *
+     * @return true if reverse playback is active
+     */
+    public boolean isReverse();
+
 
     /**
      * Gets the current playback position.
@@ -423,6 +462,33 @@ public interface IMediaPlayer {
      */
     public void setPitch(float pitch);
 
+    /**
+     * Returns the audio, video and subtitle tracks of the data source,
+     * the index of a track in the array is the index used by selectTrack.
+     * @return track info array, empty before the player is prepared
+     */
+    public ETrackInfo[] getTrackInfo();
+
+    /**
+     * Switches the audio or subtitle track while playing, the switch is asynchronous.
+     * Video keeps playing and the new track starts from the current position.
+     * @param index the index of the track in the array returned by getTrackInfo
+     */
+    public void selectTrack(int index);
+
+    /**
+     * Turns off the subtitle track, audio and video tracks cannot be deselected.
+     * @param index the index of the track in the array returned by getTrackInfo
+     */
+    public void deselectTrack(int index);
+
+    /**
+     * Returns the index of the selected track of the given type.
+     * @param trackType one of ETrackInfo.MEDIA_TRACK_TYPE_*
+     * @return the track index, or -1 if no track of this type is selected
+     */
+    public int getSelectedTrack(int trackType);
+
 
 
 
@@ -669,6 +735,29 @@ public interface IMediaPlayer {
      */
     public static final int MEDIA_INFO_METADATA_UPDATE = 802;
 
+    /** The first frame after seeking has been rendered, extra is the time from the last seek request in ms.
+     * @see com.cgfay.media.IMediaPlayer.OnInfoListener
+     */
+    public static final int MEDIA_INFO_SEEK_RENDERING_START = 10001;
+
+    /** Adaptive bitrate switched to another HLS variant, extra is the bitrate of the new variant in kbps.
+     * @see com.cgfay.media.IMediaPlayer.OnInfoListener
+     */
+    public static final int MEDIA_INFO_VARIANT_CHANGED = 10002;
+
+    /** Preloading is complete and the first frame is decoded, extra is the preload memory budget used in KB.
+     * The player was prepared with the "preload" option and is waiting for start.
+     * @see com.cgfay.media.IMediaPlayer.OnInfoListener
+     */
+    public static final int MEDIA_INFO_PRELOAD_COMPLETE = 10003;
+
+    /** The video decoder cannot keep up and changed its degradation level, extra is the new level.
+     * 0 decodes normally, 1 skips the loop filter on non-reference frames, 2 skips the loop filter
+     * on all frames, 3 skips non-reference frames and 4 decodes key frames only.
+     * @see com.cgfay.media.IMediaPlayer.OnInfoListener
+     */
+    public static final int MEDIA_INFO_DECODER_LEVEL_CHANGED = 10004;
+
     /**
      * Interface definition of a callback to be invoked to communicate some
      * info and/or warning about the media or its playback.
@@ -687,6 +776,10 @@ public interface IMediaPlayer {
          * <li>{@link #MEDIA_INFO_BAD_INTERLEAVING}
          * <li>{@link #MEDIA_INFO_NOT_SEEKABLE}
          * <li>{@link #MEDIA_INFO_METADATA_UPDATE}
+         * <li>{@link #MEDIA_INFO_SEEK_RENDERING_START}
+         * <li>{@link #MEDIA_INFO_VARIANT_CHANGED}
+         * <li>{@link #MEDIA_INFO_PRELOAD_COMPLETE}
+         * <li>{@link #MEDIA_INFO_DECODER_LEVEL_CHANGED}
          * </ul>
          * @param extra an extra code, specific to the info. Typically
          * implementation dependant.
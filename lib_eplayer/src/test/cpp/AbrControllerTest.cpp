@@ -0,0 +1,303 @@
+
+#include <gtest/gtest.h>
+#include <vector>
+#include "AbrController.h"
+
+// 三路码流，码率从低到高，每路码流有自己的视频和音频，视频流索引是2i，音频流索引是2i+1
+#define VARIANT_COUNT 3
+static const int64_t VARIANT_BITRATES[VARIANT_COUNT] = {400000, 1200000, 3000000};
+// 开始播放时使用的码流
+#define START_VARIANT 1
+// 分片时长，每个分片以视频关键帧开始，单位微秒
+#define SEGMENT_DURATION (2 * 1000 * 1000)
+#define VIDEO_FRAME_DURATION 40000
+#define AUDIO_FRAME_DURATION 20000
+// 数据包队列的高水位，队列填充程度是已缓冲时长相对高水位的比例，单位微秒
+#define HIGH_WATER (10 * 1000 * 1000)
+// 缓冲这么多以后开始播放，单位微秒
+#define START_BUFFER (2 * 1000 * 1000)
+// 队列已满时读数据包线程的休眠时间，单位微秒
+#define IDLE_STEP 10000
+
+/**
+ * 使用虚拟时钟的控制器，切换间隔和超时按模拟的时间计算
+ */
+class VirtualClockAbrController : public AbrController {
+public:
+    VirtualClockAbrController(PlayerState *playerState, const int64_t *now)
+            : AbrController(playerState), now(now) {}
+
+protected:
+    int64_t getCurrentTime() override {
+        return *now;
+    }
+
+private:
+    const int64_t *now;
+};
+
+typedef struct BandwidthStep {
+    int64_t until;          // 这一段带宽持续到的时间，单位微秒
+    int64_t bandwidth;      // 单位bps
+} BandwidthStep;
+
+/**
+ * 模拟HLS解复用器和读数据包线程：没有被丢弃的码流按时间戳交错输出数据包，下载耗时按脚本中的带宽计算，
+ * 重新打开的码流从当前时间所在的分片开始下载，播放按真实速度消耗缓冲
+ */
+class AbrControllerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        format.name = "hls";
+        pFormatCtx = avformat_alloc_context();
+        pFormatCtx->iformat = &format;
+        for (int i = 0; i < VARIANT_COUNT; i++) {
+            AVStream *video = avformat_new_stream(pFormatCtx, NULL);
+            video->time_base = (AVRational) {1, 90000};
+            video->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+            video->codecpar->codec_id = AV_CODEC_ID_H264;
+            AVStream *audio = avformat_new_stream(pFormatCtx, NULL);
+            audio->time_base = (AVRational) {1, 90000};
+            audio->codecpar->codec_type = AVMEDIA_TYPE_AUDIO;
+            audio->codecpar->codec_id = AV_CODEC_ID_AAC;
+            AVProgram *program = av_new_program(pFormatCtx, i);
+            av_dict_set_int(&program->metadata, "variant_bitrate", VARIANT_BITRATES[i], 0);
+            av_program_add_stream_index(pFormatCtx, i, (unsigned int) video->index);
+            av_program_add_stream_index(pFormatCtx, i, (unsigned int) audio->index);
+            nextVideoTs[i] = nextAudioTs[i] = -1;
+        }
+        nextVideoTs[START_VARIANT] = nextAudioTs[START_VARIANT] = 0;
+
+        playerState = new PlayerState();
+        playerState->messageQueue->start();
+        now = 0;
+        controller = new VirtualClockAbrController(playerState, &now);
+        ASSERT_EQ(0, controller->open(pFormatCtx, 2 * START_VARIANT, 2 * START_VARIANT + 1));
+
+        lastReadTs = 0;
+        bufferedUntil = 0;
+        playPosition = 0;
+        started = false;
+        stallTime = 0;
+        lastVideoTs = lastAudioTs = -1;
+        videoVariant = START_VARIANT;
+        nonKeySwitches = 0;
+        backwardPackets = 0;
+    }
+
+    void TearDown() override {
+        delete controller;
+        delete playerState;
+        avformat_free_context(pFormatCtx);
+    }
+
+    int64_t bandwidth() {
+        for (const BandwidthStep &step : script) {
+            if (now < step.until) {
+                return step.bandwidth;
+            }
+        }
+        return script.back().bandwidth;
+    }
+
+    bool isActive(int variant) {
+        return pFormatCtx->streams[2 * variant]->discard != AVDISCARD_ALL;
+    }
+
+    // 按解复用器的方式取出下一个数据包：新打开的码流从当前时间所在的分片开始，所有码流中时间戳最小的先输出
+    bool demux(AVPacket *pkt, int *variant) {
+        int best = -1;
+        bool bestVideo = false;
+        int64_t bestTs = INT64_MAX;
+        for (int i = 0; i < VARIANT_COUNT; i++) {
+            if (!isActive(i)) {
+                nextVideoTs[i] = nextAudioTs[i] = -1;
+                continue;
+            }
+            if (nextVideoTs[i] < 0) {
+                nextVideoTs[i] = nextAudioTs[i] = lastReadTs / SEGMENT_DURATION * SEGMENT_DURATION;
+            }
+            if (nextVideoTs[i] < bestTs) {
+                best = i;
+                bestVideo = true;
+                bestTs = nextVideoTs[i];
+            }
+            if (nextAudioTs[i] < bestTs) {
+                best = i;
+                bestVideo = false;
+                bestTs = nextAudioTs[i];
+            }
+        }
+        if (best < 0) {
+            return false;
+        }
+        av_init_packet(pkt);
+        pkt->data = NULL;
+        pkt->pts = pkt->dts = av_rescale_q(bestTs, AV_TIME_BASE_Q, (AVRational) {1, 90000});
+        if (bestVideo) {
+            pkt->stream_index = 2 * best;
+            pkt->size = (int) (VARIANT_BITRATES[best] * 9 / 10 / 8 * VIDEO_FRAME_DURATION / 1000000);
+            pkt->flags = bestTs % SEGMENT_DURATION == 0 ? AV_PKT_FLAG_KEY : 0;
+            nextVideoTs[best] += VIDEO_FRAME_DURATION;
+        } else {
+            pkt->stream_index = 2 * best + 1;
+            pkt->size = (int) (VARIANT_BITRATES[best] / 10 / 8 * AUDIO_FRAME_DURATION / 1000000);
+            pkt->flags = AV_PKT_FLAG_KEY;
+            nextAudioTs[best] += AUDIO_FRAME_DURATION;
+        }
+        *variant = best;
+        lastReadTs = bestTs;
+        return true;
+    }
+
+    // 播放消耗缓冲，缓冲耗尽时记录卡顿时长
+    void advance(int64_t elapsed) {
+        now += elapsed;
+        if (!started) {
+            started = bufferedUntil - playPosition >= START_BUFFER;
+            return;
+        }
+        playPosition += elapsed;
+        if (playPosition > bufferedUntil) {
+            stallTime += playPosition - bufferedUntil;
+            playPosition = bufferedUntil;
+        }
+    }
+
+    // 跟读数据包线程一样：读数据包并计入吞吐量，映射到解码器的媒体流，再根据队列填充程度更新
+    void runUntil(int64_t end) {
+        while (now < end) {
+            if (bufferedUntil - playPosition >= HIGH_WATER) {
+                advance(IDLE_STEP);
+                continue;
+            }
+            AVPacket pkt;
+            int variant;
+            ASSERT_TRUE(demux(&pkt, &variant));
+            int64_t elapsed = (int64_t) pkt.size * 8 * 1000000 / bandwidth();
+            advance(elapsed);
+            controller->addSample(pkt.size, elapsed);
+
+            bool isVideo = pkt.stream_index == 2 * variant;
+            int64_t ts = av_rescale_q(pkt.pts, (AVRational) {1, 90000}, AV_TIME_BASE_Q);
+            if (controller->mapPacket(&pkt)) {
+                if (isVideo) {
+                    EXPECT_EQ(2 * START_VARIANT, pkt.stream_index);
+                    bool switched = variant != videoVariant;
+                    if (switched && !(pkt.flags & AV_PKT_FLAG_KEY)) {
+                        nonKeySwitches++;
+                    }
+                    videoVariant = variant;
+                    // 切换点的关键帧可以跟旧码流最后一帧的时间相同
+                    if (ts < lastVideoTs || (ts == lastVideoTs && !switched)) {
+                        backwardPackets++;
+                    }
+                    lastVideoTs = ts;
+                    bufferedUntil = FFMAX(bufferedUntil, ts + VIDEO_FRAME_DURATION);
+                } else {
+                    EXPECT_EQ(2 * START_VARIANT + 1, pkt.stream_index);
+                    if (ts <= lastAudioTs) {
+                        backwardPackets++;
+                    }
+                    lastAudioTs = ts;
+                }
+            }
+            double queueLevel = FFMIN((double) (bufferedUntil - playPosition) / HIGH_WATER, 1.0);
+            controller->update(queueLevel);
+            collectMessages();
+        }
+    }
+
+    void collectMessages() {
+        AVMessage msg;
+        while (playerState->messageQueue->getMessage(&msg, 0) > 0) {
+            if (msg.what == MSG_VARIANT_CHANGED) {
+                switches.push_back(std::make_pair(now, msg.arg2));
+            }
+            message_free_resouce(&msg);
+        }
+    }
+
+    // 指定时间正在使用的码流
+    int variantAt(int64_t time) {
+        int variant = START_VARIANT;
+        for (const std::pair<int64_t, int> &entry : switches) {
+            if (entry.first <= time) {
+                variant = entry.second;
+            }
+        }
+        return variant;
+    }
+
+    AVInputFormat format = {};
+    AVFormatContext *pFormatCtx;
+    PlayerState *playerState;
+    VirtualClockAbrController *controller;
+    std::vector<BandwidthStep> script;
+    int64_t now;                            // 虚拟时间，单位微秒
+    int64_t nextVideoTs[VARIANT_COUNT];     // 每路码流下一个数据包的时间戳，没有打开时为-1
+    int64_t nextAudioTs[VARIANT_COUNT];
+    int64_t lastReadTs;                     // 解复用器最后输出的时间戳
+    int64_t bufferedUntil;                  // 已经送给解码器的视频结束时间
+    int64_t playPosition;
+    bool started;
+    int64_t stallTime;
+    int64_t lastVideoTs;
+    int64_t lastAudioTs;
+    int videoVariant;                       // 最后送给解码器的视频来自哪路码流
+    int nonKeySwitches;                     // 切换到新码流时第一个视频数据包不是关键帧的次数
+    int backwardPackets;                    // 送给解码器的时间戳没有递增的数据包数量
+    std::vector<std::pair<int64_t, int>> switches;  // 切换完成的时间和码流
+};
+
+TEST_F(AbrControllerTest, FollowsScriptedBandwidth) {
+    script = {{30 * 1000000LL, 6000000}, {70 * 1000000LL, 800000}, {140 * 1000000LL, 6000000}};
+
+    // 带宽充足，缓冲足够以后升到最高码率，并且要等到开始播放以后的切换间隔
+    runUntil(30 * 1000000LL);
+    ASSERT_FALSE(switches.empty());
+    EXPECT_EQ(VARIANT_COUNT - 1, switches.back().second);
+    EXPECT_GE(switches.front().first, ABR_SWITCH_INTERVAL);
+    EXPECT_EQ(0, stallTime);
+
+    // 带宽降到最低码率附近，在缓冲耗尽之前降到最低码率
+    runUntil(70 * 1000000LL);
+    EXPECT_EQ(0, variantAt(70 * 1000000LL));
+    int64_t downSwitch = -1;
+    for (const std::pair<int64_t, int> &entry : switches) {
+        if (entry.first > 30 * 1000000LL && entry.second == 0 && downSwitch < 0) {
+            downSwitch = entry.first;
+        }
+    }
+    ASSERT_GT(downSwitch, 0);
+    EXPECT_LT(downSwitch, 45 * 1000000LL);
+    EXPECT_EQ(0, stallTime);
+
+    // 带宽恢复以后重新升到最高码率，两次提高码率之间至少间隔ABR_SWITCH_INTERVAL
+    runUntil(140 * 1000000LL);
+    EXPECT_EQ(VARIANT_COUNT - 1, variantAt(140 * 1000000LL));
+    for (size_t i = 1; i < switches.size(); i++) {
+        if (switches[i].second > switches[i - 1].second) {
+            EXPECT_GE(switches[i].first - switches[i - 1].first, ABR_SWITCH_INTERVAL) << "switch " << i;
+        }
+    }
+    EXPECT_EQ(0, stallTime);
+
+    // 切换点都在关键帧上，送给解码器的时间戳连续递增
+    EXPECT_GE(switches.size(), 4u);
+    EXPECT_EQ(0, nonKeySwitches);
+    EXPECT_EQ(0, backwardPackets);
+}
+
+TEST_F(AbrControllerTest, ConstantLowBandwidthNeverSwitchesUp) {
+    script = {{60 * 1000000LL, 1000000}};
+    runUntil(60 * 1000000LL);
+    // 1Mbps扣除安全余量只够最低码率
+    ASSERT_FALSE(switches.empty());
+    EXPECT_EQ(0, switches.front().second);
+    for (const std::pair<int64_t, int> &entry : switches) {
+        EXPECT_EQ(0, entry.second);
+    }
+    EXPECT_EQ(0, nonKeySwitches);
+    EXPECT_EQ(0, backwardPackets);
+}
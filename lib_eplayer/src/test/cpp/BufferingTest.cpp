@@ -0,0 +1,298 @@
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <atomic>
+#include <vector>
+#include "MediaSync.h"
+
+// 每个数据包是一帧20ms的音频
+#define FRAME_MS 20
+#define PACKET_BYTES 400
+// 实时播放需要的码率，单位byte/s
+#define REALTIME_RATE (PACKET_BYTES * 1000 / FRAME_MS)
+#define TOTAL_PACKETS 100
+// 这一段数据包限速到实时码率的一半，模拟网络变慢
+#define SLOW_BEGIN 20
+#define SLOW_END 70
+// 结束缓冲需要缓冲的时长，单位秒
+#define BUFFERING_SECONDS 0.3
+
+/**
+ * 测试用的音频解码器，每个数据包解码出一帧，只填写时间信息，不分配PCM数据
+ */
+static int fakeDecode(AVCodecContext *avctx, void *data, int *got_frame, AVPacket *pkt) {
+    AVFrame *frame = (AVFrame *) data;
+    frame->format = avctx->sample_fmt;
+    frame->sample_rate = avctx->sample_rate;
+    frame->channels = avctx->channels;
+    frame->channel_layout = avctx->channel_layout;
+    frame->nb_samples = avctx->sample_rate * FRAME_MS / 1000;
+    frame->pts = pkt->pts;
+    *got_frame = 1;
+    return pkt->size;
+}
+
+static AVCodec *getFakeCodec() {
+    static AVCodec codec;
+    if (!codec.decode) {
+        codec.name = "eplayer_fake_audio";
+        codec.long_name = "eplayer fake audio decoder";
+        codec.type = AVMEDIA_TYPE_AUDIO;
+        codec.id = AV_CODEC_ID_PCM_S16LE;
+        codec.decode = fakeDecode;
+    }
+    return &codec;
+}
+
+/**
+ * 限速读取本地文件的AVIO，按文件位置决定限速，模拟网络传输变慢
+ */
+class ThrottledReader {
+public:
+    explicit ThrottledReader(const char *path) {
+        file = fopen(path, "rb");
+        position = 0;
+        phaseStart = 0;
+        phaseBytes = 0;
+        phaseRate = 0;
+    }
+
+    ~ThrottledReader() {
+        if (file) {
+            fclose(file);
+        }
+    }
+
+    static int readPacket(void *opaque, uint8_t *buf, int size) {
+        return ((ThrottledReader *) opaque)->read(buf, size);
+    }
+
+    FILE *file;
+
+private:
+    // 限速段以内按码率计算每次读取以后需要等待的时间，0表示不限速
+    int read(uint8_t *buf, int size) {
+        int rate = (position >= SLOW_BEGIN * PACKET_BYTES && position < SLOW_END * PACKET_BYTES)
+                   ? REALTIME_RATE / 2 : 0;
+        if (rate != phaseRate) {
+            phaseRate = rate;
+            phaseStart = av_gettime_relative();
+            phaseBytes = 0;
+        }
+        // 每次最多读取一个数据包，限速才能均匀
+        size = FFMIN(size, PACKET_BYTES);
+        int len = (int) fread(buf, 1, (size_t) size, file);
+        if (len <= 0) {
+            return AVERROR_EOF;
+        }
+        position += len;
+        phaseBytes += len;
+        if (phaseRate > 0) {
+            int64_t due = phaseStart + phaseBytes * 1000000 / phaseRate;
+            int64_t now = av_gettime_relative();
+            if (due > now) {
+                av_usleep((unsigned int) (due - now));
+            }
+        }
+        return len;
+    }
+
+    int64_t position;
+    int64_t phaseStart;
+    int64_t phaseBytes;
+    int phaseRate;
+};
+
+/**
+ * 读数据包线程，从AVIO中读出固定大小的数据包送入音频解码器，跟MediaPlayer一样每送入一个数据包检查一次缓冲状态
+ */
+class PacketReader : public Runnable {
+public:
+    PacketReader(AVIOContext *pb, AudioDecoder *decoder, MediaSync *mediaSync, PlayerState *playerState)
+            : pb(pb), decoder(decoder), mediaSync(mediaSync), playerState(playerState) {}
+
+    void run() override {
+        for (int64_t pts = 0;; pts += FRAME_MS) {
+            AVPacket pkt;
+            if (av_new_packet(&pkt, PACKET_BYTES) < 0) {
+                break;
+            }
+            int len = avio_read(pb, pkt.data, PACKET_BYTES);
+            if (len < PACKET_BYTES) {
+                av_packet_unref(&pkt);
+                break;
+            }
+            pkt.pts = pkt.dts = pts;
+            pkt.duration = FRAME_MS;
+            decoder->pushPacket(&pkt);
+            mediaSync->updateBuffering();
+        }
+        playerState->eof = 1;
+        mediaSync->updateBuffering();
+    }
+
+    AVIOContext *pb;
+    AudioDecoder *decoder;
+    MediaSync *mediaSync;
+    PlayerState *playerState;
+};
+
+/**
+ * 模拟音频解码线程和音频回调：取数据之前检查缓冲状态，缓冲期间不消耗数据，每一帧按实时播放
+ */
+class AudioPlayback : public Runnable {
+public:
+    AudioPlayback(AudioDecoder *decoder, MediaSync *mediaSync, PlayerState *playerState)
+            : decoder(decoder), mediaSync(mediaSync), playerState(playerState), played(0),
+              playedWhileBuffering(0) {}
+
+    void run() override {
+        AVFrame *frame = av_frame_alloc();
+        while (played < TOTAL_PACKETS) {
+            mediaSync->updateBuffering();
+            if (playerState->buffering) {
+                av_usleep(2000);
+                continue;
+            }
+            if (decoder->getAudioFrame(frame) <= 0) {
+                break;
+            }
+            if (playerState->buffering) {
+                playedWhileBuffering++;
+            }
+            played++;
+            av_usleep(FRAME_MS * 1000);
+        }
+        av_frame_free(&frame);
+    }
+
+    AudioDecoder *decoder;
+    MediaSync *mediaSync;
+    PlayerState *playerState;
+    std::atomic<int> played;
+    std::atomic<int> playedWhileBuffering;
+};
+
+class BufferingTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        char path[] = "/tmp/eplayer_buffering_XXXXXX";
+        int fd = mkstemp(path);
+        ASSERT_GE(fd, 0);
+        std::vector<uint8_t> data(TOTAL_PACKETS * PACKET_BYTES, 0x55);
+        ASSERT_EQ((ssize_t) data.size(), write(fd, data.data(), data.size()));
+        close(fd);
+        filePath = path;
+
+        pFormatCtx = avformat_alloc_context();
+        stream = avformat_new_stream(pFormatCtx, NULL);
+        stream->time_base = (AVRational) {1, 1000};
+        AVCodec *codec = getFakeCodec();
+        AVCodecContext *avctx = avcodec_alloc_context3(codec);
+        avctx->sample_rate = 1000;
+        avctx->channels = 1;
+        avctx->channel_layout = AV_CH_LAYOUT_MONO;
+        avctx->sample_fmt = AV_SAMPLE_FMT_S16;
+        av_codec_set_pkt_timebase(avctx, stream->time_base);
+        ASSERT_EQ(0, avcodec_open2(avctx, codec, NULL));
+
+        playerState = new PlayerState();
+        playerState->abortRequest = 0;
+        playerState->pauseRequest = 0;
+        playerState->bufferingSeconds = BUFFERING_SECONDS;
+        playerState->messageQueue->start();
+        decoder = new AudioDecoder(avctx, stream, 0, playerState);
+        decoder->start();
+        mediaSync = new MediaSync(playerState);
+        mediaSync->start(NULL, decoder);
+        mediaSync->getExternalClock()->setClock(0);
+
+        reader = new ThrottledReader(path);
+        ASSERT_TRUE(reader->file != NULL);
+        ioBuffer = (uint8_t *) av_malloc(PACKET_BYTES);
+        pb = avio_alloc_context(ioBuffer, PACKET_BYTES, 0, reader, ThrottledReader::readPacket, NULL, NULL);
+    }
+
+    void TearDown() override {
+        playerState->abortRequest = 1;
+        mediaSync->stop();
+        decoder->stop();
+        delete mediaSync;
+        delete decoder;
+        delete playerState;
+        avformat_free_context(pFormatCtx);
+        av_free(pb->buffer);
+        avio_context_free(&pb);
+        delete reader;
+        unlink(filePath.c_str());
+    }
+
+    std::string filePath;
+    AVFormatContext *pFormatCtx;
+    AVStream *stream;
+    PlayerState *playerState;
+    AudioDecoder *decoder;
+    MediaSync *mediaSync;
+    ThrottledReader *reader;
+    uint8_t *ioBuffer;
+    AVIOContext *pb;
+};
+
+TEST_F(BufferingTest, SlowDeliveryPausesClockUntilBuffered) {
+    PacketReader packetReader(pb, decoder, mediaSync, playerState);
+    AudioPlayback playback(decoder, mediaSync, playerState);
+    Thread readThread(&packetReader);
+    Thread playThread(&playback);
+    readThread.start();
+    playThread.start();
+
+    int starts = 0, ends = 0, lastPercent = -1;
+    bool buffering = false;
+    AVMessage msg;
+    int64_t deadline = av_gettime_relative() + 10 * 1000000;
+    while (playback.played < TOTAL_PACKETS && av_gettime_relative() < deadline) {
+        if (playerState->messageQueue->getMessage(&msg, 0) <= 0) {
+            av_usleep(1000);
+            continue;
+        }
+        int what = msg.what;
+        int percent = msg.arg1;
+        message_free_resouce(&msg);
+        if (what == MSG_BUFFERING_START) {
+            ASSERT_FALSE(buffering);
+            buffering = true;
+            starts++;
+            lastPercent = -1;
+            // 缓冲期间时钟停止
+            double clock = mediaSync->getExternalClock()->getClock();
+            av_usleep(30 * 1000);
+            if (playerState->buffering) {
+                EXPECT_DOUBLE_EQ(clock, mediaSync->getExternalClock()->getClock());
+            }
+        } else if (what == MSG_BUFFERING_UPDATE) {
+            ASSERT_TRUE(buffering);
+            EXPECT_GT(percent, lastPercent);
+            EXPECT_LE(percent, 100);
+            lastPercent = percent;
+        } else if (what == MSG_BUFFERING_END) {
+            ASSERT_TRUE(buffering);
+            EXPECT_EQ(100, lastPercent);
+            buffering = false;
+            ends++;
+            // 缓冲结束以后时钟继续走
+            double clock = mediaSync->getExternalClock()->getClock();
+            av_usleep(30 * 1000);
+            EXPECT_GT(mediaSync->getExternalClock()->getClock(), clock);
+        }
+    }
+    readThread.join();
+    playThread.join();
+
+    EXPECT_EQ(TOTAL_PACKETS, playback.played);
+    EXPECT_EQ(0, playback.playedWhileBuffering);
+    // 限速段的码率只有实时的一半，至少要缓冲一次，每次缓冲都要结束
+    EXPECT_GE(starts, 1);
+    EXPECT_EQ(starts, ends);
+    EXPECT_FALSE(playerState->buffering);
+}
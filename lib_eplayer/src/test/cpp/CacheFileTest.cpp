@@ -0,0 +1,140 @@
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "CacheFile.h"
+
+/**
+ * 变长整数在临时文件中写入以后重新读取
+ */
+class CacheFileTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        file = tmpfile();
+        ASSERT_TRUE(file != NULL);
+    }
+
+    void TearDown() override {
+        fclose(file);
+    }
+
+    // 写入完成，回到文件开头并返回写入的字节数
+    long rewindFile() {
+        long length = ftell(file);
+        rewind(file);
+        return length;
+    }
+
+    FILE *file;
+};
+
+TEST_F(CacheFileTest, VarintRoundTrip) {
+    const uint64_t values[] = {0, 1, 127, 128, 300, 16383, 16384, UINT32_MAX, UINT64_MAX};
+    for (uint64_t value : values) {
+        writeVarint(file, value);
+    }
+    rewindFile();
+    for (uint64_t value : values) {
+        uint64_t result = 0;
+        ASSERT_EQ(0, readVarint(file, &result));
+        EXPECT_EQ(value, result);
+    }
+    uint64_t result;
+    EXPECT_EQ(-1, readVarint(file, &result));
+}
+
+TEST_F(CacheFileTest, VarintLength) {
+    writeVarint(file, 127);
+    EXPECT_EQ(1, rewindFile());
+    writeVarint(file, 128);
+    EXPECT_EQ(2, ftell(file));
+    rewindFile();
+    writeVarint(file, UINT64_MAX);
+    EXPECT_EQ(10, ftell(file));
+}
+
+TEST_F(CacheFileTest, SignedVarintRoundTrip) {
+    const int64_t values[] = {0, 1, -1, 63, -64, 64, -65, -1000000, INT64_MAX, INT64_MIN};
+    for (int64_t value : values) {
+        writeSignedVarint(file, value);
+    }
+    rewindFile();
+    for (int64_t value : values) {
+        int64_t result = 0;
+        ASSERT_EQ(0, readSignedVarint(file, &result));
+        EXPECT_EQ(value, result);
+    }
+}
+
+TEST_F(CacheFileTest, SmallNegativeUsesOneByte) {
+    writeSignedVarint(file, -64);
+    EXPECT_EQ(1, rewindFile());
+    writeSignedVarint(file, -65);
+    EXPECT_EQ(2, ftell(file));
+}
+
+TEST_F(CacheFileTest, TruncatedVarintFails) {
+    uint64_t value = 42;
+    int64_t signedValue = 42;
+    EXPECT_EQ(-1, readVarint(file, &value));
+    EXPECT_EQ(42u, value);
+
+    // 最后一个字节还带着继续标志
+    fputc(0xff, file);
+    fputc(0x80, file);
+    rewindFile();
+    EXPECT_EQ(-1, readVarint(file, &value));
+    rewind(file);
+    EXPECT_EQ(-1, readSignedVarint(file, &signedValue));
+    EXPECT_EQ(42, signedValue);
+}
+
+TEST_F(CacheFileTest, OverlongVarintFails) {
+    // 超过10个字节的变长整数是损坏的数据
+    for (int i = 0; i < 11; i++) {
+        fputc(0x80, file);
+    }
+    fputc(0, file);
+    rewindFile();
+    uint64_t value;
+    EXPECT_EQ(-1, readVarint(file, &value));
+}
+
+TEST(CacheFileKeyTest, FallbackOnlyUsedWithoutFile) {
+    char path[] = "/tmp/eplayer_cache_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+
+    // 本地文件使用修改时间，不使用fallback
+    EXPECT_EQ(computeFileKey(path, 100, 1), computeFileKey(path, 100, 2));
+    EXPECT_NE(computeFileKey(path, 100, 1), computeFileKey(path, 101, 1));
+    unlink(path);
+
+    // 网络文件拿不到修改时间，使用fallback(时长)
+    const char *url = "http://example.com/video.ts";
+    EXPECT_NE(computeFileKey(url, 100, 1), computeFileKey(url, 100, 2));
+    EXPECT_EQ(computeFileKey(url, 100, 1), computeFileKey(url, 100, 1));
+}
+
+TEST(CacheFileCommitTest, RenamesTemporaryFile) {
+    char path[] = "/tmp/eplayer_cache_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    std::string tmpPath = std::string(path) + ".tmp";
+
+    FILE *file = fopen(tmpPath.c_str(), "wb");
+    ASSERT_TRUE(file != NULL);
+    writeVarint(file, 300);
+    EXPECT_EQ(0, commitCacheFile(file, tmpPath.c_str(), path));
+    EXPECT_NE(0, access(tmpPath.c_str(), F_OK));
+
+    file = fopen(path, "rb");
+    ASSERT_TRUE(file != NULL);
+    uint64_t value = 0;
+    EXPECT_EQ(0, readVarint(file, &value));
+    EXPECT_EQ(300u, value);
+    fclose(file);
+    unlink(path);
+}
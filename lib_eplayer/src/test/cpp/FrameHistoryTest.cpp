@@ -0,0 +1,167 @@
+
+#include <gtest/gtest.h>
+#include "FrameHistory.h"
+
+// 测试用的帧间隔，30fps
+#define FRAME_INTERVAL (1.0 / 30)
+
+/**
+ * 模拟同步器显示的帧，每一帧的时间戳是序号乘以帧间隔
+ */
+class FrameHistoryTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        memset(&shown, 0, sizeof(shown));
+        shown.frame = av_frame_alloc();
+        ASSERT_TRUE(shown.frame != NULL);
+    }
+
+    void TearDown() override {
+        av_frame_free(&shown.frame);
+    }
+
+    // 显示第index帧并记录到历史中
+    void show(FrameHistory *history, int index) {
+        shown.pts = index * FRAME_INTERVAL;
+        shown.duration = FRAME_INTERVAL;
+        shown.width = 16;
+        shown.height = 16;
+        shown.uploaded = 1;
+        shown.frame->pts = index;
+        history->push(&shown);
+    }
+
+    static void expectFrame(Frame *vp, int index) {
+        ASSERT_TRUE(vp != NULL);
+        EXPECT_DOUBLE_EQ(index * FRAME_INTERVAL, vp->pts);
+        EXPECT_DOUBLE_EQ(FRAME_INTERVAL, vp->duration);
+        EXPECT_EQ(index, vp->frame->pts);
+    }
+
+    Frame shown;
+};
+
+TEST_F(FrameHistoryTest, EmptyHistoryHasNoFrames) {
+    FrameHistory history(4);
+    EXPECT_TRUE(history.current() == NULL);
+    EXPECT_TRUE(history.back() == NULL);
+    EXPECT_TRUE(history.forward() == NULL);
+    EXPECT_FALSE(history.isRewound());
+    EXPECT_EQ(0, history.getPosition());
+}
+
+TEST_F(FrameHistoryTest, StepBackAndForwardLandsOnExactPts) {
+    FrameHistory history(8);
+    for (int i = 0; i < 5; i++) {
+        show(&history, i);
+    }
+    expectFrame(history.current(), 4);
+    EXPECT_EQ(4, history.getPosition());
+    EXPECT_FALSE(history.isRewound());
+
+    for (int i = 3; i >= 0; i--) {
+        Frame *vp = history.back();
+        expectFrame(vp, i);
+        // 纹理中已经是别的帧，需要重新上传
+        EXPECT_EQ(0, vp->uploaded);
+        EXPECT_EQ(i, history.getPosition());
+        EXPECT_TRUE(history.isRewound());
+    }
+    EXPECT_TRUE(history.back() == NULL);
+    expectFrame(history.current(), 0);
+
+    for (int i = 1; i < 5; i++) {
+        expectFrame(history.forward(), i);
+    }
+    EXPECT_TRUE(history.forward() == NULL);
+    EXPECT_FALSE(history.isRewound());
+    expectFrame(history.current(), 4);
+}
+
+TEST_F(FrameHistoryTest, PushAfterRewindDropsLaterFrames) {
+    FrameHistory history(8);
+    for (int i = 0; i < 5; i++) {
+        show(&history, i);
+    }
+    expectFrame(history.back(), 3);
+    expectFrame(history.back(), 2);
+
+    // 后退以后重新定位播放，第2帧之后的记录不再有效
+    show(&history, 10);
+    expectFrame(history.current(), 10);
+    EXPECT_EQ(1, history.current()->uploaded);
+    EXPECT_FALSE(history.isRewound());
+    EXPECT_TRUE(history.forward() == NULL);
+
+    expectFrame(history.back(), 2);
+    expectFrame(history.back(), 1);
+    expectFrame(history.back(), 0);
+    EXPECT_TRUE(history.back() == NULL);
+    expectFrame(history.forward(), 1);
+    expectFrame(history.forward(), 2);
+    expectFrame(history.forward(), 10);
+    EXPECT_TRUE(history.forward() == NULL);
+}
+
+TEST_F(FrameHistoryTest, FullHistoryEvictsOldestFrame) {
+    FrameHistory history(3);
+    for (int i = 0; i < 6; i++) {
+        show(&history, i);
+    }
+    expectFrame(history.current(), 5);
+    EXPECT_EQ(2, history.getPosition());
+    expectFrame(history.back(), 4);
+    expectFrame(history.back(), 3);
+    EXPECT_TRUE(history.back() == NULL);
+    expectFrame(history.forward(), 4);
+    expectFrame(history.forward(), 5);
+    EXPECT_TRUE(history.forward() == NULL);
+}
+
+TEST_F(FrameHistoryTest, PushAfterRewindAcrossRingWrap) {
+    FrameHistory history(4);
+    // 环形缓冲已经绕过一圈，最早一帧不在数组开头
+    for (int i = 0; i < 6; i++) {
+        show(&history, i);
+    }
+    expectFrame(history.back(), 4);
+    show(&history, 6);
+    expectFrame(history.current(), 6);
+    expectFrame(history.back(), 4);
+    expectFrame(history.back(), 3);
+    expectFrame(history.back(), 2);
+    EXPECT_TRUE(history.back() == NULL);
+
+    // 满了以后继续记录，再次淘汰最早的帧
+    expectFrame(history.forward(), 3);
+    expectFrame(history.forward(), 4);
+    expectFrame(history.forward(), 6);
+    show(&history, 7);
+    expectFrame(history.back(), 6);
+    expectFrame(history.back(), 4);
+    expectFrame(history.back(), 3);
+    EXPECT_TRUE(history.back() == NULL);
+}
+
+TEST_F(FrameHistoryTest, ClearForgetsAllFrames) {
+    FrameHistory history(4);
+    for (int i = 0; i < 3; i++) {
+        show(&history, i);
+    }
+    history.clear();
+    EXPECT_TRUE(history.current() == NULL);
+    EXPECT_TRUE(history.back() == NULL);
+
+    show(&history, 20);
+    expectFrame(history.current(), 20);
+    EXPECT_TRUE(history.back() == NULL);
+}
+
+TEST_F(FrameHistoryTest, ZeroCapacityRecordsNothing) {
+    FrameHistory history(0);
+    show(&history, 0);
+    show(&history, 1);
+    EXPECT_TRUE(history.current() == NULL);
+    EXPECT_TRUE(history.back() == NULL);
+    EXPECT_FALSE(history.isRewound());
+}
@@ -0,0 +1,289 @@
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include "HttpCache.h"
+#include "Mutex.h"
+#include "Thread.h"
+
+extern "C" {
+#include "libavutil/time.h"
+};
+
+// 测试文件比8个分块多一点，最后一个分块不完整
+#define TEST_FILE_SIZE (8 * HTTP_CACHE_BLOCK_SIZE + 1000)
+// 服务器每次发送的数据量和间隔，限速以后客户端关闭连接之前不会把整个文件都塞进套接字缓冲
+#define SEND_CHUNK_SIZE (8 * 1024)
+#define SEND_CHUNK_INTERVAL 1000
+// 打开缓存时为了拿到文件大小建立的连接，关闭之前允许服务器多发送的数据量
+#define PROBE_ALLOWANCE HTTP_CACHE_BLOCK_SIZE
+
+static uint8_t fileByte(int64_t pos) {
+    return (uint8_t) (pos * 7 + (pos >> 8));
+}
+
+/**
+ * 支持Range请求的本地http服务器，统计请求的起始位置和实际发送的数据量
+ * 每个连接只处理一个请求，发送完或者客户端关闭以后断开
+ */
+class CountingHttpServer : public Runnable {
+public:
+    CountingHttpServer() : listenFd(-1), port(0), exitRequest(false), bytesSent(0) {}
+
+    int start() {
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        if (listenFd < 0) {
+            return -1;
+        }
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        if (bind(listenFd, (struct sockaddr *) &addr, len) < 0 || listen(listenFd, 8) < 0
+            || getsockname(listenFd, (struct sockaddr *) &addr, &len) < 0) {
+            return -1;
+        }
+        port = ntohs(addr.sin_port);
+        thread = new Thread(this);
+        thread->start();
+        return 0;
+    }
+
+    void stop() {
+        exitRequest = true;
+        if (listenFd >= 0) {
+            shutdown(listenFd, SHUT_RDWR);
+            close(listenFd);
+        }
+        if (thread) {
+            thread->join();
+            delete thread;
+        }
+        for (Thread *connection : connections) {
+            connection->join();
+            delete connection;
+        }
+        for (Runnable *handler : handlers) {
+            delete handler;
+        }
+    }
+
+    std::string url() {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "http://127.0.0.1:%d/video.mp4", port);
+        return buf;
+    }
+
+    // 清空统计，开始统计下一次播放
+    void resetStats() {
+        Mutex::Autolock lock(mMutex);
+        rangeStarts.clear();
+        bytesSent = 0;
+    }
+
+    std::vector<int64_t> getRangeStarts() {
+        Mutex::Autolock lock(mMutex);
+        return rangeStarts;
+    }
+
+    int64_t getBytesSent() {
+        return bytesSent;
+    }
+
+    void run() override {
+        while (!exitRequest) {
+            int fd = accept(listenFd, NULL, NULL);
+            if (fd < 0) {
+                break;
+            }
+            Runnable *handler = new Connection(this, fd);
+            Thread *connection = new Thread(handler);
+            handlers.push_back(handler);
+            connections.push_back(connection);
+            connection->start();
+        }
+    }
+
+private:
+    class Connection : public Runnable {
+    public:
+        Connection(CountingHttpServer *server, int fd) : server(server), fd(fd) {}
+
+        void run() override {
+            server->serve(fd);
+            close(fd);
+        }
+
+        CountingHttpServer *server;
+        int fd;
+    };
+
+    void serve(int fd) {
+        std::string request;
+        char c;
+        while (request.size() < 4096 && request.find("\r\n\r\n") == std::string::npos) {
+            if (recv(fd, &c, 1, 0) != 1) {
+                return;
+            }
+            request += c;
+        }
+        int64_t start = 0;
+        size_t range = request.find("Range: bytes=");
+        bool partial = range != std::string::npos;
+        if (partial) {
+            start = atoll(request.c_str() + range + strlen("Range: bytes="));
+        }
+        {
+            Mutex::Autolock lock(mMutex);
+            rangeStarts.push_back(start);
+        }
+
+        char header[256];
+        int len;
+        if (partial) {
+            len = snprintf(header, sizeof(header),
+                           "HTTP/1.1 206 Partial Content\r\nAccept-Ranges: bytes\r\n"
+                           "Content-Range: bytes %lld-%lld/%lld\r\nContent-Length: %lld\r\n\r\n",
+                           (long long) start, (long long) TEST_FILE_SIZE - 1, (long long) TEST_FILE_SIZE,
+                           (long long) (TEST_FILE_SIZE - start));
+        } else {
+            len = snprintf(header, sizeof(header),
+                           "HTTP/1.1 200 OK\r\nAccept-Ranges: bytes\r\nContent-Length: %lld\r\n\r\n",
+                           (long long) TEST_FILE_SIZE);
+        }
+        if (send(fd, header, (size_t) len, MSG_NOSIGNAL) != len) {
+            return;
+        }
+        uint8_t chunk[SEND_CHUNK_SIZE];
+        for (int64_t pos = start; pos < TEST_FILE_SIZE && !exitRequest;) {
+            int size = (int) FFMIN(SEND_CHUNK_SIZE, TEST_FILE_SIZE - pos);
+            for (int i = 0; i < size; i++) {
+                chunk[i] = fileByte(pos + i);
+            }
+            ssize_t n = send(fd, chunk, (size_t) size, MSG_NOSIGNAL);
+            if (n <= 0) {
+                return;
+            }
+            pos += n;
+            bytesSent += n;
+            av_usleep(SEND_CHUNK_INTERVAL);
+        }
+    }
+
+    int listenFd;
+    int port;
+    std::atomic<bool> exitRequest;
+    Thread *thread = NULL;
+    std::vector<Thread *> connections;
+    std::vector<Runnable *> handlers;
+    Mutex mMutex;
+    std::vector<int64_t> rangeStarts;
+    std::atomic<int64_t> bytesSent;
+};
+
+class HttpCacheTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        char dir[] = "/tmp/eplayer_http_cache_XXXXXX";
+        ASSERT_TRUE(mkdtemp(dir) != NULL);
+        cacheDir = dir;
+        ASSERT_EQ(0, server.start());
+    }
+
+    void TearDown() override {
+        server.stop();
+        DIR *dir = opendir(cacheDir.c_str());
+        if (dir) {
+            struct dirent *ent;
+            while ((ent = readdir(dir)) != NULL) {
+                if (ent->d_name[0] != '.') {
+                    unlink((cacheDir + "/" + ent->d_name).c_str());
+                }
+            }
+            closedir(dir);
+        }
+        rmdir(cacheDir.c_str());
+    }
+
+    // 跟播放器一样通过缓存的AVIOContext读取，从offset读到end，返回读到并且校验正确的字节数
+    int64_t play(int64_t offset, int64_t end) {
+        HttpCache cache;
+        if (cache.open(server.url().c_str(), cacheDir.c_str(), 64 * 1024 * 1024, NULL, NULL) < 0) {
+            return -1;
+        }
+        AVIOContext *pb = cache.getContext();
+        if (offset > 0 && avio_seek(pb, offset, SEEK_SET) != offset) {
+            cache.close();
+            return -1;
+        }
+        std::vector<uint8_t> buf(64 * 1024);
+        int64_t pos = offset;
+        while (pos < end) {
+            int n = avio_read(pb, buf.data(), (int) FFMIN((int64_t) buf.size(), end - pos));
+            if (n <= 0) {
+                break;
+            }
+            for (int i = 0; i < n; i++) {
+                if (buf[i] != fileByte(pos + i)) {
+                    cache.close();
+                    return -1;
+                }
+            }
+            pos += n;
+        }
+        cache.close();
+        return pos - offset;
+    }
+
+    std::string cacheDir;
+    CountingHttpServer server;
+};
+
+TEST_F(HttpCacheTest, ReplayIsServedFromCache) {
+    ASSERT_EQ(TEST_FILE_SIZE, play(0, TEST_FILE_SIZE));
+    EXPECT_GE(server.getBytesSent(), TEST_FILE_SIZE);
+
+    // 重播时只有打开缓存拿文件大小的连接，数据全部从缓存读取
+    server.resetStats();
+    ASSERT_EQ(TEST_FILE_SIZE, play(0, TEST_FILE_SIZE));
+    std::vector<int64_t> starts = server.getRangeStarts();
+    ASSERT_EQ(1u, starts.size());
+    EXPECT_EQ(0, starts[0]);
+    EXPECT_LT(server.getBytesSent(), PROBE_ALLOWANCE);
+
+    // 向后定位也不会重新下载
+    server.resetStats();
+    ASSERT_EQ(TEST_FILE_SIZE - 3 * HTTP_CACHE_BLOCK_SIZE, play(3 * HTTP_CACHE_BLOCK_SIZE, TEST_FILE_SIZE));
+    EXPECT_EQ(1u, server.getRangeStarts().size());
+    EXPECT_LT(server.getBytesSent(), PROBE_ALLOWANCE);
+}
+
+TEST_F(HttpCacheTest, PartialCacheFetchesOnlyMissingBlocks) {
+    const int64_t cached = 4 * HTTP_CACHE_BLOCK_SIZE;
+    ASSERT_EQ(cached, play(0, cached));
+
+    // 前4个分块从缓存读取，读到第5个分块时才从这个位置请求服务器
+    server.resetStats();
+    ASSERT_EQ(TEST_FILE_SIZE, play(0, TEST_FILE_SIZE));
+    std::vector<int64_t> starts = server.getRangeStarts();
+    ASSERT_EQ(2u, starts.size());
+    EXPECT_EQ(0, starts[0]);
+    EXPECT_EQ(cached, starts[1]);
+    EXPECT_LT(server.getBytesSent(), TEST_FILE_SIZE - cached + PROBE_ALLOWANCE);
+
+    // 第二次播放读完以后全部缓存
+    server.resetStats();
+    ASSERT_EQ(TEST_FILE_SIZE, play(0, TEST_FILE_SIZE));
+    EXPECT_EQ(1u, server.getRangeStarts().size());
+    EXPECT_LT(server.getBytesSent(), PROBE_ALLOWANCE);
+}
@@ -0,0 +1,265 @@
+
+#include <gtest/gtest.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "KeyframeIndex.h"
+#include "CacheFile.h"
+
+// 模拟的文件大小和时长，参与计算文件标识
+#define FAKE_FILE_SIZE (64 * 1024 * 1024)
+#define FAKE_DURATION (600 * (int64_t) AV_TIME_BASE)
+
+/**
+ * 用零初始化的解复用上下文模拟一个可以按字节定位的mpegts文件，时间基为毫秒
+ */
+class KeyframeIndexTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        char dir[] = "/tmp/eplayer_kfi_XXXXXX";
+        ASSERT_TRUE(mkdtemp(dir) != NULL);
+        indexDir = dir;
+        url = indexDir + "/video.ts";
+        FILE *file = fopen(url.c_str(), "wb");
+        ASSERT_TRUE(file != NULL);
+        fclose(file);
+
+        memset(&iformat, 0, sizeof(iformat));
+        iformat.name = "mpegts";
+        iformat.flags = AVFMT_TS_DISCONT;
+        memset(&pb, 0, sizeof(pb));
+        pb.seekable = AVIO_SEEKABLE_NORMAL;
+        pb.seek = seekCallback;
+        memset(&stream, 0, sizeof(stream));
+        stream.id = 0x100;
+        stream.time_base = (AVRational) {1, 1000};
+        streams[0] = &stream;
+        memset(&formatCtx, 0, sizeof(formatCtx));
+        formatCtx.iformat = &iformat;
+        formatCtx.pb = &pb;
+        formatCtx.nb_streams = 1;
+        formatCtx.streams = streams;
+        formatCtx.duration = FAKE_DURATION;
+    }
+
+    void TearDown() override {
+        unlink(indexPath(0).c_str());
+        unlink(url.c_str());
+        rmdir(indexDir.c_str());
+    }
+
+    static int64_t seekCallback(void *opaque, int64_t offset, int whence) {
+        return whence == AVSEEK_SIZE ? FAKE_FILE_SIZE : -1;
+    }
+
+    int open(KeyframeIndex *index) {
+        return index->open(&formatCtx, 0, url.c_str(), indexDir.c_str());
+    }
+
+    uint64_t fileKey() {
+        return computeFileKey(url.c_str(), FAKE_FILE_SIZE, FAKE_DURATION);
+    }
+
+    // 与KeyframeIndex使用相同的命名规则，keyOffset用来构造标识不一致的文件
+    std::string indexPath(uint64_t keyOffset) {
+        char name[32];
+        snprintf(name, sizeof(name), "/%016" PRIx64 KEYFRAME_INDEX_SUFFIX, fileKey() + keyOffset);
+        return indexDir + name;
+    }
+
+    // 按照索引文件格式直接写入，pts单位AV_TIME_BASE
+    void writeIndexFile(int version, int flags, uint64_t key, const std::vector<KeyframeEntry> &entries) {
+        FILE *file = fopen(indexPath(0).c_str(), "wb");
+        ASSERT_TRUE(file != NULL);
+        fwrite("EKFI", 1, 4, file);
+        fputc(version, file);
+        fputc(flags, file);
+        writeVarint(file, key);
+        writeVarint(file, entries.size());
+        int64_t pts = 0, pos = 0;
+        for (const KeyframeEntry &entry : entries) {
+            writeSignedVarint(file, entry.pts - pts);
+            writeSignedVarint(file, entry.pos - pos);
+            writeVarint(file, (uint64_t) entry.gopLength);
+            pts = entry.pts;
+            pos = entry.pos;
+        }
+        fclose(file);
+    }
+
+    // 读数据包线程读到的数据包，pts单位毫秒
+    static void addPacket(KeyframeIndex *index, int64_t pts, int64_t pos, bool key) {
+        AVPacket pkt;
+        av_init_packet(&pkt);
+        pkt.stream_index = 0;
+        pkt.pts = pts;
+        pkt.dts = pts;
+        pkt.pos = pos;
+        pkt.flags = key ? AV_PKT_FLAG_KEY : 0;
+        index->addPacket(&pkt);
+    }
+
+    static void expectEntry(KeyframeIndex *index, int64_t target, int64_t pts, int64_t pos) {
+        KeyframeEntry entry;
+        ASSERT_TRUE(index->lookup(target, &entry)) << "target " << target;
+        EXPECT_EQ(pts, entry.pts);
+        EXPECT_EQ(pos, entry.pos);
+    }
+
+    static void expectMissing(KeyframeIndex *index, int64_t target) {
+        KeyframeEntry entry;
+        EXPECT_FALSE(index->lookup(target, &entry)) << "target " << target;
+    }
+
+    std::string indexDir;
+    std::string url;
+    AVInputFormat iformat;
+    AVIOContext pb;
+    AVStream stream;
+    AVStream *streams[1];
+    AVFormatContext formatCtx;
+};
+
+TEST_F(KeyframeIndexTest, RejectsFormatsWithoutByteSeek) {
+    KeyframeIndex index;
+    iformat.flags = 0;
+    EXPECT_EQ(-1, open(&index));
+    iformat.flags = AVFMT_TS_DISCONT | AVFMT_NO_BYTE_SEEK;
+    EXPECT_EQ(-1, open(&index));
+    iformat.flags = AVFMT_TS_DISCONT;
+    pb.seekable = 0;
+    EXPECT_EQ(-1, open(&index));
+}
+
+TEST_F(KeyframeIndexTest, SaveAndLoadRoundTrip) {
+    {
+        KeyframeIndex index;
+        ASSERT_EQ(0, open(&index));
+        // 起始时间为负数，后面的关键帧字节偏移比前面的小，差值都是负数
+        addPacket(&index, -2000, 90000, true);
+        addPacket(&index, -1960, 91000, false);
+        addPacket(&index, -1920, 92000, false);
+        addPacket(&index, 0, 4000, true);
+        addPacket(&index, 40, 5000, false);
+        addPacket(&index, 2000, 188, true);
+        EXPECT_EQ(3, index.getKeyframeCount());
+        ASSERT_EQ(0, index.save());
+    }
+
+    KeyframeIndex index;
+    ASSERT_EQ(0, open(&index));
+    EXPECT_EQ(3, index.getKeyframeCount());
+    EXPECT_FALSE(index.isComplete());
+    expectEntry(&index, -2000 * 1000, -2000 * 1000, 90000);
+    expectEntry(&index, -1, -2000 * 1000, 90000);
+    expectEntry(&index, 1999 * 1000, 0, 4000);
+    // 最后一个关键帧之后不知道还有没有关键帧
+    expectMissing(&index, 2000 * 1000);
+}
+
+TEST_F(KeyframeIndexTest, CompleteFlagAllowsLastEntry) {
+    std::vector<KeyframeEntry> entries = {{-500000, 1000, 10}, {1500000, 376, 25}};
+    writeIndexFile(KEYFRAME_INDEX_VERSION, 1, fileKey(), entries);
+
+    KeyframeIndex index;
+    ASSERT_EQ(0, open(&index));
+    EXPECT_EQ(2, index.getKeyframeCount());
+    EXPECT_TRUE(index.isComplete());
+    expectEntry(&index, 0, -500000, 1000);
+    expectEntry(&index, FAKE_DURATION, 1500000, 376);
+}
+
+TEST_F(KeyframeIndexTest, IncompleteFileKeepsLastEntryUnknown) {
+    std::vector<KeyframeEntry> entries = {{0, 188, 10}, {1000000, 9400, 10}};
+    writeIndexFile(KEYFRAME_INDEX_VERSION, 0, fileKey(), entries);
+
+    KeyframeIndex index;
+    ASSERT_EQ(0, open(&index));
+    EXPECT_EQ(2, index.getKeyframeCount());
+    EXPECT_FALSE(index.isComplete());
+    expectEntry(&index, 999999, 0, 188);
+    expectMissing(&index, 1000000);
+}
+
+TEST_F(KeyframeIndexTest, RejectsWrongKey) {
+    std::vector<KeyframeEntry> entries = {{0, 188, 10}};
+    writeIndexFile(KEYFRAME_INDEX_VERSION, 1, fileKey() + 1, entries);
+
+    KeyframeIndex index;
+    ASSERT_EQ(0, open(&index));
+    EXPECT_EQ(0, index.getKeyframeCount());
+    EXPECT_FALSE(index.isComplete());
+}
+
+TEST_F(KeyframeIndexTest, RejectsWrongVersion) {
+    std::vector<KeyframeEntry> entries = {{0, 188, 10}};
+    writeIndexFile(KEYFRAME_INDEX_VERSION + 1, 1, fileKey(), entries);
+
+    KeyframeIndex index;
+    ASSERT_EQ(0, open(&index));
+    EXPECT_EQ(0, index.getKeyframeCount());
+    EXPECT_FALSE(index.isComplete());
+}
+
+TEST_F(KeyframeIndexTest, RejectsUnorderedEntries) {
+    std::vector<KeyframeEntry> entries = {{1000000, 188, 10}, {1000000, 9400, 10}};
+    writeIndexFile(KEYFRAME_INDEX_VERSION, 1, fileKey(), entries);
+
+    KeyframeIndex index;
+    ASSERT_EQ(0, open(&index));
+    EXPECT_EQ(0, index.getKeyframeCount());
+}
+
+TEST_F(KeyframeIndexTest, LookupEdgeCases) {
+    // 第二个关键帧之后没有连续读取，GOP长度未知
+    std::vector<KeyframeEntry> entries = {{1000000, 188, 12}, {2000000, 9400, 0}, {3000000, 18800, 12},
+                                          {4000000, 28200, 12}};
+    writeIndexFile(KEYFRAME_INDEX_VERSION, 0, fileKey(), entries);
+
+    KeyframeIndex index;
+    ASSERT_EQ(0, open(&index));
+    ASSERT_EQ(4, index.getKeyframeCount());
+    // 第一个关键帧之前
+    expectMissing(&index, 999999);
+    expectMissing(&index, INT64_MIN);
+    // 正好落在关键帧上
+    expectEntry(&index, 1000000, 1000000, 188);
+    expectEntry(&index, 1999999, 1000000, 188);
+    expectEntry(&index, 3000000, 3000000, 18800);
+    // 空缺中间可能还有其他关键帧
+    expectMissing(&index, 2000000);
+    expectMissing(&index, 2999999);
+    expectMissing(&index, INT64_MAX);
+}
+
+TEST_F(KeyframeIndexTest, DiscontinuityLeavesGap) {
+    KeyframeIndex index;
+    ASSERT_EQ(0, open(&index));
+    addPacket(&index, 0, 188, true);
+    addPacket(&index, 40, 1000, false);
+    addPacket(&index, 1000, 9400, true);
+    // 定位以后从别的位置开始读
+    index.discontinue();
+    addPacket(&index, 5000, 47000, true);
+    addPacket(&index, 5040, 48000, false);
+    addPacket(&index, 6000, 56400, true);
+    // 没有时间戳或者没有字节偏移的关键帧不记录
+    addPacket(&index, AV_NOPTS_VALUE, 60000, true);
+    addPacket(&index, 7000, -1, true);
+    EXPECT_EQ(4, index.getKeyframeCount());
+
+    expectEntry(&index, 500000, 0, 188);
+    expectMissing(&index, 1500000);
+    expectEntry(&index, 5500000, 5000000, 47000);
+    expectMissing(&index, 6500000);
+
+    // 补上空缺以后，前一个关键帧的GOP长度也确定了
+    index.discontinue();
+    addPacket(&index, 1000, 9400, true);
+    addPacket(&index, 1040, 10000, false);
+    addPacket(&index, 5000, 47000, true);
+    expectEntry(&index, 1500000, 1000000, 9400);
+    expectEntry(&index, 4999999, 1000000, 9400);
+}
@@ -0,0 +1,242 @@
+
+#include <gtest/gtest.h>
+#include <math.h>
+#include <deque>
+#include "LiveLatencyController.h"
+
+// 跟FLV一样的毫秒时间基准，音频每个数据包20ms，视频25fps，每秒一个关键帧
+#define VIDEO_INDEX 0
+#define AUDIO_INDEX 1
+#define AUDIO_FRAME_MS 20
+#define VIDEO_FRAME_MS 40
+#define GOP_FRAMES 25
+#define AUDIO_PACKET_BYTES 200
+#define VIDEO_PACKET_BYTES 5000
+#define KEY_PACKET_BYTES 30000
+// 限速链路的带宽，单位byte/ms，大约是码流的4倍，网络恢复以后可以很快送完积压的数据
+#define LINK_RATE 600
+// 开始播放之前缓冲的时长，单位毫秒
+#define START_BUFFER_MS 1000
+
+typedef struct LivePacket {
+    int64_t pts;            // 采集时间，单位毫秒
+    int streamIndex;
+    int size;
+    bool key;
+} LivePacket;
+
+/**
+ * 按虚拟时间模拟直播：推流端按采集时间产生数据包，经过限速并且会中断的链路送到读数据包线程，
+ * 读数据包线程调用LiveLatencyController检查以后送入队列，音频按播放速度消耗，主时钟是音频时钟
+ */
+class LiveLatencyTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        playerState = new PlayerState();
+        playerState->liveMode = 1;
+        playerState->pauseRequest = 0;
+        controller = new LiveLatencyController(playerState);
+        controller->open(VIDEO_INDEX, AUDIO_INDEX, (AVRational) {1, 1000});
+        now = 0;
+        nextAudio = 0;
+        nextVideo = 0;
+        linkBudget = 0;
+        stallStart = stallEnd = -1;
+        started = false;
+        playingPts = AV_NOPTS_VALUE;
+        playingRemain = 0;
+        needKeyframe = false;
+        queueDrops = 0;
+        maxLatency = 0;
+        catchUpStarted = false;
+        badVideoFrames = 0;
+    }
+
+    void TearDown() override {
+        delete controller;
+        delete playerState;
+    }
+
+    // 主时钟，单位秒，还没有开始播放时为NAN
+    double clock() {
+        if (playingPts == AV_NOPTS_VALUE) {
+            return NAN;
+        }
+        return (playingPts + AUDIO_FRAME_MS - playingRemain) / 1000.0;
+    }
+
+    // 推流端产生这一毫秒采集到的数据包
+    void capture() {
+        while (nextAudio * AUDIO_FRAME_MS <= now) {
+            LivePacket pkt = {nextAudio * AUDIO_FRAME_MS, AUDIO_INDEX, AUDIO_PACKET_BYTES, true};
+            sent.push_back(pkt);
+            nextAudio++;
+        }
+        while (nextVideo * VIDEO_FRAME_MS <= now) {
+            bool key = nextVideo % GOP_FRAMES == 0;
+            LivePacket pkt = {nextVideo * VIDEO_FRAME_MS, VIDEO_INDEX,
+                              key ? KEY_PACKET_BYTES : VIDEO_PACKET_BYTES, key};
+            sent.push_back(pkt);
+            nextVideo++;
+        }
+    }
+
+    // 链路按带宽送出数据包，中断期间不送
+    void deliver() {
+        if (now >= stallStart && now < stallEnd) {
+            return;
+        }
+        linkBudget += LINK_RATE;
+        while (!sent.empty() && linkBudget >= sent.front().size) {
+            linkBudget -= sent.front().size;
+            read(sent.front());
+            sent.pop_front();
+        }
+        if (sent.empty()) {
+            linkBudget = 0;
+        }
+    }
+
+    // 跟读数据包线程一样先检查延时，再送入队列
+    void read(const LivePacket &packet) {
+        AVPacket pkt;
+        av_init_packet(&pkt);
+        pkt.pts = pkt.dts = packet.pts;
+        pkt.stream_index = packet.streamIndex;
+        pkt.size = packet.size;
+        pkt.flags = packet.key ? AV_PKT_FLAG_KEY : 0;
+        int result = controller->check(&pkt, clock());
+        if (!isnan(controller->getLatency())) {
+            maxLatency = FFMAX(maxLatency, controller->getLatency());
+        }
+        if (playerState->liveCatchUpRate == LIVE_CATCH_UP_RATE) {
+            catchUpStarted = true;
+        }
+        if (result & LIVE_DROP_QUEUE) {
+            audioQueue.clear();
+            videoQueue.clear();
+            needKeyframe = true;
+            queueDrops++;
+        }
+        if (result & LIVE_DROP_PACKET) {
+            return;
+        }
+        if (packet.streamIndex == AUDIO_INDEX) {
+            audioQueue.push_back(packet);
+        } else {
+            videoQueue.push_back(packet);
+        }
+    }
+
+    // 音频按播放速度消耗，视频显示到主时钟的位置，丢弃队列以后第一帧视频必须是关键帧
+    void play() {
+        if (!started) {
+            if (audioQueue.empty() || audioQueue.back().pts - audioQueue.front().pts < START_BUFFER_MS) {
+                return;
+            }
+            started = true;
+        }
+        // 这一毫秒按播放速度播放的音频时长，一帧播完以后剩下的时长接着播放下一帧
+        double advance = playerState->liveCatchUpRate;
+        while (advance > 0) {
+            if (playingRemain <= 0) {
+                if (audioQueue.empty()) {
+                    break;
+                }
+                playingPts = audioQueue.front().pts;
+                playingRemain = AUDIO_FRAME_MS;
+                audioQueue.pop_front();
+            }
+            double played = FFMIN(playingRemain, advance);
+            playingRemain -= played;
+            advance -= played;
+        }
+        double position = clock() * 1000;
+        while (!videoQueue.empty() && videoQueue.front().pts <= position) {
+            if (needKeyframe && !videoQueue.front().key) {
+                badVideoFrames++;
+            }
+            needKeyframe = false;
+            videoQueue.pop_front();
+        }
+    }
+
+    // 按毫秒运行到指定的时间
+    void runUntil(int64_t end) {
+        for (; now < end; now++) {
+            capture();
+            deliver();
+            play();
+        }
+    }
+
+    PlayerState *playerState;
+    LiveLatencyController *controller;
+    int64_t now;                    // 虚拟时间，单位毫秒
+    int64_t nextAudio;
+    int64_t nextVideo;
+    std::deque<LivePacket> sent;    // 已经采集还没有送到的数据包
+    int64_t linkBudget;
+    int64_t stallStart;             // 链路中断的时间段
+    int64_t stallEnd;
+    std::deque<LivePacket> audioQueue;
+    std::deque<LivePacket> videoQueue;
+    bool started;
+    int64_t playingPts;             // 正在播放的音频帧
+    double playingRemain;           // 正在播放的音频帧还剩下的时长，单位毫秒
+    bool needKeyframe;
+    int queueDrops;
+    double maxLatency;
+    bool catchUpStarted;
+    int badVideoFrames;
+};
+
+TEST_F(LiveLatencyTest, SteadyStreamKeepsNormalSpeed) {
+    runUntil(20000);
+    EXPECT_NEAR(START_BUFFER_MS / 1000.0, controller->getLatency(), 0.1);
+    EXPECT_LE(maxLatency, playerState->liveTargetLatency + LIVE_LATENCY_TOLERANCE);
+    EXPECT_FALSE(catchUpStarted);
+    EXPECT_EQ(0, queueDrops);
+}
+
+TEST_F(LiveLatencyTest, ShortStallCatchesUpWithoutDropping) {
+    // 中断2.5秒，播放器耗尽1秒缓冲以后停顿，恢复以后延时大约是2.5秒，在上限以内
+    stallStart = 5000;
+    stallEnd = 7500;
+    runUntil(9000);
+    EXPECT_TRUE(catchUpStarted);
+    EXPECT_FLOAT_EQ(LIVE_CATCH_UP_RATE, playerState->liveCatchUpRate);
+    EXPECT_GT(controller->getLatency(), playerState->liveTargetLatency + LIVE_LATENCY_TOLERANCE);
+
+    // 1.1倍速每秒追回0.1秒，多出来的1.5秒需要15秒左右
+    runUntil(30000);
+    // 延时回到目标以后恢复正常速度，之后在目标附近，误差是一帧音频的时长
+    EXPECT_FLOAT_EQ(1.0f, playerState->liveCatchUpRate);
+    EXPECT_NEAR(playerState->liveTargetLatency, controller->getLatency(), 0.05);
+    EXPECT_LT(maxLatency, playerState->liveMaxLatency);
+    EXPECT_EQ(0, queueDrops);
+}
+
+TEST_F(LiveLatencyTest, LongStallDropsToNextKeyframe) {
+    // 中断5秒，恢复以后积压的数据包让延时超过上限，丢弃缓冲的数据包直到下一个关键帧
+    stallStart = 5000;
+    stallEnd = 10000;
+    runUntil(12000);
+    // 丢弃以后主时钟到达保留下来的数据包之前不再计算延时，只丢弃一次
+    EXPECT_EQ(1, queueDrops);
+
+    runUntil(40000);
+    EXPECT_EQ(1, queueDrops);
+    EXPECT_EQ(0, badVideoFrames);
+    EXPECT_FLOAT_EQ(1.0f, playerState->liveCatchUpRate);
+    EXPECT_LE(controller->getLatency(), playerState->liveTargetLatency + LIVE_LATENCY_TOLERANCE);
+}
+
+TEST_F(LiveLatencyTest, PausedOrBufferingIsNotLatency) {
+    stallStart = 5000;
+    stallEnd = 10000;
+    playerState->buffering = 1;
+    runUntil(12000);
+    EXPECT_EQ(0, queueDrops);
+    EXPECT_FALSE(catchUpStarted);
+}
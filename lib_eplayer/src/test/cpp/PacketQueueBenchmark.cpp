@@ -0,0 +1,182 @@
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include "PacketQueue.h"
+#include "Thread.h"
+
+extern "C" {
+#include "libavutil/time.h"
+};
+
+// 每轮写入再读出的数据包数量，相当于几秒钟的音视频数据包
+#define BENCH_BATCH 256
+// 单线程测试的轮数
+#define BENCH_ROUNDS 2000
+// 多线程测试的数据包总数
+#define BENCH_THREADED_PACKETS (BENCH_BATCH * BENCH_ROUNDS)
+
+/**
+ * 改成环形缓冲之前的链表队列，每个数据包分配一个链表节点，只保留测试用到的部分
+ */
+class LinkedPacketQueue {
+public:
+    LinkedPacketQueue() : first(NULL), last(NULL), count(0), size(0), duration(0) {}
+
+    virtual ~LinkedPacketQueue() {
+        AVPacket pkt;
+        while (getPacket(&pkt, 0) > 0) {
+            av_packet_unref(&pkt);
+        }
+    }
+
+    int pushPacket(AVPacket *pkt) {
+        Node *node = (Node *) av_malloc(sizeof(Node));
+        if (!node) {
+            av_packet_unref(pkt);
+            return -1;
+        }
+        node->pkt = *pkt;
+        node->next = NULL;
+        mMutex.lock();
+        if (!last) {
+            first = node;
+        } else {
+            last->next = node;
+        }
+        last = node;
+        count++;
+        size += node->pkt.size + (int) sizeof(*node);
+        duration += node->pkt.duration;
+        mCondition.signal();
+        mMutex.unlock();
+        return 0;
+    }
+
+    int getPacket(AVPacket *pkt, int block) {
+        Mutex::Autolock lock(mMutex);
+        for (;;) {
+            Node *node = first;
+            if (node) {
+                first = node->next;
+                if (!first) {
+                    last = NULL;
+                }
+                count--;
+                size -= node->pkt.size + (int) sizeof(*node);
+                duration -= node->pkt.duration;
+                *pkt = node->pkt;
+                av_free(node);
+                return 1;
+            } else if (!block) {
+                return 0;
+            }
+            mCondition.wait(mMutex);
+        }
+    }
+
+private:
+    typedef struct Node {
+        AVPacket pkt;
+        struct Node *next;
+    } Node;
+
+    Mutex mMutex;
+    Condition mCondition;
+    Node *first;
+    Node *last;
+    int count;
+    int size;
+    int64_t duration;
+};
+
+static void initPacket(AVPacket *pkt, int number) {
+    av_init_packet(pkt);
+    pkt->data = NULL;
+    pkt->size = 1000 + number % 100;
+    pkt->duration = 1;
+    pkt->pos = number;
+}
+
+/**
+ * 单线程按批写入再读出，只测量队列本身的开销，返回每个数据包的耗时，单位纳秒
+ */
+template<typename Queue>
+static double benchSingleThread(Queue *queue) {
+    AVPacket pkt;
+    int64_t start = av_gettime_relative();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (int i = 0; i < BENCH_BATCH; i++) {
+            initPacket(&pkt, i);
+            queue->pushPacket(&pkt);
+        }
+        for (int i = 0; i < BENCH_BATCH; i++) {
+            if (queue->getPacket(&pkt, 0) != 1 || pkt.pos != i) {
+                return -1;
+            }
+        }
+    }
+    return (av_gettime_relative() - start) * 1000.0 / (BENCH_ROUNDS * BENCH_BATCH);
+}
+
+/**
+ * 生产者线程，模拟读数据包线程
+ */
+template<typename Queue>
+class BenchProducer : public Runnable {
+public:
+    explicit BenchProducer(Queue *queue) : queue(queue) {}
+
+    void run() override {
+        AVPacket pkt;
+        for (int i = 0; i < BENCH_THREADED_PACKETS; i++) {
+            initPacket(&pkt, i);
+            queue->pushPacket(&pkt);
+        }
+    }
+
+    Queue *queue;
+};
+
+/**
+ * 读数据包线程写入，解码线程阻塞读取，返回每个数据包的耗时，单位纳秒
+ */
+template<typename Queue>
+static double benchProducerConsumer(Queue *queue) {
+    BenchProducer<Queue> producer(queue);
+    Thread thread(&producer);
+    AVPacket pkt;
+    int64_t start = av_gettime_relative();
+    thread.start();
+    for (int i = 0; i < BENCH_THREADED_PACKETS; i++) {
+        if (queue->getPacket(&pkt, 1) != 1 || pkt.pos != i) {
+            thread.join();
+            return -1;
+        }
+    }
+    thread.join();
+    return (av_gettime_relative() - start) * 1000.0 / BENCH_THREADED_PACKETS;
+}
+
+// 只打印耗时，不按耗时判断成败，主机负载会影响结果
+TEST(PacketQueueBenchmark, SingleThread) {
+    PacketQueue ring;
+    LinkedPacketQueue linked;
+    // 先各跑一遍预热
+    ASSERT_GE(benchSingleThread(&ring), 0);
+    ASSERT_GE(benchSingleThread(&linked), 0);
+    double ringCost = benchSingleThread(&ring);
+    double linkedCost = benchSingleThread(&linked);
+    ASSERT_GE(ringCost, 0);
+    ASSERT_GE(linkedCost, 0);
+    printf("single thread: ring %.1fns/packet, linked list %.1fns/packet\n", ringCost, linkedCost);
+}
+
+TEST(PacketQueueBenchmark, ProducerConsumer) {
+    PacketQueue ring;
+    LinkedPacketQueue linked;
+    double ringCost = benchProducerConsumer(&ring);
+    double linkedCost = benchProducerConsumer(&linked);
+    ASSERT_GE(ringCost, 0);
+    ASSERT_GE(linkedCost, 0);
+    printf("producer/consumer: ring %.1fns/packet, linked list %.1fns/packet\n", ringCost, linkedCost);
+}
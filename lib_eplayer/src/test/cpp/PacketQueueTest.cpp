@@ -0,0 +1,210 @@
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include "PacketQueue.h"
+#include "Thread.h"
+
+/**
+ * 数据包只带序号，不分配数据，序号保存在pos中，大小和时长都由序号决定
+ */
+static void initPacket(AVPacket *pkt, int number) {
+    av_init_packet(pkt);
+    pkt->data = NULL;
+    pkt->size = number % 100;
+    pkt->duration = 1;
+    pkt->pos = number;
+}
+
+static int pushNumbered(PacketQueue *queue, int number) {
+    AVPacket pkt;
+    initPacket(&pkt, number);
+    return queue->pushPacket(&pkt);
+}
+
+static void expectNumbered(PacketQueue *queue, int number) {
+    AVPacket pkt;
+    ASSERT_EQ(1, queue->getPacket(&pkt, 0));
+    EXPECT_EQ(number, pkt.pos);
+    EXPECT_EQ(number % 100, pkt.size);
+}
+
+static int expectedSize(int from, int to) {
+    int size = 0;
+    for (int i = from; i < to; i++) {
+        size += i % 100 + (int) sizeof(AVPacket);
+    }
+    return size;
+}
+
+TEST(PacketQueueTest, EmptyQueueDoesNotBlock) {
+    PacketQueue queue;
+    AVPacket pkt;
+    EXPECT_EQ(0, queue.getPacket(&pkt, 0));
+    EXPECT_EQ(0, queue.getPacketSize());
+    EXPECT_EQ(0, queue.getSize());
+    EXPECT_EQ(0, queue.getDuration());
+}
+
+TEST(PacketQueueTest, WrapsWithinInitialRing) {
+    PacketQueue queue;
+    int written = 0;
+    int next = 0;
+    // 每轮写入3个读出2个，积压到一半容量时全部读出，读写位置多次绕过环形缓冲
+    while (written < 5 * PACKET_RING_INIT_CAPACITY) {
+        for (int j = 0; j < 3; j++) {
+            ASSERT_EQ(0, pushNumbered(&queue, written++));
+        }
+        for (int j = 0; j < 2; j++) {
+            expectNumbered(&queue, next++);
+        }
+        if (queue.getPacketSize() > PACKET_RING_INIT_CAPACITY / 2) {
+            while (next < written) {
+                expectNumbered(&queue, next++);
+            }
+        }
+    }
+    while (next < written) {
+        expectNumbered(&queue, next++);
+    }
+    EXPECT_EQ(0, queue.getPacketSize());
+    EXPECT_EQ(0, queue.getSize());
+}
+
+TEST(PacketQueueTest, GrowsBeyondInitialCapacity) {
+    PacketQueue queue;
+    const int total = PACKET_RING_INIT_CAPACITY * 8 + 7;
+    // 先读出一部分，让扩容发生在读写位置不在开头的时候
+    for (int i = 0; i < 100; i++) {
+        ASSERT_EQ(0, pushNumbered(&queue, i));
+    }
+    for (int i = 0; i < 50; i++) {
+        expectNumbered(&queue, i);
+    }
+    for (int i = 100; i < total; i++) {
+        ASSERT_EQ(0, pushNumbered(&queue, i));
+    }
+    EXPECT_EQ(total - 50, queue.getPacketSize());
+    EXPECT_EQ(total - 50, queue.getDuration());
+    EXPECT_EQ(expectedSize(50, total), queue.getSize());
+
+    for (int i = 50; i < total; i++) {
+        expectNumbered(&queue, i);
+    }
+    AVPacket pkt;
+    EXPECT_EQ(0, queue.getPacket(&pkt, 0));
+    EXPECT_EQ(0, queue.getPacketSize());
+    EXPECT_EQ(0, queue.getSize());
+    EXPECT_EQ(0, queue.getDuration());
+}
+
+TEST(PacketQueueTest, FlushDropsQueuedPackets) {
+    PacketQueue queue;
+    for (int i = 0; i < PACKET_RING_INIT_CAPACITY * 3; i++) {
+        ASSERT_EQ(0, pushNumbered(&queue, i));
+    }
+    queue.flush();
+    EXPECT_EQ(0, queue.getPacketSize());
+    EXPECT_EQ(0, queue.getSize());
+    EXPECT_EQ(0, queue.getDuration());
+    AVPacket pkt;
+    EXPECT_EQ(0, queue.getPacket(&pkt, 0));
+
+    // flush以后继续使用扩容后的环形缓冲
+    for (int i = 0; i < 10; i++) {
+        ASSERT_EQ(0, pushNumbered(&queue, 1000 + i));
+    }
+    for (int i = 0; i < 10; i++) {
+        expectNumbered(&queue, 1000 + i);
+    }
+}
+
+TEST(PacketQueueTest, NullPacket) {
+    PacketQueue queue;
+    ASSERT_EQ(0, pushNumbered(&queue, 1));
+    ASSERT_EQ(0, queue.pushNullPacket(3));
+    expectNumbered(&queue, 1);
+
+    AVPacket pkt;
+    ASSERT_EQ(1, queue.getPacket(&pkt, 0));
+    EXPECT_TRUE(pkt.data == NULL);
+    EXPECT_EQ(0, pkt.size);
+    EXPECT_EQ(3, pkt.stream_index);
+}
+
+TEST(PacketQueueTest, AbortRejectsPackets) {
+    PacketQueue queue;
+    ASSERT_EQ(0, pushNumbered(&queue, 1));
+    queue.abort();
+    EXPECT_TRUE(queue.isAbort());
+    EXPECT_EQ(-1, pushNumbered(&queue, 2));
+    AVPacket pkt;
+    EXPECT_EQ(-1, queue.getPacket(&pkt, 1));
+
+    queue.start();
+    expectNumbered(&queue, 1);
+    EXPECT_EQ(0, queue.getPacket(&pkt, 0));
+}
+
+/**
+ * 生产者线程，模拟读数据包线程
+ */
+class PacketProducer : public Runnable {
+public:
+    PacketProducer(PacketQueue *queue, int count) : queue(queue), count(count), failed(0) {}
+
+    void run() override {
+        for (int i = 0; i < count; i++) {
+            if (pushNumbered(queue, i) < 0) {
+                failed++;
+            }
+        }
+    }
+
+    PacketQueue *queue;
+    int count;
+    int failed;
+};
+
+TEST(PacketQueueTest, BlockingConsumerKeepsOrder) {
+    PacketQueue queue;
+    // 数量超过最大容量，消费者跟不上时生产者需要等待空位
+    const int total = PACKET_RING_MAX_CAPACITY * 2;
+    PacketProducer producer(&queue, total);
+    Thread thread(&producer);
+    thread.start();
+
+    AVPacket pkt;
+    for (int i = 0; i < total; i++) {
+        ASSERT_EQ(1, queue.getPacket(&pkt, 1));
+        ASSERT_EQ(i, pkt.pos);
+    }
+    thread.join();
+    EXPECT_EQ(0, producer.failed);
+    EXPECT_EQ(0, queue.getPacketSize());
+    EXPECT_EQ(0, queue.getSize());
+}
+
+/**
+ * 等一会再终止队列，模拟停止播放
+ */
+class PacketQueueAborter : public Runnable {
+public:
+    explicit PacketQueueAborter(PacketQueue *queue) : queue(queue) {}
+
+    void run() override {
+        usleep(20 * 1000);
+        queue->abort();
+    }
+
+    PacketQueue *queue;
+};
+
+TEST(PacketQueueTest, AbortWakesBlockedConsumer) {
+    PacketQueue queue;
+    PacketQueueAborter aborter(&queue);
+    Thread thread(&aborter);
+    thread.start();
+    AVPacket pkt;
+    EXPECT_EQ(-1, queue.getPacket(&pkt, 1));
+    thread.join();
+}
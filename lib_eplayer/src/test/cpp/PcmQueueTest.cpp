@@ -0,0 +1,148 @@
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include "PcmQueue.h"
+#include "Thread.h"
+
+/**
+ * 写入一个缓冲块，数据大小和音频时钟都由序号决定
+ */
+static void writeNumbered(PcmQueue *queue, int number) {
+    PcmBuffer *buffer = queue->peekWritable();
+    ASSERT_TRUE(buffer != NULL);
+    buffer->size = number;
+    buffer->clock = number * 0.02;
+    buffer->serial = queue->getSerial();
+    queue->pushBuffer();
+}
+
+static void readNumbered(PcmQueue *queue, int number) {
+    PcmBuffer *buffer = queue->peekReadable();
+    ASSERT_TRUE(buffer != NULL);
+    EXPECT_EQ(number, buffer->size);
+    EXPECT_DOUBLE_EQ(number * 0.02, buffer->clock);
+    queue->popBuffer();
+}
+
+TEST(PcmQueueTest, NotWritableBeforeStart) {
+    PcmQueue queue(4);
+    EXPECT_TRUE(queue.peekWritable() == NULL);
+    EXPECT_TRUE(queue.peekReadable() == NULL);
+    queue.start();
+    EXPECT_TRUE(queue.peekWritable() != NULL);
+    EXPECT_TRUE(queue.peekReadable() == NULL);
+}
+
+TEST(PcmQueueTest, WrapsAroundRing) {
+    PcmQueue queue(4);
+    queue.start();
+    int next = 0;
+    // 写入和读取的位置都多次绕过环形缓冲，缓冲块一直被复用
+    for (int i = 0; i < 40; i += 3) {
+        for (int j = 0; j < 3; j++) {
+            writeNumbered(&queue, i + j);
+        }
+        EXPECT_EQ(i + 3 - next, queue.getBufferCount());
+        while (next < i + 3) {
+            readNumbered(&queue, next++);
+        }
+        EXPECT_EQ(0, queue.getBufferCount());
+        EXPECT_TRUE(queue.peekReadable() == NULL);
+    }
+}
+
+TEST(PcmQueueTest, FlushDropsBuffersWithOldSerial) {
+    PcmQueue queue(8);
+    queue.start();
+    for (int i = 0; i < 5; i++) {
+        writeNumbered(&queue, i);
+    }
+    readNumbered(&queue, 0);
+    int serial = queue.getSerial();
+    queue.flush();
+    EXPECT_EQ(serial + 1, queue.getSerial());
+    // flush不动读写位置，旧数据由消费者丢弃
+    EXPECT_EQ(4, queue.getBufferCount());
+    EXPECT_TRUE(queue.peekReadable() == NULL);
+    EXPECT_EQ(0, queue.getBufferCount());
+
+    writeNumbered(&queue, 100);
+    writeNumbered(&queue, 101);
+    readNumbered(&queue, 100);
+    readNumbered(&queue, 101);
+    EXPECT_TRUE(queue.peekReadable() == NULL);
+}
+
+TEST(PcmQueueTest, FlushKeepsBuffersWrittenAfterIt) {
+    PcmQueue queue(4);
+    queue.start();
+    writeNumbered(&queue, 1);
+    writeNumbered(&queue, 2);
+    queue.flush();
+    // 消费者还没来得及丢弃旧数据时，生产者已经写入了新序列号的数据
+    writeNumbered(&queue, 3);
+    EXPECT_EQ(3, queue.getBufferCount());
+    readNumbered(&queue, 3);
+    EXPECT_EQ(0, queue.getBufferCount());
+}
+
+TEST(PcmQueueTest, DepthIsClamped) {
+    PcmQueue queue(1);
+    queue.start();
+    writeNumbered(&queue, 1);
+    writeNumbered(&queue, 2);
+    EXPECT_EQ(2, queue.getBufferCount());
+    // 队列已满，终止以后不再等待
+    queue.abort();
+    EXPECT_TRUE(queue.peekWritable() == NULL);
+
+    PcmQueue large(PCM_QUEUE_MAX_DEPTH * 2);
+    large.start();
+    for (int i = 0; i < PCM_QUEUE_MAX_DEPTH; i++) {
+        writeNumbered(&large, i);
+    }
+    EXPECT_EQ(PCM_QUEUE_MAX_DEPTH, large.getBufferCount());
+    large.abort();
+    EXPECT_TRUE(large.peekWritable() == NULL);
+}
+
+/**
+ * 生产者线程，模拟音频解码线程
+ */
+class PcmProducer : public Runnable {
+public:
+    PcmProducer(PcmQueue *queue, int count) : queue(queue), count(count) {}
+
+    void run() override {
+        for (int i = 0; i < count; i++) {
+            writeNumbered(queue, i);
+        }
+    }
+
+    PcmQueue *queue;
+    int count;
+};
+
+TEST(PcmQueueTest, FullQueueWaitsForConsumer) {
+    PcmQueue queue(4);
+    queue.start();
+    PcmProducer producer(&queue, 1000);
+    Thread thread(&producer);
+    thread.start();
+
+    // 消费者和音频回调一样不阻塞，没有数据时稍后再试
+    int next = 0;
+    while (next < 1000) {
+        PcmBuffer *buffer = queue.peekReadable();
+        if (!buffer) {
+            usleep(100);
+            continue;
+        }
+        ASSERT_EQ(next, buffer->size);
+        ASSERT_LE(queue.getBufferCount(), 4);
+        queue.popBuffer();
+        next++;
+    }
+    thread.join();
+    EXPECT_EQ(0, queue.getBufferCount());
+}
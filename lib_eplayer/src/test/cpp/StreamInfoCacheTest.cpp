@@ -0,0 +1,141 @@
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include "StreamInfoCache.h"
+
+static const uint8_t EXTRADATA[] = {0x01, 0x64, 0x00, 0x1f, 0xff};
+
+/**
+ * 用零初始化的解复用上下文模拟avformat_open_input以后的状态，一路视频一路音频
+ * 文件不存在，文件标识使用时长计算
+ */
+class StreamInfoCacheTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        char dir[] = "/tmp/eplayer_esi_XXXXXX";
+        ASSERT_TRUE(mkdtemp(dir) != NULL);
+        cacheDir = dir;
+    }
+
+    void TearDown() override {
+        std::string command = "rm -rf " + cacheDir;
+        system(command.c_str());
+    }
+
+    // 打开文件时文件头中的参数，withVideoSize和withExtradata为false时模拟需要探测的文件头
+    static AVFormatContext *openHeader(bool withVideoSize, bool withExtradata) {
+        AVFormatContext *ic = avformat_alloc_context();
+        ic->duration = 10 * AV_TIME_BASE;
+        AVStream *video = avformat_new_stream(ic, NULL);
+        video->id = 1;
+        video->time_base = (AVRational) {1, 90000};
+        video->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+        video->codecpar->codec_id = AV_CODEC_ID_H264;
+        if (withVideoSize) {
+            video->codecpar->width = 1280;
+            video->codecpar->height = 720;
+        }
+        if (withExtradata) {
+            video->codecpar->extradata = (uint8_t *) av_mallocz(sizeof(EXTRADATA) + AV_INPUT_BUFFER_PADDING_SIZE);
+            memcpy(video->codecpar->extradata, EXTRADATA, sizeof(EXTRADATA));
+            video->codecpar->extradata_size = sizeof(EXTRADATA);
+        }
+        AVStream *audio = avformat_new_stream(ic, NULL);
+        audio->id = 2;
+        audio->time_base = (AVRational) {1, 44100};
+        audio->codecpar->codec_type = AVMEDIA_TYPE_AUDIO;
+        audio->codecpar->codec_id = AV_CODEC_ID_AAC;
+        audio->codecpar->sample_rate = 44100;
+        audio->codecpar->channels = 2;
+        return ic;
+    }
+
+    // 模拟avformat_find_stream_info探测出来的参数
+    static void probe(AVFormatContext *ic) {
+        AVCodecParameters *par = ic->streams[0]->codecpar;
+        par->width = 1280;
+        par->height = 720;
+        par->format = AV_PIX_FMT_YUV420P;
+        par->profile = 100;
+        ic->streams[0]->avg_frame_rate = (AVRational) {25, 1};
+        ic->streams[1]->codecpar->format = AV_SAMPLE_FMT_FLTP;
+        ic->streams[1]->codecpar->channel_layout = AV_CH_LAYOUT_STEREO;
+        ic->start_time = 0;
+    }
+
+    int open(StreamInfoCache *cache, AVFormatContext *ic) {
+        return cache->open(ic, "http://example.com/video.mp4", cacheDir.c_str());
+    }
+
+    void saveProbed() {
+        AVFormatContext *ic = openHeader(true, true);
+        probe(ic);
+        StreamInfoCache cache;
+        ASSERT_EQ(0, open(&cache, ic));
+        ASSERT_EQ(0, cache.save(ic));
+        avformat_free_context(ic);
+    }
+
+    std::string cacheDir;
+};
+
+TEST_F(StreamInfoCacheTest, AppliesToCompleteHeader) {
+    saveProbed();
+    AVFormatContext *ic = openHeader(true, true);
+    StreamInfoCache cache;
+    ASSERT_EQ(0, open(&cache, ic));
+    ASSERT_EQ(0, cache.apply(ic));
+    AVCodecParameters *par = ic->streams[0]->codecpar;
+    EXPECT_EQ(AV_PIX_FMT_YUV420P, par->format);
+    EXPECT_EQ(100, par->profile);
+    ASSERT_EQ((int) sizeof(EXTRADATA), par->extradata_size);
+    EXPECT_EQ(0, memcmp(EXTRADATA, par->extradata, sizeof(EXTRADATA)));
+    EXPECT_EQ(25, ic->streams[0]->avg_frame_rate.num);
+    EXPECT_EQ(AV_SAMPLE_FMT_FLTP, ic->streams[1]->codecpar->format);
+    EXPECT_EQ(0, ic->start_time);
+    avformat_free_context(ic);
+}
+
+TEST_F(StreamInfoCacheTest, SkipsHeaderWithoutVideoSize) {
+    saveProbed();
+    AVFormatContext *ic = openHeader(false, true);
+    StreamInfoCache cache;
+    ASSERT_EQ(0, open(&cache, ic));
+    EXPECT_EQ(-1, cache.apply(ic));
+    // 不使用缓存时不修改媒体流
+    EXPECT_EQ(0, ic->streams[0]->codecpar->width);
+    EXPECT_EQ(-1, ic->streams[0]->codecpar->format);
+    avformat_free_context(ic);
+}
+
+TEST_F(StreamInfoCacheTest, SkipsHeaderWithoutExtradata) {
+    saveProbed();
+    AVFormatContext *ic = openHeader(true, false);
+    StreamInfoCache cache;
+    ASSERT_EQ(0, open(&cache, ic));
+    EXPECT_EQ(-1, cache.apply(ic));
+    EXPECT_EQ(0, ic->streams[0]->codecpar->extradata_size);
+    avformat_free_context(ic);
+}
+
+TEST_F(StreamInfoCacheTest, SkipsHeaderWithoutSampleRate) {
+    saveProbed();
+    AVFormatContext *ic = openHeader(true, true);
+    ic->streams[1]->codecpar->sample_rate = 0;
+    StreamInfoCache cache;
+    ASSERT_EQ(0, open(&cache, ic));
+    EXPECT_EQ(-1, cache.apply(ic));
+    avformat_free_context(ic);
+}
+
+TEST_F(StreamInfoCacheTest, IncompleteProbeIsNotSaved) {
+    AVFormatContext *ic = openHeader(true, true);
+    StreamInfoCache cache;
+    ASSERT_EQ(0, open(&cache, ic));
+    // 没有探测出像素格式
+    EXPECT_EQ(-1, cache.save(ic));
+    EXPECT_EQ(-1, cache.apply(ic));
+    avformat_free_context(ic);
+}
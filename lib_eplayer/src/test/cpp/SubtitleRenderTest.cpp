@@ -0,0 +1,163 @@
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <EGL/egl.h>
+#include "GLSubtitleFilter.h"
+
+// 离屏绘制的屏幕大小
+#define SURFACE_WIDTH 64
+#define SURFACE_HEIGHT 48
+// 软件渲染混合以后的取整误差
+#define COLOR_TOLERANCE 2
+
+// 背景颜色，蓝色
+static const uint8_t BACKGROUND[] = {0, 0, 255};
+
+// 2x2的字幕图像，预乘透明度，第一行不透明的红色，第二行半透明的白色
+static uint8_t SUBTITLE[] = {
+        255, 0, 0, 255, 255, 0, 0, 255,
+        128, 128, 128, 128, 128, 128, 128, 128,
+};
+// 半透明白色混合到蓝色背景以后的颜色：src + dst * (1 - srcAlpha)
+static const uint8_t BLENDED[] = {128, 128, 255};
+static const uint8_t RED[] = {255, 0, 0};
+
+/**
+ * 用EGL的pbuffer离屏绘制字幕，读回像素检查位置、方向和混合
+ * 主机上使用mesa的surfaceless平台，不需要窗口系统，没有可用的EGL时跳过
+ */
+class SubtitleRenderTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        setenv("EGL_PLATFORM", "surfaceless", 0);
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+            display = EGL_NO_DISPLAY;
+            GTEST_SKIP() << "没有可用的EGL";
+        }
+        const EGLint configAttribs[] = {
+                EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+                EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+                EGL_RED_SIZE, 8,
+                EGL_GREEN_SIZE, 8,
+                EGL_BLUE_SIZE, 8,
+                EGL_ALPHA_SIZE, 8,
+                EGL_NONE
+        };
+        EGLConfig config;
+        EGLint numConfigs = 0;
+        if (!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs < 1) {
+            GTEST_SKIP() << "没有支持pbuffer的GLES2配置";
+        }
+        const EGLint surfaceAttribs[] = {EGL_WIDTH, SURFACE_WIDTH, EGL_HEIGHT, SURFACE_HEIGHT, EGL_NONE};
+        surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+        const EGLint contextAttribs[] = {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE};
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+        ASSERT_NE(EGL_NO_SURFACE, surface);
+        ASSERT_NE(EGL_NO_CONTEXT, context);
+        ASSERT_TRUE(eglMakeCurrent(display, surface, surface, context));
+        filter = new GLSubtitleFilter();
+    }
+
+    void TearDown() override {
+        if (filter) {
+            filter->destroyProgram();
+            delete filter;
+        }
+        if (display != EGL_NO_DISPLAY) {
+            eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            if (context != EGL_NO_CONTEXT) {
+                eglDestroyContext(display, context);
+            }
+            if (surface != EGL_NO_SURFACE) {
+                eglDestroySurface(display, surface);
+            }
+            eglTerminate(display);
+        }
+    }
+
+    // 跟GLESDevice一样，视频画面绘制完以后叠加字幕
+    void render(int videoWidth, int videoHeight, float x, float y, float w, float h) {
+        filter->setTextureSize(videoWidth, videoHeight);
+        filter->setDisplaySize(SURFACE_WIDTH, SURFACE_HEIGHT);
+        filter->initProgram();
+        filter->nativeSurfaceChanged(SURFACE_WIDTH, SURFACE_HEIGHT);
+        filter->setSubtitle(SUBTITLE, 2, 2, x, y, w, h);
+        ASSERT_TRUE(filter->isInitialized());
+        ASSERT_TRUE(filter->hasSubtitle());
+
+        glViewport(0, 0, SURFACE_WIDTH, SURFACE_HEIGHT);
+        glClearColor(BACKGROUND[0] / 255.0f, BACKGROUND[1] / 255.0f, BACKGROUND[2] / 255.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        filter->drawSubtitle();
+        glFinish();
+        glReadPixels(0, 0, SURFACE_WIDTH, SURFACE_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        ASSERT_EQ(GL_NO_ERROR, glGetError());
+    }
+
+    // 读取屏幕像素，row从屏幕顶部开始计算，glReadPixels的第一行是屏幕底部
+    ::testing::AssertionResult pixelIs(int column, int row, const uint8_t *expected) {
+        const uint8_t *pixel = pixels[SURFACE_HEIGHT - 1 - row][column];
+        for (int i = 0; i < 3; i++) {
+            if (abs(pixel[i] - expected[i]) > COLOR_TOLERANCE) {
+                return ::testing::AssertionFailure()
+                        << "(" << column << ", " << row << ") = " << (int) pixel[0] << "," << (int) pixel[1]
+                        << "," << (int) pixel[2] << " expected " << (int) expected[0] << ","
+                        << (int) expected[1] << "," << (int) expected[2];
+            }
+        }
+        return ::testing::AssertionSuccess();
+    }
+
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLSurface surface = EGL_NO_SURFACE;
+    EGLContext context = EGL_NO_CONTEXT;
+    GLSubtitleFilter *filter = NULL;
+    uint8_t pixels[SURFACE_HEIGHT][SURFACE_WIDTH][4];
+};
+
+TEST_F(SubtitleRenderTest, BlendsAtNormalizedRectangle) {
+    // 视频跟屏幕宽高比相同，字幕占据横向16~48、纵向24~36像素，每行图像占6个像素
+    render(SURFACE_WIDTH, SURFACE_HEIGHT, 0.25f, 0.5f, 0.5f, 0.25f);
+
+    // 图像第一行在上面
+    EXPECT_TRUE(pixelIs(17, 25, RED));
+    EXPECT_TRUE(pixelIs(46, 25, RED));
+    EXPECT_TRUE(pixelIs(17, 34, BLENDED));
+    EXPECT_TRUE(pixelIs(46, 34, BLENDED));
+
+    // 四边形外面保持背景
+    EXPECT_TRUE(pixelIs(15, 30, BACKGROUND));
+    EXPECT_TRUE(pixelIs(48, 30, BACKGROUND));
+    EXPECT_TRUE(pixelIs(30, 23, BACKGROUND));
+    EXPECT_TRUE(pixelIs(30, 36, BACKGROUND));
+    EXPECT_TRUE(pixelIs(0, 0, BACKGROUND));
+    EXPECT_TRUE(pixelIs(SURFACE_WIDTH - 1, SURFACE_HEIGHT - 1, BACKGROUND));
+}
+
+TEST_F(SubtitleRenderTest, FollowsVideoFitMatrix) {
+    // 视频比屏幕宽，上下留黑边，画面在纵向12~36像素，字幕在画面底部四分之一，也就是屏幕纵向30~36像素
+    render(SURFACE_WIDTH, SURFACE_HEIGHT / 2, 0.0f, 0.75f, 1.0f, 0.25f);
+
+    EXPECT_TRUE(pixelIs(1, 30, RED));
+    EXPECT_TRUE(pixelIs(SURFACE_WIDTH - 2, 30, RED));
+    EXPECT_TRUE(pixelIs(1, 35, BLENDED));
+    EXPECT_TRUE(pixelIs(SURFACE_WIDTH - 2, 35, BLENDED));
+
+    // 画面下方的黑边和字幕上方的画面区域没有字幕
+    EXPECT_TRUE(pixelIs(30, 29, BACKGROUND));
+    EXPECT_TRUE(pixelIs(30, 36, BACKGROUND));
+    EXPECT_TRUE(pixelIs(30, SURFACE_HEIGHT - 1, BACKGROUND));
+}
+
+TEST_F(SubtitleRenderTest, ClearedSubtitleIsNotDrawn) {
+    render(SURFACE_WIDTH, SURFACE_HEIGHT, 0.0f, 0.0f, 1.0f, 1.0f);
+    EXPECT_TRUE(pixelIs(30, 10, RED));
+
+    filter->setSubtitle(NULL, 0, 0, 0, 0, 0, 0);
+    EXPECT_FALSE(filter->hasSubtitle());
+    glClear(GL_COLOR_BUFFER_BIT);
+    filter->drawSubtitle();
+    glReadPixels(0, 0, SURFACE_WIDTH, SURFACE_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    EXPECT_TRUE(pixelIs(30, 10, BACKGROUND));
+}
@@ -0,0 +1,180 @@
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include "VideoDecoder.h"
+
+// 每次定位以后送入的数据包数量，比帧队列深度多，解码线程会阻塞在帧队列上
+#define SEEK_PACKETS 8
+// 每次定位以后显示的帧数，显示完以后帧队列仍然是满的
+#define SEEK_SHOWN_FRAMES 2
+// 测试用的帧间隔，25fps，单位毫秒
+#define FRAME_INTERVAL_MS 40
+// 等待一帧或者一条消息的超时时间，单位微秒
+#define WAIT_TIMEOUT (2 * 1000 * 1000)
+
+/**
+ * 测试用的解码器，每个数据包立即解码出一帧，帧数据的第一个字节是数据包所属的定位序号
+ */
+static int fakeDecode(AVCodecContext *avctx, void *data, int *got_frame, AVPacket *pkt) {
+    AVFrame *frame = (AVFrame *) data;
+    frame->width = avctx->width;
+    frame->height = avctx->height;
+    frame->format = avctx->pix_fmt;
+    int ret = av_frame_get_buffer(frame, 32);
+    if (ret < 0) {
+        return ret;
+    }
+    frame->data[0][0] = pkt->data[0];
+    frame->pts = pkt->pts;
+    frame->key_frame = 1;
+    frame->pict_type = AV_PICTURE_TYPE_I;
+    *got_frame = 1;
+    return pkt->size;
+}
+
+static AVCodec *getFakeCodec() {
+    static AVCodec codec;
+    if (!codec.decode) {
+        codec.name = "eplayer_fake";
+        codec.long_name = "eplayer fake video decoder";
+        codec.type = AVMEDIA_TYPE_VIDEO;
+        codec.id = AV_CODEC_ID_RAWVIDEO;
+        codec.decode = fakeDecode;
+    }
+    return &codec;
+}
+
+/**
+ * 模拟读数据包线程的定位流程和同步线程的显示流程，解码线程使用真实的VideoDecoder
+ */
+class VideoDecoderSeekTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        pFormatCtx = avformat_alloc_context();
+        ASSERT_TRUE(pFormatCtx != NULL);
+        stream = avformat_new_stream(pFormatCtx, NULL);
+        ASSERT_TRUE(stream != NULL);
+        stream->time_base = (AVRational) {1, 1000};
+        stream->avg_frame_rate = (AVRational) {1000 / FRAME_INTERVAL_MS, 1};
+        stream->r_frame_rate = stream->avg_frame_rate;
+
+        AVCodec *codec = getFakeCodec();
+        AVCodecContext *avctx = avcodec_alloc_context3(codec);
+        ASSERT_TRUE(avctx != NULL);
+        avctx->width = 16;
+        avctx->height = 16;
+        avctx->pix_fmt = AV_PIX_FMT_GRAY8;
+        avctx->time_base = stream->time_base;
+        ASSERT_EQ(0, avcodec_open2(avctx, codec, NULL));
+
+        playerState = new PlayerState();
+        playerState->abortRequest = 0;
+        playerState->messageQueue->start();
+        decoder = new VideoDecoder(pFormatCtx, avctx, stream, 0, playerState);
+        decoder->start();
+    }
+
+    void TearDown() override {
+        decoder->stop();
+        delete decoder;
+        delete playerState;
+        avformat_free_context(pFormatCtx);
+    }
+
+    static int64_t framePts(int serial, int index) {
+        return (int64_t) serial * 100000 + index * FRAME_INTERVAL_MS;
+    }
+
+    // 按照读数据包线程的顺序定位：清空解码器，设置精确定位目标，送入新位置的数据包，最后清除定位请求
+    void seek(int serial, int64_t target) {
+        playerState->seekRequest = 1;
+        playerState->signalGate();
+        decoder->flush();
+        if (target != AV_NOPTS_VALUE) {
+            decoder->setSeekTarget(target);
+        }
+        for (int i = 0; i < SEEK_PACKETS; i++) {
+            AVPacket pkt;
+            ASSERT_EQ(0, av_new_packet(&pkt, 16));
+            pkt.data[0] = (uint8_t) serial;
+            pkt.pts = framePts(serial, i);
+            pkt.dts = pkt.pts;
+            pkt.duration = FRAME_INTERVAL_MS;
+            pkt.pos = i;
+            pkt.flags = AV_PKT_FLAG_KEY;
+            pkt.stream_index = 0;
+            ASSERT_EQ(0, decoder->pushPacket(&pkt));
+        }
+        playerState->seekRequest = 0;
+        playerState->signalGate();
+    }
+
+    // 跟同步线程一样取出下一帧显示，返回帧所属的定位序号
+    int showFrame(double *pts, int *seekFrame) {
+        FrameQueue *frameQueue = decoder->getFrameQueue();
+        for (int waited = 0; frameQueue->getFrameSize() <= 0; waited += 1000) {
+            if (waited >= WAIT_TIMEOUT) {
+                return -1;
+            }
+            usleep(1000);
+        }
+        Frame *vp = frameQueue->currentFrame();
+        int serial = vp->frame->data[0][0];
+        *pts = vp->pts;
+        *seekFrame = vp->seekFrame;
+        frameQueue->popFrame();
+        return serial;
+    }
+
+    // 等待定位完成的消息，返回定位位置，单位毫秒
+    int waitSeekComplete() {
+        AVMessage msg;
+        for (int waited = 0; waited < WAIT_TIMEOUT; waited += 1000) {
+            while (playerState->messageQueue->getMessage(&msg, 0) > 0) {
+                int what = msg.what;
+                int pos = msg.arg1;
+                message_free_resouce(&msg);
+                if (what == MSG_SEEK_COMPLETE) {
+                    return pos;
+                }
+            }
+            usleep(1000);
+        }
+        return -1;
+    }
+
+    AVFormatContext *pFormatCtx;
+    AVStream *stream;
+    PlayerState *playerState;
+    VideoDecoder *decoder;
+};
+
+TEST_F(VideoDecoderSeekTest, RepeatedSeeksNeverShowEarlierFrames) {
+    for (int serial = 1; serial <= 60; serial++) {
+        seek(serial, AV_NOPTS_VALUE);
+        for (int i = 0; i < SEEK_SHOWN_FRAMES; i++) {
+            double pts;
+            int seekFrame;
+            ASSERT_EQ(serial, showFrame(&pts, &seekFrame)) << "frame " << i << " after seek " << serial;
+            EXPECT_DOUBLE_EQ(framePts(serial, i) / 1000.0, pts);
+            EXPECT_EQ(i == 0, seekFrame != 0);
+        }
+    }
+}
+
+TEST_F(VideoDecoderSeekTest, RepeatedAccurateSeeksCompleteOnTargetFrame) {
+    for (int serial = 1; serial <= 60; serial++) {
+        // 目标在第三帧的中间，前两帧在目标之前结束，会被丢弃
+        int64_t targetMs = framePts(serial, 2) + FRAME_INTERVAL_MS / 2;
+        seek(serial, targetMs * 1000);
+        double pts;
+        int seekFrame;
+        ASSERT_EQ(serial, showFrame(&pts, &seekFrame)) << "seek " << serial;
+        EXPECT_DOUBLE_EQ(framePts(serial, 2) / 1000.0, pts);
+        EXPECT_TRUE(seekFrame);
+        // 每次定位都要通知完成，并且是这一次定位的位置
+        ASSERT_EQ(targetMs, waitSeekComplete()) << "seek " << serial;
+        ASSERT_EQ(serial, showFrame(&pts, &seekFrame));
+        EXPECT_DOUBLE_EQ(framePts(serial, 3) / 1000.0, pts);
+    }
+}
@@ -0,0 +1,15 @@
+#ifndef EPLAYER_HOST_ANDROID_LOG_H
+#define EPLAYER_HOST_ANDROID_LOG_H
+
+/**
+ * 主机上编译单元测试时代替NDK的android/log.h，没有定义__ANDROID__时LOGD等宏为空，只需要声明
+ */
+enum {
+    ANDROID_LOG_VERBOSE = 2,
+    ANDROID_LOG_DEBUG,
+    ANDROID_LOG_INFO,
+    ANDROID_LOG_WARN,
+    ANDROID_LOG_ERROR
+};
+
+#endif //EPLAYER_HOST_ANDROID_LOG_H